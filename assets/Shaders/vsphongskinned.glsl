@@ -57,6 +57,8 @@ mat4 loadBoneTransform()
         int index;
         getJointDetails(i, weight, index);
 
+        // Packed buffers with four influences or less leave the second vectors disabled, which read as (0, 0, 0, 1).
+        // Only stopping at the first zero weight keeps that last 1 out, the weights are sorted so none follows a zero.
         if (weight == 0.0f)
             break;
 
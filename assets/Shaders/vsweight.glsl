@@ -98,6 +98,8 @@ vec4 computeJointColor()
     for (int i = 0; i < JOINTCOUNT; i++)
     {
         getJointDetails(i, jointWeight, jointID);
+        // Packed buffers with four influences or less leave the second vectors disabled, which read as (0, 0, 0, 1).
+        // Only stopping at the first zero weight keeps that last 1 out, the weights are sorted so none follows a zero.
         if (jointWeight == 0.0f)
             break;
 
@@ -15,6 +15,8 @@ struct Animation
 
 	float duration; //in seconds
 	float ticksPerSecond;
+	// Capture time of key time 0 in seconds, set on the segments of a capture too long for float key times
+	double timeOffset = 0.0;
 	std::map<std::string, AnimationCurve> animNodeMapping; //nodename => animcurve
 	std::string name;
 	std::string path;
@@ -22,8 +24,16 @@ struct Animation
 
 	std::string ToString();
 
+	// Converts every curve to dense tracks at the given rate, see AnimationCurve::Resample
+	void Resample(float sampleRate);
+
 	static Animation* LoadFromPath(const std::string& path /*, int animIndex*/);
-	static void SaveToPath(const std::string& sourcePath, const Animation& animation, const std::string& path);
+	// Converts the first animation of a scene imported from the path, so a scene read for other reasons is not imported twice
+	static Animation* FromScene(const aiScene* scene, const std::string& path);
+	// Writes the animation as collada, the node hierarchy is taken from the skeleton file which is only read once per file
+	static void SaveToPath(const std::string& skeletonPath, const Animation& animation, const std::string& path);
+	// Writes consecutive segments of one capture into a single file, the key times get their offset added in double precision
+	static void SaveToPath(const std::string& skeletonPath, const std::vector<const Animation*>& segments, const std::string& path);
 
 	AnimationCurve GetAnimationCurve(std::string name) const { return animNodeMapping.at(name); }
 };
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "AnimationChunkReader.h"
+#include "Customizable/JointnameParser.h"
+#include "Utils.h"
+#include <QDebug>
+#include <algorithm>
+
+namespace
+{
+	// Index range of the keys needed to interpolate every time in [from, to]
+	template<class Key>
+	void FindKeyRange(const Key* keys, unsigned int keyCount, double from, double to, unsigned int& first, unsigned int& last)
+	{
+		const Key* begin = keys;
+		const Key* end = keys + keyCount;
+		const Key* lower = std::upper_bound(begin, end, from, [](double time, const Key& key) { return time < key.mTime; });
+		const Key* upper = std::lower_bound(begin, end, to, [](const Key& key, double time) { return key.mTime < time; });
+
+		first = lower == begin ? 0 : (unsigned int)(lower - begin) - 1;
+		last = upper == end ? keyCount - 1 : (unsigned int)(upper - begin);
+	}
+}
+
+AnimationChunkReader::AnimationChunkReader(const std::string& path) : scene(nullptr), duration(0.0), secondsPerTick(1.0), path(path)
+{
+	if (!Utils::FileExists(path))
+	{
+		qDebug() << "Could not read animation chunks: File does not exist";
+		return;
+	}
+
+	// Assimp has no streaming import, the raw scene is kept and only the chunks get converted
+	scene = aiImportFile(path.c_str(), aiProcessPreset_TargetRealtime_Fast | aiProcess_TransformUVCoords);
+	if (!scene || scene->mNumAnimations == 0)
+	{
+		qDebug() << "Could not read animation chunks: File contains no animations";
+		return;
+	}
+
+	const aiAnimation* animation = scene->mAnimations[0];
+	secondsPerTick = animation->mTicksPerSecond != 0.0 ? 1.0 / animation->mTicksPerSecond : 1.0;
+	duration = animation->mDuration * secondsPerTick;
+	name = Utils::FilenameFromPath(path, false, "/\\");
+	filename = Utils::FilenameFromPath(path, true, "/\\");
+}
+
+AnimationChunkReader::~AnimationChunkReader()
+{
+	if (scene)
+		aiReleaseImport(scene);
+}
+
+Animation* AnimationChunkReader::ReadRange(double from, double to) const
+{
+	if (!IsValid())
+		return nullptr;
+
+	const aiAnimation* source = scene->mAnimations[0];
+
+	Animation* animation = new Animation();
+	animation->name = name;
+	animation->filename = filename;
+	// The keys of the chunk are in seconds
+	animation->ticksPerSecond = 1.0;
+	animation->duration = to - from;
+
+	double fromTicks = from / secondsPerTick;
+	double toTicks = to / secondsPerTick;
+	unsigned int first;
+	unsigned int last;
+	for (unsigned int j = 0; j < source->mNumChannels; j++)
+	{
+		const aiNodeAnim* channel = source->mChannels[j];
+
+		AnimationCurve curve;
+		curve.name = JointnameParser::ExtractJointName(channel->mNodeName);
+
+		if (channel->mNumPositionKeys > 0)
+		{
+			FindKeyRange(channel->mPositionKeys, channel->mNumPositionKeys, fromTicks, toTicks, first, last);
+			for (unsigned int k = first; k <= last; k++)
+			{
+				const aiVectorKey& key = channel->mPositionKeys[k];
+				curve.positions.push_back(AnimationCurve::VectorAnimationKey(key.mTime * secondsPerTick - from, Vector3(key.mValue.x, key.mValue.y, key.mValue.z)));
+			}
+		}
+
+		if (channel->mNumRotationKeys > 0)
+		{
+			FindKeyRange(channel->mRotationKeys, channel->mNumRotationKeys, fromTicks, toTicks, first, last);
+			for (unsigned int k = first; k <= last; k++)
+			{
+				const aiQuatKey& key = channel->mRotationKeys[k];
+				curve.rotations.push_back(AnimationCurve::QuaternionAnimationKey(key.mTime * secondsPerTick - from, Quaternion(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w)));
+			}
+		}
+
+		if (channel->mNumScalingKeys > 0)
+		{
+			FindKeyRange(channel->mScalingKeys, channel->mNumScalingKeys, fromTicks, toTicks, first, last);
+			for (unsigned int k = first; k <= last; k++)
+			{
+				const aiVectorKey& key = channel->mScalingKeys[k];
+				curve.scalings.push_back(AnimationCurve::VectorAnimationKey(key.mTime * secondsPerTick - from, Vector3(key.mValue.x, key.mValue.y, key.mValue.z)));
+			}
+		}
+
+		curve.Classify();
+		animation->animNodeMapping[curve.name] = curve;
+	}
+
+	return animation;
+}
+
+Animation* AnimationChunkReader::ReadAll() const
+{
+	return IsValid() ? Animation::FromScene(scene, path) : nullptr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include "Animation.h"
+
+/// <summary>
+/// Cuts a long capture into animations covering short time ranges.
+/// Key times are kept in double precision until they are rebased onto the start of the range,
+/// so the resulting chunks keep full float precision regardless of the capture length.
+/// </summary>
+class AnimationChunkReader
+{
+public:
+	AnimationChunkReader(const std::string& path);
+	~AnimationChunkReader();
+
+	bool IsValid() const { return scene != nullptr && scene->mNumAnimations > 0; }
+	// Length of the capture in seconds
+	double GetDuration() const { return duration; }
+	const std::string& GetName() const { return name; }
+	const std::string& GetFilename() const { return filename; }
+
+	/// <summary>
+	/// Creates an animation holding the keys of the given range, including one key on both sides for interpolation
+	/// </summary>
+	/// <param name="from">Start of the range in seconds, becomes time 0 of the chunk</param>
+	/// <param name="to">End of the range in seconds</param>
+	Animation* ReadRange(double from, double to) const;
+	// Converts the whole capture like Animation::LoadFromPath, for captures short enough to be read at once
+	Animation* ReadAll() const;
+private:
+	AnimationChunkReader(const AnimationChunkReader&);
+
+	const aiScene* scene;
+	double duration;
+	// Converts the tick times of the file into seconds
+	double secondsPerTick;
+	std::string name;
+	std::string filename;
+	std::string path;
+};
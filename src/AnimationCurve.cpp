@@ -1,8 +1,33 @@
 #include "AnimationCurve.h"
 #include <QDebug>
+#include <cmath>
 #include "Customizable/JointnameParser.h"
 
-AnimationCurve::AnimationCurve(aiNodeAnim* aiNodeAnim)
+namespace
+{
+	// Keys closer than this to the value predicted for them count as equal, relative to the size of the values
+	const float ChannelTolerance = 1e-5f;
+
+	bool NearlyEqual(const Vector3& a, const Vector3& b, float scale)
+	{
+		float tolerance = ChannelTolerance * scale;
+		return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+	}
+
+	bool NearlyEqual(const Quaternion& a, const Quaternion& b)
+	{
+		// q and -q are the same rotation
+		float sign = a.dot(b) < 0.0f ? -1.0f : 1.0f;
+		return std::abs(a.x - sign * b.x) <= ChannelTolerance && std::abs(a.y - sign * b.y) <= ChannelTolerance
+			&& std::abs(a.z - sign * b.z) <= ChannelTolerance && std::abs(a.w - sign * b.w) <= ChannelTolerance;
+	}
+}
+
+AnimationCurve::AnimationCurve(aiNodeAnim* aiNodeAnim) :
+	positionType(ChannelType::General),
+	rotationType(ChannelType::General),
+	scalingType(ChannelType::General),
+	constantTransform(Matrix::identity)
 {
 	name = JointnameParser::ExtractJointName(aiNodeAnim->mNodeName);
 
@@ -12,4 +37,92 @@ AnimationCurve::AnimationCurve(aiNodeAnim* aiNodeAnim)
 		rotations.push_back(QuaternionAnimationKey(aiNodeAnim->mRotationKeys[k]));
 	for (int k = 0; k < aiNodeAnim->mNumScalingKeys; k++)
 		scalings.push_back(VectorAnimationKey(aiNodeAnim->mScalingKeys[k]));
+}
+
+void AnimationCurve::Classify()
+{
+	positionType = ClassifyVectors(positions);
+	rotationType = ClassifyQuaternions(rotations);
+	scalingType = ClassifyVectors(scalings);
+
+	constantPose = RigidTransform();
+	constantTransform = Matrix::identity;
+	if (IsConstant())
+	{
+		constantPose = RigidTransform(rotations.front().value, positions.front().value, scalings.front().value);
+		constantTransform = constantPose.ToMatrix();
+	}
+}
+
+AnimationCurve::ChannelType AnimationCurve::ClassifyVectors(const std::vector<VectorAnimationKey>& keys)
+{
+	// Empty channels keep going through the keys as before
+	if (keys.empty())
+		return ChannelType::General;
+
+	const VectorAnimationKey& first = keys.front();
+	const VectorAnimationKey& last = keys.back();
+	float scale = 1.0f + std::max(first.value.length(), last.value.length());
+
+	bool constant = true;
+	bool linear = true;
+	for (const VectorAnimationKey& key : keys)
+	{
+		constant = constant && NearlyEqual(key.value, first.value, scale);
+		linear = linear && NearlyEqual(key.value, Vector3::interpolate(first.value, last.value, GetLinearFactor(key.time, first, last)), scale);
+		if (!linear)
+			return ChannelType::General;
+	}
+	return constant ? ChannelType::Constant : ChannelType::Linear;
+}
+
+AnimationCurve::ChannelType AnimationCurve::ClassifyQuaternions(const std::vector<QuaternionAnimationKey>& keys)
+{
+	if (keys.empty())
+		return ChannelType::General;
+
+	const QuaternionAnimationKey& first = keys.front();
+	const QuaternionAnimationKey& last = keys.back();
+
+	bool constant = true;
+	bool linear = true;
+	for (const QuaternionAnimationKey& key : keys)
+	{
+		constant = constant && NearlyEqual(key.value, first.value);
+		linear = linear && NearlyEqual(key.value, Quaternion::interpolate(first.value, last.value, GetLinearFactor(key.time, first, last)));
+		if (!linear)
+			return ChannelType::General;
+	}
+	return constant ? ChannelType::Constant : ChannelType::Linear;
+}
+
+void AnimationCurve::Resample(float sampleRate, float duration)
+{
+	ClearResampled();
+	if (sampleRate <= 0.0f)
+		return;
+
+	resampled.sampleRate = sampleRate;
+	size_t sampleCount = (size_t)std::ceil(std::max(0.0f, duration) * sampleRate) + 1;
+
+	if (!positions.empty())
+	{
+		resampled.positions.reserve(sampleCount);
+		for (size_t i = 0; i < sampleCount; i++)
+			resampled.positions.push_back(VectorAnimationKey::Interpolate(i / sampleRate, positions));
+	}
+
+	if (!rotations.empty())
+	{
+		resampled.rotations.reserve(sampleCount);
+		for (size_t i = 0; i < sampleCount; i++)
+			resampled.rotations.push_back(QuaternionAnimationKey::Interpolate(i / sampleRate, rotations));
+	}
+
+	if (!scalings.empty())
+	{
+		resampled.scalings.reserve(sampleCount);
+		for (size_t i = 0; i < sampleCount; i++)
+			resampled.scalings.push_back(VectorAnimationKey::Interpolate(i / sampleRate, scalings));
+	}
 }
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include <vector>
 #include "vector.h"
 #include "Quaternion.h"
+#include "RigidTransform.h"
 #include <cassert>
+#include <algorithm>
 
 struct AnimationCurve
 {
@@ -110,17 +112,124 @@ struct AnimationCurve
 		}
 	};
 
+	// Channels sampled at a fixed rate starting at time 0, so a sample is found by index arithmetic.
+	// An empty channel falls back to the keys.
+	struct ResampledTrack
+	{
+		float sampleRate = 0.0f;
+		std::vector<Vector3> positions;
+		std::vector<Quaternion> rotations;
+		std::vector<Vector3> scalings;
+
+		// Finds the sample before the time and the interpolation factor towards the next one
+		void FindSample(float time, size_t sampleCount, size_t& index, float& t) const
+		{
+			float position = std::max(0.0f, time * sampleRate);
+			index = (size_t)position;
+			if (index + 1 >= sampleCount)
+			{
+				index = sampleCount - 1;
+				t = 0.0f;
+				return;
+			}
+			t = position - index;
+		}
+
+		Vector3 SampleVector(float time, const std::vector<Vector3>& samples) const
+		{
+			size_t index;
+			float t;
+			FindSample(time, samples.size(), index, t);
+			if (t == 0.0f)
+				return samples[index];
+			return Vector3::interpolate(samples[index], samples[index + 1], t);
+		}
+
+		Quaternion SampleQuaternion(float time, const std::vector<Quaternion>& samples) const
+		{
+			size_t index;
+			float t;
+			FindSample(time, samples.size(), index, t);
+			if (t == 0.0f)
+				return samples[index];
+			// Neighbouring samples are close, so nlerp is as good as slerp here
+			return Quaternion::Lerp(samples[index], samples[index + 1], t);
+		}
+	};
+
+	// How a channel gets evaluated. Constant channels return their first key, linear ones interpolate
+	// between the first and the last key without a key search, general ones go through all keys.
+	enum class ChannelType { Constant, Linear, General };
+
 #pragma endregion Internal_Datastructures
 
-	AnimationCurve() : name("") {}
+	AnimationCurve() : name(""), positionType(ChannelType::General), rotationType(ChannelType::General), scalingType(ChannelType::General), constantTransform(Matrix::identity) {}
 	AnimationCurve(aiNodeAnim* aiNodeAnim);
 
-	Vector3 GetPosition(const float& time) const { return VectorAnimationKey::Interpolate(time, positions); }
-	Quaternion GetRotation(const float& time) const { return QuaternionAnimationKey::Interpolate(time, rotations); }
-	Vector3 GetScale(const float& time) const { return VectorAnimationKey::Interpolate(time, scalings); }
+	Vector3 GetPosition(const float& time) const
+	{
+		if (positionType != ChannelType::General)
+			return positionType == ChannelType::Constant ? positions.front().value : Vector3::interpolate(positions.front().value, positions.back().value, GetLinearFactor(time, positions.front(), positions.back()));
+		return resampled.positions.empty() ? VectorAnimationKey::Interpolate(time, positions) : resampled.SampleVector(time, resampled.positions);
+	}
+	Quaternion GetRotation(const float& time) const
+	{
+		if (rotationType != ChannelType::General)
+			return rotationType == ChannelType::Constant ? rotations.front().value : Quaternion::interpolate(rotations.front().value, rotations.back().value, GetLinearFactor(time, rotations.front(), rotations.back()));
+		return resampled.rotations.empty() ? QuaternionAnimationKey::Interpolate(time, rotations) : resampled.SampleQuaternion(time, resampled.rotations);
+	}
+	Vector3 GetScale(const float& time) const
+	{
+		if (scalingType != ChannelType::General)
+			return scalingType == ChannelType::Constant ? scalings.front().value : Vector3::interpolate(scalings.front().value, scalings.back().value, GetLinearFactor(time, scalings.front(), scalings.back()));
+		return resampled.scalings.empty() ? VectorAnimationKey::Interpolate(time, scalings) : resampled.SampleVector(time, resampled.scalings);
+	}
+
+	/// <summary>
+	/// The local pose of the node at the given time. A curve with only constant channels returns the pose folded by Classify.
+	/// </summary>
+	RigidTransform GetLocalPose(float time) const { return IsConstant() ? constantPose : RigidTransform(GetRotation(time), GetPosition(time), GetScale(time)); }
+	// Same as GetLocalPose as a matrix
+	Matrix GetLocalTransform(float time) const { return IsConstant() ? constantTransform : GetLocalPose(time).ToMatrix(); }
+
+	/// <summary>
+	/// Finds the constant and linear channels, called once the keys of a loaded clip are complete.
+	/// Curves which are not classified evaluate every channel through its keys. Classify again after editing the keys.
+	/// </summary>
+	void Classify();
+	ChannelType GetPositionType() const { return positionType; }
+	ChannelType GetRotationType() const { return rotationType; }
+	ChannelType GetScalingType() const { return scalingType; }
+	bool IsConstant() const { return positionType == ChannelType::Constant && rotationType == ChannelType::Constant && scalingType == ChannelType::Constant; }
+
+	/// <summary>
+	/// Samples the keys into dense tracks used for all further lookups. The keys stay untouched for export.
+	/// </summary>
+	/// <param name="sampleRate">Samples per second</param>
+	/// <param name="duration">The length of the animation in seconds</param>
+	void Resample(float sampleRate, float duration);
+	void ClearResampled() { resampled = ResampledTrack(); }
+	bool IsResampled() const { return resampled.sampleRate > 0.0f; }
 
 	std::string name;
 	std::vector<VectorAnimationKey> positions;
 	std::vector<QuaternionAnimationKey> rotations;
 	std::vector<VectorAnimationKey> scalings;
+	ResampledTrack resampled;
+private:
+	static float GetLinearFactor(float time, const AnimationKey& first, const AnimationKey& last)
+	{
+		if (last.time <= first.time)
+			return 0.0f;
+		return std::clamp((time - first.time) / (last.time - first.time), 0.0f, 1.0f);
+	}
+	static ChannelType ClassifyVectors(const std::vector<VectorAnimationKey>& keys);
+	static ChannelType ClassifyQuaternions(const std::vector<QuaternionAnimationKey>& keys);
+
+	ChannelType positionType;
+	ChannelType rotationType;
+	ChannelType scalingType;
+	// The whole local transform if every channel is constant
+	RigidTransform constantPose;
+	Matrix constantTransform;
 };
\ No newline at end of file
@@ -99,7 +99,8 @@ void Animator::SetAnimationTime(float time, bool force)
 		return;
 
 	animationTime = time;
-	UpdateAnimation(animationTime/* * animation->ticksPerSecond*/, &model->GetRoot(), Matrix::identity);
+	modelPose = RigidTransform::FromMatrix(model->getGlobalTransform());
+	UpdateAnimation(animationTime/* * animation->ticksPerSecond*/, &model->GetRoot(), RigidTransform::identity);
 	model->UpdateBoneAnimation();
 }
 
@@ -137,6 +138,25 @@ void Animator::Stop()
 	SetNormalizedAnimationTime(0.0f);
 }
 
+void Animator::SetRequiredJoints(const std::set<std::string>& joints)
+{
+	requiredNodes.clear();
+	if (!joints.empty())
+		MarkRequiredNodes(&model->GetRoot(), joints);
+}
+
+bool Animator::MarkRequiredNodes(const MeshModel::Node* node, const std::set<std::string>& joints)
+{
+	// Every child is visited, a node is required if any joint below it is
+	bool required = joints.count(node->Name) > 0;
+	for (int i = 0; i < node->ChildCount; i++)
+		required = MarkRequiredNodes(&node->Children[i], joints) || required;
+
+	if (required)
+		requiredNodes.insert(node);
+	return required;
+}
+
 const MeshModel::Node* Animator::GetRootNode()
 {
 	return &model->GetRoot();
@@ -178,33 +198,39 @@ Matrix Animator::GetNodeTransform(float time, std::string nodeName)
 	return model->GetJointMapping().at(nodeName).transform;
 }
 
-void Animator::UpdateAnimation(float time, const MeshModel::Node* node, const Matrix& parentTransform)
+void Animator::UpdateAnimation(float time, const MeshModel::Node* node, const RigidTransform& parentPose)
 {
-	std::string nodeName = node->Name;
-	Matrix nodeTransform = node->Trans;
+	const std::string& nodeName = node->Name;
+	RigidTransform nodePose = node->Pose;
 
-	if (animation->animNodeMapping.find(nodeName) != animation->animNodeMapping.end())
-	{
-		const AnimationCurve& animNode = animation->animNodeMapping.at(nodeName);
-		Matrix scalingMatrix = Matrix().scale(InterpolateVector(time, animNode.scalings));
-		Matrix rotationMatrix = InterpolateQuaternion(time, animNode.rotations).toRotationMatrix();
-		Matrix translationMatrix = Matrix().translation(InterpolateVector(time, animNode.positions));
-		nodeTransform = translationMatrix * rotationMatrix * scalingMatrix;
-	}
+	// Goes through the curve, so resampled tracks and the constant channels found at load are used
+	auto curve = animation->animNodeMapping.find(nodeName);
+	if (curve != animation->animNodeMapping.end())
+		nodePose = curve->second.GetLocalPose(time);
 
-	Matrix meshTransform = parentTransform * nodeTransform;
+	// The hierarchy is composed as poses, matrices are only built for the joints
+	RigidTransform meshPose = parentPose * nodePose;
 
 	auto& jointMapping = model->GetJointMapping();
-	if (jointMapping.find(nodeName) != jointMapping.end())
+	auto joint = jointMapping.find(nodeName);
+	if (joint != jointMapping.end())
 	{
-		SkinnedModel::JointInfo& info = jointMapping.at(nodeName);
-		info.transform = model->GetInverseMeshTransform() * meshTransform * info.offset;
-		info.localTransform = nodeTransform;
-		info.globalTransform = model->getGlobalTransform() * meshTransform;
+		SkinnedModel::JointInfo& info = joint->second;
+		info.localPose = nodePose;
+		info.globalPose = modelPose * meshPose;
+		info.transform = model->GetInverseMeshTransform() * meshPose.ToMatrix() * info.offset;
+		info.localTransform = nodePose.ToMatrix();
+		info.globalTransform = info.globalPose.ToMatrix();
 	}
 
 	for (int i = 0; i < node->ChildCount; i++)
-		UpdateAnimation(time, &node->Children[i], meshTransform);
+	{
+		// Subtrees without a required joint are skipped
+		const MeshModel::Node* child = &node->Children[i];
+		if (!requiredNodes.empty() && requiredNodes.find(child) == requiredNodes.end())
+			continue;
+		UpdateAnimation(time, child, meshPose);
+	}
 }
 
 void Animator::DefaultPose()
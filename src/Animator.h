@@ -3,6 +3,8 @@
 #include "vector.h"
 #include "Quaternion.h"
 #include <vector>
+#include <set>
+#include <unordered_set>
 #include "Animation.h"
 #include <assimp\scene.h>
 #include "SkinnedModel.h"
@@ -18,6 +20,10 @@ class Animator
 	//Matrix globalInverseTransform;
 	bool isPlaying;
 	bool loopAnimation;
+	// The required joints and their ancestors, empty if every node gets evaluated
+	std::unordered_set<const MeshModel::Node*> requiredNodes;
+	// Placement of the model, split once per update
+	RigidTransform modelPose;
 public:
 	float speed;
 
@@ -43,10 +49,17 @@ public:
 	bool HasAnimation() { return animation != NULL; };
 	float NormalizedTime();
 	SkinnedModel* GetModel() { return model; }
+
+	/// <summary>
+	/// Restricts the evaluation to the given joints and their ancestors. The other joints keep their last pose.
+	/// </summary>
+	/// <param name="joints">Joint names of the model, empty evaluates every joint again</param>
+	void SetRequiredJoints(const std::set<std::string>& joints);
 private:
+	bool MarkRequiredNodes(const MeshModel::Node* node, const std::set<std::string>& joints);
 	static float GetInterpolationTime(const AnimationCurve::AnimationKey& from, const AnimationCurve::AnimationKey& to, const float time);
 	Matrix GetNodeTransform(float time, std::string nodeName);
-	void UpdateAnimation(float time, const MeshModel::Node* node, const Matrix& parentTransform);
+	void UpdateAnimation(float time, const MeshModel::Node* node, const RigidTransform& parentPose);
 	void DefaultPose();
 	Quaternion InterpolateQuaternion(float time, const std::vector<AnimationCurve::QuaternionAnimationKey>& quatKey) const;
 	Vector3 InterpolateVector(float time, const std::vector<AnimationCurve::VectorAnimationKey>& vectorKey) const;
@@ -1,6 +1,8 @@
 #include "AttachedModel.h"
 #include "Paths.h"
 #include <string>
+#include <vector>
+#include <algorithm>
 #include "AttachedModelShader.h"
 
 AttachedModel::~AttachedModel()
@@ -8,6 +10,18 @@ AttachedModel::~AttachedModel()
 
 }
 
+void AttachedModel::GetAttachedJointNames(SkinnedModel& model, std::set<std::string>& names) const
+{
+	for (const auto& kv : model.GetJointMapping())
+	{
+		for (int slot = 0; slot < attachedJointCount; ++slot)
+		{
+			if (attachedJointIndices[slot] == kv.second.jointID && attachedJointWeights[slot] > 0.0f)
+				names.insert(kv.first);
+		}
+	}
+}
+
 void AttachedModel::SumWeights(std::map<int, float>& weightMapping, const VertexBuffer::JointWeights& weights, float factor) const
 {
 	for (int i = 0; i < JOINTCOUNT; i++)
@@ -79,6 +93,7 @@ bool AttachedModel::attachToMesh(const BaseModel* model, unsigned int meshID, co
 	this->transform = Matrix(this->parentNode->GlobalTrans).invert() * globalTrans;
 
 	ApplyWeightMapping(weightMapping);
+	UpdateBasis();
 
 	return true;
 }
@@ -97,6 +112,7 @@ bool AttachedModel::attachToMesh(const BaseModel* model, const std::string& node
 	this->parentNode = animModel->GetNode(nodeName);
 	this->transform = transform;
 	ApplyWeightMapping(weightMapping);
+	UpdateBasis();
 
 	return true;
 }
@@ -114,52 +130,59 @@ std::map<int, float> AttachedModel::GetWeightMapping()
 
 void AttachedModel::ApplyWeightMapping(const std::map<int, float>& weightMapping)
 {
-	float max = std::numeric_limits<float>::max();
+	// Keep the strongest joints, sorted from the largest weight down
+	std::vector<std::pair<int, float>> sortedWeights;
+	for (const auto& kv : weightMapping)
+	{
+		if (kv.second > 0.0f)
+			sortedWeights.push_back(kv);
+	}
+	int count = std::min((int)sortedWeights.size(), JOINTCOUNT);
+	std::partial_sort(sortedWeights.begin(), sortedWeights.begin() + count, sortedWeights.end(), [](const std::pair<int, float>& a, const std::pair<int, float>& b) { return a.second > b.second; });
+
+	attachedJointCount = count;
 	for (int i = 0; i < JOINTCOUNT; i++)
 	{
-		float highest = 0.0f;
-		int index = 0;
-		//for (std::map<int, float>::iterator it = weightMapping.begin(); it != weightMapping.end(); ++it)
-		for (const auto& kv : weightMapping)
-		{
-			const float& value = kv.second;
+		attachedJointIndices[i] = i < count ? sortedWeights[i].first : 0;
+		attachedJointWeights[i] = i < count ? sortedWeights[i].second : 0.0f;
+	}
+}
 
-			if (value <= highest || value >= max)
-				continue;
+void AttachedModel::UpdateBasis()
+{
+	if (!parentNode)
+		return;
 
-			highest = value;
-			index = kv.first;
-		}
+	localToNode = parentNode->Trans * transform;
+	nodeToLocal = Matrix(localToNode).invert();
+}
 
-		if (highest == 0.0f)
-			break;
+void AttachedModel::setTransform(const Matrix& m)
+{
+	MeshModel::setTransform(m);
+	UpdateBasis();
+}
 
-		max = highest;
-		attachedJointWeights[i] = highest;
-		attachedJointIndices[i] = index;
+void AttachedModel::BlendBones(const Matrix* bones, const int* indices, const float* weights, int count, Matrix& result)
+{
+	// Plain float loops, so the compiler can keep the 16 elements in vector registers
+	float* blended = result.m;
+	std::fill(blended, blended + 16, 0.0f);
+	for (int i = 0; i < count; i++)
+	{
+		const float* bone = bones[indices[i]].m;
+		float weight = weights[i];
+		for (int k = 0; k < 16; k++)
+			blended[k] += bone[k] * weight;
 	}
 }
 
 Matrix AttachedModel::getAnimationTransform() const
 {
-	Matrix boneTransform = Matrix::zero;
-
-	Matrix localToNode = parentNode->Trans * transform;
-	Matrix nodeToLocal = Matrix(localToNode).invert();
-	
-	for (int i = 0; i < JOINTCOUNT; i++)
-	{
-		int index = attachedJointIndices[i];
-		float weight = attachedJointWeights[i];
-
-		if (weight == 0.0f)
-			break;
+	Matrix boneTransform;
+	BlendBones(Bones, attachedJointIndices, attachedJointWeights, attachedJointCount, boneTransform);
 
-		Matrix bone = nodeToLocal * Bones[index] * localToNode;
-		boneTransform = boneTransform + bone * weight;
-	}
-	
-	Matrix t = getGlobalTransform() * boneTransform;
+	Matrix t = getGlobalTransform() * nodeToLocal * boneTransform * localToNode;
 	return t.lastElementDivision();
 }
 
@@ -169,6 +192,7 @@ void AttachedModel::shader(BaseShader* shader, bool deleteOnDestruction)
 	loadBoneArray();
 
 	std::string name;
+	attachedJointCount = 0;
 	for (int i = 0; i < JOINTCOUNT; i++)
 	{
 		std::string indexString = std::to_string(i);
@@ -191,9 +215,6 @@ void AttachedModel::activate()
 	if (!attachedTo)
 		return;
 
-	Matrix localToNode = parentNode->Trans * transform;
-	Matrix nodeToLocal = Matrix(localToNode).invert();
-
 	for (int i = 0; i < (*boneCount); ++i)
 		pShader->setParameter(BonesLoc[i], nodeToLocal * Bones[i] * localToNode);
 
@@ -3,19 +3,21 @@
 #ifndef AttachedModel_h
 #define AttachedModel_h
 
+#include <set>
 #include "SkinnedModel.h"
 
 class AttachedModel : public MeshModel
 {
 public:
-	AttachedModel() : MeshModel(), center(Vector3::zero), parentNode(NULL), attachedTo(NULL), Bones(NULL), boneCount(NULL) {};
+	AttachedModel() : MeshModel(), center(Vector3::zero), parentNode(NULL), attachedTo(NULL), Bones(NULL), boneCount(NULL), attachedJointCount(0) {};
 	AttachedModel(const char* ModelFile, bool FitSize = false) : 
 		MeshModel(ModelFile, FitSize), 
 		center(Vector3::zero), 
 		parentNode(NULL), 
 		attachedTo(NULL), 
 		Bones(NULL), 
-		boneCount(NULL)
+		boneCount(NULL),
+		attachedJointCount(0)
 	{};
 	virtual ~AttachedModel();
 
@@ -24,6 +26,7 @@ public:
 	std::map<int, float> GetWeightMapping();
 	std::map<int, float> GenerateWeightMapping(const Vector3& position, HitInfo::TriangleInfo& triangleInfo, const std::vector<VertexBuffer::JointWeights>& joints);
 	Matrix getAnimationTransform() const;
+	virtual void setTransform(const Matrix& m);
 	virtual void draw(const BaseCamera& Cam);
 	virtual void activate();
 	virtual const Matrix localToWorld() const;
@@ -31,6 +34,20 @@ public:
 	virtual BaseShader* shader() { return BaseModel::shader(); }
 	const BaseModel* getAttachedTo() const { return attachedTo; }
 	const Node* getParentNode() const { return parentNode; }
+
+	// The compiled attachment, weights sorted from the largest down and 0 behind the last joint
+	int GetAttachedJointCount() const { return attachedJointCount; }
+	const int* GetAttachedJointIndices() const { return attachedJointIndices; }
+	const float* GetAttachedJointWeights() const { return attachedJointWeights; }
+	const Matrix* GetBones() const { return Bones; }
+	// The attachment in the space of its node and the inverse, updated whenever the attachment changes
+	const Matrix& GetLocalToNode() const { return localToNode; }
+	const Matrix& GetNodeToLocal() const { return nodeToLocal; }
+	// Adds the names of the joints the attachment follows, looked up in a model of the rig it is attached to
+	void GetAttachedJointNames(SkinnedModel& model, std::set<std::string>& names) const;
+
+	// Weighted sum of the bones, skinning is linear so this is done once instead of once per bone
+	static void BlendBones(const Matrix* bones, const int* indices, const float* weights, int count, Matrix& result);
 	//void deactivate();
 protected:
 	void loadBoneArray();
@@ -41,6 +58,9 @@ protected:
 
 	float attachedJointWeights[JOINTCOUNT];
 	int attachedJointIndices[JOINTCOUNT];
+	int attachedJointCount;
+	Matrix localToNode;
+	Matrix nodeToLocal;
 
 	const Matrix* Bones;
 	const int* boneCount;
@@ -50,6 +70,7 @@ protected:
 private:
 	void SumWeights(std::map<int, float>& weightMapping, const VertexBuffer::JointWeights& weights, float factor) const;
 	void ApplyWeightMapping(const std::map<int, float>& weightMapping);
+	void UpdateBasis();
 };
 
 #endif /* AttachedModel_h */
@@ -0,0 +1,104 @@
+#include "AttachmentBatch.h"
+#include <algorithm>
+
+AttachmentBatch::AttachmentBatch(const std::vector<const AttachedModel*>& models, const SkinnedModel* posedModel) :
+	models(models),
+	joints(models.size() * JOINTCOUNT, 0),
+	weights(models.size() * JOINTCOUNT, 0.0f),
+	bones(models.size(), nullptr),
+	blended(models.size() * 16, 0.0f)
+{
+	const int* boneCount = nullptr;
+	posedBones = posedModel ? posedModel->getBones(boneCount) : nullptr;
+	posedBoneCount = posedBones && boneCount ? *boneCount : 0;
+	for (size_t model = 0; model < models.size(); ++model)
+	{
+		const AttachedModel* attachedModel = models[model];
+		bones[model] = posedBones && attachedModel->GetBones() ? posedBones : attachedModel->GetBones();
+		std::copy(attachedModel->GetAttachedJointIndices(), attachedModel->GetAttachedJointIndices() + attachedModel->GetAttachedJointCount(), joints.begin() + model * JOINTCOUNT);
+		std::copy(attachedModel->GetAttachedJointWeights(), attachedModel->GetAttachedJointWeights() + attachedModel->GetAttachedJointCount(), weights.begin() + model * JOINTCOUNT);
+	}
+}
+
+void AttachmentBatch::Evaluate(std::vector<Matrix>& transforms) const
+{
+	size_t modelCount = models.size();
+	transforms.resize(modelCount);
+
+	// Every model runs through all slots, the empty ones add zeros instead of ending the loop early
+	for (size_t model = 0; model < modelCount; ++model)
+	{
+		float* blendedBone = &blended[model * 16];
+		std::fill(blendedBone, blendedBone + 16, 0.0f);
+		if (!bones[model])
+			continue;
+
+		const int* modelJoints = &joints[model * JOINTCOUNT];
+		const float* modelWeights = &weights[model * JOINTCOUNT];
+		for (int slot = 0; slot < JOINTCOUNT; ++slot)
+		{
+			const float* bone = bones[model][modelJoints[slot]].m;
+			float weight = modelWeights[slot];
+			for (int k = 0; k < 16; ++k)
+				blendedBone[k] += bone[k] * weight;
+		}
+	}
+
+	// The blended bones are moved into the space of every attachment with its cached basis
+	for (size_t model = 0; model < modelCount; ++model)
+	{
+		const AttachedModel* attachedModel = models[model];
+		if (!bones[model])
+		{
+			transforms[model] = attachedModel->getGlobalTransform();
+			continue;
+		}
+
+		Matrix boneTransform;
+		std::copy(&blended[model * 16], &blended[model * 16] + 16, boneTransform.m);
+		transforms[model] = attachedModel->getGlobalTransform() * attachedModel->GetNodeToLocal() * boneTransform * attachedModel->GetLocalToNode();
+		transforms[model].lastElementDivision();
+	}
+}
+
+void AttachmentBatch::EvaluateFrames(const std::vector<Matrix>& poses, int frameCount, std::vector<Matrix>& transforms) const
+{
+	size_t modelCount = models.size();
+	transforms.resize((size_t)std::max(0, frameCount) * modelCount);
+
+	for (size_t model = 0; model < modelCount; ++model)
+	{
+		const AttachedModel* attachedModel = models[model];
+		if (!bones[model])
+		{
+			for (int frame = 0; frame < frameCount; ++frame)
+				transforms[frame * modelCount + model] = attachedModel->getGlobalTransform();
+			continue;
+		}
+
+		// The basis does not change between the frames, only the blended bone does
+		Matrix toGlobal = attachedModel->getGlobalTransform() * attachedModel->GetNodeToLocal();
+		const Matrix& localToNode = attachedModel->GetLocalToNode();
+		const int* modelJoints = &joints[model * JOINTCOUNT];
+		const float* modelWeights = &weights[model * JOINTCOUNT];
+		bool posed = bones[model] == posedBones && posedBoneCount > 0;
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			const Matrix* frameBones = posed ? &poses[(size_t)frame * posedBoneCount] : bones[model];
+			Matrix boneTransform;
+			std::fill(boneTransform.m, boneTransform.m + 16, 0.0f);
+			for (int slot = 0; slot < JOINTCOUNT; ++slot)
+			{
+				const float* bone = frameBones[modelJoints[slot]].m;
+				float weight = modelWeights[slot];
+				for (int k = 0; k < 16; ++k)
+					boneTransform.m[k] += bone[k] * weight;
+			}
+
+			Matrix& transform = transforms[frame * modelCount + model];
+			transform = toGlobal * boneTransform * localToNode;
+			transform.lastElementDivision();
+		}
+	}
+}
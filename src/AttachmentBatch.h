@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "AttachedModel.h"
+
+// Skinned transforms of many attached models from one pose. The attachments are compiled into flat tables with
+// a fixed number of joint slots each, so the bones of all models are blended in one branchless pass over plain
+// floats the compiler can vectorize. Dense marker sets with dozens of trackers per character are evaluated per
+// frame without going through every model on its own.
+class AttachmentBatch
+{
+public:
+	// The models must stay attached while the batch is in use, the tables are not refreshed.
+	// With a posed model the bones are read from it instead of the model every attachment belongs to, it must share the rig.
+	AttachmentBatch(const std::vector<const AttachedModel*>& models, const SkinnedModel* posedModel = nullptr);
+
+	size_t GetSize() const { return models.size(); }
+
+	// Transforms of all models for the current pose of the bones they are attached to, in model order
+	void Evaluate(std::vector<Matrix>& transforms) const;
+	/// <summary>
+	/// Transforms of all models for several poses of the posed model. Every model loads its slots and its basis once and
+	/// runs through all frames. Models that read the bones of their own model keep their current pose in every frame.
+	/// </summary>
+	/// <param name="poses">Bones of the posed model per frame, poses[frame * GetPosedBoneCount() + bone]</param>
+	/// <param name="transforms">Receives transforms[frame * GetSize() + model]</param>
+	void EvaluateFrames(const std::vector<Matrix>& poses, int frameCount, std::vector<Matrix>& transforms) const;
+
+	// Bones per pose passed to EvaluateFrames, 0 without a posed model
+	int GetPosedBoneCount() const { return posedBoneCount; }
+private:
+	std::vector<const AttachedModel*> models;
+	// JOINTCOUNT slots per model, unused slots point at joint 0 with weight 0
+	std::vector<int> joints;
+	std::vector<float> weights;
+	std::vector<const Matrix*> bones;
+	const Matrix* posedBones = nullptr;
+	int posedBoneCount = 0;
+	// Scratch space for the blended bones, 16 floats per model
+	mutable std::vector<float> blended;
+};
@@ -46,8 +46,18 @@ CustomEnums::AxisType Avatar::GetAxis(Vector3 dir, Transform* transform)
 }
 
 float Avatar::GetAnatomicAngle(CustomEnums::AvatarJointType jointType, CustomEnums::HumanAnatomicAngleType humanAnatomicAngle)
+{
+    UpdateTransforms();
+    return CalculateAnatomicAngle(jointType, humanAnatomicAngle);
+}
+
+void Avatar::UpdateTransforms()
 {
     skinnedModel->UpdateTransformsFromJointMapping(transforms);
+}
+
+float Avatar::CalculateAnatomicAngle(CustomEnums::AvatarJointType jointType, CustomEnums::HumanAnatomicAngleType humanAnatomicAngle)
+{
 
     try
     {
@@ -76,7 +86,7 @@ float Avatar::GetAnatomicAngle(CustomEnums::AvatarJointType jointType, CustomEnu
 
         // CenterHip is a special case because its the root of the avatar
         if (jointType == CustomEnums::AvatarJointType::CenterHip)
-            return GetAnatomicAngle(CustomEnums::AvatarJointType::Spine, humanAnatomicAngle) + GetAnatomicAngle(CustomEnums::AvatarJointType::Chest, humanAnatomicAngle);
+            return CalculateAnatomicAngle(CustomEnums::AvatarJointType::Spine, humanAnatomicAngle) + CalculateAnatomicAngle(CustomEnums::AvatarJointType::Chest, humanAnatomicAngle);
         else
         {
             bool isTwist = anatomicAngleInformation == avatarJoint->twistAnatomicAngleInformation;
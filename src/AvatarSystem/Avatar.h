@@ -26,6 +26,15 @@ public:
     /// <param name="humanAnatomicAngle">The type of movement to calculate</param>
     /// <returns>The angle in degrees</returns>
     float GetAnatomicAngle(CustomEnums::AvatarJointType jointType, CustomEnums::HumanAnatomicAngleType humanAnatomicAngle);
+    /// <summary>
+    /// Pulls the current joint transforms of the skinned model into the avatar hierarchy.
+    /// Has to be called once after posing the model before using CalculateAnatomicAngle.
+    /// </summary>
+    void UpdateTransforms();
+    /// <summary>
+    /// Same as GetAnatomicAngle, but works on the transforms of the last UpdateTransforms call
+    /// </summary>
+    float CalculateAnatomicAngle(CustomEnums::AvatarJointType jointType, CustomEnums::HumanAnatomicAngleType humanAnatomicAngle);
     float CalculateCurrentAngle(AvatarJoint& avatarJoint, CustomEnums::AxisType rotationAxis);
     std::vector<float> CalculateAnatomicAnglesInOrder(AvatarJoint& avatarJoint, std::vector<AnatomicAngleInformation*> ordererAnatomicAngleInformations);
     AvatarJoint* GetAvatarJoint(CustomEnums::AvatarJointType humanJointType);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Queue between two pipeline stages. The producer blocks while it is full, so a fast stage can not run ahead
+// of a slow one by more than the capacity. Closing it lets the consumer drain what is left and stop.
+template <typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+	// Blocks while the queue is full, false if it got closed
+	bool Push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+		if (closed)
+			return false;
+
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// Blocks while the queue is empty, false once it is closed and drained
+	bool Pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+		if (items.empty())
+			return false;
+
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	// No more pushes, the items already queued can still be popped
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+private:
+	BoundedQueue(const BoundedQueue&);
+
+	size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+};
@@ -0,0 +1,50 @@
+#include "CancellationToken.h"
+#include <algorithm>
+
+CancellationToken::CancellationToken(ProgressCallback progressCallback) :
+	parent(nullptr),
+	canceled(false),
+	progress(0.0f),
+	progressCallback(progressCallback),
+	stageStart(0.0f),
+	stageEnd(1.0f),
+	reportedPerMille(-1)
+{
+}
+
+CancellationToken::CancellationToken(const CancellationToken* parent) :
+	parent(parent),
+	canceled(false),
+	progress(0.0f),
+	progressCallback(nullptr),
+	stageStart(0.0f),
+	stageEnd(1.0f),
+	reportedPerMille(-1)
+{
+}
+
+void CancellationToken::BeginStage(const std::string& stage, float start, float end)
+{
+	this->stage = stage;
+	stageStart = start;
+	stageEnd = end;
+
+	// A new stage always gets reported, the label changed
+	reportedPerMille = -1;
+	ReportProgress(0.0f);
+}
+
+void CancellationToken::ReportProgress(float stageProgress)
+{
+	stageProgress = std::clamp(stageProgress, 0.0f, 1.0f);
+	float jobProgress = stageStart + stageProgress * (stageEnd - stageStart);
+	progress = jobProgress;
+
+	int perMille = (int)(jobProgress * 1000.0f);
+	if (perMille == reportedPerMille)
+		return;
+	reportedPerMille = perMille;
+
+	if (progressCallback)
+		progressCallback(stage, jobProgress);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <functional>
+
+// Shared between the ui and a running job. The job polls IsCanceled at its own granularity
+// and reports its progress, the ui cancels from its own thread.
+class CancellationToken
+{
+public:
+	// Called on the job thread, progress is normalized over the whole job
+	typedef std::function<void(const std::string& stage, float progress)> ProgressCallback;
+
+	CancellationToken(ProgressCallback progressCallback = nullptr);
+	// Token of a sub job running on another thread, canceled together with the parent. Reports no progress.
+	explicit CancellationToken(const CancellationToken* parent);
+
+	void Cancel() { canceled = true; }
+	bool IsCanceled() const { return canceled || (parent && parent->IsCanceled()); }
+
+	/// <summary>
+	/// Starts a new stage of the job, the progress reported for it gets mapped into the given range
+	/// </summary>
+	/// <param name="stage">Readable description of the stage</param>
+	/// <param name="start">Job progress at the start of the stage</param>
+	/// <param name="end">Job progress at the end of the stage</param>
+	void BeginStage(const std::string& stage, float start, float end);
+	// Progress of the current stage in [0, 1]. Only forwarded every per mille, so it can be called per frame.
+	void ReportProgress(float stageProgress);
+
+	float GetProgress() const { return progress; }
+private:
+	CancellationToken(const CancellationToken&);
+
+	const CancellationToken* parent;
+	std::atomic<bool> canceled;
+	std::atomic<float> progress;
+	ProgressCallback progressCallback;
+
+	// Only touched by the job thread
+	std::string stage;
+	float stageStart;
+	float stageEnd;
+	int reportedPerMille;
+};
@@ -0,0 +1,258 @@
+#include "ColladaAnimationWriter.h"
+#include "Customizable/JointnameParser.h"
+#include "Matrix.h"
+#include <QDebug>
+#include <fstream>
+#include <charconv>
+#include <set>
+#include <algorithm>
+
+std::map<std::string, std::shared_ptr<const ColladaAnimationWriter::Skeleton>> ColladaAnimationWriter::skeletonCache;
+std::mutex ColladaAnimationWriter::skeletonCacheMutex;
+
+namespace
+{
+	// Shortest representation which reads back to the same float, independent of the locale
+	void AppendFloat(std::string& output, float value)
+	{
+		char buffer[32];
+		std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		output.append(buffer, result.ptr);
+	}
+
+	void AppendDouble(std::string& output, double value)
+	{
+		char buffer[32];
+		std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		output.append(buffer, result.ptr);
+	}
+
+	// Collada matrices are row major
+	void AppendMatrix(std::string& output, const Matrix& matrix)
+	{
+		const float values[16] = {
+			matrix.m00, matrix.m01, matrix.m02, matrix.m03,
+			matrix.m10, matrix.m11, matrix.m12, matrix.m13,
+			matrix.m20, matrix.m21, matrix.m22, matrix.m23,
+			matrix.m30, matrix.m31, matrix.m32, matrix.m33 };
+
+		for (int i = 0; i < 16; i++)
+		{
+			if (i > 0)
+				output += ' ';
+			AppendFloat(output, values[i]);
+		}
+	}
+
+	Matrix ConvertMatrix(const aiMatrix4x4& m)
+	{
+		return Matrix(
+			m.a1, m.a2, m.a3, m.a4,
+			m.b1, m.b2, m.b3, m.b4,
+			m.c1, m.c2, m.c3, m.c4,
+			m.d1, m.d2, m.d3, m.d4);
+	}
+
+	// Node names may contain characters which are not allowed in ids and may repeat
+	std::string CreateNodeId(const std::string& name, std::set<std::string>& usedIds)
+	{
+		std::string id = name;
+		for (char& c : id)
+		{
+			if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.')
+				c = '_';
+		}
+		if (id.empty() || isdigit((unsigned char)id[0]))
+			id = "_" + id;
+
+		std::string uniqueId = id;
+		for (int i = 1; usedIds.count(uniqueId); i++)
+			uniqueId = id + "-" + std::to_string(i);
+		usedIds.insert(uniqueId);
+		return uniqueId;
+	}
+
+	void WriteNode(const aiNode* node, int depth, std::string& output, ColladaAnimationWriter::Skeleton& skeleton, std::set<std::string>& usedIds)
+	{
+		std::string name = JointnameParser::ExtractJointName(node->mName);
+		std::string id = CreateNodeId(name, usedIds);
+		if (!skeleton.nodeIds.count(name))
+		{
+			skeleton.nodeIds[name] = id;
+			skeleton.bindPoses[name] = RigidTransform::FromMatrix(ConvertMatrix(node->mTransformation));
+		}
+
+		std::string indent(depth, '\t');
+		output += indent + "<node id=\"" + id + "\" sid=\"" + id + "\" name=\"" + name + "\" type=\"JOINT\">\n";
+		output += indent + "\t<matrix sid=\"matrix\">";
+		AppendMatrix(output, ConvertMatrix(node->mTransformation));
+		output += "</matrix>\n";
+
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			WriteNode(node->mChildren[i], depth + 1, output, skeleton, usedIds);
+
+		output += indent + "</node>\n";
+	}
+
+	void WriteSource(std::ofstream& file, const std::string& id, const std::string& values, size_t count, int stride, const char* paramName, const char* paramType, bool names = false)
+	{
+		const char* arrayType = names ? "Name_array" : "float_array";
+		file << "\t\t\t<source id=\"" << id << "\">\n";
+		file << "\t\t\t\t<" << arrayType << " id=\"" << id << "-array\" count=\"" << count * stride << "\">" << values << "</" << arrayType << ">\n";
+		file << "\t\t\t\t<technique_common>\n";
+		file << "\t\t\t\t\t<accessor source=\"#" << id << "-array\" count=\"" << count << "\" stride=\"" << stride << "\">\n";
+		file << "\t\t\t\t\t\t<param name=\"" << paramName << "\" type=\"" << paramType << "\" />\n";
+		file << "\t\t\t\t\t</accessor>\n";
+		file << "\t\t\t\t</technique_common>\n";
+		file << "\t\t\t</source>\n";
+	}
+}
+
+std::shared_ptr<const ColladaAnimationWriter::Skeleton> ColladaAnimationWriter::GetSkeleton(const std::string& sourcePath)
+{
+	std::lock_guard<std::mutex> lock(skeletonCacheMutex);
+
+	auto it = skeletonCache.find(sourcePath);
+	if (it != skeletonCache.end())
+		return it->second;
+
+	// Only the node hierarchy is needed, so skip all post processing
+	const aiScene* scene = aiImportFile(sourcePath.c_str(), 0);
+	if (!scene || !scene->mRootNode)
+	{
+		qDebug() << "Could not read skeleton from" << sourcePath.c_str();
+		return nullptr;
+	}
+
+	std::shared_ptr<Skeleton> skeleton = std::make_shared<Skeleton>();
+	std::set<std::string> usedIds;
+	std::string& output = skeleton->visualScenes;
+	output += "\t<library_visual_scenes>\n";
+	output += "\t\t<visual_scene id=\"Scene\" name=\"Scene\">\n";
+	WriteNode(scene->mRootNode, 3, output, *skeleton, usedIds);
+	output += "\t\t</visual_scene>\n";
+	output += "\t</library_visual_scenes>\n";
+	aiReleaseImport(scene);
+
+	skeletonCache[sourcePath] = skeleton;
+	return skeleton;
+}
+
+bool ColladaAnimationWriter::Write(const Skeleton& skeleton, const Animation& animation, const std::string& path)
+{
+	return Write(skeleton, std::vector<const Animation*> { &animation }, path);
+}
+
+bool ColladaAnimationWriter::Write(const Skeleton& skeleton, const std::vector<const Animation*>& segments, const std::string& path)
+{
+	// Binary mode, so the line endings are the same on every platform
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		qDebug() << "Could not open" << path.c_str() << "for writing";
+		return false;
+	}
+
+	file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+	file << "<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n";
+	file << "\t<asset>\n";
+	// Fixed dates keep the output byte stable
+	file << "\t\t<created>1970-01-01T00:00:00</created>\n";
+	file << "\t\t<modified>1970-01-01T00:00:00</modified>\n";
+	file << "\t\t<up_axis>Y_UP</up_axis>\n";
+	file << "\t</asset>\n";
+	file << "\t<library_animations>\n";
+
+	std::string times;
+	std::string matrices;
+	std::string interpolations;
+	std::vector<float> keyTimes;
+
+	// Ordered by name, so the channel order is stable
+	std::set<std::string> channelNames;
+	for (const Animation* segment : segments)
+		for (const auto& kv : segment->animNodeMapping)
+			channelNames.insert(kv.first);
+
+	for (const std::string& channelName : channelNames)
+	{
+		auto nodeId = skeleton.nodeIds.find(channelName);
+		if (nodeId == skeleton.nodeIds.end())
+			continue;
+
+		times.clear();
+		matrices.clear();
+		interpolations.clear();
+		size_t keyCount = 0;
+		for (const Animation* segment : segments)
+		{
+			auto channel = segment->animNodeMapping.find(channelName);
+			if (channel == segment->animNodeMapping.end())
+				continue;
+
+			// Channels without keys stay in the bind pose, instead of dropping the joint from the clip
+			const AnimationCurve& curve = channel->second;
+			bool complete = !curve.positions.empty() && !curve.rotations.empty() && !curve.scalings.empty();
+			const RigidTransform& bindPose = skeleton.bindPoses.at(channelName);
+
+			// Collada animates the whole node matrix, so every channel is sampled at the union of its key times
+			keyTimes.clear();
+			for (const AnimationCurve::VectorAnimationKey& key : curve.positions)
+				keyTimes.push_back(key.time);
+			for (const AnimationCurve::QuaternionAnimationKey& key : curve.rotations)
+				keyTimes.push_back(key.time);
+			for (const AnimationCurve::VectorAnimationKey& key : curve.scalings)
+				keyTimes.push_back(key.time);
+			std::sort(keyTimes.begin(), keyTimes.end());
+			keyTimes.erase(std::unique(keyTimes.begin(), keyTimes.end()), keyTimes.end());
+
+			for (float time : keyTimes)
+			{
+				Matrix transform = complete ? curve.GetLocalTransform(time) : RigidTransform(
+					curve.rotations.empty() ? bindPose.rotation : curve.GetRotation(time),
+					curve.positions.empty() ? bindPose.translation : curve.GetPosition(time),
+					curve.scalings.empty() ? bindPose.scale : curve.GetScale(time)).ToMatrix();
+
+				if (keyCount > 0)
+				{
+					times += ' ';
+					matrices += ' ';
+					interpolations += ' ';
+				}
+				// Segments without offset keep the exact float times. With an offset the times get all digits of a double,
+				// Collada has no double array, so float_array text is read back at the precision of the importer.
+				if (segment->timeOffset == 0.0)
+					AppendFloat(times, time);
+				else
+					AppendDouble(times, segment->timeOffset + time);
+				AppendMatrix(matrices, transform);
+				interpolations += "LINEAR";
+				keyCount++;
+			}
+		}
+		if (keyCount == 0)
+			continue;
+
+		const std::string& id = nodeId->second;
+		file << "\t\t<animation id=\"" << id << "-anim\" name=\"" << channelName << "\">\n";
+		WriteSource(file, id + "-input", times, keyCount, 1, "TIME", "float");
+		WriteSource(file, id + "-output", matrices, keyCount, 16, "TRANSFORM", "float4x4");
+		WriteSource(file, id + "-interpolation", interpolations, keyCount, 1, "INTERPOLATION", "name", true);
+		file << "\t\t\t<sampler id=\"" << id << "-sampler\">\n";
+		file << "\t\t\t\t<input semantic=\"INPUT\" source=\"#" << id << "-input\" />\n";
+		file << "\t\t\t\t<input semantic=\"OUTPUT\" source=\"#" << id << "-output\" />\n";
+		file << "\t\t\t\t<input semantic=\"INTERPOLATION\" source=\"#" << id << "-interpolation\" />\n";
+		file << "\t\t\t</sampler>\n";
+		file << "\t\t\t<channel source=\"#" << id << "-sampler\" target=\"" << id << "/matrix\" />\n";
+		file << "\t\t</animation>\n";
+	}
+
+	file << "\t</library_animations>\n";
+	file << skeleton.visualScenes;
+	file << "\t<scene>\n";
+	file << "\t\t<instance_visual_scene url=\"#Scene\" />\n";
+	file << "\t</scene>\n";
+	file << "</COLLADA>\n";
+
+	return file.good();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include "Animation.h"
+#include "RigidTransform.h"
+
+/// <summary>
+/// Writes animations as minimal Collada files, holding only the node hierarchy and the animation channels.
+/// The node hierarchy is read and serialized once per skeleton source and reused for every following write.
+/// The output only depends on the animation and the skeleton, so results of two runs can be diffed.
+/// </summary>
+class ColladaAnimationWriter
+{
+public:
+	struct Skeleton
+	{
+		// Serialized <library_visual_scenes> element
+		std::string visualScenes;
+		// Generic node name => collada node id
+		std::map<std::string, std::string> nodeIds;
+		// Generic node name => local bind pose, fills the channels a curve has no keys for
+		std::map<std::string, RigidTransform> bindPoses;
+	};
+
+	/// <summary>
+	/// Returns the skeleton of the file, the file is only imported on the first request
+	/// </summary>
+	/// <param name="sourcePath">A character or animation file containing the node hierarchy</param>
+	/// <returns>Null if the file could not be imported</returns>
+	static std::shared_ptr<const Skeleton> GetSkeleton(const std::string& sourcePath);
+
+	static bool Write(const Skeleton& skeleton, const Animation& animation, const std::string& path);
+	/// <summary>
+	/// Writes the segments one after another into the same channels. Every key is written at the time offset
+	/// of its segment plus its own time, summed in double precision.
+	/// </summary>
+	/// <param name="segments">Ordered by time, the key ranges must not overlap</param>
+	static bool Write(const Skeleton& skeleton, const std::vector<const Animation*>& segments, const std::string& path);
+private:
+	static std::map<std::string, std::shared_ptr<const Skeleton>> skeletonCache;
+	static std::mutex skeletonCacheMutex;
+};
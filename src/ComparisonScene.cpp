@@ -1,10 +1,16 @@
 #include "ComparisonScene.h"
 #include "AnimatedModelShader.h"
 #include "EventManager.h"
+#include "PipelineOptions.h"
+#include "StageCache.h"
+#include "JointDependencies.h"
 #include <QDebug>
 #include <QtWidgets>
+#include <QJsonArray>
+#include "QJsonSerializer.h"
 #include <tinyxml2.h>
 #include <filesystem>
+#include <fstream>
 #include <ctime>
 
 ComparisonScene::ComparisonScene(
@@ -12,13 +18,15 @@ ComparisonScene::ComparisonScene(
 	std::vector<BaseErrorMetric*> selectedErrorMetrics,
 	std::vector<std::string> groundTruthAnimationPaths,
 	std::vector<std::string> solvedAnimationPaths,
-	int errorMetricsSampleRate)
+	int errorMetricsSampleRate,
+	std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips)
 	:
 	modelfile(modelfile),
 	selectedErrorMetrics(selectedErrorMetrics),
 	groundTruthAnimationPaths(groundTruthAnimationPaths),
 	solvedAnimationPaths(solvedAnimationPaths),
 	errorMetricsSampleRate(errorMetricsSampleRate),
+	fusedClips(fusedClips),
 	Scene()
 {
 	std::function<void()> voidCallback = std::function([this]() { return this->OnStopButtonPressed(); });
@@ -31,6 +39,11 @@ ComparisonScene::ComparisonScene(
 
 ComparisonScene::~ComparisonScene()
 {
+	// Let running jobs finish before their workers get destroyed
+	delete comparisonPool;
+	ClearWorkers();
+	delete planner;
+	delete journal;
 }
 
 void ComparisonScene::start()
@@ -62,8 +75,6 @@ void ComparisonScene::start()
 	groundTruthSkinnedModel->setTransparency(TRANSPARENCY_FULL);
 	models.push_back(groundTruthSkinnedModel);
 
-	Avatar* groundTruthAvatar = new Avatar(groundTruthSkinnedModel);
-
 	Animator* groundTruthAnimator = new Animator(*groundTruthSkinnedModel);
 	animators.push_back(groundTruthAnimator);
 
@@ -80,187 +91,614 @@ void ComparisonScene::start()
 	solvedSkinnedModel->setTransparency(TRANSPARENCY_FULL);
 	models.push_back(solvedSkinnedModel);
 
-	Avatar* solvedAvatar = new Avatar(solvedSkinnedModel);
-
 	Animator* solvedAnimator = new Animator(*solvedSkinnedModel);
 	animators.push_back(solvedAnimator);
 
-	int maxX = selectedErrorMetrics.size();
-	int maxY = solvedAnimationPaths.size();
-	std::vector<float> resultsMatrix = std::vector<float>(maxX * maxY);
-	std::vector<std::string> columnNames;
-	std::vector<std::string> rowNames;
-	std::vector<std::string> finalSolvedAnimationPaths;
-	std::vector<std::string> finalTruthAnimationPaths;
+	StartComparison();
+}
 
-	std::vector<AnimationResults> combinedResults;
-	int row = 0;
-	for (int y = 0; y < groundTruthAnimationPaths.size(); ++y)
+void ComparisonScene::StartComparison()
+{
+	// Metric names and the merged pose inputs only depend on the selection, so plan once for all animations
+	planner = new MetricEvaluationPlanner(selectedErrorMetrics);
+
+	QJsonArray metrics;
+	for (BaseErrorMetric* metric : selectedErrorMetrics)
 	{
-		AnimationResults results;
+		QJsonObject parameters;
+		for (const auto& kv : metric->GetParameters())
+			parameters.insert(kv.first.c_str(), QJsonSerializer::ParameterToJson(kv.second));
+
+		QJsonObject metricJson;
+		metricJson.insert("name", metric->GetName().c_str());
+		metricJson.insert("parameters", parameters);
+		metricJson.insert("sampleRate", errorMetricsSampleRate);
+		metricJson.insert("pipeline", PipelineOptions::instance().GetProcessingSettings());
+		metricSettings.push_back(metricJson);
+		metrics.append(metricJson);
+	}
 
-		Animation* solvedAnimation = Animation::LoadFromPath(solvedAnimationPaths[y]);
-		if (!solvedAnimation)
-			continue;
-		Animation* groundTruthAnimation = Animation::LoadFromPath(groundTruthAnimationPaths[y]);
-		if (!groundTruthAnimation || !solvedAnimation)
+	// Finished rows are persisted next to the solved animations, so an interrupted comparison can resume.
+	// Solved clips the fused pipeline kept in memory have no path.
+	auto writtenPath = std::find_if(solvedAnimationPaths.begin(), solvedAnimationPaths.end(), [](const std::string& path) { return !path.empty(); });
+	if (writtenPath != solvedAnimationPaths.end())
+	{
+		journal = new RunJournal(std::filesystem::path(*writtenPath).parent_path().string());
+
+		QJsonObject settingsJson;
+		settingsJson.insert("metrics", metrics);
+		comparisonSettingsHash = RunJournal::HashJson(settingsJson);
+	}
+
+	// Both skeletons are posed from the model, so its skin and rig are inputs of every row
+	if (journal || StageCache::instance().IsEnabled())
+		modelHash = RunJournal::HashFile(modelfile);
+
+	int animationCount = groundTruthAnimationPaths.size();
+	int metricCount = selectedErrorMetrics.size();
+
+	// Only the rows the fused pipeline did not evaluate get jobs
+	std::vector<int> evaluatedRows;
+	for (int y = 0; y < animationCount; ++y)
+	{
+		if (!GetFusedClip(y))
+			evaluatedRows.push_back(y);
+	}
+	int jobRowCount = evaluatedRows.size();
+	int threadCount = std::max(1, std::min(ThreadPool::DefaultThreadCount(), jobRowCount));
+
+	// Split the metrics into groups if there are fewer animations than threads.
+	// Every group samples its own inputs, so this only pays off for idle threads.
+	int shardCount = 1;
+	if (jobRowCount > 0 && jobRowCount < ThreadPool::DefaultThreadCount())
+		shardCount = std::max(1, std::min(metricCount, ThreadPool::DefaultThreadCount() / jobRowCount));
+	threadCount = std::max(threadCount, std::min(ThreadPool::DefaultThreadCount(), jobRowCount * shardCount));
+
+	// Chunks of long captures are spread over the threads, even for a single capture
+	if (jobRowCount > 0)
+		threadCount = std::max(threadCount, PipelineOptions::instance().GetChunkThreadCount());
+
+	for (int shard = 0; shard < shardCount; ++shard)
+	{
+		MetricShard metricShard;
+		std::vector<BaseErrorMetric*> shardMetrics;
+		for (int x = shard; x < metricCount; x += shardCount)
+		{
+			metricShard.metricIndices.push_back(x);
+			shardMetrics.push_back(selectedErrorMetrics[x]);
+		}
+		metricShard.planner = new MetricEvaluationPlanner(shardMetrics);
+		metricShards.push_back(metricShard);
+	}
+
+	// Every worker gets its own skeletons, the models are loaded here since loading needs the GL context
+	const char* modelfile_cstr = modelfile.c_str();
+	for (int worker = 0; worker < threadCount && jobRowCount > 0; ++worker)
+	{
+		ComparisonWorker comparisonWorker;
+		comparisonWorker.groundTruthModel = new SkinnedModel(modelfile_cstr, false);
+		comparisonWorker.solvedModel = new SkinnedModel(modelfile_cstr, false);
+		comparisonWorker.groundTruthAvatar = new Avatar(comparisonWorker.groundTruthModel);
+		comparisonWorker.solvedAvatar = new Avatar(comparisonWorker.solvedModel);
+		comparisonWorker.groundTruthAnimator = new Animator(*comparisonWorker.groundTruthModel);
+		comparisonWorker.solvedAnimator = new Animator(*comparisonWorker.solvedModel);
+
+		// A worker runs every shard, so it poses the joints of all metrics
+		JointDependencies dependencies;
+		dependencies.AddMetrics(*planner, comparisonWorker.groundTruthAvatar);
+		comparisonWorker.groundTruthAnimator->SetRequiredJoints(dependencies.GetJoints());
+		comparisonWorker.solvedAnimator->SetRequiredJoints(dependencies.GetJoints());
+		workers.push_back(comparisonWorker);
+	}
+
+	comparisonResults.assign(animationCount, ComparisonResult());
+	for (ComparisonResult& result : comparisonResults)
+	{
+		result.metricResults.assign(metricCount, std::vector<float>());
+		result.pendingShards = shardCount;
+	}
+	availableAnimations.assign(animationCount, false);
+
+	// Rows of the fused pipeline are published with the first update
+	for (int y = 0; y < animationCount; ++y)
+	{
+		std::shared_ptr<FusedPipeline::Clip> clip = GetFusedClip(y);
+		if (!clip)
 			continue;
 
-		finalSolvedAnimationPaths.push_back(solvedAnimationPaths[y]);
-		finalTruthAnimationPaths.push_back(groundTruthAnimationPaths[y]);
+		ComparisonResult& result = comparisonResults[y];
+		result.pendingShards = 0;
+		result.loaded = clip->evaluated && (int)clip->metricResults.size() == metricCount;
+		if (result.loaded)
+		{
+			result.name = clip->name;
+			result.timestamps = clip->timestamps;
+			result.metricResults = clip->metricResults;
+		}
+		finishedAnimations.push_back(y);
+	}
+
+	// Lay out the table up front, the rows get filled in as their animations finish
+	std::vector<std::string> rowNames;
+	for (const std::string& path : groundTruthAnimationPaths)
+		rowNames.push_back(std::filesystem::path(path).stem().string());
+	ResultsMatrix emptyMatrix = ResultsMatrix(rowNames, planner->GetMetricNames(), std::vector<float>(), metricCount, animationCount);
+	EventManager::instance().FireEvent("OnComparisonStarted", emptyMatrix);
+
+	pendingJobs = jobRowCount * shardCount;
+	comparisonPool = new ThreadPool(threadCount);
+	for (int y : evaluatedRows)
+	{
+		for (int shard = 0; shard < shardCount; ++shard)
+			comparisonPool->Enqueue([this, y, shard](int worker) { RunComparisonJob(y, shard, worker); });
+	}
 
-		groundTruthAnimator->SetAnimation(groundTruthAnimation);
-		solvedAnimator->SetAnimation(solvedAnimation);
+	if (jobRowCount == 0)
+		FinishComparison();
+}
+
+void ComparisonScene::RunComparisonJob(int animationIndex, int shardIndex, int workerIndex)
+{
+	// The pool swallows exceptions, a job that threw still has to complete or the comparison never finishes
+	bool completed = true;
+	try
+	{
+		completed = RunShard(animationIndex, shardIndex, workerIndex);
+	}
+	catch (const std::exception& e)
+	{
+		qDebug() << "Comparison of" << groundTruthAnimationPaths[animationIndex].c_str() << "failed:" << e.what();
+		workers[workerIndex].groundTruthAnimator->RemoveAnimation(true);
+		workers[workerIndex].solvedAnimator->RemoveAnimation(true);
+		FailRow(animationIndex);
+	}
+
+	if (completed)
+		CompleteJob(animationIndex);
+}
 
-		bool velocitiesNeeded = false;
-		bool accelerationsNeeded = false;
-		for (int a = 0; a < selectedErrorMetrics.size(); ++a)
+bool ComparisonScene::RunShard(int animationIndex, int shardIndex, int workerIndex)
+{
+	ComparisonWorker& worker = workers[workerIndex];
+	const MetricShard& shard = metricShards[shardIndex];
+	ComparisonResult& result = comparisonResults[animationIndex];
+
+	// Rows an earlier attempt already evaluated are only read back
+	StageCache& cache = StageCache::instance();
+	std::string inputHash = journal || cache.IsEnabled() ? GetComparisonInputHash(animationIndex) : "";
+	if (shardIndex == 0)
+		result.inputHash = inputHash;
+	if (journal && LoadJournaledResult(animationIndex, shardIndex, inputHash))
+		return true;
+
+	// Series of earlier runs on the same animations come from the stage cache, only the others get evaluated
+	std::vector<std::string> cacheKeys(selectedErrorMetrics.size());
+	std::vector<int> missingColumns;
+	std::string cachedName;
+	std::vector<double> cachedTimestamps;
+	for (int x : shard.metricIndices)
+	{
+		if (cache.IsEnabled())
 		{
-			if (selectedErrorMetrics[a]->needsVelocities)
-				velocitiesNeeded = true;
-			if (selectedErrorMetrics[a]->needsAccelerations)
-				accelerationsNeeded = true;
-			if (velocitiesNeeded && accelerationsNeeded)
-				break;
+			QJsonObject inputs = metricSettings[x];
+			inputs.insert("animations", inputHash.c_str());
+			cacheKeys[x] = cache.GetKey("metric", inputs);
+
+			QByteArray data;
+			if (cache.Load("metric", cacheKeys[x], data) && StageCache::DeserializeSeries(data, cachedName, cachedTimestamps, result.metricResults[x]))
+				continue;
 		}
+		missingColumns.push_back(x);
+	}
 
-		// Calulate sample times for the error metrics
-		std::vector<float> sampleTimes;
-		std::map<std::string, Vector3> prevGroundTruthPositions;
-		std::map<std::string, Vector3> prevGroundTruthVelocities;
-		std::map<std::string, Vector3> prevSolvedPositions;
-		std::map<std::string, Vector3> prevSolvedVelocities;
-		float animationLength = groundTruthAnimator->GetAnimationLength();
-		int frameCount = animationLength * errorMetricsSampleRate;
-		std::map<std::string, std::vector<float>> resultsMap;
-		for (size_t i = 0; i < frameCount; i++)
+	if (missingColumns.empty())
+	{
+		if (shardIndex == 0)
 		{
-			float sampleTime = animationLength * (i / (float)frameCount);
-			sampleTimes.push_back(sampleTime);
+			result.name = cachedName;
+			result.timestamps = std::move(cachedTimestamps);
+			result.loaded = true;
+		}
+		return true;
+	}
 
-			BaseErrorMetric::Pose groundTruthPose;
-			BaseErrorMetric::Pose solvedPose;
+	// A partial hit only plans the missing metrics
+	std::unique_ptr<MetricEvaluationPlanner> partialPlanner;
+	if (missingColumns.size() != shard.metricIndices.size())
+	{
+		std::vector<BaseErrorMetric*> missingMetrics;
+		for (int x : missingColumns)
+			missingMetrics.push_back(selectedErrorMetrics[x]);
+		partialPlanner.reset(new MetricEvaluationPlanner(missingMetrics));
+	}
 
-			groundTruthPose.skinnedModel = groundTruthSkinnedModel;
-			solvedPose.skinnedModel = solvedSkinnedModel;
+	// Long captures get their chunks evaluated by jobs of their own, the last one finishes the row.
+	// The scenes read for the duration are converted for short ones, instead of being imported again.
+	std::unique_ptr<AnimationChunkReader> groundTruthReader;
+	std::unique_ptr<AnimationChunkReader> solvedReader;
+	if (PipelineOptions::instance().streamingChunkLength > 0.0)
+	{
+		groundTruthReader.reset(new AnimationChunkReader(groundTruthAnimationPaths[animationIndex]));
+		solvedReader.reset(new AnimationChunkReader(solvedAnimationPaths[animationIndex]));
+		if (StartChunkedRow(animationIndex, shardIndex, missingColumns, cacheKeys, partialPlanner, groundTruthReader, solvedReader))
+			return false;
+	}
 
-			groundTruthPose.avatar = groundTruthAvatar;
-			solvedPose.avatar = solvedAvatar;
+	std::string name;
+	std::vector<double> sampleTimes;
+	std::vector<std::vector<float>> evaluatedResults;
+	if (EvaluateRow(animationIndex, worker, partialPlanner ? *partialPlanner : *shard.planner, groundTruthReader.get(), solvedReader.get(), name, sampleTimes, evaluatedResults))
+		StoreEvaluatedColumns(animationIndex, shardIndex, missingColumns, cacheKeys, name, sampleTimes, evaluatedResults);
+	return true;
+}
 
-			groundTruthPose.velocities.clear();
-			groundTruthPose.accelerations.clear();
-			solvedPose.velocities.clear();
-			solvedPose.accelerations.clear();
+void ComparisonScene::StoreEvaluatedColumns(int animationIndex, int shardIndex, const std::vector<int>& columns, const std::vector<std::string>& cacheKeys, const std::string& name, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& evaluatedResults)
+{
+	ComparisonResult& result = comparisonResults[animationIndex];
+	StageCache& cache = StageCache::instance();
 
-			groundTruthAnimator->SetNormalizedAnimationTime(sampleTime / animationLength);
-			solvedAnimator->SetNormalizedAnimationTime(sampleTime / animationLength);
+	// Shards write disjoint metric columns, the shared row data is written by the first one
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		int x = columns[i];
+		if (!cacheKeys[x].empty())
+			cache.Store("metric", cacheKeys[x], StageCache::SerializeSeries(name, sampleTimes, evaluatedResults[i]));
+		result.metricResults[x] = std::move(evaluatedResults[i]);
+	}
+	if (shardIndex == 0)
+	{
+		result.name = name;
+		result.timestamps = std::move(sampleTimes);
+		result.loaded = true;
+	}
+}
 
-			if (velocitiesNeeded || accelerationsNeeded)
-			{
-				std::map<std::string, Vector3> groundTruthVelocities = std::map<std::string, Vector3>();
-				std::map<std::string, Vector3> solvedVelocities = std::map<std::string, Vector3>();
+bool ComparisonScene::StartChunkedRow(int animationIndex, int shardIndex, const std::vector<int>& columns, const std::vector<std::string>& cacheKeys, std::unique_ptr<MetricEvaluationPlanner>& partialPlanner,
+	std::unique_ptr<AnimationChunkReader>& groundTruthReader, std::unique_ptr<AnimationChunkReader>& solvedReader)
+{
+	const PipelineOptions& options = PipelineOptions::instance();
+	if (!groundTruthReader->IsValid() || !solvedReader->IsValid() || !options.UseStreaming(groundTruthReader->GetDuration()))
+		return false;
+
+	std::shared_ptr<ChunkedRow> row = std::make_shared<ChunkedRow>();
+	row->groundTruthReader = std::move(groundTruthReader);
+	row->solvedReader = std::move(solvedReader);
+	row->animationIndex = animationIndex;
+	row->shardIndex = shardIndex;
+	row->columns = columns;
+	row->cacheKeys = cacheKeys;
+	row->partialPlanner = std::move(partialPlanner);
+	row->planner = row->partialPlanner ? row->partialPlanner.get() : metricShards[shardIndex].planner;
+	row->chunks = row->planner->PlanChunks(row->groundTruthReader->GetDuration(), errorMetricsSampleRate, options.streamingChunkLength, options.streamingChunkOverlap);
+
+	int chunkCount = row->chunks.size();
+	row->sampleTimes.resize(chunkCount);
+	row->results.resize(chunkCount);
+	row->evaluated.assign(chunkCount, false);
+	row->pendingChunks = chunkCount;
+	if (chunkCount == 0)
+	{
+		FinishChunkedRow(*row);
+		return true;
+	}
+
+	// Counted before the jobs are queued, so the comparison can not finish in between
+	pendingJobs += chunkCount;
+	for (int chunk = 0; chunk < chunkCount; ++chunk)
+		comparisonPool->Enqueue([this, row, chunk](int worker) { RunChunkJob(row, chunk, worker); });
+	return true;
+}
+
+void ComparisonScene::RunChunkJob(std::shared_ptr<ChunkedRow> row, int chunkIndex, int workerIndex)
+{
+	ComparisonWorker& worker = workers[workerIndex];
+	try
+	{
+		row->evaluated[chunkIndex] = row->planner->EvaluateChunk(
+			*row->groundTruthReader, *worker.groundTruthAnimator, *worker.groundTruthModel, worker.groundTruthAvatar,
+			*row->solvedReader, *worker.solvedAnimator, *worker.solvedModel, worker.solvedAvatar,
+			errorMetricsSampleRate, row->chunks[chunkIndex], row->sampleTimes[chunkIndex], row->results[chunkIndex]);
+	}
+	catch (const std::exception& e)
+	{
+		// Unlike a chunk that could not be read, which ends the series, the whole row fails
+		qDebug() << "Chunk" << chunkIndex << "of" << row->groundTruthReader->GetName().c_str() << "failed:" << e.what();
+		worker.groundTruthAnimator->RemoveAnimation(true);
+		worker.solvedAnimator->RemoveAnimation(true);
+		row->evaluated[chunkIndex] = false;
+		row->failed = true;
+	}
+
+	if (--row->pendingChunks == 0)
+		FinishChunkedRow(*row);
+	pendingJobs--;
+}
+
+void ComparisonScene::FinishChunkedRow(ChunkedRow& row)
+{
+	if (!row.failed)
+	{
+		try
+		{
+			StoreChunkedRow(row);
+		}
+		catch (const std::exception& e)
+		{
+			qDebug() << "Stitching" << row.groundTruthReader->GetName().c_str() << "failed:" << e.what();
+			row.failed = true;
+		}
+	}
 
-				// Calculate velocity
-				if (i > 0 && (velocitiesNeeded || accelerationsNeeded))
-				{
-					for (std::pair<std::string, MeshModel::JointInfo> pair : groundTruthSkinnedModel->GetJointMapping())
-						groundTruthVelocities[pair.first] = pair.second.transform.translation() - prevGroundTruthPositions[pair.first];
+	if (row.failed)
+		FailRow(row.animationIndex);
+	CompleteJob(row.animationIndex);
+}
 
-					groundTruthPose.velocities = groundTruthVelocities;
+void ComparisonScene::StoreChunkedRow(ChunkedRow& row)
+{
+	// Stitched in time order, the overlap of every chunk was already dropped. Like a sequential pass, a chunk that could not be read ends the series.
+	std::vector<double> sampleTimes;
+	std::vector<std::vector<float>> evaluatedResults(row.columns.size());
+	for (size_t chunk = 0; chunk < row.chunks.size() && row.evaluated[chunk]; ++chunk)
+	{
+		sampleTimes.insert(sampleTimes.end(), row.sampleTimes[chunk].begin(), row.sampleTimes[chunk].end());
+		for (size_t i = 0; i < evaluatedResults.size(); ++i)
+			evaluatedResults[i].insert(evaluatedResults[i].end(), row.results[chunk][i].begin(), row.results[chunk][i].end());
+	}
 
-					for (std::pair<std::string, MeshModel::JointInfo> pair : solvedSkinnedModel->GetJointMapping())
-						solvedVelocities[pair.first] = pair.second.transform.translation() - prevSolvedPositions[pair.first];
+	StoreEvaluatedColumns(row.animationIndex, row.shardIndex, row.columns, row.cacheKeys, row.groundTruthReader->GetName(), sampleTimes, evaluatedResults);
+}
 
-					solvedPose.velocities = solvedVelocities;
-				}
+bool ComparisonScene::EvaluateRow(int animationIndex, ComparisonWorker& worker, MetricEvaluationPlanner& rowPlanner, const AnimationChunkReader* groundTruthReader, const AnimationChunkReader* solvedReader, std::string& name, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results)
+{
+	Animation* solvedAnimation = solvedReader && solvedReader->IsValid() ? solvedReader->ReadAll() : Animation::LoadFromPath(solvedAnimationPaths[animationIndex]);
+	Animation* groundTruthAnimation = groundTruthReader && groundTruthReader->IsValid() ? groundTruthReader->ReadAll() : Animation::LoadFromPath(groundTruthAnimationPaths[animationIndex]);
+	if (!groundTruthAnimation || !solvedAnimation)
+	{
+		delete groundTruthAnimation;
+		delete solvedAnimation;
+		return false;
+	}
 
-				// Calculate acceleration
-				if (i > 1 && accelerationsNeeded)
-				{
-					std::map<std::string, Vector3> groundTruthAccelerations = std::map<std::string, Vector3>();
-					std::map<std::string, Vector3> solvedAccelerations = std::map<std::string, Vector3>();
+	worker.groundTruthAnimator->SetAnimation(groundTruthAnimation);
+	worker.solvedAnimator->SetAnimation(solvedAnimation);
 
-					for (std::pair<std::string, MeshModel::JointInfo> pair : groundTruthSkinnedModel->GetJointMapping())
-						groundTruthAccelerations[pair.first] = groundTruthVelocities[pair.first] - prevGroundTruthVelocities[pair.first];
+	// Calulate sample times for the error metrics and evaluate them on the shared pose frames
+	rowPlanner.Evaluate(
+		*worker.groundTruthAnimator, *worker.groundTruthModel, worker.groundTruthAvatar,
+		*worker.solvedAnimator, *worker.solvedModel, worker.solvedAvatar,
+		errorMetricsSampleRate, sampleTimes, results);
+	name = groundTruthAnimation->name;
 
-					groundTruthPose.accelerations = groundTruthAccelerations;
+	//removeanimation handles animation destruction
+	worker.groundTruthAnimator->RemoveAnimation(true);
+	worker.solvedAnimator->RemoveAnimation(true);
+	return true;
+}
 
-					for (std::pair<std::string, MeshModel::JointInfo> pair : solvedSkinnedModel->GetJointMapping())
-						solvedAccelerations[pair.first] = solvedVelocities[pair.first] - prevGroundTruthVelocities[pair.first];
+void ComparisonScene::CompleteJob(int animationIndex)
+{
+	bool rowFinished;
+	{
+		std::lock_guard<std::mutex> lock(finishedAnimationsMutex);
+		ComparisonResult& result = comparisonResults[animationIndex];
+		rowFinished = --result.pendingShards == 0;
+		// Columns of the other shards are no use without the failed ones
+		if (rowFinished && result.failed)
+			result.loaded = false;
+	}
 
-					solvedPose.accelerations = solvedAccelerations;
-				}
+	if (rowFinished)
+	{
+		// All shards wrote their columns, so the last one persists the row
+		const ComparisonResult& result = comparisonResults[animationIndex];
+		if (journal && result.loaded && !result.fromJournal)
+			PersistResult(animationIndex);
 
-				for (std::pair<std::string, MeshModel::JointInfo> pair : groundTruthSkinnedModel->GetJointMapping())
-					prevGroundTruthPositions[pair.first] = pair.second.transform.translation();
+		std::lock_guard<std::mutex> lock(finishedAnimationsMutex);
+		finishedAnimations.push_back(animationIndex);
+	}
 
-				for (std::pair<std::string, MeshModel::JointInfo> pair : solvedSkinnedModel->GetJointMapping())
-					prevSolvedPositions[pair.first] = pair.second.transform.translation();
+	// Decremented after queueing, so the row is always published before the final matrix
+	pendingJobs--;
+}
 
-				prevGroundTruthVelocities = groundTruthVelocities;
-				prevSolvedVelocities = solvedVelocities;
-			}
+void ComparisonScene::FailRow(int animationIndex)
+{
+	std::lock_guard<std::mutex> lock(finishedAnimationsMutex);
+	comparisonResults[animationIndex].failed = true;
+}
 
-			for (int x = 0; x < selectedErrorMetrics.size(); ++x)
-			{
-				std::string metricName = dynamic_cast<Parameter<std::string>*>(selectedErrorMetrics[x]->GetParameters().at("Name"))->GetValue();
+std::shared_ptr<FusedPipeline::Clip> ComparisonScene::GetFusedClip(int animationIndex) const
+{
+	auto it = fusedClips.find(groundTruthAnimationPaths[animationIndex]);
+	return it != fusedClips.end() ? it->second : nullptr;
+}
 
-				if (metricName == "")
-					metricName = "ErrorMetric " + x;
+std::string ComparisonScene::GetComparisonInputHash(int animationIndex) const
+{
+	return RunJournal::HashFile(groundTruthAnimationPaths[animationIndex]) + RunJournal::HashFile(solvedAnimationPaths[animationIndex]) + modelHash;
+}
 
-				float result;
-				bool success = selectedErrorMetrics[x]->CalculateDifference(groundTruthPose, solvedPose, result);
-				if (success)
-					resultsMap[metricName].push_back(result);
-				else
-					resultsMap[metricName].push_back(NAN);
-			}
-		}
+bool ComparisonScene::LoadJournaledResult(int animationIndex, int shardIndex, const std::string& inputHash)
+{
+	QJsonObject output;
+	if (!journal->FindStage(groundTruthAnimationPaths[animationIndex], "compared", inputHash, comparisonSettingsHash, output))
+		return false;
+
+	ComparisonResult& result = comparisonResults[animationIndex];
+	ComparisonResult persisted;
+	if (!ReadMetricSeries(output["path"].toString().toStdString(), persisted) || persisted.metricResults.size() != result.metricResults.size())
+		return false;
+
+	for (int x : metricShards[shardIndex].metricIndices)
+		result.metricResults[x] = std::move(persisted.metricResults[x]);
+	if (shardIndex == 0)
+	{
+		result.name = persisted.name;
+		result.timestamps = std::move(persisted.timestamps);
+		result.loaded = true;
+		result.fromJournal = true;
+	}
+	return true;
+}
 
-		std::string animationName = groundTruthAnimation->name;
-		qDebug() << animationName.c_str();
-		rowNames.push_back(animationName);
+void ComparisonScene::PersistResult(int animationIndex)
+{
+	const ComparisonResult& result = comparisonResults[animationIndex];
+	const std::string& groundTruthPath = groundTruthAnimationPaths[animationIndex];
 
-		for (int x = 0; x < selectedErrorMetrics.size(); ++x)
-		{
-			std::string metricName = dynamic_cast<Parameter<std::string>*>(selectedErrorMetrics[x]->GetParameters().at("Name"))->GetValue();
+	// Clips from different folders may share a name, the path hash keeps their series apart
+	std::string seriesName = std::filesystem::path(groundTruthPath).stem().string() + "_" + RunJournal::HashBytes(groundTruthPath.c_str()).substr(0, 8) + ".metrics";
+	std::filesystem::path seriesPath = std::filesystem::path(journal->GetDirectory()) / "metrics" / seriesName;
+	std::filesystem::create_directories(seriesPath.parent_path());
 
-			if (metricName == "")
-				metricName = "ErrorMetric " + x;
+	// The journal record is written last, a torn series file is never referenced
+	if (WriteMetricSeries(seriesPath.string(), result))
+		journal->CompleteStage(groundTruthPath, "compared", result.inputHash, comparisonSettingsHash, QJsonObject { { "path", seriesPath.string().c_str() } });
+}
 
-			float combined = 0.0f;
-			int resultCount = 0;
-			for (size_t i = 0; i < resultsMap[metricName].size(); i++)
-			{
-				float result = resultsMap[metricName][i];
-				if (std::isnan(result))
-					continue;
-				combined += result;
-				resultCount++;
-			}
+bool ComparisonScene::WriteMetricSeries(const std::string& path, const ComparisonResult& result)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	auto writeCount = [&](size_t count) { uint32_t value = (uint32_t)count; file.write((const char*)&value, sizeof(value)); };
+
+	writeCount(result.name.size());
+	file.write(result.name.data(), result.name.size());
+	writeCount(result.timestamps.size());
+	file.write((const char*)result.timestamps.data(), result.timestamps.size() * sizeof(double));
+	writeCount(result.metricResults.size());
+	for (const std::vector<float>& series : result.metricResults)
+	{
+		writeCount(series.size());
+		file.write((const char*)series.data(), series.size() * sizeof(float));
+	}
+
+	return file.good();
+}
+
+bool ComparisonScene::ReadMetricSeries(const std::string& path, ComparisonResult& result)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	auto readCount = [&]() { uint32_t value = 0; file.read((char*)&value, sizeof(value)); return (size_t)value; };
+
+	result.name.resize(readCount());
+	file.read(&result.name[0], result.name.size());
+	result.timestamps.resize(readCount());
+	file.read((char*)result.timestamps.data(), result.timestamps.size() * sizeof(double));
+	result.metricResults.resize(readCount());
+	for (std::vector<float>& series : result.metricResults)
+	{
+		series.resize(readCount());
+		file.read((char*)series.data(), series.size() * sizeof(float));
+	}
+
+	return file.good();
+}
 
-			resultsMatrix[row * maxX + x] = combined / resultCount;
+void ComparisonScene::PublishFinishedAnimations()
+{
+	std::vector<int> finished;
+	{
+		std::lock_guard<std::mutex> lock(finishedAnimationsMutex);
+		finished.swap(finishedAnimations);
+	}
+
+	// No job touches these results anymore, so they can be read without the lock
+	for (int y : finished)
+	{
+		const ComparisonResult& comparisonResult = comparisonResults[y];
+
+		ResultsRow row;
+		row.row = y;
+		row.loaded = comparisonResult.loaded;
+		row.label = comparisonResult.loaded ? comparisonResult.name : std::filesystem::path(groundTruthAnimationPaths[y]).stem().string();
+		if (comparisonResult.loaded)
+		{
+			for (const std::vector<float>& metricResults : comparisonResult.metricResults)
+				row.values.push_back(MeanResult(metricResults));
 		}
 
-		results.name = animationName;
-		results.timestamps = sampleTimes;
-		results.errorMetricsResultsMap = resultsMap;
+		availableAnimations[y] = comparisonResult.loaded;
+		EventManager::instance().FireEvent("OnComparisonRowCalculated", row);
+	}
+}
 
-		combinedResults.push_back(results);
+float ComparisonScene::MeanResult(const std::vector<float>& results)
+{
+	float combined = 0.0f;
+	int resultCount = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		float result = results[i];
+		if (std::isnan(result))
+			continue;
+		combined += result;
+		resultCount++;
+	}
+	return combined / resultCount;
+}
+
+void ComparisonScene::FinishComparison()
+{
+	comparisonFinished = true;
+
+	// All jobs are done, release the workers and their skeletons
+	delete comparisonPool;
+	comparisonPool = nullptr;
+	ClearWorkers();
 
-		//removeanimation handles animation destruction
-		groundTruthAnimator->RemoveAnimation(true);
-		solvedAnimator->RemoveAnimation(true);
+	int maxX = selectedErrorMetrics.size();
+	std::vector<float> resultsMatrix;
+	std::vector<std::string> columnNames;
+	std::vector<std::string> rowNames;
+	std::vector<std::string> finalSolvedAnimationPaths;
+	std::vector<std::string> finalTruthAnimationPaths;
+	std::vector<AnimationResults> combinedResults;
 
-		row++;
+	// Rows that finished since the last update still get their own event
+	PublishFinishedAnimations();
+
+	// Assemble in animation order, independent of the order the jobs finished in
+	for (int y = 0; y < comparisonResults.size(); ++y)
+	{
+		const ComparisonResult& comparisonResult = comparisonResults[y];
+		if (!comparisonResult.loaded)
+			continue;
+
+		finalSolvedAnimationPaths.push_back(solvedAnimationPaths[y]);
+		finalTruthAnimationPaths.push_back(groundTruthAnimationPaths[y]);
+
+		qDebug() << comparisonResult.name.c_str();
+		rowNames.push_back(comparisonResult.name);
+
+		AnimationResults results;
+		for (int x = 0; x < maxX; ++x)
+		{
+			const std::vector<float>& metricResults = comparisonResult.metricResults[x];
+			resultsMatrix.push_back(MeanResult(metricResults));
+			results.errorMetricsResultsMap[planner->GetMetricNames()[x]] = metricResults;
+		}
+
+		results.name = comparisonResult.name;
+		results.timestamps = comparisonResult.timestamps;
+		combinedResults.push_back(results);
 	}
+	comparisonResults.clear();
 
+	// The final matrix only contains loaded animations, so the rows get renumbered
 	solvedAnimationPaths = finalSolvedAnimationPaths;
 	groundTruthAnimationPaths = finalTruthAnimationPaths;
+	availableAnimations.assign(groundTruthAnimationPaths.size(), true);
 
-	for (int x = 0; x < selectedErrorMetrics.size(); ++x)
+	for (const std::string& metricName : planner->GetMetricNames())
 	{
-		std::string metricName = dynamic_cast<Parameter<std::string>*>(selectedErrorMetrics[x]->GetParameters().at("Name"))->GetValue();
 		qDebug() << metricName.c_str();
 		columnNames.push_back(metricName);
 	}
@@ -273,6 +711,24 @@ void ComparisonScene::start()
 	EventManager::instance().FireEvent("OnMatrixCalculated", matrix);
 }
 
+void ComparisonScene::ClearWorkers()
+{
+	for (ComparisonWorker& worker : workers)
+	{
+		delete worker.groundTruthAnimator;
+		delete worker.solvedAnimator;
+		delete worker.groundTruthAvatar;
+		delete worker.solvedAvatar;
+		delete worker.groundTruthModel;
+		delete worker.solvedModel;
+	}
+	workers.clear();
+
+	for (MetricShard& shard : metricShards)
+		delete shard.planner;
+	metricShards.clear();
+}
+
 void ComparisonScene::OnProgressSliderValueChanged(float value)
 {
 	std::list<Animator*>::iterator it = animators.begin();
@@ -315,10 +771,15 @@ void ComparisonScene::TogglePlay()
 	}
 }
 
-void ComparisonScene::LoadAnimations(int index)
+bool ComparisonScene::LoadAnimations(int index)
 {
+	if (index < 0 || index >= availableAnimations.size() || !availableAnimations[index])
+		return false;
+
 	Animation* groundTruthAnimation = Animation::LoadFromPath(groundTruthAnimationPaths[index]);
-	Animation* solvedAnimation = Animation::LoadFromPath(solvedAnimationPaths[index]);
+	// Clips kept in memory are decompressed for the animator, which deletes its animation
+	std::shared_ptr<FusedPipeline::Clip> clip = GetFusedClip(index);
+	Animation* solvedAnimation = clip && clip->solved ? clip->solved->Decompress() : Animation::LoadFromPath(solvedAnimationPaths[index]);
 	std::list<Animator*>::iterator it = animators.begin();
 	Animator* animator = *it;
 	animator->RemoveAnimation(true);
@@ -327,12 +788,21 @@ void ComparisonScene::LoadAnimations(int index)
 	animator = *it;
 	animator->RemoveAnimation(true);
 	animator->SetAnimation(solvedAnimation);
+	return true;
 }
 
 void ComparisonScene::update(float dtime)
 {
 	Scene::update(dtime);
 
+	// The results get published on this thread, since the listeners are ui objects
+	if (!comparisonFinished && comparisonPool)
+	{
+		PublishFinishedAnimations();
+		if (pendingJobs == 0)
+			FinishComparison();
+	}
+
 	std::list<Animator*>::iterator it = animators.begin();
 	Animator* animator = *it;
 	if (animator->HasAnimation())
@@ -2,6 +2,13 @@
 
 #include "Scene.h"
 #include "Customizable/ErrorMetrics/BaseErrorMetric.h"
+#include "Customizable/ErrorMetrics/MetricEvaluationPlanner.h"
+#include "ThreadPool.h"
+#include "RunJournal.h"
+#include "FusedPipeline.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
 
 class ComparisonScene : public Scene
 {
@@ -20,20 +27,145 @@ public:
 	struct AnimationResults
 	{
 		std::string name;
-		std::vector<float> timestamps;
+		// Double precision, multi hour captures lose sub millisecond precision as float
+		std::vector<double> timestamps;
 		std::map<std::string, std::vector<float>> errorMetricsResultsMap;
 	};
 
+	// The mean results of one animation, published as soon as all of its jobs are done
+	struct ResultsRow
+	{
+		// Index of the animation in the paths passed in, the table keeps this order until the final matrix arrives
+		int row = 0;
+		bool loaded = false;
+		std::string label;
+		// Indexed like the column labels
+		std::vector<float> values;
+	};
+
 private:
+	// Skeleton state owned by one pool thread, so animations can be evaluated in parallel
+	struct ComparisonWorker
+	{
+		SkinnedModel* groundTruthModel = nullptr;
+		SkinnedModel* solvedModel = nullptr;
+		Avatar* groundTruthAvatar = nullptr;
+		Avatar* solvedAvatar = nullptr;
+		Animator* groundTruthAnimator = nullptr;
+		Animator* solvedAnimator = nullptr;
+	};
+
+	// A group of metrics evaluated by its own job
+	struct MetricShard
+	{
+		MetricEvaluationPlanner* planner = nullptr;
+		std::vector<int> metricIndices;
+	};
+
+	struct ComparisonResult
+	{
+		bool loaded = false;
+		// Guarded by finishedAnimationsMutex
+		int pendingShards = 0;
+		bool failed = false;
+		// Set by the first shard
+		std::string inputHash;
+		bool fromJournal = false;
+		std::string name;
+		std::vector<double> timestamps;
+		// Indexed like selectedErrorMetrics
+		std::vector<std::vector<float>> metricResults;
+	};
+
+	// A long capture whose chunks are evaluated by jobs of their own
+	struct ChunkedRow
+	{
+		int animationIndex = 0;
+		int shardIndex = 0;
+		// Metric columns the chunks evaluate, indexed like the results of the planner
+		std::vector<int> columns;
+		std::vector<std::string> cacheKeys;
+		std::unique_ptr<AnimationChunkReader> groundTruthReader;
+		std::unique_ptr<AnimationChunkReader> solvedReader;
+		std::unique_ptr<MetricEvaluationPlanner> partialPlanner;
+		const MetricEvaluationPlanner* planner = nullptr;
+		std::vector<MetricEvaluationPlanner::Chunk> chunks;
+		// Indexed like the chunks, every job only writes its own entries
+		std::vector<std::vector<double>> sampleTimes;
+		std::vector<std::vector<std::vector<float>>> results;
+		std::vector<char> evaluated;
+		std::atomic<int> pendingChunks { 0 };
+		// A chunk threw, the row fails
+		std::atomic<bool> failed { false };
+	};
+
+	MetricEvaluationPlanner* planner = nullptr;
+	ThreadPool* comparisonPool = nullptr;
+	std::vector<ComparisonWorker> workers;
+	std::vector<MetricShard> metricShards;
+	// Indexed like the animation paths passed in
+	std::vector<ComparisonResult> comparisonResults;
+	std::atomic<int> pendingJobs { 0 };
+	bool comparisonFinished = false;
+	// Animations whose jobs are all done but that have not been published yet
+	std::mutex finishedAnimationsMutex;
+	std::vector<int> finishedAnimations;
+	// Animations that can already be played back, indexed like the animation paths
+	std::vector<bool> availableAnimations;
+	// Journal of the run the solved animations belong to, finished rows get persisted there
+	RunJournal* journal = nullptr;
+	std::string comparisonSettingsHash;
+	// Content hash of the model file, only computed if the journal or the stage cache needs it
+	std::string modelHash;
+	// Everything a metric series depends on besides the animations, indexed like selectedErrorMetrics
+	std::vector<QJsonObject> metricSettings;
+
 	std::vector<BaseErrorMetric*> selectedErrorMetrics;
 	std::vector<std::string> groundTruthAnimationPaths;
 	std::vector<std::string> solvedAnimationPaths;
+	// Rows the fused pipeline already evaluated, by ground truth path
+	std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips;
 	std::string modelfile = "";
 	int errorMetricsSampleRate = 0;
 
 	void SaveErrorMetricResults(std::vector<AnimationResults> combinedResults);
+
+	void StartComparison();
+	// Completes the job even if it threw, the row is failed then
+	void RunComparisonJob(int animationIndex, int shardIndex, int workerIndex);
+	// False once chunk jobs took the row over, they complete the job then
+	bool RunShard(int animationIndex, int shardIndex, int workerIndex);
+	// Samples both animations of a row and evaluates the planned metrics, false if they could not be loaded.
+	// Valid readers provide the animations, otherwise they are imported from their paths.
+	bool EvaluateRow(int animationIndex, ComparisonWorker& worker, MetricEvaluationPlanner& rowPlanner, const AnimationChunkReader* groundTruthReader, const AnimationChunkReader* solvedReader, std::string& name, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results);
+	void StoreEvaluatedColumns(int animationIndex, int shardIndex, const std::vector<int>& columns, const std::vector<std::string>& cacheKeys, const std::string& name, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& evaluatedResults);
+	// Queues a job per chunk if the row is a long capture, takes over the partial planner and the readers then. False if the row is evaluated at once.
+	bool StartChunkedRow(int animationIndex, int shardIndex, const std::vector<int>& columns, const std::vector<std::string>& cacheKeys, std::unique_ptr<MetricEvaluationPlanner>& partialPlanner,
+		std::unique_ptr<AnimationChunkReader>& groundTruthReader, std::unique_ptr<AnimationChunkReader>& solvedReader);
+	void RunChunkJob(std::shared_ptr<ChunkedRow> row, int chunkIndex, int workerIndex);
+	// Stitches the chunks of a row and completes its job
+	void FinishChunkedRow(ChunkedRow& row);
+	void StoreChunkedRow(ChunkedRow& row);
+	void CompleteJob(int animationIndex);
+	// The row is left out of the results once all of its jobs completed
+	void FailRow(int animationIndex);
+	// Null for rows evaluated by the jobs
+	std::shared_ptr<FusedPipeline::Clip> GetFusedClip(int animationIndex) const;
+	// Content hash of both animations of a row and the model
+	std::string GetComparisonInputHash(int animationIndex) const;
+	// Takes the shard columns from a row an earlier attempt persisted, false if there is none for these inputs
+	bool LoadJournaledResult(int animationIndex, int shardIndex, const std::string& inputHash);
+	void PersistResult(int animationIndex);
+	static bool WriteMetricSeries(const std::string& path, const ComparisonResult& result);
+	static bool ReadMetricSeries(const std::string& path, ComparisonResult& result);
+	// Fires a row event for every animation finished since the last update
+	void PublishFinishedAnimations();
+	// Builds the results matrix in animation order once all jobs are done
+	void FinishComparison();
+	void ClearWorkers();
+	static float MeanResult(const std::vector<float>& results);
 public:
-	ComparisonScene(std::string modelfile,std::vector<BaseErrorMetric*> selectedErrorMetrics, std::vector<std::string> groundTruthAnimationPaths, std::vector<std::string> solvedAnimationPaths, int errorMetricsSampleRate);
+	ComparisonScene(std::string modelfile,std::vector<BaseErrorMetric*> selectedErrorMetrics, std::vector<std::string> groundTruthAnimationPaths, std::vector<std::string> solvedAnimationPaths, int errorMetricsSampleRate, std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips = {});
 	~ComparisonScene(); 
 
 	virtual void start();
@@ -47,5 +179,6 @@ public:
 	void OnStopButtonPressed();
 	void TogglePlay();
 
-	void LoadAnimations(int index);
+	// Returns false if the animation at the index is not evaluated yet
+	bool LoadAnimations(int index);
 };
\ No newline at end of file
@@ -0,0 +1,446 @@
+#include "CompressedAnimation.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float QUANTIZATION_STEPS = 65535.0f;
+	const float SMALLEST_THREE_STEPS = 1023.0f;
+	const float SMALLEST_THREE_RANGE = 0.70710678f; // 1 / sqrt(2)
+
+	// Smallest positive distance between two keys of any channel
+	float DetectTimeStep(const Animation& animation)
+	{
+		float timeStep = 0.0f;
+		auto inspect = [&timeStep](float previous, float current)
+		{
+			float delta = current - previous;
+			if (delta > 1e-6f && (timeStep == 0.0f || delta < timeStep))
+				timeStep = delta;
+		};
+
+		for (const auto& kv : animation.animNodeMapping)
+		{
+			const AnimationCurve& curve = kv.second;
+			for (size_t k = 1; k < curve.positions.size(); k++)
+				inspect(curve.positions[k - 1].time, curve.positions[k].time);
+			for (size_t k = 1; k < curve.rotations.size(); k++)
+				inspect(curve.rotations[k - 1].time, curve.rotations[k].time);
+			for (size_t k = 1; k < curve.scalings.size(); k++)
+				inspect(curve.scalings[k - 1].time, curve.scalings[k].time);
+		}
+		return timeStep;
+	}
+
+	CompressedAnimation::KeyTimes BuildKeyTimes(const std::vector<float>& times, float timeStep)
+	{
+		CompressedAnimation::KeyTimes keyTimes;
+		keyTimes.timeStep = timeStep;
+
+		// Frame indices only work if every key lies on the grid
+		bool onGrid = timeStep > 0.0f;
+		for (size_t k = 0; k < times.size() && onGrid; k++)
+		{
+			float frame = std::round(times[k] / timeStep);
+			onGrid = frame >= 0.0f && frame <= QUANTIZATION_STEPS && std::abs(frame * timeStep - times[k]) <= timeStep * 1e-3f;
+		}
+
+		if (onGrid)
+		{
+			keyTimes.frames.reserve(times.size());
+			for (float time : times)
+				keyTimes.frames.push_back((uint16_t)std::round(time / timeStep));
+		}
+		else
+			keyTimes.times = times;
+
+		return keyTimes;
+	}
+
+	uint16_t Quantize(float value, float minimum, float extent)
+	{
+		if (extent <= 0.0f)
+			return 0;
+		float normalized = std::clamp((value - minimum) / extent, 0.0f, 1.0f);
+		return (uint16_t)std::round(normalized * QUANTIZATION_STEPS);
+	}
+
+	float Dequantize(uint16_t value, float minimum, float extent)
+	{
+		return minimum + extent * (value / QUANTIZATION_STEPS);
+	}
+
+	/// Greedily extends linear segments as long as every skipped key is reconstructed within the tolerance.
+	/// The segment end points are the quantized values, so the bound covers quantization and reduction together.
+	/// The kept keys themselves have to be within the tolerance already, see QuantizationFits.
+	template<class T, class Interpolate, class Error>
+	std::vector<size_t> ReduceKeys(const std::vector<float>& times, const std::vector<T>& original, const std::vector<T>& quantized,
+		Interpolate interpolate, Error error, float tolerance, int maxSegmentLength)
+	{
+		auto segmentFits = [&](size_t start, size_t end)
+		{
+			float length = times[end] - times[start];
+			for (size_t k = start + 1; k < end; k++)
+			{
+				float t = length > 0.0f ? (times[k] - times[start]) / length : 0.0f;
+				if (error(interpolate(quantized[start], quantized[end], t), original[k]) > tolerance)
+					return false;
+			}
+			return true;
+		};
+
+		std::vector<size_t> kept = { 0 };
+		size_t count = original.size();
+		size_t start = 0;
+		while (start + 1 < count)
+		{
+			size_t end = start + 1;
+			while (end + 1 < count && (int)(end + 1 - start) <= maxSegmentLength && segmentFits(start, end + 1))
+				end++;
+			kept.push_back(end);
+			start = end;
+		}
+		return kept;
+	}
+
+	// Whether every key survives the quantization within the tolerance, otherwise the kept keys would break the bound
+	template<class T, class Error>
+	bool QuantizationFits(const std::vector<T>& original, const std::vector<T>& quantized, Error error, float tolerance)
+	{
+		for (size_t k = 0; k < original.size(); k++)
+		{
+			if (error(quantized[k], original[k]) > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	CompressedAnimation::VectorChannel CompressVectorChannel(const std::vector<AnimationCurve::VectorAnimationKey>& keys, float tolerance, float timeStep, int maxSegmentLength)
+	{
+		CompressedAnimation::VectorChannel channel;
+		if (keys.empty())
+			return channel;
+
+		Vector3 minimum = keys[0].value;
+		Vector3 maximum = keys[0].value;
+		for (const AnimationCurve::VectorAnimationKey& key : keys)
+		{
+			minimum = Vector3(std::min(minimum.x, key.value.x), std::min(minimum.y, key.value.y), std::min(minimum.z, key.value.z));
+			maximum = Vector3(std::max(maximum.x, key.value.x), std::max(maximum.y, key.value.y), std::max(maximum.z, key.value.z));
+		}
+
+		// Fold the channel if every key is within the tolerance of the center of the bounds
+		Vector3 extent = maximum - minimum;
+		if (extent.length() * 0.5f <= tolerance)
+		{
+			channel.mode = CompressedAnimation::ChannelMode::Constant;
+			channel.minimum = minimum + extent * 0.5f;
+			return channel;
+		}
+
+		channel.mode = CompressedAnimation::ChannelMode::Keyed;
+		channel.minimum = minimum;
+		channel.extent = extent;
+
+		std::vector<float> times;
+		std::vector<Vector3> original;
+		std::vector<Vector3> quantized;
+		std::vector<uint16_t> packed;
+		for (const AnimationCurve::VectorAnimationKey& key : keys)
+		{
+			uint16_t x = Quantize(key.value.x, minimum.x, extent.x);
+			uint16_t y = Quantize(key.value.y, minimum.y, extent.y);
+			uint16_t z = Quantize(key.value.z, minimum.z, extent.z);
+			packed.insert(packed.end(), { x, y, z });
+
+			times.push_back(key.time);
+			original.push_back(key.value);
+			quantized.push_back(Vector3(Dequantize(x, minimum.x, extent.x), Dequantize(y, minimum.y, extent.y), Dequantize(z, minimum.z, extent.z)));
+		}
+
+		auto distance = [](const Vector3& lhs, const Vector3& rhs) { return Vector3::Distance(lhs, rhs); };
+		bool raw = !QuantizationFits(original, quantized, distance, tolerance);
+		std::vector<size_t> kept = ReduceKeys(times, original, raw ? original : quantized,
+			[](const Vector3& from, const Vector3& to, float t) { return Vector3::interpolate(from, to, t); },
+			distance, tolerance, maxSegmentLength);
+
+		std::vector<float> keptTimes;
+		for (size_t k : kept)
+		{
+			keptTimes.push_back(times[k]);
+			if (raw)
+				channel.rawValues.push_back(original[k]);
+			else
+				channel.values.insert(channel.values.end(), packed.begin() + k * 3, packed.begin() + k * 3 + 3);
+		}
+		channel.keyTimes = BuildKeyTimes(keptTimes, timeStep);
+
+		return channel;
+	}
+
+	CompressedAnimation::RotationChannel CompressRotationChannel(const std::vector<AnimationCurve::QuaternionAnimationKey>& keys, float tolerance, float timeStep, int maxSegmentLength)
+	{
+		CompressedAnimation::RotationChannel channel;
+		if (keys.empty())
+			return channel;
+
+		bool constant = true;
+		for (size_t k = 1; k < keys.size() && constant; k++)
+			constant = Quaternion::Angle(keys[0].value, keys[k].value) <= tolerance;
+
+		if (constant)
+		{
+			channel.mode = CompressedAnimation::ChannelMode::Constant;
+			channel.constant = keys[0].value.normalized();
+			return channel;
+		}
+
+		channel.mode = CompressedAnimation::ChannelMode::Keyed;
+
+		std::vector<float> times;
+		std::vector<Quaternion> original;
+		std::vector<Quaternion> quantized;
+		std::vector<uint32_t> packed;
+		for (const AnimationCurve::QuaternionAnimationKey& key : keys)
+		{
+			uint32_t value = CompressedAnimation::PackQuaternion(key.value);
+			packed.push_back(value);
+
+			times.push_back(key.time);
+			original.push_back(key.value);
+			quantized.push_back(CompressedAnimation::UnpackQuaternion(value));
+		}
+
+		auto angle = [](const Quaternion& lhs, const Quaternion& rhs) { return Quaternion::Angle(lhs, rhs); };
+		bool raw = !QuantizationFits(original, quantized, angle, tolerance);
+		std::vector<size_t> kept = ReduceKeys(times, original, raw ? original : quantized,
+			[](const Quaternion& from, const Quaternion& to, float t) { return Quaternion::Lerp(from, to, t); },
+			angle, tolerance, maxSegmentLength);
+
+		std::vector<float> keptTimes;
+		for (size_t k : kept)
+		{
+			keptTimes.push_back(times[k]);
+			if (raw)
+				channel.rawValues.push_back(original[k]);
+			else
+				channel.values.push_back(packed[k]);
+		}
+		channel.keyTimes = BuildKeyTimes(keptTimes, timeStep);
+
+		return channel;
+	}
+}
+
+size_t CompressedAnimation::KeyTimes::FindKey(float time) const
+{
+	size_t next;
+	if (frames.empty())
+		next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+	else
+	{
+		float frame = time / timeStep;
+		next = std::upper_bound(frames.begin(), frames.end(), frame, [](float value, uint16_t key) { return value < key; }) - frames.begin();
+	}
+	return next == 0 ? 0 : next - 1;
+}
+
+Vector3 CompressedAnimation::VectorChannel::Value(size_t key) const
+{
+	if (!rawValues.empty())
+		return rawValues[key];
+	const uint16_t* value = &values[key * 3];
+	return Vector3(Dequantize(value[0], minimum.x, extent.x), Dequantize(value[1], minimum.y, extent.y), Dequantize(value[2], minimum.z, extent.z));
+}
+
+Vector3 CompressedAnimation::VectorChannel::Sample(float time) const
+{
+	if (mode == ChannelMode::Empty)
+		return Vector3::zero;
+	if (mode == ChannelMode::Constant)
+		return minimum;
+
+	size_t key = keyTimes.FindKey(time);
+	float from = keyTimes.Time(key);
+	if (key + 1 >= keyTimes.Count() || time <= from)
+		return Value(key);
+
+	float to = keyTimes.Time(key + 1);
+	return Vector3::interpolate(Value(key), Value(key + 1), (time - from) / (to - from));
+}
+
+Quaternion CompressedAnimation::RotationChannel::Sample(float time) const
+{
+	if (mode == ChannelMode::Empty)
+		return Quaternion::identity;
+	if (mode == ChannelMode::Constant)
+		return constant;
+
+	size_t key = keyTimes.FindKey(time);
+	float from = keyTimes.Time(key);
+	if (key + 1 >= keyTimes.Count() || time <= from)
+		return Value(key);
+
+	float to = keyTimes.Time(key + 1);
+	return Quaternion::Lerp(Value(key), Value(key + 1), (time - from) / (to - from));
+}
+
+uint32_t CompressedAnimation::PackQuaternion(const Quaternion& rotation)
+{
+	Quaternion normalized = rotation.normalized();
+	float components[4] = { normalized.x, normalized.y, normalized.z, normalized.w };
+
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (std::abs(components[i]) > std::abs(components[largest]))
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so the dropped component can always be made positive
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint32_t packed = (uint32_t)largest;
+	int shift = 2;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		float normalizedComponent = (components[i] * sign / SMALLEST_THREE_RANGE + 1.0f) * 0.5f;
+		uint32_t quantized = (uint32_t)std::round(std::clamp(normalizedComponent, 0.0f, 1.0f) * SMALLEST_THREE_STEPS);
+		packed |= quantized << shift;
+		shift += 10;
+	}
+
+	return packed;
+}
+
+Quaternion CompressedAnimation::UnpackQuaternion(uint32_t packed)
+{
+	int largest = packed & 0x3;
+	float components[4];
+	float sum = 0.0f;
+	int shift = 2;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		float normalizedComponent = ((packed >> shift) & 0x3FF) / SMALLEST_THREE_STEPS;
+		components[i] = (normalizedComponent * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+		sum += components[i] * components[i];
+		shift += 10;
+	}
+	components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+	return Quaternion(components[0], components[1], components[2], components[3]).normalized();
+}
+
+CompressedAnimation* CompressedAnimation::Compress(const Animation& animation, const AnimationCompressionSettings& settings)
+{
+	CompressedAnimation* compressed = new CompressedAnimation();
+	compressed->duration = animation.duration;
+	compressed->ticksPerSecond = animation.ticksPerSecond;
+	compressed->name = animation.name;
+	compressed->path = animation.path;
+	compressed->filename = animation.filename;
+
+	float timeStep = DetectTimeStep(animation);
+	compressed->channels.reserve(animation.animNodeMapping.size());
+	for (const auto& kv : animation.animNodeMapping)
+	{
+		const AnimationCurve& curve = kv.second;
+
+		Channel channel;
+		channel.name = curve.name;
+		channel.positions = CompressVectorChannel(curve.positions, settings.positionTolerance, timeStep, settings.maxSegmentLength);
+		channel.rotations = CompressRotationChannel(curve.rotations, settings.rotationTolerance, timeStep, settings.maxSegmentLength);
+		channel.scalings = CompressVectorChannel(curve.scalings, settings.scaleTolerance, timeStep, settings.maxSegmentLength);
+
+		compressed->channelIndices[kv.first] = compressed->channels.size();
+		compressed->channels.push_back(std::move(channel));
+	}
+
+	return compressed;
+}
+
+Animation* CompressedAnimation::Decompress() const
+{
+	Animation* animation = new Animation();
+	animation->duration = duration;
+	animation->ticksPerSecond = ticksPerSecond;
+	animation->name = name;
+	animation->path = path;
+	animation->filename = filename;
+
+	for (const auto& kv : channelIndices)
+	{
+		const Channel& channel = channels[kv.second];
+
+		AnimationCurve curve;
+		curve.name = channel.name;
+
+		auto decompressVectors = [](const VectorChannel& source, std::vector<AnimationCurve::VectorAnimationKey>& keys)
+		{
+			if (source.mode == ChannelMode::Constant)
+				keys.push_back(AnimationCurve::VectorAnimationKey(0.0f, source.minimum));
+			else if (source.mode == ChannelMode::Keyed)
+			{
+				for (size_t k = 0; k < source.keyTimes.Count(); k++)
+					keys.push_back(AnimationCurve::VectorAnimationKey(source.keyTimes.Time(k), source.Value(k)));
+			}
+		};
+
+		decompressVectors(channel.positions, curve.positions);
+		decompressVectors(channel.scalings, curve.scalings);
+
+		if (channel.rotations.mode == ChannelMode::Constant)
+			curve.rotations.push_back(AnimationCurve::QuaternionAnimationKey(0.0f, channel.rotations.constant));
+		else if (channel.rotations.mode == ChannelMode::Keyed)
+		{
+			for (size_t k = 0; k < channel.rotations.keyTimes.Count(); k++)
+				curve.rotations.push_back(AnimationCurve::QuaternionAnimationKey(channel.rotations.keyTimes.Time(k), channel.rotations.Value(k)));
+		}
+
+		curve.Classify();
+		animation->animNodeMapping[kv.first] = curve;
+	}
+
+	return animation;
+}
+
+int CompressedAnimation::FindChannel(const std::string& nodeName) const
+{
+	auto it = channelIndices.find(nodeName);
+	if (it == channelIndices.end())
+		return -1;
+	return it->second;
+}
+
+size_t CompressedAnimation::GetMemoryUsage() const
+{
+	size_t usage = sizeof(CompressedAnimation);
+	for (const Channel& channel : channels)
+	{
+		usage += channel.name.capacity();
+		usage += channel.positions.MemoryUsage() + channel.rotations.MemoryUsage() + channel.scalings.MemoryUsage();
+	}
+	return usage;
+}
+
+size_t CompressedAnimation::GetMemoryUsage(const Animation& animation)
+{
+	size_t usage = sizeof(Animation);
+	for (const auto& kv : animation.animNodeMapping)
+	{
+		const AnimationCurve& curve = kv.second;
+		usage += sizeof(AnimationCurve) + curve.name.capacity();
+		usage += curve.positions.capacity() * sizeof(AnimationCurve::VectorAnimationKey);
+		usage += curve.rotations.capacity() * sizeof(AnimationCurve::QuaternionAnimationKey);
+		usage += curve.scalings.capacity() * sizeof(AnimationCurve::VectorAnimationKey);
+		usage += (curve.resampled.positions.capacity() + curve.resampled.scalings.capacity()) * sizeof(Vector3);
+		usage += curve.resampled.rotations.capacity() * sizeof(Quaternion);
+	}
+	return usage;
+}
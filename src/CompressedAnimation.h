@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+#include "Animation.h"
+
+// Error bounds used when compressing an animation
+struct AnimationCompressionSettings
+{
+	// Maximum deviation of a decompressed position or scale, in model units
+	float positionTolerance = 0.001f;
+	float scaleTolerance = 0.001f;
+	// Maximum deviation of a decompressed rotation in degrees
+	float rotationTolerance = 0.5f;
+	// Upper bound for the keys a single linear segment may span. Every extension of a segment re-checks all keys it skips,
+	// so this caps the work per segment at O(maxSegmentLength^2).
+	int maxSegmentLength = 512;
+};
+
+/// <summary>
+/// Compact storage for large animation libraries.
+/// Constant channels are folded into a single value, positions and scales are quantized to 16 bit against their channel bounds,
+/// rotations are stored smallest three quantized in 32 bit and keys which can be reconstructed by interpolation within the error bounds are removed.
+/// Channels whose quantization alone would exceed the error bounds keep their values unquantized.
+/// Every channel can still be sampled at random times without decompressing the whole clip.
+/// </summary>
+class CompressedAnimation
+{
+public:
+	enum class ChannelMode { Empty, Constant, Keyed };
+
+	// Key times, stored as frame indices if all keys lie on the time grid of the source animation
+	struct KeyTimes
+	{
+		float timeStep = 0.0f;
+		std::vector<uint16_t> frames;
+		std::vector<float> times;
+
+		size_t Count() const { return frames.empty() ? times.size() : frames.size(); }
+		float Time(size_t key) const { return frames.empty() ? times[key] : frames[key] * timeStep; }
+		// Index of the last key at or before the time
+		size_t FindKey(float time) const;
+		size_t MemoryUsage() const { return frames.size() * sizeof(uint16_t) + times.size() * sizeof(float); }
+	};
+
+	struct VectorChannel
+	{
+		ChannelMode mode = ChannelMode::Empty;
+		KeyTimes keyTimes;
+		// Holds the value of a constant channel
+		Vector3 minimum = Vector3::zero;
+		Vector3 extent = Vector3::zero;
+		// Three components per key
+		std::vector<uint16_t> values;
+		// Used instead of the quantized values if their steps are too coarse for the tolerance
+		std::vector<Vector3> rawValues;
+
+		Vector3 Value(size_t key) const;
+		Vector3 Sample(float time) const;
+		size_t MemoryUsage() const { return sizeof(VectorChannel) + keyTimes.MemoryUsage() + values.size() * sizeof(uint16_t) + rawValues.size() * sizeof(Vector3); }
+	};
+
+	struct RotationChannel
+	{
+		ChannelMode mode = ChannelMode::Empty;
+		KeyTimes keyTimes;
+		Quaternion constant = Quaternion::identity;
+		std::vector<uint32_t> values;
+		// Used instead of the packed values if their steps are too coarse for the tolerance
+		std::vector<Quaternion> rawValues;
+
+		Quaternion Value(size_t key) const { return rawValues.empty() ? UnpackQuaternion(values[key]) : rawValues[key]; }
+		Quaternion Sample(float time) const;
+		size_t MemoryUsage() const { return sizeof(RotationChannel) + keyTimes.MemoryUsage() + values.size() * sizeof(uint32_t) + rawValues.size() * sizeof(Quaternion); }
+	};
+
+	struct Channel
+	{
+		std::string name;
+		VectorChannel positions;
+		RotationChannel rotations;
+		VectorChannel scalings;
+
+		Vector3 GetPosition(float time) const { return positions.Sample(time); }
+		Quaternion GetRotation(float time) const { return rotations.Sample(time); }
+		Vector3 GetScale(float time) const { return scalings.Sample(time); }
+	};
+
+	float duration = 0.0f;
+	float ticksPerSecond = 1.0f;
+	std::string name;
+	std::string path;
+	std::string filename;
+
+	/// <summary>
+	/// Compresses the keyed curves of the animation, dense tracks are ignored
+	/// </summary>
+	static CompressedAnimation* Compress(const Animation& animation, const AnimationCompressionSettings& settings = AnimationCompressionSettings());
+
+	// Creates a regular keyed animation from the remaining keys
+	Animation* Decompress() const;
+
+	// Returns -1 if there is no channel for the node
+	int FindChannel(const std::string& nodeName) const;
+	const Channel& GetChannel(int index) const { return channels[index]; }
+	int GetChannelCount() const { return channels.size(); }
+
+	size_t GetMemoryUsage() const;
+	// Memory held by the keys of an uncompressed animation, for comparison
+	static size_t GetMemoryUsage(const Animation& animation);
+
+	static uint32_t PackQuaternion(const Quaternion& rotation);
+	static Quaternion UnpackQuaternion(uint32_t packed);
+private:
+	std::vector<Channel> channels;
+	std::map<std::string, int> channelIndices;
+};
@@ -8,30 +8,52 @@ AnatomicAngleErrorMetric::AnatomicAngleErrorMetric() : BaseErrorMetric("Anatomic
 	//AddParameter(new Parameter<CustomEnums::AvatarJointType>("Joint", CustomEnums::AvatarJointType::));
 }
 
-bool AnatomicAngleErrorMetric::CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result)
+bool AnatomicAngleErrorMetric::CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results)
 {
-	// Use double just to be safe here
-	double combinedAngle = 0.0f;
-	int counter = 0;
-
-	for (int jointType = 0; jointType <= (int)CustomEnums::AvatarJointType::Head; jointType++)
+	// Pair up the angles both avatars have sampled
+	std::vector<int> truthAngles;
+	std::vector<int> solvedAngles;
+	for (int angle = 0; angle < groundTruth.AngleCount(); ++angle)
 	{
-		AvatarJoint* joint = groundTruthPose.avatar->GetAvatarJoint((CustomEnums::AvatarJointType)jointType);
-		std::vector<CustomEnums::HumanAnatomicAngleType> angleTypes = groundTruthPose.avatar->GetAnatomicAngleTypesOfJoint(joint->humanJointType);
-		for (CustomEnums::HumanAnatomicAngleType angleType : angleTypes)
-		{
-			float groundTruthAngle = groundTruthPose.avatar->GetAnatomicAngle((CustomEnums::AvatarJointType)jointType, angleType);
-			float solvedAngle = solvedPose.avatar->GetAnatomicAngle((CustomEnums::AvatarJointType)jointType, angleType);
-			combinedAngle += std::abs(groundTruthAngle - solvedAngle);
-			++counter;
-		}
+		const AnatomicAngleKey& key = groundTruth.AngleKey(angle);
+		if (key.first > CustomEnums::AvatarJointType::Head)
+			continue;
+
+		int solvedAngle = solved.AngleIndex(key.first, key.second);
+		if (solvedAngle < 0)
+			continue;
+
+		truthAngles.push_back(angle);
+		solvedAngles.push_back(solvedAngle);
 	}
 
-	result = combinedAngle / counter;
+	if (truthAngles.empty())
+		return false;
+
+	int angleCount = truthAngles.size();
+	results.resize(groundTruth.frameCount);
+	for (int frame = 0; frame < groundTruth.frameCount; ++frame)
+	{
+		const float* truthFrame = groundTruth.Angles(frame);
+		const float* solvedFrame = solved.Angles(frame);
+
+		// Use double just to be safe here
+		double combinedAngle = 0.0;
+		for (int i = 0; i < angleCount; ++i)
+			combinedAngle += std::abs(truthFrame[truthAngles[i]] - solvedFrame[solvedAngles[i]]);
+
+		results[frame] = combinedAngle / angleCount;
+	}
 
 	return true;
 }
 
+void AnatomicAngleErrorMetric::DeclareInputs(MetricInputs& inputs) const
+{
+	for (int jointType = 0; jointType <= (int)CustomEnums::AvatarJointType::Head; jointType++)
+		inputs.AddAngle((CustomEnums::AvatarJointType)jointType, CustomEnums::HumanAnatomicAngleType::All);
+}
+
 BaseErrorMetric* AnatomicAngleErrorMetric::Clone() const
 {
 	return new AnatomicAngleErrorMetric();
@@ -7,7 +7,9 @@ class AnatomicAngleErrorMetric : public BaseErrorMetric
 public:
 	AnatomicAngleErrorMetric();
 
-	virtual bool CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result);
+	virtual bool CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results);
+	virtual bool SupportsBatch() const { return true; }
+	virtual void DeclareInputs(MetricInputs& inputs) const;
 
 	static RegisterBaseErrorMetric<AnatomicAngleErrorMetric> Register;
 
@@ -1,7 +1,8 @@
 #include "BaseErrorMetric.h"
 #include "../../Animator.h"
+#include <cmath>
 
-BaseErrorMetric::BaseErrorMetric(std::string name) : name(name)
+BaseErrorMetric::BaseErrorMetric(std::string name) : name(name), needsVelocities(false), needsAccelerations(false)
 {
     AddParameter(new Parameter<std::string>("Name", name));
 }
@@ -17,6 +18,31 @@ std::string BaseErrorMetric::GetName() const
     return name;
 }
 
+bool BaseErrorMetric::CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result)
+{
+	if (!groundTruthPose.frame.frames || !solvedPose.frame.frames)
+		return false;
+
+	std::vector<float> results;
+	if (!CalculateDifferences(groundTruthPose.frame, solvedPose.frame, results) || results.empty())
+		return false;
+
+	result = results[0];
+	return !std::isnan(result);
+}
+
+bool BaseErrorMetric::CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results)
+{
+	return false;
+}
+
+void BaseErrorMetric::DeclareInputs(MetricInputs& inputs) const
+{
+	inputs.allJoints = true;
+	inputs.rotations = true;
+	inputs.derivativeOrder = needsAccelerations ? 2 : (needsVelocities ? 1 : 0);
+}
+
 int BaseErrorMetric::GetSamplerate()
 {
 	return dynamic_cast<Parameter<int>*>(parameters["SampleRate"])->GetValue();
@@ -7,6 +7,7 @@
 #include "../../Parameter.h"
 #include "../../AvatarSystem/Avatar.h"
 #include "../../Animator.h"
+#include "PoseFrames.h"
 
 template <class T>
 struct RegisterBaseErrorMetric
@@ -29,6 +30,9 @@ public:
 	{
 		Avatar* avatar = nullptr;
 		SkinnedModel* skinnedModel = nullptr;
+		// Single frame view into the sampled trajectory
+		PoseWindow frame;
+		// Only filled for per frame metrics which request them
 		std::map<std::string, Vector3> velocities = std::map<std::string, Vector3>();
 		std::map<std::string, Vector3> accelerations = std::map<std::string, Vector3>();
 	};
@@ -38,7 +42,27 @@ public:
 
 	BaseErrorMetric(std::string name);
 
-	virtual bool CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result) = 0;
+	/// <summary>
+	/// Calculates the difference for a single frame.
+	/// The default implementation adapts to CalculateDifferences with a window of one frame.
+	/// </summary>
+	virtual bool CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result);
+
+	/// <summary>
+	/// Calculates the difference for every frame of the windows at once.
+	/// Only called if SupportsBatch returns true.
+	/// </summary>
+	/// <param name="results">Receives one value per frame, NAN marks an invalid frame</param>
+	virtual bool CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results);
+
+	// Metrics which only read the sampled pose frames can be evaluated for a whole trajectory in one call
+	virtual bool SupportsBatch() const { return false; }
+
+	/// <summary>
+	/// Declares which joints, derivatives and anatomic angles the metric reads from the pose frames.
+	/// The default requests everything, so metrics which do not override it keep working unchanged.
+	/// </summary>
+	virtual void DeclareInputs(MetricInputs& inputs) const;
 
 	// Define a virtual destructor
 	virtual ~BaseErrorMetric() {}
@@ -0,0 +1,334 @@
+#include "MetricEvaluationPlanner.h"
+#include <cmath>
+#include <algorithm>
+
+MetricEvaluationPlanner::MetricEvaluationPlanner(const std::vector<BaseErrorMetric*>& metrics) : metrics(metrics)
+{
+	for (int x = 0; x < metrics.size(); ++x)
+	{
+		// Resolve the names once instead of looking up the parameter every frame
+		std::string metricName = dynamic_cast<Parameter<std::string>*>(metrics[x]->GetParameters().at("Name"))->GetValue();
+		if (metricName == "")
+			metricName = "ErrorMetric " + std::to_string(x);
+		metricNames.push_back(metricName);
+
+		if (metrics[x]->SupportsBatch())
+			batchMetrics.push_back(x);
+		else
+			frameMetrics.push_back(x);
+
+		MetricInputs metricInputs;
+		metrics[x]->DeclareInputs(metricInputs);
+		inputs.Merge(metricInputs);
+	}
+
+	// Per frame metrics still read the derivatives by joint name
+	if (!frameMetrics.empty())
+		inputs.allJoints = true;
+}
+
+std::vector<std::string> MetricEvaluationPlanner::ResolveJoints(SkinnedModel& model) const
+{
+	std::vector<std::string> jointNames;
+	for (const auto& kv : model.GetJointMapping())
+	{
+		if (inputs.allJoints || inputs.joints.count(kv.first))
+			jointNames.push_back(kv.first);
+	}
+	return jointNames;
+}
+
+std::vector<AnatomicAngleKey> MetricEvaluationPlanner::ResolveAngles(Avatar* avatar) const
+{
+	std::vector<AnatomicAngleKey> keys;
+	if (!avatar)
+		return keys;
+
+	std::set<AnatomicAngleKey> resolved;
+	for (const AnatomicAngleKey& key : inputs.angles)
+	{
+		if (key.second != CustomEnums::HumanAnatomicAngleType::All)
+		{
+			resolved.insert(key);
+			continue;
+		}
+
+		for (CustomEnums::HumanAnatomicAngleType angleType : avatar->GetAnatomicAngleTypesOfJoint(key.first))
+			resolved.insert(AnatomicAngleKey(key.first, angleType));
+	}
+
+	keys.assign(resolved.begin(), resolved.end());
+	return keys;
+}
+
+bool MetricEvaluationPlanner::GetRequiredJoints(Avatar* avatar, std::set<std::string>& joints) const
+{
+	// Per frame metrics get the whole model
+	if (inputs.allJoints || !frameMetrics.empty())
+		return false;
+
+	joints.insert(inputs.joints.begin(), inputs.joints.end());
+	if (!inputs.angles.empty())
+	{
+		if (!avatar)
+			return false;
+		for (AvatarJoint* avatarJoint : avatar->GetAllAvatarJoints())
+			joints.insert(avatarJoint->transform->Name());
+	}
+	return true;
+}
+
+void MetricEvaluationPlanner::InitializeFrames(PoseFrames& frames, SkinnedModel& model, Avatar* avatar, int frameCount) const
+{
+	frames.Initialize(model, ResolveJoints(model), frameCount, inputs.derivativeOrder, inputs.rotations);
+	frames.InitializeAngles(avatar, ResolveAngles(avatar));
+}
+
+void MetricEvaluationPlanner::Evaluate(
+	Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	int sampleRate, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const
+{
+	float animationLength = groundTruthAnimator.GetAnimationLength();
+	int frameCount = animationLength * sampleRate;
+
+	sampleTimes.clear();
+	sampleTimes.reserve(frameCount);
+	for (int i = 0; i < frameCount; i++)
+		sampleTimes.push_back(animationLength * (i / (double)frameCount));
+
+	results.assign(metrics.size(), std::vector<float>());
+	EvaluateFrames(
+		groundTruthAnimator, groundTruthModel, groundTruthAvatar,
+		solvedAnimator, solvedModel, solvedAvatar,
+		sampleTimes, 0, results);
+}
+
+void MetricEvaluationPlanner::EvaluateChunked(
+	const AnimationChunkReader& groundTruthReader, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	const AnimationChunkReader& solvedReader, Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	int sampleRate, double chunkLength, double overlap, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const
+{
+	sampleTimes.clear();
+	sampleTimes.reserve((size_t)(groundTruthReader.GetDuration() * sampleRate));
+	results.assign(metrics.size(), std::vector<float>());
+
+	std::vector<double> chunkSampleTimes;
+	std::vector<std::vector<float>> chunkResults;
+	for (const Chunk& chunk : PlanChunks(groundTruthReader.GetDuration(), sampleRate, chunkLength, overlap))
+	{
+		if (!EvaluateChunk(
+			groundTruthReader, groundTruthAnimator, groundTruthModel, groundTruthAvatar,
+			solvedReader, solvedAnimator, solvedModel, solvedAvatar,
+			sampleRate, chunk, chunkSampleTimes, chunkResults))
+			break;
+
+		sampleTimes.insert(sampleTimes.end(), chunkSampleTimes.begin(), chunkSampleTimes.end());
+		for (size_t x = 0; x < results.size(); ++x)
+			results[x].insert(results[x].end(), chunkResults[x].begin(), chunkResults[x].end());
+	}
+}
+
+std::vector<MetricEvaluationPlanner::Chunk> MetricEvaluationPlanner::PlanChunks(double duration, int sampleRate, double chunkLength, double overlap) const
+{
+	// Frames are placed on a global grid, so the chunks line up without gaps or duplicates
+	long long frameCount = (long long)(duration * sampleRate);
+	long long framesPerChunk = std::max(1LL, (long long)(chunkLength * sampleRate));
+	long long warmupFrames = std::max((long long)inputs.derivativeOrder, (long long)std::ceil(overlap * sampleRate));
+
+	std::vector<Chunk> chunks;
+	for (long long firstFrame = 0; firstFrame < frameCount; firstFrame += framesPerChunk)
+		chunks.push_back({ std::max(0LL, firstFrame - warmupFrames), firstFrame, std::min(firstFrame + framesPerChunk, frameCount) });
+	return chunks;
+}
+
+bool MetricEvaluationPlanner::EvaluateChunk(
+	const AnimationChunkReader& groundTruthReader, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	const AnimationChunkReader& solvedReader, Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	int sampleRate, const Chunk& chunk, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const
+{
+	sampleTimes.clear();
+	results.assign(metrics.size(), std::vector<float>());
+
+	double from = chunk.warmupStart / (double)sampleRate;
+	double to = chunk.lastFrame / (double)sampleRate;
+
+	Animation* groundTruthChunk = groundTruthReader.ReadRange(from, to);
+	Animation* solvedChunk = solvedReader.ReadRange(from, to);
+	if (!groundTruthChunk || !solvedChunk)
+	{
+		delete groundTruthChunk;
+		delete solvedChunk;
+		return false;
+	}
+
+	groundTruthAnimator.SetAnimation(groundTruthChunk);
+	solvedAnimator.SetAnimation(solvedChunk);
+
+	// Chunk local times stay small, so they keep their precision as float
+	std::vector<double> chunkSampleTimes;
+	for (long long frame = chunk.warmupStart; frame < chunk.lastFrame; frame++)
+		chunkSampleTimes.push_back(frame / (double)sampleRate - from);
+	for (long long frame = chunk.firstFrame; frame < chunk.lastFrame; frame++)
+		sampleTimes.push_back(frame / (double)sampleRate);
+
+	EvaluateFrames(
+		groundTruthAnimator, groundTruthModel, groundTruthAvatar,
+		solvedAnimator, solvedModel, solvedAvatar,
+		chunkSampleTimes, chunk.firstFrame - chunk.warmupStart, results);
+
+	//removeanimation handles animation destruction
+	groundTruthAnimator.RemoveAnimation(true);
+	solvedAnimator.RemoveAnimation(true);
+	return true;
+}
+
+void MetricEvaluationPlanner::CaptureGroundTruth(
+	Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	int sampleRate, std::vector<double>& sampleTimes, PoseFrames& groundTruthFrames) const
+{
+	float animationLength = groundTruthAnimator.GetAnimationLength();
+	int frameCount = animationLength * sampleRate;
+
+	sampleTimes.clear();
+	sampleTimes.reserve(frameCount);
+	for (int i = 0; i < frameCount; i++)
+		sampleTimes.push_back(animationLength * (i / (double)frameCount));
+
+	CaptureFrames(groundTruthAnimator, groundTruthModel, groundTruthAvatar, sampleTimes, groundTruthFrames);
+}
+
+void MetricEvaluationPlanner::EvaluateAgainst(
+	const PoseFrames& groundTruthFrames, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	const std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const
+{
+	int frameCount = sampleTimes.size();
+	PoseFrames solvedFrames;
+	InitializeFrames(solvedFrames, solvedModel, solvedAvatar, frameCount);
+
+	results.assign(metrics.size(), std::vector<float>());
+	for (int x : frameMetrics)
+		results[x].reserve(frameCount);
+
+	for (int i = 0; i < frameCount; i++)
+	{
+		CaptureFrame(solvedAnimator, solvedFrames, sampleTimes[i], i);
+		if (frameMetrics.empty())
+			continue;
+
+		// The ground truth frames are already captured, only the skeleton has to follow for per frame metrics
+		groundTruthAnimator.SetNormalizedAnimationTime(sampleTimes[i] / groundTruthAnimator.GetAnimationLength());
+		EvaluateFrameMetrics(
+			groundTruthFrames, groundTruthModel, groundTruthAvatar,
+			solvedFrames, solvedModel, solvedAvatar,
+			i, results);
+	}
+
+	EvaluateBatchMetrics(groundTruthFrames, solvedFrames, 0, results);
+}
+
+void MetricEvaluationPlanner::EvaluateFrames(
+	Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	const std::vector<double>& sampleTimes, int warmupFrames, std::vector<std::vector<float>>& results) const
+{
+	int frameCount = sampleTimes.size();
+	PoseFrames groundTruthFrames;
+	PoseFrames solvedFrames;
+	InitializeFrames(groundTruthFrames, groundTruthModel, groundTruthAvatar, frameCount);
+	InitializeFrames(solvedFrames, solvedModel, solvedAvatar, frameCount);
+
+	for (int x : frameMetrics)
+		results[x].reserve(results[x].size() + frameCount - warmupFrames);
+
+	// Per frame metrics may read the skeletons, so both stay posed at the frame until its metrics ran
+	for (int i = 0; i < frameCount; i++)
+	{
+		CaptureFrame(groundTruthAnimator, groundTruthFrames, sampleTimes[i], i);
+		CaptureFrame(solvedAnimator, solvedFrames, sampleTimes[i], i);
+		if (i < warmupFrames || frameMetrics.empty())
+			continue;
+
+		EvaluateFrameMetrics(
+			groundTruthFrames, groundTruthModel, groundTruthAvatar,
+			solvedFrames, solvedModel, solvedAvatar,
+			i, results);
+	}
+
+	EvaluateBatchMetrics(groundTruthFrames, solvedFrames, warmupFrames, results);
+}
+
+void MetricEvaluationPlanner::CaptureFrame(Animator& animator, PoseFrames& frames, double sampleTime, int frame) const
+{
+	float time = sampleTime;
+	animator.SetNormalizedAnimationTime(time / animator.GetAnimationLength());
+	frames.CaptureFrame(frame, time);
+	frames.UpdateDerivatives(frame);
+}
+
+void MetricEvaluationPlanner::CaptureFrames(Animator& animator, SkinnedModel& model, Avatar* avatar, const std::vector<double>& sampleTimes, PoseFrames& frames) const
+{
+	int frameCount = sampleTimes.size();
+	InitializeFrames(frames, model, avatar, frameCount);
+
+	for (int i = 0; i < frameCount; i++)
+		CaptureFrame(animator, frames, sampleTimes[i], i);
+}
+
+void MetricEvaluationPlanner::EvaluateFrameMetrics(
+	const PoseFrames& groundTruthFrames, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+	const PoseFrames& solvedFrames, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+	int frame, std::vector<std::vector<float>>& results) const
+{
+	BaseErrorMetric::Pose groundTruthPose;
+	BaseErrorMetric::Pose solvedPose;
+
+	groundTruthPose.skinnedModel = &groundTruthModel;
+	solvedPose.skinnedModel = &solvedModel;
+
+	groundTruthPose.avatar = groundTruthAvatar;
+	solvedPose.avatar = solvedAvatar;
+
+	groundTruthPose.frame = PoseWindow(&groundTruthFrames, frame, 1);
+	solvedPose.frame = PoseWindow(&solvedFrames, frame, 1);
+
+	int derivativeOrder = inputs.derivativeOrder;
+	for (int joint = 0; joint < groundTruthFrames.jointCount; ++joint)
+	{
+		const std::string& jointName = groundTruthFrames.jointNames[joint];
+		if (derivativeOrder >= 1 && frame > 0)
+		{
+			groundTruthPose.velocities[jointName] = groundTruthFrames.Velocity(frame, joint);
+			solvedPose.velocities[jointName] = solvedFrames.Velocity(frame, joint);
+		}
+		if (derivativeOrder >= 2 && frame > 1)
+		{
+			groundTruthPose.accelerations[jointName] = groundTruthFrames.Acceleration(frame, joint);
+			solvedPose.accelerations[jointName] = solvedFrames.Acceleration(frame, joint);
+		}
+	}
+
+	for (int x : frameMetrics)
+	{
+		float result;
+		bool success = metrics[x]->CalculateDifference(groundTruthPose, solvedPose, result);
+		results[x].push_back(success ? result : NAN);
+	}
+}
+
+void MetricEvaluationPlanner::EvaluateBatchMetrics(const PoseFrames& groundTruthFrames, const PoseFrames& solvedFrames, int warmupFrames, std::vector<std::vector<float>>& results) const
+{
+	// Evaluate the trajectory metrics on the whole range at once
+	int resultCount = groundTruthFrames.frameCount - warmupFrames;
+	PoseWindow groundTruthWindow = PoseWindow(&groundTruthFrames, warmupFrames, resultCount);
+	PoseWindow solvedWindow = PoseWindow(&solvedFrames, warmupFrames, resultCount);
+	std::vector<float> batchResults;
+	for (int x : batchMetrics)
+	{
+		bool success = metrics[x]->CalculateDifferences(groundTruthWindow, solvedWindow, batchResults);
+		if (!success || batchResults.size() != resultCount)
+			batchResults.assign(resultCount, NAN);
+		results[x].insert(results[x].end(), batchResults.begin(), batchResults.end());
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "BaseErrorMetric.h"
+#include "PoseFrames.h"
+#include "../../AnimationChunkReader.h"
+
+// Collects the inputs of all selected error metrics, so every shared pose quantity
+// (joint transforms, derivatives, anatomic angles) gets sampled only once per frame
+class MetricEvaluationPlanner
+{
+private:
+	std::vector<BaseErrorMetric*> metrics;
+	std::vector<std::string> metricNames;
+	std::vector<int> batchMetrics;
+	std::vector<int> frameMetrics;
+	MetricInputs inputs;
+
+	std::vector<std::string> ResolveJoints(SkinnedModel& model) const;
+	std::vector<AnatomicAngleKey> ResolveAngles(Avatar* avatar) const;
+
+	// Samples both animators at the given times and appends the results of every frame after the warm up frames.
+	// Per frame metrics run right after their frame got captured, while both skeletons are still posed at it.
+	void EvaluateFrames(
+		Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		const std::vector<double>& sampleTimes, int warmupFrames, std::vector<std::vector<float>>& results) const;
+	// Poses the animator at the sample time and captures the frame, including the derivatives
+	void CaptureFrame(Animator& animator, PoseFrames& frames, double sampleTime, int frame) const;
+	// Samples one animator at the given times
+	void CaptureFrames(Animator& animator, SkinnedModel& model, Avatar* avatar, const std::vector<double>& sampleTimes, PoseFrames& frames) const;
+	// Appends the per frame metric results of one frame, the skeletons have to be posed at that frame
+	void EvaluateFrameMetrics(
+		const PoseFrames& groundTruthFrames, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		const PoseFrames& solvedFrames, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		int frame, std::vector<std::vector<float>>& results) const;
+	// Appends the trajectory metric results of every frame after the warm up frames
+	void EvaluateBatchMetrics(const PoseFrames& groundTruthFrames, const PoseFrames& solvedFrames, int warmupFrames, std::vector<std::vector<float>>& results) const;
+public:
+	MetricEvaluationPlanner(const std::vector<BaseErrorMetric*>& metrics);
+
+	// The result names of the metrics, in metric order
+	const std::vector<std::string>& GetMetricNames() const { return metricNames; }
+	const MetricInputs& GetInputs() const { return inputs; }
+
+	/// <summary>
+	/// Adds the joints the metrics read from the skeleton, the anatomic angles need every avatar joint
+	/// </summary>
+	/// <returns>False if a metric may read any joint</returns>
+	bool GetRequiredJoints(Avatar* avatar, std::set<std::string>& joints) const;
+
+	/// <summary>
+	/// Allocates the frames for the merged inputs of all metrics
+	/// </summary>
+	/// <param name="avatar">Used to calculate anatomic angles, can be null if no metric needs them</param>
+	void InitializeFrames(PoseFrames& frames, SkinnedModel& model, Avatar* avatar, int frameCount) const;
+
+	/// <summary>
+	/// Samples both animators at the given rate and evaluates all metrics on the sampled frames
+	/// </summary>
+	/// <param name="sampleTimes">Receives the time of every sampled frame</param>
+	/// <param name="results">Receives one value per frame for every metric, in metric order. NAN marks an invalid frame</param>
+	void Evaluate(
+		Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		int sampleRate, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const;
+
+	/// <summary>
+	/// Samples the ground truth once, so it can be evaluated against several solved animations with EvaluateAgainst
+	/// </summary>
+	/// <param name="sampleTimes">Receives the time of every sampled frame</param>
+	void CaptureGroundTruth(
+		Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		int sampleRate, std::vector<double>& sampleTimes, PoseFrames& groundTruthFrames) const;
+
+	/// <summary>
+	/// Same as Evaluate for a ground truth captured by CaptureGroundTruth. The frames are only read, so several threads can share them.
+	/// </summary>
+	/// <param name="groundTruthAnimator">Plays the captured ground truth, only posed for per frame metrics. Every thread needs its own.</param>
+	void EvaluateAgainst(
+		const PoseFrames& groundTruthFrames, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		const std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const;
+
+	/// <summary>
+	/// Same as Evaluate, but only holds the pose frames of one chunk at a time.
+	/// Every chunk starts the overlap earlier, the overlapping frames only warm up derivatives and are dropped.
+	/// </summary>
+	/// <param name="chunkLength">Length of a chunk in seconds</param>
+	/// <param name="overlap">Warm up time in seconds in front of every chunk</param>
+	void EvaluateChunked(
+		const AnimationChunkReader& groundTruthReader, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		const AnimationChunkReader& solvedReader, Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		int sampleRate, double chunkLength, double overlap, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const;
+
+	// Frames of one chunk on the global frame grid, the frames from warmupStart to firstFrame only warm up derivatives
+	struct Chunk
+	{
+		long long warmupStart;
+		long long firstFrame;
+		long long lastFrame;
+	};
+
+	// The chunks EvaluateChunked splits a capture of the given length into
+	std::vector<Chunk> PlanChunks(double duration, int sampleRate, double chunkLength, double overlap) const;
+
+	/// <summary>
+	/// Evaluates a single chunk of PlanChunks. The chunks do not depend on each other, so they can be evaluated on separate skeletons at the same time.
+	/// </summary>
+	/// <param name="sampleTimes">Receives the capture time of every frame of the chunk</param>
+	/// <param name="results">Receives one value per frame of the chunk for every metric</param>
+	/// <returns>False if the chunk could not be read</returns>
+	bool EvaluateChunk(
+		const AnimationChunkReader& groundTruthReader, Animator& groundTruthAnimator, SkinnedModel& groundTruthModel, Avatar* groundTruthAvatar,
+		const AnimationChunkReader& solvedReader, Animator& solvedAnimator, SkinnedModel& solvedModel, Avatar* solvedAvatar,
+		int sampleRate, const Chunk& chunk, std::vector<double>& sampleTimes, std::vector<std::vector<float>>& results) const;
+};
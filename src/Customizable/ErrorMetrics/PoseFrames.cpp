@@ -0,0 +1,138 @@
+#include "PoseFrames.h"
+#include "../../SkinnedModel.h"
+#include "../../AvatarSystem/Avatar.h"
+#include "../../Enumerations.h"
+#include <algorithm>
+
+void MetricInputs::AddJoint(int humanJointType)
+{
+	if (humanJointType != (int)Enums::HumanJointType::All)
+	{
+		joints.insert(QVariant::fromValue((Enums::HumanJointType)humanJointType).toString().toStdString());
+		return;
+	}
+
+	for (int joint = (int)Enums::HumanJointType::Hips; joint != (int)Enums::HumanJointType::All; joint++)
+		joints.insert(QVariant::fromValue((Enums::HumanJointType)joint).toString().toStdString());
+}
+
+void MetricInputs::Merge(const MetricInputs& other)
+{
+	joints.insert(other.joints.begin(), other.joints.end());
+	allJoints = allJoints || other.allJoints;
+	rotations = rotations || other.rotations;
+	derivativeOrder = std::max(derivativeOrder, other.derivativeOrder);
+	angles.insert(other.angles.begin(), other.angles.end());
+}
+
+void PoseFrames::Initialize(SkinnedModel& model, const std::vector<std::string>& jointNames, int frameCount, int derivativeOrder, bool captureRotations)
+{
+	this->jointNames = jointNames;
+	this->jointCount = jointNames.size();
+	this->frameCount = frameCount;
+	this->derivativeOrder = derivativeOrder;
+	this->captureRotations = captureRotations;
+
+	jointIndices.clear();
+	boundJoints.clear();
+	boundJoints.reserve(jointCount);
+
+	// Resolve the names once, the jointmapping nodes stay valid for the lifetime of the model
+	const std::map<std::string, MeshModel::JointInfo>& jointMapping = model.GetJointMapping();
+	for (int joint = 0; joint < jointCount; ++joint)
+	{
+		jointIndices[jointNames[joint]] = joint;
+
+		auto it = jointMapping.find(jointNames[joint]);
+		boundJoints.push_back(it != jointMapping.end() ? &it->second : nullptr);
+	}
+
+	size_t valueCount = (size_t)frameCount * jointCount;
+	timestamps.assign(frameCount, 0.0f);
+	positions.assign(valueCount, Vector3::zero);
+	rotations.assign(captureRotations ? valueCount : 0, Quaternion::identity);
+	velocities.assign(derivativeOrder >= 1 ? valueCount : 0, Vector3::zero);
+	accelerations.assign(derivativeOrder >= 2 ? valueCount : 0, Vector3::zero);
+
+	InitializeAngles(nullptr, {});
+}
+
+void PoseFrames::InitializeAngles(Avatar* avatar, const std::vector<AnatomicAngleKey>& keys)
+{
+	boundAvatar = keys.empty() ? nullptr : avatar;
+	angleKeys = boundAvatar ? keys : std::vector<AnatomicAngleKey>();
+	angleCount = angleKeys.size();
+
+	angleIndices.clear();
+	for (int angle = 0; angle < angleCount; ++angle)
+		angleIndices[angleKeys[angle]] = angle;
+
+	angles.assign((size_t)frameCount * angleCount, 0.0f);
+}
+
+void PoseFrames::CaptureFrame(int frame, float time)
+{
+	timestamps[frame] = time;
+
+	Vector3* framePositions = &positions[frame * jointCount];
+	Quaternion* frameRotations = captureRotations ? &rotations[frame * jointCount] : nullptr;
+	for (int joint = 0; joint < jointCount; ++joint)
+	{
+		const MeshModel::JointInfo* info = boundJoints[joint];
+		if (!info)
+			continue;
+
+		framePositions[joint] = info->globalPose.translation;
+		if (frameRotations)
+		{
+			// Same sign as the matrix conversion used before, w is never negative
+			const Quaternion& rotation = info->globalPose.rotation;
+			frameRotations[joint] = rotation.w < 0.0f ? rotation * -1.0f : rotation;
+		}
+	}
+
+	if (!boundAvatar)
+		return;
+
+	// The avatar hierarchy only has to follow the model once per frame for all angles
+	boundAvatar->UpdateTransforms();
+	float* frameAngles = &angles[frame * angleCount];
+	for (int angle = 0; angle < angleCount; ++angle)
+		frameAngles[angle] = boundAvatar->CalculateAnatomicAngle(angleKeys[angle].first, angleKeys[angle].second);
+}
+
+void PoseFrames::UpdateDerivatives(int frame)
+{
+	if (derivativeOrder < 1 || frame == 0)
+		return;
+
+	const Vector3* current = &positions[frame * jointCount];
+	const Vector3* previous = &positions[(frame - 1) * jointCount];
+	Vector3* velocity = &velocities[frame * jointCount];
+	for (int joint = 0; joint < jointCount; ++joint)
+		velocity[joint] = current[joint] - previous[joint];
+
+	if (derivativeOrder < 2 || frame == 1)
+		return;
+
+	const Vector3* previousVelocity = &velocities[(frame - 1) * jointCount];
+	Vector3* acceleration = &accelerations[frame * jointCount];
+	for (int joint = 0; joint < jointCount; ++joint)
+		acceleration[joint] = velocity[joint] - previousVelocity[joint];
+}
+
+int PoseFrames::JointIndex(const std::string& name) const
+{
+	auto it = jointIndices.find(name);
+	if (it == jointIndices.end())
+		return -1;
+	return it->second;
+}
+
+int PoseFrames::AngleIndex(CustomEnums::AvatarJointType joint, CustomEnums::HumanAnatomicAngleType angle) const
+{
+	auto it = angleIndices.find(AnatomicAngleKey(joint, angle));
+	if (it == angleIndices.end())
+		return -1;
+	return it->second;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+
+#include "../../vector.h"
+#include "../../Quaternion.h"
+#include "../../MeshModel.h"
+#include "../CustomEnumerations.h"
+
+class SkinnedModel;
+class Avatar;
+
+typedef std::pair<CustomEnums::AvatarJointType, CustomEnums::HumanAnatomicAngleType> AnatomicAngleKey;
+
+// The pose quantities an error metric reads, used to sample every shared quantity only once per frame
+struct MetricInputs
+{
+	// Joint names to capture, ignored if allJoints is set
+	std::set<std::string> joints;
+	bool allJoints = false;
+	bool rotations = false;
+	// 0 = positions only, 1 = with velocities, 2 = with velocities and accelerations
+	int derivativeOrder = 0;
+	// HumanAnatomicAngleType::All requests every angle the avatar defines for the joint
+	std::set<AnatomicAngleKey> angles;
+
+	// Adds a joint by its enum, Enums::HumanJointType::All adds every human joint
+	void AddJoint(int humanJointType);
+	void AddAngle(CustomEnums::AvatarJointType joint, CustomEnums::HumanAnatomicAngleType angle) { angles.insert(AnatomicAngleKey(joint, angle)); }
+	void Merge(const MetricInputs& other);
+};
+
+// Structure-of-arrays storage for a sequence of sampled poses.
+// Every per joint quantity is stored frame major: data[frame * jointCount + joint]
+struct PoseFrames
+{
+	std::vector<std::string> jointNames;
+	std::map<std::string, int> jointIndices;
+	int jointCount = 0;
+	int frameCount = 0;
+	int derivativeOrder = 0;
+
+	std::vector<float> timestamps;
+	std::vector<Vector3> positions;
+	std::vector<Quaternion> rotations;
+	std::vector<Vector3> velocities;
+	std::vector<Vector3> accelerations;
+
+	std::vector<AnatomicAngleKey> angleKeys;
+	std::map<AnatomicAngleKey, int> angleIndices;
+	int angleCount = 0;
+	// Frame major as well: angles[frame * angleCount + angle]
+	std::vector<float> angles;
+
+	/// <summary>
+	/// Allocates storage for the given joints and frames and binds the joints to the model they get captured from
+	/// </summary>
+	/// <param name="model">The model the frames get captured from</param>
+	/// <param name="jointNames">The joints to capture, in storage order</param>
+	/// <param name="frameCount">The amount of frames to reserve</param>
+	/// <param name="derivativeOrder">0 = positions only, 1 = with velocities, 2 = with velocities and accelerations</param>
+	/// <param name="captureRotations">Rotation extraction is skipped if no metric reads them</param>
+	void Initialize(SkinnedModel& model, const std::vector<std::string>& jointNames, int frameCount, int derivativeOrder, bool captureRotations = true);
+
+	/// <summary>
+	/// Allocates storage for anatomic angles and binds the avatar they get calculated with
+	/// </summary>
+	/// <param name="keys">The angles to capture, in storage order. Must not contain HumanAnatomicAngleType::All</param>
+	void InitializeAngles(Avatar* avatar, const std::vector<AnatomicAngleKey>& keys);
+
+	// Copies the current global joint transforms of the bound model and the anatomic angles of the bound avatar into the given frame
+	void CaptureFrame(int frame, float time);
+
+	// Backward differences per sample, only depends on the frames before, so it can run directly after capturing
+	void UpdateDerivatives(int frame);
+
+	int JointIndex(const std::string& name) const;
+	int AngleIndex(CustomEnums::AvatarJointType joint, CustomEnums::HumanAnatomicAngleType angle) const;
+
+	const Vector3& Position(int frame, int joint) const { return positions[frame * jointCount + joint]; }
+	const Quaternion& Rotation(int frame, int joint) const { return rotations[frame * jointCount + joint]; }
+	const Vector3& Velocity(int frame, int joint) const { return velocities[frame * jointCount + joint]; }
+	const Vector3& Acceleration(int frame, int joint) const { return accelerations[frame * jointCount + joint]; }
+	float Angle(int frame, int angle) const { return angles[frame * angleCount + angle]; }
+
+private:
+	std::vector<const MeshModel::JointInfo*> boundJoints;
+	Avatar* boundAvatar = nullptr;
+	bool captureRotations = true;
+};
+
+// Read-only view over a consecutive range of frames of a PoseFrames container
+struct PoseWindow
+{
+	PoseWindow() : frames(nullptr), firstFrame(0), frameCount(0) {}
+	PoseWindow(const PoseFrames* frames, int firstFrame, int frameCount) : frames(frames), firstFrame(firstFrame), frameCount(frameCount) {}
+
+	const PoseFrames* frames;
+	int firstFrame;
+	int frameCount;
+
+	int JointCount() const { return frames->jointCount; }
+	int JointIndex(const std::string& name) const { return frames->JointIndex(name); }
+	int AngleCount() const { return frames->angleCount; }
+	const AnatomicAngleKey& AngleKey(int angle) const { return frames->angleKeys[angle]; }
+	int AngleIndex(CustomEnums::AvatarJointType joint, CustomEnums::HumanAnatomicAngleType angle) const { return frames->AngleIndex(joint, angle); }
+	float Timestamp(int frame) const { return frames->timestamps[firstFrame + frame]; }
+
+	// Pointers to the first joint of a frame, the joints of a frame are contiguous
+	const Vector3* Positions(int frame) const { return &frames->positions[(firstFrame + frame) * frames->jointCount]; }
+	const Quaternion* Rotations(int frame) const { return &frames->rotations[(firstFrame + frame) * frames->jointCount]; }
+	const Vector3* Velocities(int frame) const { return &frames->velocities[(firstFrame + frame) * frames->jointCount]; }
+	const Vector3* Accelerations(int frame) const { return &frames->accelerations[(firstFrame + frame) * frames->jointCount]; }
+	const float* Angles(int frame) const { return &frames->angles[(firstFrame + frame) * frames->angleCount]; }
+
+	PoseWindow SubWindow(int first, int count) const { return PoseWindow(frames, firstFrame + first, count); }
+};
@@ -8,41 +8,56 @@ PositionDifferenceErrorMetric::PositionDifferenceErrorMetric() : BaseErrorMetric
 	AddParameter(new Parameter<Enums::HumanJointType>("Joint", Enums::HumanJointType::All));
 }
 
-bool PositionDifferenceErrorMetric::CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result)
+bool PositionDifferenceErrorMetric::CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results)
 {
-	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters["Joint"])->GetValue();
+	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters.at("Joint"))->GetValue();
 
-	if (selectedJoint == Enums::HumanJointType::All)
+	// Resolve the joint names to indices once for the whole window
+	std::vector<int> truthJoints;
+	std::vector<int> solvedJoints;
+	int firstJoint = selectedJoint == Enums::HumanJointType::All ? (int)Enums::HumanJointType::Hips : (int)selectedJoint;
+	int lastJoint = selectedJoint == Enums::HumanJointType::All ? (int)Enums::HumanJointType::All : (int)selectedJoint + 1;
+	for (int humanJointType = firstJoint; humanJointType != lastJoint; humanJointType++)
 	{
-		// Use double just to be safe here
-		double combinedDistance = 0.0f;
-		int counter = 0;
-
-		std::map<std::string, MeshModel::JointInfo> truthJointMapping = groundTruthPose.skinnedModel->GetJointMapping();
-		std::map<std::string, MeshModel::JointInfo> solvedJointMapping = solvedPose.skinnedModel->GetJointMapping();
-		for (int humanJointType = (int)Enums::HumanJointType::Hips; humanJointType != (int)Enums::HumanJointType::All; humanJointType++)
-		{
-			Enums::HumanJointType jointEnum = static_cast<Enums::HumanJointType>(humanJointType);
-			std::string jointString = QVariant::fromValue(jointEnum).toString().toStdString();
-
-			Vector3 groundTruthPosition = truthJointMapping[jointString].globalTransform.translation();
-			Vector3 solvedPosition = solvedJointMapping[jointString].globalTransform.translation();
-			combinedDistance += Vector3::Distance(groundTruthPosition, solvedPosition);
-			++counter;
-		}
-		result = combinedDistance / counter;
+		Enums::HumanJointType jointEnum = static_cast<Enums::HumanJointType>(humanJointType);
+		std::string jointString = QVariant::fromValue(jointEnum).toString().toStdString();
+
+		int truthJoint = groundTruth.JointIndex(jointString);
+		int solvedJoint = solved.JointIndex(jointString);
+		if (truthJoint < 0 || solvedJoint < 0)
+			continue;
+
+		truthJoints.push_back(truthJoint);
+		solvedJoints.push_back(solvedJoint);
 	}
-	else
+
+	if (truthJoints.empty())
+		return false;
+
+	int jointCount = truthJoints.size();
+	results.resize(groundTruth.frameCount);
+	for (int frame = 0; frame < groundTruth.frameCount; ++frame)
 	{
-		std::string selectedJointString = QVariant::fromValue(selectedJoint).toString().toStdString();
-		Vector3 solvedPos = solvedPose.skinnedModel->GetJointMapping()[selectedJointString].globalTransform.translation();
-		Vector3 groundTruthPos = groundTruthPose.skinnedModel->GetJointMapping()[selectedJointString].globalTransform.translation();
-		result = Vector3::Distance(groundTruthPos, solvedPos);
+		const Vector3* truthPositions = groundTruth.Positions(frame);
+		const Vector3* solvedPositions = solved.Positions(frame);
+
+		// Use double just to be safe here
+		double combinedDistance = 0.0;
+		for (int i = 0; i < jointCount; ++i)
+			combinedDistance += Vector3::Distance(truthPositions[truthJoints[i]], solvedPositions[solvedJoints[i]]);
+
+		results[frame] = combinedDistance / jointCount;
 	}
 
 	return true;
 }
 
+void PositionDifferenceErrorMetric::DeclareInputs(MetricInputs& inputs) const
+{
+	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters.at("Joint"))->GetValue();
+	inputs.AddJoint((int)selectedJoint);
+}
+
 BaseErrorMetric* PositionDifferenceErrorMetric::Clone() const
 {
 	return new PositionDifferenceErrorMetric();
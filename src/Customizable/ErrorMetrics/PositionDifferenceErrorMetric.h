@@ -7,7 +7,9 @@ class PositionDifferenceErrorMetric : public BaseErrorMetric
 public:
 	PositionDifferenceErrorMetric();
 
-	virtual bool CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result);
+	virtual bool CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results);
+	virtual bool SupportsBatch() const { return true; }
+	virtual void DeclareInputs(MetricInputs& inputs) const;
 
 	static RegisterBaseErrorMetric<PositionDifferenceErrorMetric> Register;
 
@@ -8,41 +8,57 @@ RotationDifferenceErrorMetric::RotationDifferenceErrorMetric() : BaseErrorMetric
 	AddParameter(new Parameter<Enums::HumanJointType>("Joint", Enums::HumanJointType::All));
 }
 
-bool RotationDifferenceErrorMetric::CalculateDifference(const Pose& groundTruthPose, const Pose& solvedPose, float& result)
+bool RotationDifferenceErrorMetric::CalculateDifferences(const PoseWindow& groundTruth, const PoseWindow& solved, std::vector<float>& results)
 {
-	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters["Joint"])->GetValue();
+	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters.at("Joint"))->GetValue();
 
-	if (selectedJoint == Enums::HumanJointType::All)
+	// Resolve the joint names to indices once for the whole window
+	std::vector<int> truthJoints;
+	std::vector<int> solvedJoints;
+	int firstJoint = selectedJoint == Enums::HumanJointType::All ? (int)Enums::HumanJointType::Hips : (int)selectedJoint;
+	int lastJoint = selectedJoint == Enums::HumanJointType::All ? (int)Enums::HumanJointType::All : (int)selectedJoint + 1;
+	for (int humanJointType = firstJoint; humanJointType != lastJoint; humanJointType++)
 	{
-		// Use double just to be safe here
-		double combinedAngle = 0.0f;
-		int counter = 0;
-
-		std::map<std::string, MeshModel::JointInfo> truthJointMapping = groundTruthPose.skinnedModel->GetJointMapping();
-		std::map<std::string, MeshModel::JointInfo> solvedJointMapping = solvedPose.skinnedModel->GetJointMapping();
-		for (int humanJointType = (int)Enums::HumanJointType::Hips; humanJointType != (int)Enums::HumanJointType::All; humanJointType++)
-		{
-			Enums::HumanJointType jointEnum = static_cast<Enums::HumanJointType>(humanJointType);
-			std::string jointString = QVariant::fromValue(jointEnum).toString().toStdString();
-
-			Quaternion groundTruthPosition = truthJointMapping[jointString].globalTransform.rotation();
-			Quaternion solvedPosition = solvedJointMapping[jointString].globalTransform.rotation();
-			combinedAngle += Quaternion::Angle(groundTruthPosition, solvedPosition);
-			++counter;
-		}
-		result = combinedAngle / counter;
+		Enums::HumanJointType jointEnum = static_cast<Enums::HumanJointType>(humanJointType);
+		std::string jointString = QVariant::fromValue(jointEnum).toString().toStdString();
+
+		int truthJoint = groundTruth.JointIndex(jointString);
+		int solvedJoint = solved.JointIndex(jointString);
+		if (truthJoint < 0 || solvedJoint < 0)
+			continue;
+
+		truthJoints.push_back(truthJoint);
+		solvedJoints.push_back(solvedJoint);
 	}
-	else
+
+	if (truthJoints.empty())
+		return false;
+
+	int jointCount = truthJoints.size();
+	results.resize(groundTruth.frameCount);
+	for (int frame = 0; frame < groundTruth.frameCount; ++frame)
 	{
-		std::string selectedJointString = QVariant::fromValue(selectedJoint).toString().toStdString();
-		Quaternion solvedPos = solvedPose.skinnedModel->GetJointMapping()[selectedJointString].globalTransform.rotation();
-		Quaternion groundTruthPos = groundTruthPose.skinnedModel->GetJointMapping()[selectedJointString].globalTransform.rotation();
-		result = Quaternion::Angle(groundTruthPos, solvedPos);
+		const Quaternion* truthRotations = groundTruth.Rotations(frame);
+		const Quaternion* solvedRotations = solved.Rotations(frame);
+
+		// Use double just to be safe here
+		double combinedAngle = 0.0;
+		for (int i = 0; i < jointCount; ++i)
+			combinedAngle += Quaternion::Angle(truthRotations[truthJoints[i]], solvedRotations[solvedJoints[i]]);
+
+		results[frame] = combinedAngle / jointCount;
 	}
 
 	return true;
 }
 
+void RotationDifferenceErrorMetric::DeclareInputs(MetricInputs& inputs) const
+{
+	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters.at("Joint"))->GetValue();
+	inputs.AddJoint((int)selectedJoint);
+	inputs.rotations = true;
+}
+
 BaseErrorMetric* RotationDifferenceErrorMetric::Clone() const
 {
 	return new RotationDifferenceErrorMetric();
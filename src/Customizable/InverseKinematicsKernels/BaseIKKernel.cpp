@@ -1,6 +1,11 @@
 #include "BaseIKKernel.h"
+#include "IKSkeleton.h"
+#include "../../ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 
-BaseIKKernel::BaseIKKernel(std::string name) : name(name) { }
+BaseIKKernel::BaseIKKernel(std::string name) : name(name), cancellationToken(nullptr) { }
 
 std::vector<BaseIKKernel*>& BaseIKKernel::registry()
 {
@@ -16,4 +21,115 @@ std::string BaseIKKernel::GetName() const
 void BaseIKKernel::AddParameter(BaseParameter* parameter)
 {
     parameters[parameter->GetName()] = parameter;
-}
\ No newline at end of file
+}
+
+TrackerConfidence BaseIKKernel::GetInputConfidence(const std::string& inputName) const
+{
+	auto it = inputConfidences.find(inputName);
+	return it == inputConfidences.end() ? TrackerConfidence() : it->second;
+}
+
+void BaseIKKernel::AddSegmentParameters()
+{
+	AddParameter(new Parameter<int>("SampleRate", 60));
+	AddParameter(new Parameter<int>("SegmentFrames", 240));
+	AddParameter(new Parameter<int>("WarmupFrames", 10));
+	// 0 uses one per hardware thread
+	AddParameter(new Parameter<int>("Threads", 0));
+}
+
+std::vector<float> BaseIKKernel::GetFrameTimes(const Animation& groundTruthAnimation) const
+{
+	int sampleRate = dynamic_cast<Parameter<int>*>(parameters.at("SampleRate"))->GetValue();
+	return IKSkeleton::GetFrameTimes(groundTruthAnimation.duration, (float)std::max(1, sampleRate));
+}
+
+bool BaseIKKernel::SolveSegments(int frameCount, int segmentFrames, int warmupFrames, int threadCount, const std::function<bool(int warmupStart, int start, int end)>& solveSegment) const
+{
+	segmentFrames = std::max(1, segmentFrames);
+	int segmentCount = (frameCount + segmentFrames - 1) / segmentFrames;
+	if (threadCount <= 0)
+		threadCount = ThreadPool::DefaultThreadCount();
+
+	std::mutex progressMutex;
+	int finishedFrames = 0;
+	{
+		ThreadPool pool(std::min(threadCount, std::max(1, segmentCount)));
+		for (int segment = 0; segment < segmentCount; ++segment)
+		{
+			pool.Enqueue([&, segment](int worker)
+			{
+				int start = segment * segmentFrames;
+				int end = std::min(start + segmentFrames, frameCount);
+				if (!solveSegment(std::max(0, start - warmupFrames), start, end))
+					return;
+
+				std::lock_guard<std::mutex> lock(progressMutex);
+				finishedFrames += end - start;
+				ReportProgress(finishedFrames / (float)frameCount);
+			});
+		}
+		pool.Wait();
+	}
+
+	return !IsCanceled();
+}
+
+Animation* BaseIKKernel::SolveStreamed(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const std::function<bool(float time, std::vector<TrackerSample>& samples)>& sampleFrame)
+{
+	IKPoseBuffer pose;
+	if (!Begin(trackers, model, pose))
+		return nullptr;
+
+	std::vector<float> times = GetFrameTimes(groundTruthAnimation);
+	size_t frameCount = times.size();
+	size_t jointCount = pose.jointNames.size();
+	std::vector<Vector3> positions(frameCount * jointCount);
+	std::vector<Quaternion> rotations(frameCount * jointCount);
+
+	std::vector<TrackerSample> samples(InputNames().size());
+	double totalLatency = 0.0;
+	double maxLatency = 0.0;
+	double totalSolve = 0.0;
+	bool solved = true;
+	for (size_t frame = 0; frame < frameCount && solved; ++frame)
+	{
+		if (IsCanceled())
+		{
+			solved = false;
+			break;
+		}
+
+		// From asking the trackers for their samples until the pose is written
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (TrackerSample& sample : samples)
+			sample.valid = false;
+		solved = sampleFrame(times[frame], samples);
+		std::chrono::steady_clock::time_point sampled = std::chrono::steady_clock::now();
+		solved = solved && SolveFrame(times[frame], samples, pose);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		double latency = std::chrono::duration<double>(end - start).count();
+		totalLatency += latency;
+		maxLatency = std::max(maxLatency, latency);
+		totalSolve += std::chrono::duration<double>(end - sampled).count();
+
+		std::copy(pose.localPositions.begin(), pose.localPositions.end(), positions.begin() + frame * jointCount);
+		std::copy(pose.localRotations.begin(), pose.localRotations.end(), rotations.begin() + frame * jointCount);
+		ReportProgress((frame + 1) / (float)frameCount);
+	}
+	End();
+
+	if (!solved)
+		return nullptr;
+
+	double frames = (double)std::max<size_t>(1, frameCount);
+	qDebug() << GetName().c_str() << "streamed" << frameCount << "frames, latency per frame" << totalLatency / frames * 1000.0 << "ms mean,"
+		<< maxLatency * 1000.0 << "ms max, solving took" << totalSolve / frames * 1000.0 << "ms of the mean";
+
+	// The clip is built like for the skeletons of the kernels, which only needs the names and scalings
+	IKSkeleton joints;
+	joints.names = pose.jointNames;
+	joints.bindScalings = pose.localScalings;
+	return joints.CreateAnimation(groundTruthAnimation, times, positions, rotations);
+}
@@ -7,6 +7,19 @@
 #include "../../Parameter.h"
 #include "../../SkinnedModel.h"
 #include "../../Tracker.h"
+#include "../../CancellationToken.h"
+#include "IKSkeleton.h"
+#include <functional>
+#include <algorithm>
+
+// Local joint transforms of one frame. Begin allocates it, every SolveFrame overwrites it in place.
+struct IKPoseBuffer
+{
+	std::vector<std::string> jointNames;
+	std::vector<Vector3> localPositions;
+	std::vector<Quaternion> localRotations;
+	std::vector<Vector3> localScalings;
+};
 
 template <class T>
 struct RegisterIKSolver
@@ -25,6 +38,37 @@ private:
 	BaseIKKernel(const BaseIKKernel &);
 protected:
 	std::map<std::string, BaseParameter*> parameters;
+	CancellationToken* cancellationToken;
+	std::map<std::string, TrackerConfidence> inputConfidences;
+
+	// Kernels should check this per frame and return nullptr once set
+	bool IsCanceled() const { return cancellationToken && cancellationToken->IsCanceled(); }
+	// Progress of the solve in [0, 1]
+	void ReportProgress(float progress) const { if (cancellationToken) cancellationToken->ReportProgress(progress); }
+	// Full confidence for slots without a virtualizer
+	TrackerConfidence GetInputConfidence(const std::string& inputName) const;
+
+	/// <summary>
+	/// Solves the frames of a clip in segments of a fixed length on a thread pool and reports the progress.
+	/// Every segment starts cold some frames early, so the result does not depend on the thread count.
+	/// </summary>
+	/// <param name="solveSegment">Solves the frames [warmupStart, end) in order and keeps the ones from start on. Returns false once canceled.</param>
+	/// <returns>False if the solve got canceled</returns>
+	bool SolveSegments(int frameCount, int segmentFrames, int warmupFrames, int threadCount, const std::function<bool(int warmupStart, int start, int end)>& solveSegment) const;
+
+	// Adds the SampleRate, SegmentFrames, WarmupFrames and Threads parameters GetFrameTimes and SolveClip read
+	void AddSegmentParameters();
+	// Times of the frames to solve at the SampleRate parameter
+	std::vector<float> GetFrameTimes(const Animation& groundTruthAnimation) const;
+
+	/// <summary>
+	/// Solves the frames with SolveSegments and the segment parameters, every segment starts from its own copy of the initial state.
+	/// Collects the local transforms of every joint into the solved clip.
+	/// </summary>
+	/// <param name="solveFrame">Called as solveFrame(frame, state) in frame order, returns the solved IKPose of the frame</param>
+	/// <returns>nullptr if the solve got canceled</returns>
+	template <class State, class FrameSolver>
+	Animation* SolveClip(const IKSkeleton& skeleton, const Animation& groundTruthAnimation, const std::vector<float>& times, const State& initialState, FrameSolver solveFrame) const;
 
 public:
 	BaseIKKernel(std::string name);
@@ -35,9 +79,75 @@ public:
 	virtual Animation* Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation) = 0;
 	virtual std::vector<std::string> InputNames() = 0;
 
+	// Kernels that solve frame by frame implement the streaming interface below and report it here
+	virtual bool SupportsStreaming() const { return false; }
+	/// <summary>
+	/// Prepares a streamed solve. The samples of every SolveFrame call are ordered like InputNames.
+	/// </summary>
+	/// <param name="pose">Gets allocated for the joints the kernel solves</param>
+	/// <returns>False if the kernel can not stream or not solve the model</returns>
+	virtual bool Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose) { return false; }
+	// Solves the frame at the time in seconds into the buffer of Begin, the times have to increase
+	virtual bool SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose) { return false; }
+	// Releases what Begin set up
+	virtual void End() {}
+
+	/// <summary>
+	/// Solves the clip like a live session, one frame after the other at the SampleRate parameter through the streaming interface.
+	/// Every frame takes the tracker samples and solves them before the next one starts, the time of both is logged as the latency per frame.
+	/// </summary>
+	/// <param name="sampleFrame">Called as sampleFrame(time, samples) with the samples ordered like InputNames, returns false if the trackers could not be sampled</param>
+	/// <returns>nullptr if the kernel can not stream, sampling failed or the solve got canceled</returns>
+	Animation* SolveStreamed(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const std::function<bool(float time, std::vector<TrackerSample>& samples)>& sampleFrame);
+	// Whether equal inputs and parameters always give the same solve, only then the output gets cached
+	virtual bool IsDeterministic() const { return true; }
+
 	void AddParameter(BaseParameter* parameter);
 	const std::map<std::string, BaseParameter*>& GetParameters() { return parameters; }
 
+	// The token of the job the next Solve calls belong to, nullptr if they can not be canceled
+	void SetCancellationToken(CancellationToken* token) { cancellationToken = token; }
+	// The confidence of the virtualizer of every solve slot for the next Solve calls
+	void SetInputConfidences(const std::map<std::string, TrackerConfidence>& confidences) { inputConfidences = confidences; }
+
 	static std::vector<BaseIKKernel*>& registry();
 	std::string GetName() const;
-};
\ No newline at end of file
+
+	// Use the virtual constructor idiom to create copies of subtypes, e.g. one per parallel configuration
+	virtual BaseIKKernel* Clone() const = 0;
+};
+
+template <class State, class FrameSolver>
+Animation* BaseIKKernel::SolveClip(const IKSkeleton& skeleton, const Animation& groundTruthAnimation, const std::vector<float>& times, const State& initialState, FrameSolver solveFrame) const
+{
+	int segmentFrames = dynamic_cast<Parameter<int>*>(parameters.at("SegmentFrames"))->GetValue();
+	int warmupFrames = dynamic_cast<Parameter<int>*>(parameters.at("WarmupFrames"))->GetValue();
+	int threads = dynamic_cast<Parameter<int>*>(parameters.at("Threads"))->GetValue();
+
+	int frameCount = times.size();
+	int jointCount = skeleton.GetJointCount();
+	std::vector<Vector3> solvedPositions((size_t)frameCount * jointCount);
+	std::vector<Quaternion> solvedRotations((size_t)frameCount * jointCount);
+
+	bool solved = SolveSegments(frameCount, segmentFrames, std::max(0, warmupFrames), threads, [&](int warmupStart, int segmentStart, int segmentEnd)
+	{
+		State state = initialState;
+		for (int frame = warmupStart; frame < segmentEnd; ++frame)
+		{
+			if (IsCanceled())
+				return false;
+
+			const IKPose& pose = solveFrame(frame, state);
+			if (frame < segmentStart)
+				continue;
+
+			std::copy(pose.localPositions.begin(), pose.localPositions.end(), solvedPositions.begin() + (size_t)frame * jointCount);
+			std::copy(pose.localRotations.begin(), pose.localRotations.end(), solvedRotations.begin() + (size_t)frame * jointCount);
+		}
+		return true;
+	});
+	if (!solved)
+		return nullptr;
+
+	return skeleton.CreateAnimation(groundTruthAnimation, times, solvedPositions, solvedRotations);
+}
@@ -0,0 +1,583 @@
+#include "DampedLeastSquaresIKKernel.h"
+#include <algorithm>
+#include <cmath>
+
+RegisterIKSolver<DampedLeastSquaresIKKernel> DampedLeastSquaresIKKernel::Register;
+
+namespace
+{
+	// Rotation vector of a unit quaternion, along the shorter way
+	Vector3 Log(Quaternion q)
+	{
+		if (q.w < 0.0f)
+			q = q * -1.0f;
+		Vector3 v(q.x, q.y, q.z);
+		float s = v.length();
+		if (s < 1e-6f)
+			return v * 2.0f;
+		return v * (2.0f * std::atan2(s, q.w) / s);
+	}
+
+	Quaternion Exp(const Vector3& rotation)
+	{
+		float angle = rotation.length();
+		if (angle < 1e-6f)
+			return Quaternion(rotation.x * 0.5f, rotation.y * 0.5f, rotation.z * 0.5f, 1.0f).normalized();
+		float s = std::sin(angle * 0.5f) / angle;
+		return Quaternion(rotation.x * s, rotation.y * s, rotation.z * s, std::cos(angle * 0.5f));
+	}
+
+	// Replaces the lower triangle of a symmetric positive definite a with its Cholesky factor
+	bool FactorCholesky(std::vector<double>& a, int n)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			double diagonal = a[j * n + j];
+			for (int k = 0; k < j; ++k)
+				diagonal -= a[j * n + k] * a[j * n + k];
+			if (diagonal <= 0.0)
+				return false;
+			diagonal = std::sqrt(diagonal);
+			a[j * n + j] = diagonal;
+
+			for (int i = j + 1; i < n; ++i)
+			{
+				double value = a[i * n + j];
+				for (int k = 0; k < j; ++k)
+					value -= a[i * n + k] * a[j * n + k];
+				a[i * n + j] = value / diagonal;
+			}
+		}
+		return true;
+	}
+
+	// Solves a x = b with the factor of FactorCholesky, b receives x
+	void SolveFactored(const std::vector<double>& a, int n, double* b)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			for (int k = 0; k < i; ++k)
+				b[i] -= a[i * n + k] * b[k];
+			b[i] /= a[i * n + i];
+		}
+		for (int i = n - 1; i >= 0; --i)
+		{
+			for (int k = i + 1; k < n; ++k)
+				b[i] -= a[k * n + i] * b[k];
+			b[i] /= a[i * n + i];
+		}
+	}
+}
+
+DampedLeastSquaresIKKernel::DampedLeastSquaresIKKernel() : BaseIKKernel("Damped Least Squares IK Kernel")
+{
+	AddSegmentParameters();
+	// Levenberg-Marquardt steps per frame, the cost of a frame is bounded by it
+	AddParameter(new Parameter<int>("Iterations", 4));
+	AddParameter(new Parameter<float>("Damping", 0.1f));
+	// Residual at which a frame counts as solved, relative to the body size
+	AddParameter(new Parameter<float>("Tolerance", 0.001f));
+	// A position error of the body size weighs as much as an orientation error of a radian times these
+	AddParameter(new Parameter<float>("PositionWeight", 1.0f));
+	AddParameter(new Parameter<float>("OrientationWeight", 0.3f));
+}
+
+Animation* DampedLeastSquaresIKKernel::Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation)
+{
+	Problem problem;
+	if (!problem.skeleton.Build(model, IKEffectors::GetNames()))
+	{
+		qDebug() << "DampedLeastSquaresIKKernel: the model has none of the effector joints";
+		return nullptr;
+	}
+
+	IKPose bindPose;
+	bindPose.SetBindPose(problem.skeleton);
+
+	std::vector<float> times = GetFrameTimes(groundTruthAnimation);
+	std::vector<IKEffectorTrack> tracks = IKEffectorTrack::SampleAll(IKEffectors::GetNames(), trackers, model, endEffectorsAnimation, times);
+	if (!BuildProblem(tracks, bindPose, problem))
+		return nullptr;
+
+	Segment initialSegment;
+	initialSegment.pose = bindPose;
+	initialSegment.workspace.candidate = bindPose;
+	return SolveClip(problem.skeleton, groundTruthAnimation, times, initialSegment, [&](int frame, Segment& segment) -> const IKPose&
+	{
+		SolvePose(problem, frame, segment.pose, segment.workspace);
+		return segment.pose;
+	});
+}
+
+bool DampedLeastSquaresIKKernel::BuildProblem(const std::vector<IKEffectorTrack>& tracks, const IKPose& bindPose, Problem& problem) const
+{
+	Parameter<int>* iterations = dynamic_cast<Parameter<int>*>(parameters.at("Iterations"));
+	Parameter<float>* damping = dynamic_cast<Parameter<float>*>(parameters.at("Damping"));
+	Parameter<float>* tolerance = dynamic_cast<Parameter<float>*>(parameters.at("Tolerance"));
+	Parameter<float>* positionWeight = dynamic_cast<Parameter<float>*>(parameters.at("PositionWeight"));
+	Parameter<float>* orientationWeight = dynamic_cast<Parameter<float>*>(parameters.at("OrientationWeight"));
+
+	const IKSkeleton& skeleton = problem.skeleton;
+	problem.root = skeleton.Find(IKEffectors::Names[IKEffectors::Root]);
+	problem.iterations = std::max(0, iterations->GetValue());
+	problem.damping = std::max(0.0f, damping->GetValue());
+	problem.tolerance = tolerance->GetValue();
+
+	// The joints above the root stay in the bind pose
+	int jointCount = skeleton.GetJointCount();
+	int base = problem.root >= 0 ? problem.root : 0;
+	for (int e = 0; e < IKEffectors::Count; ++e)
+	{
+		int joint = skeleton.Find(IKEffectors::Names[e]);
+		if (joint < 0 || !skeleton.IsAncestor(base, joint) || !tracks[e].valid)
+			continue;
+
+		TrackerConfidence confidence = GetInputConfidence(IKEffectors::Names[e]);
+		problem.effectors.push_back(tracks[e]);
+		problem.effectorSlots.push_back(e);
+		problem.effectorJoints.push_back(joint);
+		problem.positionWeights.push_back(positionWeight->GetValue() * confidence.position);
+		problem.orientationWeights.push_back(orientationWeight->GetValue() * confidence.orientation);
+	}
+
+	if (problem.effectors.empty())
+	{
+		qDebug() << "DampedLeastSquaresIKKernel: no tracker drives a joint of the model";
+		return false;
+	}
+
+	// Only the joints on the path to a tracked effector move it, the others keep the bind pose
+	for (int joint = 0; joint < jointCount; ++joint)
+	{
+		if (!skeleton.IsAncestor(base, joint))
+			continue;
+		for (int effectorJoint : problem.effectorJoints)
+		{
+			if (skeleton.IsAncestor(joint, effectorJoint))
+			{
+				problem.dofJoints.push_back(joint);
+				break;
+			}
+		}
+	}
+
+	int translationBlock = problem.dofJoints.size();
+	std::vector<int> blockEffectors(translationBlock + 1, 0);
+	std::vector<int> blockOwners(translationBlock + 1, -1);
+	problem.characteristicLength = 0.0f;
+	for (size_t e = 0; e < problem.effectors.size(); ++e)
+	{
+		int joint = problem.effectorJoints[e];
+		std::vector<int> blocks;
+		for (size_t block = 0; block < problem.dofJoints.size(); ++block)
+			if (skeleton.IsAncestor(problem.dofJoints[block], joint))
+				blocks.push_back(block);
+		blocks.push_back(translationBlock);
+
+		for (int block : blocks)
+		{
+			blockEffectors[block]++;
+			blockOwners[block] = e;
+		}
+		problem.effectorBlocks.push_back(blocks);
+		problem.characteristicLength = std::max(problem.characteristicLength, (bindPose.globalPositions[joint] - bindPose.globalPositions[base]).length());
+	}
+	if (problem.characteristicLength <= 0.0f)
+		problem.characteristicLength = 1.0f;
+
+	// Blocks moving a single effector only couple with each other and the shared blocks
+	problem.chainVariables.resize(problem.effectors.size());
+	for (int block = 0; block <= translationBlock; ++block)
+	{
+		std::vector<int>& variables = blockEffectors[block] == 1 ? problem.chainVariables[blockOwners[block]] : problem.sharedVariables;
+		for (int i = 0; i < 3; ++i)
+			variables.push_back(3 * block + i);
+	}
+
+	return true;
+}
+
+std::vector<std::string> DampedLeastSquaresIKKernel::InputNames()
+{
+	return IKEffectors::GetNames();
+}
+
+BaseIKKernel* DampedLeastSquaresIKKernel::Clone() const
+{
+	return new DampedLeastSquaresIKKernel();
+}
+
+bool DampedLeastSquaresIKKernel::Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose)
+{
+	std::unique_ptr<Stream> newStream(new Stream());
+	Problem& problem = newStream->problem;
+	const IKSkeleton& skeleton = problem.skeleton;
+	if (!problem.skeleton.Build(model, IKEffectors::GetNames()))
+	{
+		qDebug() << "DampedLeastSquaresIKKernel: the model has none of the effector joints";
+		return false;
+	}
+
+	IKPose bindPose;
+	bindPose.SetBindPose(skeleton);
+
+	// Every slot with a tracker becomes an effector, it holds the bind pose of its joint until the first sample
+	IKEffectorStream& input = newStream->input;
+	input.Begin(IKEffectors::GetNames(), trackers, model);
+	for (int e = 0; e < IKEffectors::Count; ++e)
+	{
+		IKEffectorTrack& track = input.effectors[e];
+		int joint = skeleton.Find(IKEffectors::Names[e]);
+		track.valid = joint >= 0 && input.trackers[e];
+		if (!track.valid)
+			continue;
+		track.x[0] = bindPose.globalPositions[joint].x;
+		track.y[0] = bindPose.globalPositions[joint].y;
+		track.z[0] = bindPose.globalPositions[joint].z;
+		track.rotations[0] = bindPose.globalRotations[joint];
+	}
+	if (!BuildProblem(input.effectors, bindPose, problem))
+		return false;
+	newStream->positionWeights = problem.positionWeights;
+	newStream->orientationWeights = problem.orientationWeights;
+
+	newStream->segment.pose = bindPose;
+	newStream->segment.workspace.candidate = bindPose;
+
+	pose.jointNames = skeleton.names;
+	pose.localPositions = skeleton.bindPositions;
+	pose.localRotations = skeleton.bindRotations;
+	pose.localScalings = skeleton.bindScalings;
+
+	stream = std::move(newStream);
+	return true;
+}
+
+bool DampedLeastSquaresIKKernel::SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose)
+{
+	if (!stream)
+		return false;
+
+	// Effectors without a sample keep their last target at zero weight, so the compiled problem stays the same
+	Problem& problem = stream->problem;
+	stream->input.SetSamples(samples);
+	for (size_t e = 0; e < problem.effectors.size(); ++e)
+	{
+		const IKEffectorTrack& sample = stream->input.effectors[problem.effectorSlots[e]];
+		IKEffectorTrack& effector = problem.effectors[e];
+		if (sample.valid)
+		{
+			effector.x[0] = sample.x[0];
+			effector.y[0] = sample.y[0];
+			effector.z[0] = sample.z[0];
+			effector.rotations[0] = sample.rotations[0];
+		}
+		problem.positionWeights[e] = sample.valid ? stream->positionWeights[e] : 0.0f;
+		problem.orientationWeights[e] = sample.valid ? stream->orientationWeights[e] : 0.0f;
+	}
+
+	Segment& segment = stream->segment;
+	SolvePose(problem, 0, segment.pose, segment.workspace);
+	std::copy(segment.pose.localPositions.begin(), segment.pose.localPositions.end(), pose.localPositions.begin());
+	std::copy(segment.pose.localRotations.begin(), segment.pose.localRotations.end(), pose.localRotations.begin());
+	return true;
+}
+
+void DampedLeastSquaresIKKernel::End()
+{
+	stream.reset();
+}
+
+void DampedLeastSquaresIKKernel::SolvePose(const Problem& problem, int frame, IKPose& pose, Workspace& workspace) const
+{
+	const IKSkeleton& skeleton = problem.skeleton;
+
+	// A cold start puts the root onto its tracker right away, the rest of the body follows in the iterations
+	if (!pose.warm && problem.root >= 0 && !problem.effectorJoints.empty() && problem.effectorJoints[0] == problem.root)
+	{
+		const IKEffectorTrack& rootTrack = problem.effectors[0];
+		Vector3 position = rootTrack.GetPosition(frame);
+		int parent = skeleton.parents[problem.root];
+		if (parent >= 0)
+		{
+			Quaternion inverseParent = pose.globalRotations[parent].conjugate();
+			Vector3 local = inverseParent * (position - pose.globalPositions[parent]);
+			const Vector3& scaling = pose.globalScalings[parent];
+			pose.localPositions[problem.root] = Vector3(local.x / scaling.x, local.y / scaling.y, local.z / scaling.z);
+			pose.localRotations[problem.root] = inverseParent * rootTrack.rotations[frame];
+		}
+		else
+		{
+			pose.localPositions[problem.root] = position;
+			pose.localRotations[problem.root] = rootTrack.rotations[frame];
+		}
+	}
+	pose.UpdateGlobals(skeleton);
+	pose.warm = true;
+
+	int n = problem.GetVariableCount();
+	double error = GetError(problem, frame, pose);
+	double lambda = problem.damping;
+	double toleranceSquared = (double)problem.tolerance * problem.tolerance;
+	for (int iteration = 0; iteration < problem.iterations && error > toleranceSquared; ++iteration)
+	{
+		BuildNormalEquations(problem, frame, pose, workspace.normalMatrix, workspace.gradient);
+		for (int i = 0; i < n; ++i)
+			workspace.normalMatrix[i * n + i] += lambda * lambda;
+
+		if (!SolveNormalEquations(problem, workspace))
+		{
+			lambda = std::max(lambda * 4.0, 1e-3);
+			continue;
+		}
+
+		ApplyStep(problem, pose, workspace.step, workspace.candidate);
+		double candidateError = GetError(problem, frame, workspace.candidate);
+		if (candidateError < error)
+		{
+			std::swap(pose, workspace.candidate);
+			error = candidateError;
+			lambda *= 0.5;
+		}
+		else
+		{
+			// Rejected, a more damped step is shorter and closer to the gradient
+			lambda = std::max(lambda * 4.0, 1e-3);
+		}
+	}
+}
+
+double DampedLeastSquaresIKKernel::GetError(const Problem& problem, int frame, const IKPose& pose) const
+{
+	double error = 0.0;
+	for (size_t e = 0; e < problem.effectors.size(); ++e)
+	{
+		const IKEffectorTrack& track = problem.effectors[e];
+		int joint = problem.effectorJoints[e];
+
+		Vector3 positionResidual = (track.GetPosition(frame) - pose.globalPositions[joint]) * (problem.positionWeights[e] / problem.characteristicLength);
+		Vector3 orientationResidual = Log(track.rotations[frame] * pose.globalRotations[joint].conjugate()) * problem.orientationWeights[e];
+		error += positionResidual.lengthSquared() + orientationResidual.lengthSquared();
+	}
+	return error;
+}
+
+void DampedLeastSquaresIKKernel::BuildNormalEquations(const Problem& problem, int frame, const IKPose& pose, std::vector<double>& normalMatrix, std::vector<double>& gradient) const
+{
+	int n = problem.GetVariableCount();
+	normalMatrix.assign((size_t)n * n, 0.0);
+	gradient.assign(n, 0.0);
+	int translationBlock = problem.dofJoints.size();
+	float length = problem.characteristicLength;
+
+	// Rotating a joint about a model axis moves the effector by the cross product with its lever arm d and turns
+	// it by the same axis. With the scaled position Jacobian J_a = -wp / L [d_a]x the blocks become
+	// J_a^T J_b = wp^2 / L^2 ((d_a . d_b) I - d_b d_a^T) + wo^2 I. Only the blocks on the path of an effector are touched.
+	std::vector<Vector3> levers;
+	for (size_t e = 0; e < problem.effectors.size(); ++e)
+	{
+		const IKEffectorTrack& track = problem.effectors[e];
+		const std::vector<int>& blocks = problem.effectorBlocks[e];
+		int joint = problem.effectorJoints[e];
+		double wp = problem.positionWeights[e];
+		double wo = problem.orientationWeights[e];
+
+		const Vector3& position = pose.globalPositions[joint];
+		Vector3 positionResidual = (track.GetPosition(frame) - position) * (float)(wp / length);
+		Vector3 orientationResidual = Log(track.rotations[frame] * pose.globalRotations[joint].conjugate()) * (float)wo;
+
+		levers.resize(blocks.size());
+		for (size_t a = 0; a < blocks.size(); ++a)
+			levers[a] = blocks[a] == translationBlock ? Vector3::zero : (position - pose.globalPositions[problem.dofJoints[blocks[a]]]) * (1.0f / length);
+
+		for (size_t a = 0; a < blocks.size(); ++a)
+		{
+			int rowBlock = blocks[a];
+			bool rowTranslation = rowBlock == translationBlock;
+			const Vector3& da = levers[a];
+
+			// J^T r
+			Vector3 g = rowTranslation ? positionResidual * (float)wp : da.cross(positionResidual) * (float)wp + orientationResidual * (float)wo;
+			gradient[3 * rowBlock + 0] += g.x;
+			gradient[3 * rowBlock + 1] += g.y;
+			gradient[3 * rowBlock + 2] += g.z;
+
+			for (size_t b = 0; b < blocks.size(); ++b)
+			{
+				int columnBlock = blocks[b];
+				bool columnTranslation = columnBlock == translationBlock;
+				const Vector3& db = levers[b];
+				double block[3][3];
+
+				if (rowTranslation && columnTranslation)
+				{
+					for (int i = 0; i < 3; ++i)
+						for (int j = 0; j < 3; ++j)
+							block[i][j] = i == j ? wp * wp : 0.0;
+				}
+				else if (rowTranslation)
+				{
+					// wp I^T (-wp [d_b]x)
+					double d[3] = { db.x, db.y, db.z };
+					block[0][0] = 0.0;          block[0][1] = wp * wp * d[2];  block[0][2] = -wp * wp * d[1];
+					block[1][0] = -wp * wp * d[2]; block[1][1] = 0.0;          block[1][2] = wp * wp * d[0];
+					block[2][0] = wp * wp * d[1];  block[2][1] = -wp * wp * d[0]; block[2][2] = 0.0;
+				}
+				else if (columnTranslation)
+				{
+					// (-wp [d_a]x)^T wp I = wp^2 [d_a]x
+					double d[3] = { da.x, da.y, da.z };
+					block[0][0] = 0.0;          block[0][1] = -wp * wp * d[2]; block[0][2] = wp * wp * d[1];
+					block[1][0] = wp * wp * d[2];  block[1][1] = 0.0;          block[1][2] = -wp * wp * d[0];
+					block[2][0] = -wp * wp * d[1]; block[2][1] = wp * wp * d[0];  block[2][2] = 0.0;
+				}
+				else
+				{
+					double dot = da.dot(db);
+					double a3[3] = { da.x, da.y, da.z };
+					double b3[3] = { db.x, db.y, db.z };
+					for (int i = 0; i < 3; ++i)
+						for (int j = 0; j < 3; ++j)
+							block[i][j] = wp * wp * ((i == j ? dot : 0.0) - b3[i] * a3[j]) + (i == j ? wo * wo : 0.0);
+				}
+
+				for (int i = 0; i < 3; ++i)
+					for (int j = 0; j < 3; ++j)
+						normalMatrix[(size_t)(3 * rowBlock + i) * n + 3 * columnBlock + j] += block[i][j];
+			}
+		}
+	}
+}
+
+bool DampedLeastSquaresIKKernel::SolveNormalEquations(const Problem& problem, Workspace& workspace) const
+{
+	// The normal matrix has an arrow shape, chains of different effectors never share a row. Every chain is
+	// eliminated on its own, which leaves the Schur complement S = A_ss - sum A_sc A_cc^-1 A_cs for the shared
+	// blocks. The chains follow by back substitution. Same step as a dense solve, at the cost of the largest chain.
+	int n = problem.GetVariableCount();
+	const std::vector<double>& a = workspace.normalMatrix;
+	const std::vector<double>& g = workspace.gradient;
+	const std::vector<int>& shared = problem.sharedVariables;
+	int sharedCount = shared.size();
+
+	workspace.shared.resize((size_t)sharedCount * sharedCount);
+	workspace.sharedStep.resize(sharedCount);
+	for (int i = 0; i < sharedCount; ++i)
+	{
+		for (int j = 0; j < sharedCount; ++j)
+			workspace.shared[i * sharedCount + j] = a[(size_t)shared[i] * n + shared[j]];
+		workspace.sharedStep[i] = g[shared[i]];
+	}
+
+	size_t chainCount = problem.chainVariables.size();
+	workspace.chainMatrices.resize(chainCount);
+	workspace.chainCouplings.resize(chainCount);
+	workspace.chainSteps.resize(chainCount);
+	for (size_t c = 0; c < chainCount; ++c)
+	{
+		const std::vector<int>& chain = problem.chainVariables[c];
+		int chainSize = chain.size();
+		if (chainSize == 0)
+			continue;
+
+		std::vector<double>& matrix = workspace.chainMatrices[c];
+		std::vector<double>& coupling = workspace.chainCouplings[c];
+		std::vector<double>& chainStep = workspace.chainSteps[c];
+		matrix.resize((size_t)chainSize * chainSize);
+		coupling.resize((size_t)sharedCount * chainSize);
+		chainStep.resize(chainSize);
+		for (int i = 0; i < chainSize; ++i)
+		{
+			for (int j = 0; j < chainSize; ++j)
+				matrix[i * chainSize + j] = a[(size_t)chain[i] * n + chain[j]];
+			chainStep[i] = g[chain[i]];
+		}
+		if (!FactorCholesky(matrix, chainSize))
+			return false;
+
+		// A_cc^-1 A_cs, one shared column at a time
+		for (int j = 0; j < sharedCount; ++j)
+		{
+			double* column = coupling.data() + (size_t)j * chainSize;
+			for (int i = 0; i < chainSize; ++i)
+				column[i] = a[(size_t)chain[i] * n + shared[j]];
+			SolveFactored(matrix, chainSize, column);
+		}
+		SolveFactored(matrix, chainSize, chainStep.data());
+
+		for (int i = 0; i < sharedCount; ++i)
+		{
+			const double* row = a.data() + (size_t)shared[i] * n;
+			for (int j = 0; j < sharedCount; ++j)
+			{
+				const double* column = coupling.data() + (size_t)j * chainSize;
+				double sum = 0.0;
+				for (int k = 0; k < chainSize; ++k)
+					sum += row[chain[k]] * column[k];
+				workspace.shared[i * sharedCount + j] -= sum;
+			}
+			double sum = 0.0;
+			for (int k = 0; k < chainSize; ++k)
+				sum += row[chain[k]] * chainStep[k];
+			workspace.sharedStep[i] -= sum;
+		}
+	}
+
+	if (!FactorCholesky(workspace.shared, sharedCount))
+		return false;
+	SolveFactored(workspace.shared, sharedCount, workspace.sharedStep.data());
+
+	workspace.step.resize(n);
+	for (int i = 0; i < sharedCount; ++i)
+		workspace.step[shared[i]] = workspace.sharedStep[i];
+	for (size_t c = 0; c < chainCount; ++c)
+	{
+		const std::vector<int>& chain = problem.chainVariables[c];
+		int chainSize = chain.size();
+		const std::vector<double>& coupling = workspace.chainCouplings[c];
+		for (int i = 0; i < chainSize; ++i)
+		{
+			double value = workspace.chainSteps[c][i];
+			for (int j = 0; j < sharedCount; ++j)
+				value -= coupling[(size_t)j * chainSize + i] * workspace.sharedStep[j];
+			workspace.step[chain[i]] = value;
+		}
+	}
+	return true;
+}
+
+void DampedLeastSquaresIKKernel::ApplyStep(const Problem& problem, const IKPose& pose, const std::vector<double>& step, IKPose& result) const
+{
+	const IKSkeleton& skeleton = problem.skeleton;
+	result.localPositions = pose.localPositions;
+	result.localRotations = pose.localRotations;
+	result.warm = pose.warm;
+
+	// Every increment is a rotation about model axes in the current pose, so it is applied against the old globals.
+	// The increments of the ancestors are added on top by the forward kinematics.
+	for (size_t block = 0; block < problem.dofJoints.size(); ++block)
+	{
+		int joint = problem.dofJoints[block];
+		Quaternion increment = Exp(Vector3((float)step[3 * block], (float)step[3 * block + 1], (float)step[3 * block + 2]));
+		Quaternion rotation = increment * pose.globalRotations[joint];
+		int parent = skeleton.parents[joint];
+		result.localRotations[joint] = (parent >= 0 ? pose.globalRotations[parent].conjugate() * rotation : rotation).normalized();
+	}
+
+	// The translation is solved in units of the body size
+	int base = problem.dofJoints[0];
+	size_t translationBlock = problem.dofJoints.size();
+	Vector3 translation((float)step[3 * translationBlock], (float)step[3 * translationBlock + 1], (float)step[3 * translationBlock + 2]);
+	translation = translation * problem.characteristicLength;
+	int parent = skeleton.parents[base];
+	if (parent >= 0)
+	{
+		Vector3 local = pose.globalRotations[parent].conjugate() * translation;
+		const Vector3& scaling = pose.globalScalings[parent];
+		result.localPositions[base] = result.localPositions[base] + Vector3(local.x / scaling.x, local.y / scaling.y, local.z / scaling.z);
+	}
+	else
+		result.localPositions[base] = result.localPositions[base] + translation;
+
+	result.UpdateGlobals(skeleton);
+}
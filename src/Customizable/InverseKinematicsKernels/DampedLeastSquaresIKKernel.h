@@ -0,0 +1,102 @@
+#pragma once
+
+#include "BaseIKKernel.h"
+#include "IKSkeleton.h"
+#include <memory>
+#include <vector>
+
+// Levenberg-Marquardt solver over the whole skeleton. Every joint on the path from the root to a tracked effector
+// has three rotational degrees of freedom, the root can also move. The trackers pull on positions and orientations,
+// weighted by the confidence of their virtualizer, so orientation only suits work as well as optical ones.
+// Each frame gets a fixed iteration budget and starts from the previous solution. Segments are solved in parallel.
+// Also solves streamed frames, one at a time.
+class DampedLeastSquaresIKKernel : public BaseIKKernel
+{
+public:
+	DampedLeastSquaresIKKernel();
+
+	static RegisterIKSolver<DampedLeastSquaresIKKernel> Register;
+
+	virtual Animation* Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation);
+	virtual std::vector<std::string> InputNames();
+	virtual BaseIKKernel* Clone() const;
+
+	virtual bool SupportsStreaming() const { return true; }
+	virtual bool Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose);
+	virtual bool SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose);
+	virtual void End();
+private:
+	// The compiled problem, shared by all segments
+	struct Problem
+	{
+		IKSkeleton skeleton;
+		int root;
+		// Skeleton joint of every rotational block, the translation block of the root comes last
+		std::vector<int> dofJoints;
+		// Per effector the blocks that move it, only those get accumulated into the normal equations
+		std::vector<std::vector<int>> effectorBlocks;
+		// Variables of the blocks that move only one effector, per effector, and of the blocks that move several
+		std::vector<std::vector<int>> chainVariables;
+		std::vector<int> sharedVariables;
+		std::vector<int> effectorJoints;
+		// Solve slot of every effector
+		std::vector<int> effectorSlots;
+		std::vector<IKEffectorTrack> effectors;
+		std::vector<float> positionWeights;
+		std::vector<float> orientationWeights;
+		// Positions are measured in this length, so the weights do not depend on the model units
+		float characteristicLength;
+		int iterations;
+		float damping;
+		float tolerance;
+
+		int GetVariableCount() const { return 3 * (dofJoints.size() + 1); }
+	};
+
+	// Scratch buffers of one segment, so the frames do not allocate
+	struct Workspace
+	{
+		std::vector<double> normalMatrix;
+		std::vector<double> gradient;
+		std::vector<double> step;
+		// Schur complement of the shared blocks and its right hand side
+		std::vector<double> shared;
+		std::vector<double> sharedStep;
+		// Per chain its factored diagonal block, the coupling to the shared blocks solved by it and its own step
+		std::vector<std::vector<double>> chainMatrices;
+		std::vector<std::vector<double>> chainCouplings;
+		std::vector<std::vector<double>> chainSteps;
+		IKPose candidate;
+	};
+
+	// What a thread solving one segment carries from frame to frame
+	struct Segment
+	{
+		IKPose pose;
+		Workspace workspace;
+	};
+
+	// State of a streamed solve between Begin and End
+	struct Stream
+	{
+		Problem problem;
+		Segment segment;
+		IKEffectorStream input;
+		// Weights of the effectors while their trackers report samples, a missing sample drops the effector for the frame
+		std::vector<float> positionWeights;
+		std::vector<float> orientationWeights;
+	};
+	std::unique_ptr<Stream> stream;
+
+	// Compiles the problem for the valid tracks, its skeleton has to be built. False if no track drives a joint.
+	bool BuildProblem(const std::vector<IKEffectorTrack>& tracks, const IKPose& bindPose, Problem& problem) const;
+
+	void SolvePose(const Problem& problem, int frame, IKPose& pose, Workspace& workspace) const;
+	// Weighted squared residual of all effectors
+	double GetError(const Problem& problem, int frame, const IKPose& pose) const;
+	// Accumulates J^T J and J^T r block by block along the path of every effector
+	void BuildNormalEquations(const Problem& problem, int frame, const IKPose& pose, std::vector<double>& normalMatrix, std::vector<double>& gradient) const;
+	// Solves the normal equations of the workspace into its step, false if they are not positive definite
+	bool SolveNormalEquations(const Problem& problem, Workspace& workspace) const;
+	void ApplyStep(const Problem& problem, const IKPose& pose, const std::vector<double>& step, IKPose& result) const;
+};
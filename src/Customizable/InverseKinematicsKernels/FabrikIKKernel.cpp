@@ -0,0 +1,491 @@
+#include "FabrikIKKernel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+RegisterIKSolver<FabrikIKKernel> FabrikIKKernel::Register;
+
+namespace
+{
+	// Upper and lower arm or leg
+	const int LimbBones = 2;
+
+	const float DegToRad = 3.14159265358979f / 180.0f;
+
+	Vector3 MultiplyElements(const Vector3& a, const Vector3& b)
+	{
+		return Vector3(a.x * b.x, a.y * b.y, a.z * b.z);
+	}
+}
+
+FabrikIKKernel::FabrikIKKernel() : BaseIKKernel("FABRIK IK Kernel")
+{
+	AddSegmentParameters();
+	AddParameter(new Parameter<int>("Iterations", 10));
+	// Distance in model units at which an effector counts as reached
+	AddParameter(new Parameter<float>("Tolerance", 0.001f));
+	// Largest angle in degrees between two neighbouring bones of a chain
+	AddParameter(new Parameter<float>("SpineBendLimit", 30.0f));
+	AddParameter(new Parameter<float>("LimbBendLimit", 160.0f));
+}
+
+Animation* FabrikIKKernel::Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation)
+{
+	int iterations = dynamic_cast<Parameter<int>*>(parameters["Iterations"])->GetValue();
+	float tolerance = dynamic_cast<Parameter<float>*>(parameters["Tolerance"])->GetValue();
+
+	IKSkeleton skeleton;
+	if (!skeleton.Build(model, IKEffectors::GetNames()))
+	{
+		qDebug() << "FabrikIKKernel: the model has none of the effector joints";
+		return nullptr;
+	}
+	int root = skeleton.Find(IKEffectors::Names[IKEffectors::Root]);
+
+	Pose bindPose;
+	Prepare(skeleton, root, model.GetRoot().GlobalTrans.forward().normalized(), bindPose);
+
+	std::vector<float> times = GetFrameTimes(groundTruthAnimation);
+	std::vector<IKEffectorTrack> effectors = IKEffectorTrack::SampleAll(IKEffectors::GetNames(), trackers, model, endEffectorsAnimation, times);
+
+	return SolveClip(skeleton, groundTruthAnimation, times, bindPose, [&](int frame, Pose& pose) -> const IKPose&
+	{
+		SolvePose(skeleton, root, effectors, frame, iterations, tolerance, pose);
+		return pose;
+	});
+}
+
+std::vector<std::string> FabrikIKKernel::InputNames()
+{
+	return IKEffectors::GetNames();
+}
+
+BaseIKKernel* FabrikIKKernel::Clone() const
+{
+	return new FabrikIKKernel();
+}
+
+bool FabrikIKKernel::Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose)
+{
+	std::unique_ptr<Stream> newStream(new Stream());
+	IKSkeleton& skeleton = newStream->skeleton;
+	if (!skeleton.Build(model, IKEffectors::GetNames()))
+	{
+		qDebug() << "FabrikIKKernel: the model has none of the effector joints";
+		return false;
+	}
+	newStream->root = skeleton.Find(IKEffectors::Names[IKEffectors::Root]);
+	newStream->iterations = dynamic_cast<Parameter<int>*>(parameters["Iterations"])->GetValue();
+	newStream->tolerance = dynamic_cast<Parameter<float>*>(parameters["Tolerance"])->GetValue();
+	Prepare(skeleton, newStream->root, model.GetRoot().GlobalTrans.forward().normalized(), newStream->pose);
+	newStream->input.Begin(IKEffectors::GetNames(), trackers, model);
+
+	pose.jointNames = skeleton.names;
+	pose.localPositions = skeleton.bindPositions;
+	pose.localRotations = skeleton.bindRotations;
+	pose.localScalings = skeleton.bindScalings;
+
+	stream = std::move(newStream);
+	return true;
+}
+
+bool FabrikIKKernel::SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose)
+{
+	if (!stream)
+		return false;
+
+	// Like a segment of the clip that never ends, every frame starts from the previous one
+	stream->input.SetSamples(samples);
+	SolvePose(stream->skeleton, stream->root, stream->input.effectors, 0, stream->iterations, stream->tolerance, stream->pose);
+	std::copy(stream->pose.localPositions.begin(), stream->pose.localPositions.end(), pose.localPositions.begin());
+	std::copy(stream->pose.localRotations.begin(), stream->pose.localRotations.end(), pose.localRotations.begin());
+	return true;
+}
+
+void FabrikIKKernel::End()
+{
+	stream.reset();
+}
+
+double FabrikIKKernel::Benchmark(int frameCount)
+{
+	// A typical full body rig in centimeters, facing +z
+	struct BenchmarkJoint
+	{
+		const char* name;
+		int parent;
+		Vector3 position;
+	};
+	const BenchmarkJoint joints[] = {
+		{ "Hips", -1, Vector3(0, 100, 0) },
+		{ "Spine", 0, Vector3(0, 10, 0) },
+		{ "Spine1", 1, Vector3(0, 12, 0) },
+		{ "Spine2", 2, Vector3(0, 12, 0) },
+		{ "Neck", 3, Vector3(0, 14, 0) },
+		{ "Head", 4, Vector3(0, 10, 0) },
+		{ "LeftShoulder", 3, Vector3(5, 10, 0) },
+		{ "LeftArm", 6, Vector3(12, 0, 0) },
+		{ "LeftForeArm", 7, Vector3(28, 0, 0) },
+		{ "LeftHand", 8, Vector3(25, 0, 0) },
+		{ "RightShoulder", 3, Vector3(-5, 10, 0) },
+		{ "RightArm", 10, Vector3(-12, 0, 0) },
+		{ "RightForeArm", 11, Vector3(-28, 0, 0) },
+		{ "RightHand", 12, Vector3(-25, 0, 0) },
+		{ "LeftUpLeg", 0, Vector3(9, -5, 0) },
+		{ "LeftLeg", 14, Vector3(0, -42, 0) },
+		{ "LeftFoot", 15, Vector3(0, -40, 0) },
+		{ "RightUpLeg", 0, Vector3(-9, -5, 0) },
+		{ "RightLeg", 17, Vector3(0, -42, 0) },
+		{ "RightFoot", 18, Vector3(0, -40, 0) },
+	};
+
+	IKSkeleton skeleton;
+	for (const BenchmarkJoint& joint : joints)
+	{
+		skeleton.names.push_back(joint.name);
+		skeleton.parents.push_back(joint.parent);
+		skeleton.bindPositions.push_back(joint.position);
+		skeleton.bindRotations.push_back(Quaternion::identity);
+		skeleton.bindScalings.push_back(Vector3(1, 1, 1));
+	}
+
+	FabrikIKKernel kernel;
+	Parameter<int>* iterations = dynamic_cast<Parameter<int>*>(kernel.parameters["Iterations"]);
+	Parameter<float>* tolerance = dynamic_cast<Parameter<float>*>(kernel.parameters["Tolerance"]);
+	int root = skeleton.Find(IKEffectors::Names[IKEffectors::Root]);
+	Pose pose;
+	kernel.Prepare(skeleton, root, Vector3(0, 0, 1), pose);
+
+	// Walking in place at 60 Hz: the hips bob and turn, the hands and feet swing against each other
+	frameCount = std::max(1, frameCount);
+	std::vector<IKEffectorTrack> effectors(IKEffectors::Count);
+	for (int e = 0; e < IKEffectors::Count; ++e)
+	{
+		IKEffectorTrack& effector = effectors[e];
+		effector.valid = true;
+		effector.x.resize(frameCount);
+		effector.y.resize(frameCount);
+		effector.z.resize(frameCount);
+		effector.rotations.resize(frameCount);
+
+		const Vector3& bindPosition = pose.globalPositions[skeleton.Find(IKEffectors::Names[e])];
+		float side = e % 2 == 0 ? 1.0f : -1.0f;
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			float phase = 2.0f * 3.14159265358979f * frame / 60.0f;
+			float swing = std::sin(phase);
+			Vector3 offset;
+			Quaternion rotation = Quaternion::identity;
+			if (e == IKEffectors::Root)
+			{
+				offset = Vector3(2.0f * swing, 2.0f * std::sin(2.0f * phase), 0.0f);
+				rotation = Quaternion(0.0f, std::sin(0.05f * swing), 0.0f, std::cos(0.05f * swing));
+			}
+			else if (e == IKEffectors::Head)
+				offset = Vector3(2.0f * swing, 2.0f * std::sin(2.0f * phase) - 3.0f, 4.0f);
+			else if (e < IKEffectors::LeftFoot)
+				offset = Vector3(0.0f, 15.0f * (1.0f - std::abs(swing)) - 45.0f, 25.0f * side * swing);
+			else
+				offset = Vector3(0.0f, 8.0f * std::max(0.0f, side * swing), -20.0f * side * swing);
+
+			effector.x[frame] = bindPosition.x + offset.x;
+			effector.y[frame] = bindPosition.y + offset.y;
+			effector.z[frame] = bindPosition.z + offset.z;
+			effector.rotations[frame] = rotation;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+		kernel.SolvePose(skeleton, root, effectors, frame, iterations->GetValue(), tolerance->GetValue(), pose);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return frameCount / std::max(seconds, 1e-9);
+}
+
+void FabrikIKKernel::Prepare(const IKSkeleton& skeleton, int root, const Vector3& forward, Pose& bindPose) const
+{
+	bindPose.SetBindPose(skeleton);
+	BuildChains(skeleton, root, forward, bindPose.chains);
+}
+
+void FabrikIKKernel::BuildChains(const IKSkeleton& skeleton, int root, const Vector3& forward, std::vector<Chain>& chains) const
+{
+	Parameter<float>* spineBendLimit = dynamic_cast<Parameter<float>*>(parameters.at("SpineBendLimit"));
+	Parameter<float>* limbBendLimit = dynamic_cast<Parameter<float>*>(parameters.at("LimbBendLimit"));
+
+	// Global bind positions, the bone lengths are taken from them
+	IKPose bindPose;
+	bindPose.SetBindPose(skeleton);
+
+	// The spine goes first, the limbs are attached to it
+	for (int e = IKEffectors::Head; e < IKEffectors::Count; ++e)
+	{
+		int effector = skeleton.Find(IKEffectors::Names[e]);
+		if (effector < 0)
+			continue;
+
+		Chain chain;
+		chain.effector = e;
+		bool spine = e == IKEffectors::Head;
+		int maxJoints = spine ? (int)skeleton.names.size() : LimbBones + 1;
+		for (int joint = effector; joint >= 0 && joint != root && (int)chain.joints.size() < maxJoints; joint = skeleton.parents[joint])
+			chain.joints.insert(chain.joints.begin(), joint);
+		if (chain.joints.size() < 2)
+			continue;
+
+		float cosLimit = std::cos((spine ? spineBendLimit->GetValue() : limbBendLimit->GetValue()) * DegToRad);
+		chain.totalLength = 0.0f;
+		for (size_t i = 0; i < chain.joints.size(); ++i)
+		{
+			if (i + 1 < chain.joints.size())
+			{
+				float length = (bindPose.globalPositions[chain.joints[i + 1]] - bindPose.globalPositions[chain.joints[i]]).length();
+				chain.lengths.push_back(length);
+				chain.totalLength += length;
+			}
+			chain.cosLimits.push_back(i == 0 ? -1.0f : cosLimit);
+		}
+		chain.x.resize(chain.joints.size());
+		chain.y.resize(chain.joints.size());
+		chain.z.resize(chain.joints.size());
+
+		// Knees bend forward and elbows backward, kept relative to the joint the chain hangs off
+		chain.bendHint = Vector3::zero;
+		if (!spine)
+		{
+			int anchor = skeleton.parents[chain.joints[0]];
+			Vector3 hint = e >= IKEffectors::LeftFoot ? forward : -forward;
+			chain.bendHint = anchor >= 0 ? bindPose.globalRotations[anchor].conjugate() * hint : hint;
+		}
+
+		chains.push_back(chain);
+	}
+}
+
+void FabrikIKKernel::SolvePose(const IKSkeleton& skeleton, int root, const std::vector<IKEffectorTrack>& effectors, int frame, int iterations, float tolerance, Pose& pose) const
+{
+	// Unsolved joints and the twist of solved ones come from the bind pose, so nothing drifts over time
+	std::copy(skeleton.bindPositions.begin(), skeleton.bindPositions.end(), pose.localPositions.begin());
+	std::copy(skeleton.bindRotations.begin(), skeleton.bindRotations.end(), pose.localRotations.begin());
+
+	const IKEffectorTrack& rootTrack = effectors[IKEffectors::Root];
+	if (root >= 0 && rootTrack.valid)
+	{
+		pose.UpdateGlobals(skeleton);
+		Vector3 position = rootTrack.GetPosition(frame);
+		int parent = skeleton.parents[root];
+		if (parent >= 0)
+		{
+			Quaternion inverseParent = pose.globalRotations[parent].conjugate();
+			Vector3 local = inverseParent * (position - pose.globalPositions[parent]);
+			const Vector3& scaling = pose.globalScalings[parent];
+			pose.localPositions[root] = Vector3(local.x / scaling.x, local.y / scaling.y, local.z / scaling.z);
+			pose.localRotations[root] = inverseParent * rootTrack.rotations[frame];
+		}
+		else
+		{
+			pose.localPositions[root] = position;
+			pose.localRotations[root] = rootTrack.rotations[frame];
+		}
+	}
+	pose.UpdateGlobals(skeleton);
+
+	for (Chain& chain : pose.chains)
+	{
+		const IKEffectorTrack& effector = effectors[chain.effector];
+		if (!effector.valid)
+			continue;
+
+		int base = chain.joints[0];
+		if (!pose.warm)
+		{
+			for (size_t i = 0; i < chain.joints.size(); ++i)
+			{
+				const Vector3& position = pose.globalPositions[chain.joints[i]];
+				chain.x[i] = position.x;
+				chain.y[i] = position.y;
+				chain.z[i] = position.z;
+			}
+		}
+		else
+		{
+			// Start from the last solution, moved along with the base
+			const Vector3& position = pose.globalPositions[base];
+			float dx = position.x - chain.x[0];
+			float dy = position.y - chain.y[0];
+			float dz = position.z - chain.z[0];
+			for (size_t i = 0; i < chain.joints.size(); ++i)
+			{
+				chain.x[i] += dx;
+				chain.y[i] += dy;
+				chain.z[i] += dz;
+			}
+		}
+
+		int anchor = skeleton.parents[base];
+		Vector3 bendHint = anchor >= 0 ? pose.globalRotations[anchor] * chain.bendHint : chain.bendHint;
+		Vector3 target = effector.GetPosition(frame);
+		SolveChain(chain, target, bendHint, iterations, tolerance);
+		ApplyChain(skeleton, chain, effector, frame, pose);
+		// Joints further down, e.g. the shoulders on the spine, follow the chain
+		pose.UpdateGlobals(skeleton);
+	}
+
+	pose.warm = true;
+}
+
+void FabrikIKKernel::SolveChain(Chain& chain, const Vector3& target, const Vector3& bendHint, int iterations, float tolerance) const
+{
+	int n = chain.joints.size();
+	float* x = chain.x.data();
+	float* y = chain.y.data();
+	float* z = chain.z.data();
+	const float* lengths = chain.lengths.data();
+	const float* cosLimits = chain.cosLimits.data();
+
+	float baseX = x[0], baseY = y[0], baseZ = z[0];
+	float toTargetX = target.x - baseX, toTargetY = target.y - baseY, toTargetZ = target.z - baseZ;
+	float targetDistance = std::sqrt(toTargetX * toTargetX + toTargetY * toTargetY + toTargetZ * toTargetZ);
+
+	// Out of reach, the chain points straight at the target
+	if (targetDistance >= chain.totalLength)
+	{
+		float scale = 1.0f / std::max(targetDistance, 1e-8f);
+		for (int i = 0; i < n - 1; ++i)
+		{
+			x[i + 1] = x[i] + toTargetX * scale * lengths[i];
+			y[i + 1] = y[i] + toTargetY * scale * lengths[i];
+			z[i + 1] = z[i] + toTargetZ * scale * lengths[i];
+		}
+		return;
+	}
+
+	bool hinge = bendHint.lengthSquared() > 0.0f;
+	float toleranceSquared = tolerance * tolerance;
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		float errorX = x[n - 1] - target.x, errorY = y[n - 1] - target.y, errorZ = z[n - 1] - target.z;
+		if (errorX * errorX + errorY * errorY + errorZ * errorZ <= toleranceSquared)
+			break;
+
+		// A straight chain only slides along its line, so it gets bent towards the hint first
+		if (hinge)
+		{
+			float axisX = x[n - 1] - baseX, axisY = y[n - 1] - baseY, axisZ = z[n - 1] - baseZ;
+			float axisLength = std::sqrt(axisX * axisX + axisY * axisY + axisZ * axisZ);
+			float inverseAxisLength = 1.0f / std::max(axisLength, 1e-8f);
+			axisX *= inverseAxisLength;
+			axisY *= inverseAxisLength;
+			axisZ *= inverseAxisLength;
+			for (int i = 1; i < n - 1; ++i)
+			{
+				float dx = x[i] - baseX, dy = y[i] - baseY, dz = z[i] - baseZ;
+				float along = dx * axisX + dy * axisY + dz * axisZ;
+				float px = dx - axisX * along, py = dy - axisY * along, pz = dz - axisZ * along;
+				float side = px * bendHint.x + py * bendHint.y + pz * bendHint.z;
+				float nudge = 0.05f * chain.totalLength;
+				if (px * px + py * py + pz * pz < nudge * nudge * 0.01f)
+				{
+					x[i] += bendHint.x * nudge;
+					y[i] += bendHint.y * nudge;
+					z[i] += bendHint.z * nudge;
+				}
+				else if (side < 0.0f)
+				{
+					// Mirror across the axis, which keeps the distances to the base and the effector
+					x[i] -= 2.0f * px;
+					y[i] -= 2.0f * py;
+					z[i] -= 2.0f * pz;
+				}
+			}
+		}
+
+		// Forward: the effector onto the target, then back towards the base
+		x[n - 1] = target.x;
+		y[n - 1] = target.y;
+		z[n - 1] = target.z;
+		for (int i = n - 2; i >= 0; --i)
+		{
+			float dx = x[i] - x[i + 1], dy = y[i] - y[i + 1], dz = z[i] - z[i + 1];
+			float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+			if (length < 1e-8f)
+				continue;
+			float scale = lengths[i] / length;
+			x[i] = x[i + 1] + dx * scale;
+			y[i] = y[i + 1] + dy * scale;
+			z[i] = z[i + 1] + dz * scale;
+		}
+
+		// Backward: the base back into place, then out towards the effector within the bend limits
+		x[0] = baseX;
+		y[0] = baseY;
+		z[0] = baseZ;
+		for (int i = 0; i < n - 1; ++i)
+		{
+			float dx = x[i + 1] - x[i], dy = y[i + 1] - y[i], dz = z[i + 1] - z[i];
+			float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+			if (length < 1e-8f)
+				continue;
+			dx /= length;
+			dy /= length;
+			dz /= length;
+
+			if (i > 0 && cosLimits[i] > -1.0f)
+			{
+				float parentX = (x[i] - x[i - 1]) / lengths[i - 1];
+				float parentY = (y[i] - y[i - 1]) / lengths[i - 1];
+				float parentZ = (z[i] - z[i - 1]) / lengths[i - 1];
+				float cosAngle = dx * parentX + dy * parentY + dz * parentZ;
+				if (cosAngle < cosLimits[i])
+				{
+					// Onto the cone around the parent bone, in the plane of both bones
+					float ox = dx - parentX * cosAngle, oy = dy - parentY * cosAngle, oz = dz - parentZ * cosAngle;
+					float orthogonalLength = std::sqrt(ox * ox + oy * oy + oz * oz);
+					if (orthogonalLength > 1e-6f)
+					{
+						float sinLimit = std::sqrt(std::max(0.0f, 1.0f - cosLimits[i] * cosLimits[i]));
+						dx = parentX * cosLimits[i] + ox / orthogonalLength * sinLimit;
+						dy = parentY * cosLimits[i] + oy / orthogonalLength * sinLimit;
+						dz = parentZ * cosLimits[i] + oz / orthogonalLength * sinLimit;
+					}
+				}
+			}
+
+			x[i + 1] = x[i] + dx * lengths[i];
+			y[i + 1] = y[i] + dy * lengths[i];
+			z[i + 1] = z[i] + dz * lengths[i];
+		}
+	}
+}
+
+void FabrikIKKernel::ApplyChain(const IKSkeleton& skeleton, const Chain& chain, const IKEffectorTrack& effector, int frame, Pose& pose) const
+{
+	// Every joint is turned the shortest way onto its solved bone, the children follow right away
+	size_t n = chain.joints.size();
+	for (size_t i = 0; i + 1 < n; ++i)
+	{
+		int joint = chain.joints[i];
+		int child = chain.joints[i + 1];
+		const Vector3& position = pose.globalPositions[joint];
+		Vector3 childOffset = MultiplyElements(pose.globalScalings[joint], pose.localPositions[child]);
+
+		Vector3 current = pose.globalRotations[joint] * childOffset;
+		Vector3 solved(chain.x[i + 1] - position.x, chain.y[i + 1] - position.y, chain.z[i + 1] - position.z);
+		if (current.lengthSquared() < 1e-12f || solved.lengthSquared() < 1e-12f)
+			continue;
+
+		Quaternion rotation = (IKSkeleton::ShortestArc(current.normalized(), solved.normalized()) * pose.globalRotations[joint]).normalized();
+		int parent = skeleton.parents[joint];
+		pose.localRotations[joint] = parent >= 0 ? pose.globalRotations[parent].conjugate() * rotation : rotation;
+		pose.globalRotations[joint] = rotation;
+
+		pose.globalPositions[child] = position + rotation * childOffset;
+		pose.globalRotations[child] = rotation * pose.localRotations[child];
+	}
+
+	// The effector takes the orientation of its tracker
+	int end = chain.joints[n - 1];
+	int parent = skeleton.parents[end];
+	pose.localRotations[end] = parent >= 0 ? pose.globalRotations[parent].conjugate() * effector.rotations[frame] : effector.rotations[frame];
+	pose.globalRotations[end] = effector.rotations[frame];
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BaseIKKernel.h"
+#include "IKSkeleton.h"
+#include <memory>
+#include <vector>
+
+// Full body FABRIK solver. The hips tracker places the root, a spine chain reaches for the head
+// and two bone chains for the hands and feet. Every frame starts from the solution of the previous one.
+// The clip is cut into segments that are solved in parallel, each one warms up on a few frames before its start.
+// Also solves streamed frames, one at a time.
+class FabrikIKKernel : public BaseIKKernel
+{
+public:
+	FabrikIKKernel();
+
+	static RegisterIKSolver<FabrikIKKernel> Register;
+
+	virtual Animation* Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation);
+	virtual std::vector<std::string> InputNames();
+	virtual BaseIKKernel* Clone() const;
+
+	virtual bool SupportsStreaming() const { return true; }
+	virtual bool Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose);
+	virtual bool SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose);
+	virtual void End();
+
+	/// <summary>
+	/// Solves a synthetic full body walk on a single thread with the default parameters.
+	/// Needs no model or GL context, main runs it for --benchmark-ik.
+	/// </summary>
+	/// <returns>Full body solves per second</returns>
+	static double Benchmark(int frameCount);
+private:
+	// Consecutive joints from the base to the effector. The base is placed by its parent and stays fixed.
+	// The positions are kept as structure of arrays, they carry over to the next frame.
+	struct Chain
+	{
+		std::vector<int> joints;
+		// lengths[i] is the bone from joint i to i + 1
+		std::vector<float> lengths;
+		// Cosine of the largest angle between bone i - 1 and bone i
+		std::vector<float> cosLimits;
+		std::vector<float> x, y, z;
+		float totalLength;
+		// Side the middle joints bend to in the bind pose of the anchor, zero for chains without a hinge
+		Vector3 bendHint;
+		int effector;
+	};
+
+	// Everything a thread solving one segment writes to
+	struct Pose : IKPose
+	{
+		std::vector<Chain> chains;
+	};
+
+	// State of a streamed solve between Begin and End
+	struct Stream
+	{
+		IKSkeleton skeleton;
+		int root;
+		int iterations;
+		float tolerance;
+		Pose pose;
+		IKEffectorStream input;
+	};
+	std::unique_ptr<Stream> stream;
+
+	// The bind pose with the chains every segment starts from
+	void Prepare(const IKSkeleton& skeleton, int root, const Vector3& forward, Pose& bindPose) const;
+	void BuildChains(const IKSkeleton& skeleton, int root, const Vector3& forward, std::vector<Chain>& chains) const;
+
+	// Solves one frame, the pose holds the previous frame of the segment if it is warm
+	void SolvePose(const IKSkeleton& skeleton, int root, const std::vector<IKEffectorTrack>& effectors, int frame, int iterations, float tolerance, Pose& pose) const;
+	void SolveChain(Chain& chain, const Vector3& target, const Vector3& bendHint, int iterations, float tolerance) const;
+	void ApplyChain(const IKSkeleton& skeleton, const Chain& chain, const IKEffectorTrack& effector, int frame, Pose& pose) const;
+};
@@ -0,0 +1,264 @@
+#include "IKSkeleton.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+const char* const IKEffectors::Names[IKEffectors::Count] = { "Hips", "Head", "LeftHand", "RightHand", "LeftFoot", "RightFoot" };
+
+namespace
+{
+	Vector3 MultiplyElements(const Vector3& a, const Vector3& b)
+	{
+		return Vector3(a.x * b.x, a.y * b.y, a.z * b.z);
+	}
+
+	// Keys are visited in increasing time, so the cursor only moves forward
+	template <typename Key, typename Value, typename Lerp>
+	Value SampleKeys(const std::vector<Key>& keys, float time, size_t& cursor, Lerp lerp)
+	{
+		while (cursor + 1 < keys.size() && keys[cursor + 1].time <= time)
+			cursor++;
+		if (cursor + 1 >= keys.size() || time <= keys[cursor].time)
+			return keys[cursor].value;
+
+		const Key& from = keys[cursor];
+		const Key& to = keys[cursor + 1];
+		return lerp(from.value, to.value, (time - from.time) / (to.time - from.time));
+	}
+}
+
+bool IKSkeleton::Build(const SkinnedModel& model, const std::vector<std::string>& effectorNames)
+{
+	std::set<const MeshModel::Node*> used;
+	for (const std::string& effectorName : effectorNames)
+		for (const MeshModel::Node* node = model.GetNode(effectorName); node; node = node->Parent)
+			used.insert(node);
+
+	if (used.empty())
+		return false;
+
+	// Depth first from the root, so parents are added before their children
+	std::map<const MeshModel::Node*, int> indices;
+	std::vector<const MeshModel::Node*> stack(1, &model.GetRoot());
+	while (!stack.empty())
+	{
+		const MeshModel::Node* node = stack.back();
+		stack.pop_back();
+		if (!used.count(node))
+			continue;
+
+		indices[node] = names.size();
+		names.push_back(node->Name);
+		parents.push_back(node->Parent && indices.count(node->Parent) ? indices[node->Parent] : -1);
+		bindPositions.push_back(node->Trans.translation());
+		bindRotations.push_back(node->Trans.rotation());
+		bindScalings.push_back(node->Trans.scale());
+
+		for (int child = (int)node->ChildCount - 1; child >= 0; --child)
+			stack.push_back(&node->Children[child]);
+	}
+
+	return true;
+}
+
+int IKSkeleton::Find(const std::string& name) const
+{
+	auto it = std::find(names.begin(), names.end(), name);
+	return it == names.end() ? -1 : (int)(it - names.begin());
+}
+
+bool IKSkeleton::IsAncestor(int ancestor, int joint) const
+{
+	for (; joint >= 0; joint = parents[joint])
+		if (joint == ancestor)
+			return true;
+	return false;
+}
+
+void IKSkeleton::UpdateGlobals(
+	const std::vector<Vector3>& localPositions, const std::vector<Quaternion>& localRotations,
+	std::vector<Vector3>& globalPositions, std::vector<Quaternion>& globalRotations, std::vector<Vector3>& globalScalings) const
+{
+	size_t jointCount = names.size();
+	globalPositions.resize(jointCount);
+	globalRotations.resize(jointCount);
+	globalScalings.resize(jointCount);
+
+	for (size_t joint = 0; joint < jointCount; ++joint)
+	{
+		int parent = parents[joint];
+		if (parent < 0)
+		{
+			globalPositions[joint] = localPositions[joint];
+			globalRotations[joint] = localRotations[joint];
+			globalScalings[joint] = bindScalings[joint];
+			continue;
+		}
+
+		const Quaternion& parentRotation = globalRotations[parent];
+		const Vector3& parentScaling = globalScalings[parent];
+		globalPositions[joint] = globalPositions[parent] + parentRotation * MultiplyElements(parentScaling, localPositions[joint]);
+		globalRotations[joint] = parentRotation * localRotations[joint];
+		globalScalings[joint] = MultiplyElements(parentScaling, bindScalings[joint]);
+	}
+}
+
+Animation* IKSkeleton::CreateAnimation(const Animation& groundTruthAnimation, const std::vector<float>& times, const std::vector<Vector3>& positions, const std::vector<Quaternion>& rotations) const
+{
+	Animation* solvedAnimation = new Animation();
+	solvedAnimation->name = groundTruthAnimation.name;
+	solvedAnimation->path = groundTruthAnimation.path;
+	solvedAnimation->filename = groundTruthAnimation.filename;
+	solvedAnimation->duration = groundTruthAnimation.duration;
+	solvedAnimation->ticksPerSecond = groundTruthAnimation.ticksPerSecond;
+
+	size_t jointCount = names.size();
+	for (size_t joint = 0; joint < jointCount; ++joint)
+	{
+		AnimationCurve& curve = solvedAnimation->animNodeMapping[names[joint]];
+		curve.name = names[joint];
+		curve.positions.reserve(times.size());
+		curve.rotations.reserve(times.size());
+		for (size_t frame = 0; frame < times.size(); ++frame)
+		{
+			size_t index = frame * jointCount + joint;
+			curve.positions.push_back(AnimationCurve::VectorAnimationKey(times[frame], positions[index]));
+			curve.rotations.push_back(AnimationCurve::QuaternionAnimationKey(times[frame], rotations[index]));
+		}
+		curve.scalings.push_back(AnimationCurve::VectorAnimationKey(0.0f, bindScalings[joint]));
+	}
+
+	return solvedAnimation;
+}
+
+std::vector<float> IKSkeleton::GetFrameTimes(float duration, float sampleRate)
+{
+	int frameCount = (int)std::ceil(std::max(0.0f, duration) * sampleRate) + 1;
+	std::vector<float> times(frameCount);
+	for (int frame = 0; frame < frameCount; ++frame)
+		times[frame] = std::min(frame / sampleRate, duration);
+	return times;
+}
+
+Quaternion IKSkeleton::ShortestArc(const Vector3& from, const Vector3& to)
+{
+	float d = from.dot(to);
+	if (d < -0.99999f)
+	{
+		Vector3 axis = std::abs(from.x) < 0.9f ? from.cross(Vector3(1, 0, 0)) : from.cross(Vector3(0, 1, 0));
+		axis.normalize();
+		return Quaternion(axis.x, axis.y, axis.z, 0.0f);
+	}
+	Vector3 c = from.cross(to);
+	return Quaternion(c.x, c.y, c.z, 1.0f + d).normalized();
+}
+
+void IKPose::SetBindPose(const IKSkeleton& skeleton)
+{
+	localPositions = skeleton.bindPositions;
+	localRotations = skeleton.bindRotations;
+	warm = false;
+	UpdateGlobals(skeleton);
+}
+
+void IKCurveCursor::Sample(const AnimationCurve& curve, float time, Vector3& position, Quaternion& rotation)
+{
+	if (curve.IsResampled())
+	{
+		position = curve.GetPosition(time);
+		rotation = curve.GetRotation(time);
+		return;
+	}
+	position = SampleKeys<AnimationCurve::VectorAnimationKey, Vector3>(curve.positions, time, positionKey, Vector3::interpolate);
+	rotation = SampleKeys<AnimationCurve::QuaternionAnimationKey, Quaternion>(curve.rotations, time, rotationKey, Quaternion::interpolate);
+}
+
+void IKEffectorTrack::Sample(const AnimationCurve& curve, const Tracker* tracker, const Matrix& worldToModel, const std::vector<float>& times)
+{
+	valid = false;
+	if (!curve.IsResampled() && (curve.positions.empty() || curve.rotations.empty()))
+		return;
+
+	Vector3 offsetPosition = tracker ? tracker->GetOffsetPosition() : Vector3::zero;
+	Quaternion offsetRotation = tracker ? tracker->GetOffsetRotation() : Quaternion::identity;
+	Quaternion worldToModelRotation = worldToModel.rotation();
+
+	size_t frameCount = times.size();
+	x.resize(frameCount);
+	y.resize(frameCount);
+	z.resize(frameCount);
+	rotations.resize(frameCount);
+
+	IKCurveCursor cursor;
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		Vector3 position;
+		Quaternion rotation;
+		cursor.Sample(curve, times[frame], position, rotation);
+
+		Vector3 modelPosition = worldToModel * (position + rotation * offsetPosition);
+		x[frame] = modelPosition.x;
+		y[frame] = modelPosition.y;
+		z[frame] = modelPosition.z;
+		rotations[frame] = (worldToModelRotation * (rotation * offsetRotation)).normalized();
+	}
+	valid = true;
+}
+
+void IKEffectorTrack::SetFrame(int frame, const Vector3& position, const Quaternion& rotation, const Tracker* tracker, const Matrix& worldToModel)
+{
+	Vector3 offsetPosition = tracker ? tracker->GetOffsetPosition() : Vector3::zero;
+	Quaternion offsetRotation = tracker ? tracker->GetOffsetRotation() : Quaternion::identity;
+
+	Vector3 modelPosition = worldToModel * (position + rotation * offsetPosition);
+	x[frame] = modelPosition.x;
+	y[frame] = modelPosition.y;
+	z[frame] = modelPosition.z;
+	rotations[frame] = (worldToModel.rotation() * (rotation * offsetRotation)).normalized();
+}
+
+std::vector<IKEffectorTrack> IKEffectorTrack::SampleAll(
+	const std::vector<std::string>& slots, const std::map<std::string, Tracker*>& trackers, const SkinnedModel& model,
+	const Animation& endEffectorsAnimation, const std::vector<float>& times)
+{
+	Matrix worldToModel = Matrix(model.getGlobalTransform()).invert();
+	std::vector<IKEffectorTrack> tracks(slots.size());
+	for (size_t slot = 0; slot < slots.size(); ++slot)
+	{
+		auto curve = endEffectorsAnimation.animNodeMapping.find(slots[slot]);
+		if (curve == endEffectorsAnimation.animNodeMapping.end())
+			continue;
+		auto tracker = trackers.find(slots[slot]);
+		tracks[slot].Sample(curve->second, tracker != trackers.end() ? tracker->second : nullptr, worldToModel, times);
+	}
+	return tracks;
+}
+
+void IKEffectorStream::Begin(const std::vector<std::string>& slots, const std::map<std::string, Tracker*>& trackers, const SkinnedModel& model)
+{
+	worldToModel = Matrix(model.getGlobalTransform()).invert();
+	effectors.assign(slots.size(), IKEffectorTrack());
+	this->trackers.assign(slots.size(), nullptr);
+	for (size_t slot = 0; slot < slots.size(); ++slot)
+	{
+		IKEffectorTrack& effector = effectors[slot];
+		effector.x.resize(1);
+		effector.y.resize(1);
+		effector.z.resize(1);
+		effector.rotations.resize(1, Quaternion::identity);
+		auto tracker = trackers.find(slots[slot]);
+		if (tracker != trackers.end())
+			this->trackers[slot] = tracker->second;
+	}
+}
+
+void IKEffectorStream::SetSamples(const std::vector<TrackerSample>& samples)
+{
+	for (size_t slot = 0; slot < effectors.size(); ++slot)
+	{
+		IKEffectorTrack& effector = effectors[slot];
+		effector.valid = slot < samples.size() && samples[slot].valid;
+		if (effector.valid)
+			effector.SetFrame(0, samples[slot].position, samples[slot].rotation, trackers[slot], worldToModel);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../../Animation.h"
+#include "../../SkinnedModel.h"
+#include "../../Tracker.h"
+#include <vector>
+#include <string>
+#include <map>
+
+// The solve slots the full body kernels share. The first one drives the root, then the head, the hands and the feet.
+struct IKEffectors
+{
+	enum { Root, Head, LeftHand, RightHand, LeftFoot, RightFoot, Count };
+	static const char* const Names[Count];
+
+	static std::vector<std::string> GetNames() { return std::vector<std::string>(Names, Names + Count); }
+};
+
+// Pose of the tracker of one solve slot at a single time in world space, like the keys of the tracker curves
+struct TrackerSample
+{
+	Vector3 position;
+	Quaternion rotation;
+	bool valid = false;
+};
+
+// Joint hierarchy of a skinned model compiled into flat arrays for the solvers. Only the joints on the paths
+// from the model root to the effectors are kept, parents always come before their children.
+struct IKSkeleton
+{
+	std::vector<std::string> names;
+	std::vector<int> parents;
+	std::vector<Vector3> bindPositions;
+	std::vector<Quaternion> bindRotations;
+	std::vector<Vector3> bindScalings;
+
+	// False if the model has none of the effectors
+	bool Build(const SkinnedModel& model, const std::vector<std::string>& effectorNames);
+	// -1 if the joint is not part of the skeleton
+	int Find(const std::string& name) const;
+	int GetJointCount() const { return names.size(); }
+	// Whether the joint is the ancestor or the joint itself
+	bool IsAncestor(int ancestor, int joint) const;
+
+	// Forward kinematics in model space, the scalings are not solved and always taken from the bind pose
+	void UpdateGlobals(
+		const std::vector<Vector3>& localPositions, const std::vector<Quaternion>& localRotations,
+		std::vector<Vector3>& globalPositions, std::vector<Quaternion>& globalRotations, std::vector<Vector3>& globalScalings) const;
+
+	/// <summary>
+	/// Creates the solved clip with one key per frame for every joint
+	/// </summary>
+	/// <param name="positions">Local positions, positions[frame * jointCount + joint]</param>
+	/// <param name="rotations">Local rotations, laid out like the positions</param>
+	Animation* CreateAnimation(const Animation& groundTruthAnimation, const std::vector<float>& times, const std::vector<Vector3>& positions, const std::vector<Quaternion>& rotations) const;
+
+	// Times of the frames at the given rate, the last one at the end of the clip
+	static std::vector<float> GetFrameTimes(float duration, float sampleRate);
+	// Rotation from one unit vector onto another, stable for opposite vectors
+	static Quaternion ShortestArc(const Vector3& from, const Vector3& to);
+};
+
+// Joint transforms of a pose being solved, the globals are derived from the locals in model space
+struct IKPose
+{
+	std::vector<Vector3> localPositions;
+	std::vector<Quaternion> localRotations;
+	std::vector<Vector3> globalPositions;
+	std::vector<Quaternion> globalRotations;
+	std::vector<Vector3> globalScalings;
+	// Set once the pose holds a solved frame the next one can start from
+	bool warm = false;
+
+	void SetBindPose(const IKSkeleton& skeleton);
+	void UpdateGlobals(const IKSkeleton& skeleton) { skeleton.UpdateGlobals(localPositions, localRotations, globalPositions, globalRotations, globalScalings); }
+};
+
+// Samples a curve at increasing times, the key search goes on from the previous sample
+struct IKCurveCursor
+{
+	size_t positionKey = 0;
+	size_t rotationKey = 0;
+
+	void Sample(const AnimationCurve& curve, float time, Vector3& position, Quaternion& rotation);
+};
+
+// The joint pose an effector tracker asks for at every frame, in model space and as structure of arrays
+struct IKEffectorTrack
+{
+	bool valid = false;
+	std::vector<float> x, y, z;
+	std::vector<Quaternion> rotations;
+
+	/// <summary>
+	/// Samples the tracker curve at every frame time. The offset of the tracker leads from the skin to the joint,
+	/// without a tracker the curve is taken as the joint itself.
+	/// </summary>
+	void Sample(const AnimationCurve& curve, const Tracker* tracker, const Matrix& worldToModel, const std::vector<float>& times);
+	// Sets the frame from a single world pose of the tracker, converted like in Sample
+	void SetFrame(int frame, const Vector3& position, const Quaternion& rotation, const Tracker* tracker, const Matrix& worldToModel);
+
+	/// <summary>
+	/// Samples the curve of every slot at the frame times. Trackers give world poses, the tracks are in the model space of the skeleton.
+	/// </summary>
+	/// <returns>One track per slot, slots without a curve stay invalid</returns>
+	static std::vector<IKEffectorTrack> SampleAll(
+		const std::vector<std::string>& slots, const std::map<std::string, Tracker*>& trackers, const SkinnedModel& model,
+		const Animation& endEffectorsAnimation, const std::vector<float>& times);
+
+	Vector3 GetPosition(int frame) const { return Vector3(x[frame], y[frame], z[frame]); }
+};
+
+// Effector tracks of a streamed solve, every slot holds a single frame the samples overwrite
+struct IKEffectorStream
+{
+	std::vector<IKEffectorTrack> effectors;
+	std::vector<const Tracker*> trackers;
+	Matrix worldToModel;
+
+	void Begin(const std::vector<std::string>& slots, const std::map<std::string, Tracker*>& trackers, const SkinnedModel& model);
+	// Converts the samples, ordered like the slots, into frame 0. Slots without a valid sample become invalid.
+	void SetSamples(const std::vector<TrackerSample>& samples);
+};
@@ -16,3 +16,8 @@ std::vector<std::string> PerfectIKKernel::InputNames()
 {
 	return std::vector<std::string>();
 }
+
+BaseIKKernel* PerfectIKKernel::Clone() const
+{
+	return new PerfectIKKernel();
+}
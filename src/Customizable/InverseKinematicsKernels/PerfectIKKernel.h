@@ -12,5 +12,6 @@ public:
 
 	virtual Animation* Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation);
 	virtual std::vector<std::string> InputNames();
+	virtual BaseIKKernel* Clone() const;
 };
 
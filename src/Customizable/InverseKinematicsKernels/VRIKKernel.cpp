@@ -0,0 +1,360 @@
+#include "VRIKKernel.h"
+#include <algorithm>
+#include <cmath>
+
+RegisterIKSolver<VRIKKernel> VRIKKernel::Register;
+
+namespace
+{
+	const float DegToRad = 3.14159265358979f / 180.0f;
+
+	// The part of a rotation around the given unit axis
+	Quaternion Twist(const Quaternion& rotation, const Vector3& axis)
+	{
+		float along = rotation.x * axis.x + rotation.y * axis.y + rotation.z * axis.z;
+		Quaternion twist(axis.x * along, axis.y * along, axis.z * along, rotation.w);
+		if (twist.magnitudeSqr() < 1e-12f)
+			return Quaternion::identity;
+		return twist.normalized();
+	}
+
+	Quaternion ClampAngle(Quaternion rotation, float maxAngle)
+	{
+		if (rotation.w < 0.0f)
+			rotation = rotation * -1.0f;
+		float angle = 2.0f * std::acos(std::min(1.0f, rotation.w));
+		if (angle <= maxAngle)
+			return rotation;
+		return Quaternion::Slerp(Quaternion::identity, rotation, maxAngle / angle);
+	}
+
+	// Any unit vector orthogonal to the given one
+	Vector3 Orthogonal(const Vector3& v)
+	{
+		return (std::abs(v.x) < 0.9f ? v.cross(Vector3(1, 0, 0)) : v.cross(Vector3(0, 1, 0))).normalized();
+	}
+}
+
+VRIKKernel::VRIKKernel() : BaseIKKernel("VR IK Kernel")
+{
+	AddSegmentParameters();
+	// Without a pelvis tracker or at weight 0 the body hangs below the head
+	AddParameter(new Parameter<float>("PelvisPositionWeight", 1.0f));
+	AddParameter(new Parameter<float>("PelvisRotationWeight", 1.0f));
+	AddParameter(new Parameter<float>("HeadPositionWeight", 1.0f));
+	AddParameter(new Parameter<float>("HeadRotationWeight", 1.0f));
+	// Share of the reach towards the hand the shoulder takes, up to the limit in degrees
+	AddParameter(new Parameter<float>("ShoulderRotationWeight", 0.5f));
+	AddParameter(new Parameter<float>("ShoulderAngleLimit", 25.0f));
+	AddParameter(new Parameter<float>("ArmPositionWeight", 1.0f));
+	AddParameter(new Parameter<float>("ArmRotationWeight", 1.0f));
+	AddParameter(new Parameter<float>("LegPositionWeight", 1.0f));
+	AddParameter(new Parameter<float>("LegRotationWeight", 1.0f));
+}
+
+Animation* VRIKKernel::Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation)
+{
+	Rig rig;
+	Pose bindPose;
+	if (!Prepare(model, rig, bindPose))
+		return nullptr;
+	Weights weights = GetWeights();
+
+	std::vector<float> times = GetFrameTimes(groundTruthAnimation);
+	std::vector<IKEffectorTrack> effectors = IKEffectorTrack::SampleAll(IKEffectors::GetNames(), trackers, model, endEffectorsAnimation, times);
+
+	return SolveClip(rig.skeleton, groundTruthAnimation, times, bindPose, [&](int frame, Pose& pose) -> const IKPose&
+	{
+		SolvePose(rig, effectors, weights, frame, pose);
+		return pose;
+	});
+}
+
+std::vector<std::string> VRIKKernel::InputNames()
+{
+	return IKEffectors::GetNames();
+}
+
+BaseIKKernel* VRIKKernel::Clone() const
+{
+	return new VRIKKernel();
+}
+
+bool VRIKKernel::Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose)
+{
+	std::unique_ptr<Stream> newStream(new Stream());
+	if (!Prepare(model, newStream->rig, newStream->pose))
+		return false;
+	newStream->weights = GetWeights();
+	newStream->input.Begin(IKEffectors::GetNames(), trackers, model);
+
+	const IKSkeleton& skeleton = newStream->rig.skeleton;
+	pose.jointNames = skeleton.names;
+	pose.localPositions = skeleton.bindPositions;
+	pose.localRotations = skeleton.bindRotations;
+	pose.localScalings = skeleton.bindScalings;
+
+	stream = std::move(newStream);
+	return true;
+}
+
+bool VRIKKernel::SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose)
+{
+	if (!stream)
+		return false;
+
+	// The solve only depends on the current samples and the previous pose, so the time is not needed
+	stream->input.SetSamples(samples);
+	SolvePose(stream->rig, stream->input.effectors, stream->weights, 0, stream->pose);
+	std::copy(stream->pose.localPositions.begin(), stream->pose.localPositions.end(), pose.localPositions.begin());
+	std::copy(stream->pose.localRotations.begin(), stream->pose.localRotations.end(), pose.localRotations.begin());
+	return true;
+}
+
+void VRIKKernel::End()
+{
+	stream.reset();
+}
+
+bool VRIKKernel::Prepare(SkinnedModel& model, Rig& rig, Pose& bindPose) const
+{
+	IKSkeleton& skeleton = rig.skeleton;
+	if (!skeleton.Build(model, IKEffectors::GetNames()))
+	{
+		qDebug() << "VRIKKernel: the model has none of the effector joints";
+		return false;
+	}
+
+	const Matrix& rootTransform = model.GetRoot().GlobalTrans;
+	Vector3 up = rootTransform.up().normalized();
+	Vector3 forward = Vector3::ProjectOnPlane(rootTransform.forward(), up).normalized();
+	BuildRig(forward, up, rig);
+
+	bindPose.SetBindPose(skeleton);
+	bindPose.bendNormals.assign(rig.limbs.size(), Vector3::zero);
+	return true;
+}
+
+void VRIKKernel::BuildRig(const Vector3& forward, const Vector3& up, Rig& rig) const
+{
+	const IKSkeleton& skeleton = rig.skeleton;
+	rig.forward = forward;
+	rig.up = up;
+	rig.pelvis = skeleton.Find(IKEffectors::Names[IKEffectors::Root]);
+	rig.head = skeleton.Find(IKEffectors::Names[IKEffectors::Head]);
+
+	std::vector<Vector3> bindScalings;
+	skeleton.UpdateGlobals(skeleton.bindPositions, skeleton.bindRotations, rig.bindGlobalPositions, rig.bindGlobalRotations, bindScalings);
+
+	if (rig.head >= 0)
+		for (int joint = skeleton.parents[rig.head]; joint >= 0 && joint != rig.pelvis; joint = skeleton.parents[joint])
+			rig.spine.insert(rig.spine.begin(), joint);
+
+	for (int e = IKEffectors::Head + 1; e < IKEffectors::Count; ++e)
+	{
+		Limb limb;
+		limb.effector = e;
+		limb.arm = e < IKEffectors::LeftFoot;
+		limb.end = skeleton.Find(IKEffectors::Names[e]);
+		limb.middle = limb.end >= 0 ? skeleton.parents[limb.end] : -1;
+		limb.upper = limb.middle >= 0 ? skeleton.parents[limb.middle] : -1;
+		if (limb.upper < 0 || limb.upper == rig.pelvis)
+			continue;
+
+		// The clavicle, unless the arm hangs off the spine directly
+		int anchor = skeleton.parents[limb.upper];
+		limb.shoulder = -1;
+		if (limb.arm && anchor >= 0 && anchor != rig.pelvis && std::find(rig.spine.begin(), rig.spine.end(), anchor) == rig.spine.end())
+			limb.shoulder = anchor;
+
+		// Knees bend forward along the feet, elbows backward and down
+		Vector3 hint = limb.arm ? (-forward - up * 0.5f).normalized() : forward;
+		limb.bendHint = anchor >= 0 ? rig.bindGlobalRotations[anchor].conjugate() * hint : hint;
+		limb.endBendHint = limb.arm ? Vector3::zero : rig.bindGlobalRotations[limb.end].conjugate() * forward;
+		limb.upperBendHint = rig.bindGlobalRotations[limb.upper].conjugate() * hint;
+
+		rig.limbs.push_back(limb);
+	}
+}
+
+VRIKKernel::Weights VRIKKernel::GetWeights() const
+{
+	auto get = [this](const char* name) { return std::max(0.0f, std::min(1.0f, dynamic_cast<Parameter<float>*>(parameters.at(name))->GetValue())); };
+
+	Weights weights;
+	weights.pelvisPosition = get("PelvisPositionWeight");
+	weights.pelvisRotation = get("PelvisRotationWeight");
+	weights.headPosition = get("HeadPositionWeight");
+	weights.headRotation = get("HeadRotationWeight");
+	weights.shoulderRotation = get("ShoulderRotationWeight");
+	weights.shoulderAngleLimit = std::max(0.0f, dynamic_cast<Parameter<float>*>(parameters.at("ShoulderAngleLimit"))->GetValue()) * DegToRad;
+	weights.armPosition = get("ArmPositionWeight");
+	weights.armRotation = get("ArmRotationWeight");
+	weights.legPosition = get("LegPositionWeight");
+	weights.legRotation = get("LegRotationWeight");
+	return weights;
+}
+
+void VRIKKernel::SolvePose(const Rig& rig, const std::vector<IKEffectorTrack>& effectors, const Weights& weights, int frame, Pose& pose) const
+{
+	// Every frame starts from the bind pose, only the bend sides of the limbs carry over
+	std::copy(rig.skeleton.bindPositions.begin(), rig.skeleton.bindPositions.end(), pose.localPositions.begin());
+	std::copy(rig.skeleton.bindRotations.begin(), rig.skeleton.bindRotations.end(), pose.localRotations.begin());
+	pose.UpdateGlobals(rig.skeleton);
+
+	SolvePelvis(rig, effectors[IKEffectors::Root], effectors[IKEffectors::Head], weights, frame, pose);
+	SolveSpine(rig, effectors[IKEffectors::Head], weights, frame, pose);
+	for (size_t limb = 0; limb < rig.limbs.size(); ++limb)
+		SolveLimb(rig, limb, effectors[rig.limbs[limb].effector], weights, frame, pose);
+
+	pose.warm = true;
+}
+
+void VRIKKernel::SolvePelvis(const Rig& rig, const IKEffectorTrack& pelvisTrack, const IKEffectorTrack& headTrack, const Weights& weights, int frame, Pose& pose) const
+{
+	bool hasHead = headTrack.valid && rig.head >= 0;
+	if (rig.pelvis < 0 || (!pelvisTrack.valid && !hasHead))
+		return;
+
+	Vector3 position = pose.globalPositions[rig.pelvis];
+	Quaternion rotation = pose.globalRotations[rig.pelvis];
+	if (hasHead)
+	{
+		// The bind pose below the head, turned to where the head looks
+		Vector3 headForward = headTrack.rotations[frame] * (rig.bindGlobalRotations[rig.head].conjugate() * rig.forward);
+		Vector3 heading = Vector3::ProjectOnPlane(headForward, rig.up);
+		Quaternion yaw = heading.lengthSquared() > 1e-8f ? IKSkeleton::ShortestArc(rig.forward, heading.normalized()) : Quaternion::identity;
+		position = headTrack.GetPosition(frame) + yaw * (rig.bindGlobalPositions[rig.pelvis] - rig.bindGlobalPositions[rig.head]);
+		rotation = yaw * rig.bindGlobalRotations[rig.pelvis];
+	}
+	if (pelvisTrack.valid)
+	{
+		position = Vector3::Lerp(position, pelvisTrack.GetPosition(frame), weights.pelvisPosition);
+		rotation = Quaternion::Slerp(rotation, pelvisTrack.rotations[frame], weights.pelvisRotation);
+	}
+
+	const IKSkeleton& skeleton = rig.skeleton;
+	int parent = skeleton.parents[rig.pelvis];
+	if (parent >= 0)
+	{
+		Vector3 local = pose.globalRotations[parent].conjugate() * (position - pose.globalPositions[parent]);
+		const Vector3& scaling = pose.globalScalings[parent];
+		pose.localPositions[rig.pelvis] = Vector3(local.x / scaling.x, local.y / scaling.y, local.z / scaling.z);
+	}
+	else
+		pose.localPositions[rig.pelvis] = position;
+	SetGlobalRotation(skeleton, rig.pelvis, rotation, pose);
+}
+
+void VRIKKernel::SolveSpine(const Rig& rig, const IKEffectorTrack& headTrack, const Weights& weights, int frame, Pose& pose) const
+{
+	if (rig.head < 0 || !headTrack.valid)
+		return;
+
+	const IKSkeleton& skeleton = rig.skeleton;
+	Vector3 target = Vector3::Lerp(pose.globalPositions[rig.head], headTrack.GetPosition(frame), weights.headPosition);
+	Quaternion targetRotation = Quaternion::Slerp(pose.globalRotations[rig.head], headTrack.rotations[frame], weights.headRotation);
+
+	// Bottom up, every joint bends and twists by its share of what is left, the neck takes the rest
+	size_t n = rig.spine.size();
+	for (size_t i = 0; i < n; ++i)
+	{
+		int joint = rig.spine[i];
+		const Vector3& position = pose.globalPositions[joint];
+		Vector3 toHead = pose.globalPositions[rig.head] - position;
+		Vector3 toTarget = target - position;
+		if (toHead.lengthSquared() < 1e-12f || toTarget.lengthSquared() < 1e-12f)
+			continue;
+
+		Vector3 axis = toTarget.normalized();
+		Quaternion swing = IKSkeleton::ShortestArc(toHead.normalized(), axis);
+		Quaternion twist = Twist(targetRotation * (swing * pose.globalRotations[rig.head]).conjugate(), axis);
+		Quaternion rotation = Quaternion::Slerp(Quaternion::identity, twist * swing, 1.0f / (n - i));
+		SetGlobalRotation(skeleton, joint, rotation * pose.globalRotations[joint], pose);
+	}
+
+	SetGlobalRotation(skeleton, rig.head, targetRotation, pose);
+}
+
+void VRIKKernel::SolveLimb(const Rig& rig, size_t limbIndex, const IKEffectorTrack& track, const Weights& weights, int frame, Pose& pose) const
+{
+	if (!track.valid)
+		return;
+
+	const IKSkeleton& skeleton = rig.skeleton;
+	const Limb& limb = rig.limbs[limbIndex];
+	float positionWeight = limb.arm ? weights.armPosition : weights.legPosition;
+	float rotationWeight = limb.arm ? weights.armRotation : weights.legRotation;
+	Vector3 target = Vector3::Lerp(pose.globalPositions[limb.end], track.GetPosition(frame), positionWeight);
+
+	// The shoulder takes part of the reach, limited so the arm does the rest
+	if (limb.shoulder >= 0 && weights.shoulderRotation > 0.0f)
+	{
+		const Vector3& position = pose.globalPositions[limb.shoulder];
+		Vector3 toEnd = pose.globalPositions[limb.end] - position;
+		Vector3 toTarget = target - position;
+		if (toEnd.lengthSquared() > 1e-12f && toTarget.lengthSquared() > 1e-12f)
+		{
+			Quaternion swing = Quaternion::Slerp(Quaternion::identity, IKSkeleton::ShortestArc(toEnd.normalized(), toTarget.normalized()), weights.shoulderRotation);
+			swing = ClampAngle(swing, weights.shoulderAngleLimit);
+			SetGlobalRotation(skeleton, limb.shoulder, swing * pose.globalRotations[limb.shoulder], pose);
+		}
+	}
+
+	Vector3 upperPosition = pose.globalPositions[limb.upper];
+	float upperLength = (pose.globalPositions[limb.middle] - upperPosition).length();
+	float lowerLength = (pose.globalPositions[limb.end] - pose.globalPositions[limb.middle]).length();
+	Vector3 toTarget = target - upperPosition;
+	float distance = toTarget.length();
+	if (upperLength > 1e-6f && lowerLength > 1e-6f && distance > 1e-6f)
+	{
+		Vector3 axis = toTarget * (1.0f / distance);
+		float margin = 1e-4f * (upperLength + lowerLength);
+		distance = std::max(std::abs(upperLength - lowerLength) + margin, std::min(upperLength + lowerLength - margin, distance));
+
+		// Bend side from the hints, the previous one once the hints run along the limb
+		int anchor = skeleton.parents[limb.upper];
+		Vector3 hint = anchor >= 0 ? pose.globalRotations[anchor] * limb.bendHint : limb.bendHint;
+		if (limb.endBendHint.lengthSquared() > 0.0f)
+			hint = hint + track.rotations[frame] * limb.endBendHint;
+		Vector3 bend = hint - axis * hint.dot(axis);
+		if (bend.lengthSquared() < 1e-6f && pose.warm)
+		{
+			const Vector3& previous = pose.bendNormals[limbIndex];
+			bend = previous - axis * previous.dot(axis);
+		}
+		bend = bend.lengthSquared() < 1e-6f ? Orthogonal(axis) : bend.normalized();
+		pose.bendNormals[limbIndex] = bend;
+
+		// Law of cosines for the angle at the upper joint
+		float cosUpper = (upperLength * upperLength + distance * distance - lowerLength * lowerLength) / (2.0f * upperLength * distance);
+		cosUpper = std::max(-1.0f, std::min(1.0f, cosUpper));
+		float sinUpper = std::sqrt(1.0f - cosUpper * cosUpper);
+		Vector3 middle = upperPosition + axis * (upperLength * cosUpper) + bend * (upperLength * sinUpper);
+
+		// The upper bone onto the middle joint, twisted so its bend side lies in the bend plane
+		Vector3 direction = (middle - upperPosition).normalized();
+		Quaternion upperRotation = IKSkeleton::ShortestArc((pose.globalPositions[limb.middle] - upperPosition).normalized(), direction) * pose.globalRotations[limb.upper];
+		Vector3 carried = upperRotation * limb.upperBendHint;
+		carried = carried - direction * carried.dot(direction);
+		Vector3 wanted = bend - direction * bend.dot(direction);
+		if (carried.lengthSquared() > 1e-8f && wanted.lengthSquared() > 1e-8f)
+			upperRotation = IKSkeleton::ShortestArc(carried.normalized(), wanted.normalized()) * upperRotation;
+		SetGlobalRotation(skeleton, limb.upper, upperRotation.normalized(), pose);
+
+		const Vector3& middlePosition = pose.globalPositions[limb.middle];
+		Vector3 current = pose.globalPositions[limb.end] - middlePosition;
+		Vector3 solved = target - middlePosition;
+		if (current.lengthSquared() > 1e-12f && solved.lengthSquared() > 1e-12f)
+			SetGlobalRotation(skeleton, limb.middle, IKSkeleton::ShortestArc(current.normalized(), solved.normalized()) * pose.globalRotations[limb.middle], pose);
+	}
+
+	SetGlobalRotation(skeleton, limb.end, Quaternion::Slerp(pose.globalRotations[limb.end], track.rotations[frame], rotationWeight), pose);
+}
+
+void VRIKKernel::SetGlobalRotation(const IKSkeleton& skeleton, int joint, const Quaternion& rotation, Pose& pose) const
+{
+	int parent = skeleton.parents[joint];
+	pose.localRotations[joint] = (parent >= 0 ? pose.globalRotations[parent].conjugate() * rotation : rotation).normalized();
+	pose.UpdateGlobals(skeleton);
+}
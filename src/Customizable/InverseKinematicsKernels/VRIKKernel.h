@@ -0,0 +1,106 @@
+#pragma once
+
+#include "BaseIKKernel.h"
+#include "IKSkeleton.h"
+#include <memory>
+#include <vector>
+
+// Full body solver for six point VR setups in the spirit of the VRIK solver of FinalIK. The pelvis follows its
+// tracker or hangs below the head, the spine bends and twists towards the head and arms and legs are solved
+// analytically as two bone chains. Locomotion is left out since the feet are tracked when solving offline.
+// Segments of the clip are solved in parallel, the bend planes of the limbs carry over between frames.
+// Also solves streamed frames, one at a time.
+class VRIKKernel : public BaseIKKernel
+{
+public:
+	VRIKKernel();
+
+	static RegisterIKSolver<VRIKKernel> Register;
+
+	virtual Animation* Solve(const Animation& groundTruthAnimation, const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, const Animation& endEffectorsAnimation);
+	virtual std::vector<std::string> InputNames();
+	virtual BaseIKKernel* Clone() const;
+
+	virtual bool SupportsStreaming() const { return true; }
+	virtual bool Begin(const std::map<std::string, Tracker*>& trackers, SkinnedModel& model, IKPoseBuffer& pose);
+	virtual bool SolveFrame(float time, const std::vector<TrackerSample>& samples, IKPoseBuffer& pose);
+	virtual void End();
+private:
+	// How far every part is pulled to its tracker, in [0, 1]
+	struct Weights
+	{
+		float pelvisPosition;
+		float pelvisRotation;
+		float headPosition;
+		float headRotation;
+		float shoulderRotation;
+		// Radians
+		float shoulderAngleLimit;
+		float armPosition;
+		float armRotation;
+		float legPosition;
+		float legRotation;
+	};
+
+	// Two bone chain of an arm or a leg
+	struct Limb
+	{
+		int effector;
+		// Turned before the arm is solved, -1 for legs
+		int shoulder;
+		int upper;
+		int middle;
+		int end;
+		bool arm;
+		// Side the middle joint bends to, in the bind frame of the parent of the upper joint
+		Vector3 bendHint;
+		// Added bend side in the bind frame of the end joint, lets the knees follow the feet
+		Vector3 endBendHint;
+		// The bend side as the upper joint carries it, fixes the twist of the upper bone
+		Vector3 upperBendHint;
+	};
+
+	struct Rig
+	{
+		IKSkeleton skeleton;
+		int pelvis;
+		int head;
+		// Joints between the pelvis and the head, bottom up
+		std::vector<int> spine;
+		std::vector<Limb> limbs;
+		Vector3 forward;
+		Vector3 up;
+		// Bind pose in model space
+		std::vector<Vector3> bindGlobalPositions;
+		std::vector<Quaternion> bindGlobalRotations;
+	};
+
+	struct Pose : IKPose
+	{
+		// Bend side every limb got in the previous frame, used once a limb is too straight to tell
+		std::vector<Vector3> bendNormals;
+	};
+
+	// State of a streamed solve between Begin and End
+	struct Stream
+	{
+		Rig rig;
+		Weights weights;
+		Pose pose;
+		IKEffectorStream input;
+	};
+	std::unique_ptr<Stream> stream;
+
+	// Builds the rig of the model and the bind pose every solve starts from, false if nothing can be solved
+	bool Prepare(SkinnedModel& model, Rig& rig, Pose& bindPose) const;
+	void BuildRig(const Vector3& forward, const Vector3& up, Rig& rig) const;
+	Weights GetWeights() const;
+
+	void SolvePose(const Rig& rig, const std::vector<IKEffectorTrack>& effectors, const Weights& weights, int frame, Pose& pose) const;
+	void SolvePelvis(const Rig& rig, const IKEffectorTrack& pelvisTrack, const IKEffectorTrack& headTrack, const Weights& weights, int frame, Pose& pose) const;
+	void SolveSpine(const Rig& rig, const IKEffectorTrack& headTrack, const Weights& weights, int frame, Pose& pose) const;
+	void SolveLimb(const Rig& rig, size_t limbIndex, const IKEffectorTrack& track, const Weights& weights, int frame, Pose& pose) const;
+
+	// Sets the global rotation of a joint and moves everything below it along
+	void SetGlobalRotation(const IKSkeleton& skeleton, int joint, const Quaternion& rotation, Pose& pose) const;
+};
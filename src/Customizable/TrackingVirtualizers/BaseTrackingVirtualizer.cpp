@@ -1,8 +1,12 @@
 #include "BaseTrackingVirtualizer.h"
+#include <algorithm>
 
 BaseTrackingVirtualizer::BaseTrackingVirtualizer(std::string name) : name(name) 
 { 
 	AddParameter(new Parameter<std::string>("name", "unnamed"));
+	// How far the solver should trust the output, in [0, 1]
+	AddParameter(new Parameter<float>("PositionConfidence", 1.0f));
+	AddParameter(new Parameter<float>("OrientationConfidence", 1.0f));
 }
 
 BaseTrackingVirtualizer::~BaseTrackingVirtualizer()
@@ -23,6 +27,30 @@ std::vector<const BaseTrackingVirtualizer*>& BaseTrackingVirtualizer::registry()
     return impl;
 }
 
+int BaseTrackingVirtualizer::GetInputSampleRate() const
+{
+	auto it = parameters.find("SampleRate");
+	if (it == parameters.end())
+		return 0;
+
+	Parameter<int>* sampleRate = dynamic_cast<Parameter<int>*>(it->second);
+	return sampleRate ? sampleRate->GetValue() : 0;
+}
+
+TrackerConfidence BaseTrackingVirtualizer::GetConfidence() const
+{
+	TrackerConfidence confidence;
+	auto position = parameters.find("PositionConfidence");
+	if (position != parameters.end())
+		if (Parameter<float>* value = dynamic_cast<Parameter<float>*>(position->second))
+			confidence.position = std::max(0.0f, std::min(1.0f, value->GetValue()));
+	auto orientation = parameters.find("OrientationConfidence");
+	if (orientation != parameters.end())
+		if (Parameter<float>* value = dynamic_cast<Parameter<float>*>(orientation->second))
+			confidence.orientation = std::max(0.0f, std::min(1.0f, value->GetValue()));
+	return confidence;
+}
+
 std::string BaseTrackingVirtualizer::GetName() const
 {
     return name;
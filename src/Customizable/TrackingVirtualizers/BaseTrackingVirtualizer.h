@@ -1,6 +1,7 @@
 #pragma once
 
 #include<string>
+#include <set>
 #include "../../Animation.h"
 #include "../../Animator.h"
 #include "../../AttachedModel.h"
@@ -10,6 +11,8 @@
 #include "QDebug"
 #include "../../Parameter.h"
 #include "../../Tracker.h"
+#include "../../CancellationToken.h"
+#include "../../TrackerTrajectory.h"
 
 struct TrackerHandle
 {
@@ -17,14 +20,32 @@ private:
 	mutable Animator* animator;
 	Tracker* tracker;
 	std::string inputName;
+	CancellationToken* cancellationToken;
+	// Presampled ground truth of the tracker, the tracker transforms are read from it instead of the animator if set
+	const TrackerTrajectory* trajectory;
 public:
-	TrackerHandle(Animator* animator, Tracker* tracker, std::string inputName) :
+	TrackerHandle(Animator* animator, Tracker* tracker, std::string inputName, CancellationToken* cancellationToken = nullptr, const TrackerTrajectory* trajectory = nullptr) :
 		animator(animator),
 		tracker(tracker),
-		inputName(inputName)
+		inputName(inputName),
+		cancellationToken(cancellationToken),
+		trajectory(trajectory)
 	{
 	}
 
+	// Virtualizers should check this per frame and return false once set
+	bool IsCanceled() const
+	{
+		return cancellationToken && cancellationToken->IsCanceled();
+	}
+
+	// Progress of the virtualization in [0, 1]
+	void ReportProgress(float progress) const
+	{
+		if (cancellationToken)
+			cancellationToken->ReportProgress(progress);
+	}
+
 	Vector3 GetPositionOffset()
 	{
 		return tracker->GetOffsetPosition();
@@ -37,6 +58,8 @@ public:
 
 	Vector3 GetPosition(float time) const
 	{
+		if (trajectory)
+			return trajectory->GetPosition(time);
 		animator->SetNormalizedAnimationTime(time);
 		// Maybe a draw is needed?
 		Vector3 position = tracker->GetModel()->getAnimationTransform().translation();
@@ -45,6 +68,8 @@ public:
 
 	Quaternion GetRotation(float time) const
 	{
+		if (trajectory)
+			return trajectory->GetRotation(time);
 		animator->SetNormalizedAnimationTime(time);
 		// Maybe a draw is needed?
 		Quaternion rotation = tracker->GetModel()->getAnimationTransform().rotation();
@@ -53,6 +78,8 @@ public:
 
 	Matrix GetTransform(float time) const
 	{
+		if (trajectory)
+			return trajectory->GetTransform(time);
 		animator->SetNormalizedAnimationTime(time);
 		return tracker->GetModel()->getAnimationTransform();
 	}
@@ -119,6 +146,30 @@ public:
 
 	virtual bool CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output) = 0;
 
+	// Virtualizers that can report samples while the clip plays implement the streaming interface below and report it here
+	virtual bool SupportsStreaming() const { return false; }
+	// Prepares a streamed virtualization of the tracker, the handle has to stay alive until EndStream
+	virtual bool BeginStream(TrackerHandle& trackerHandle) { return false; }
+	/// <summary>
+	/// The latest sample the tracker reported up to the time, like a live tracker polled by the solver. The times have to increase.
+	/// </summary>
+	/// <param name="time">Seconds since the start of the clip</param>
+	virtual bool SampleFrame(float time, Vector3& position, Quaternion& rotation) { return false; }
+	// Releases what BeginStream set up
+	virtual void EndStream() {}
+
+	// The rate the ground truth animation gets sampled with, 0 if unknown. Reads the SampleRate parameter by default.
+	virtual int GetInputSampleRate() const;
+	// Whether equal inputs and parameters always give the same output, only then the output gets cached
+	virtual bool IsDeterministic() const { return true; }
+	/// <summary>
+	/// Adds the joints the virtualizer reads from the skeleton besides the tracker transforms.
+	/// The default returns false, which means it may read any joint, so virtualizers which do not override it keep working unchanged.
+	/// </summary>
+	virtual bool DeclareJoints(std::set<std::string>& joints) const { return false; }
+	// How far the solver should trust the output. Reads the PositionConfidence and OrientationConfidence parameters by default.
+	virtual TrackerConfidence GetConfidence() const;
+
 	static std::vector<const BaseTrackingVirtualizer*>& registry();
 	std::string GetName() const;
 
@@ -8,7 +8,8 @@ class IMUSimTrackingVirtualizer : public BaseTrackingVirtualizer
 private:
 	static int referenceCounter;
 	static bool pythonEnvironmentActive;
-	static PyObject* pFunc;
+	// The interpreter state of the thread that initialized python, the GIL is released while no virtualization runs
+	static PyThreadState* mainThreadState;
 public:
 	static RegisterVirtualizer<IMUSimTrackingVirtualizer> Register;
 
@@ -16,6 +17,17 @@ public:
 	~IMUSimTrackingVirtualizer();
 
 	virtual bool CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output);
+	// Only reads the tracker transforms
+	virtual bool DeclareJoints(std::set<std::string>& joints) const { return true; }
+	virtual int GetInputSampleRate() const;
+	// The simulated IMU noise is not seeded
+	virtual bool IsDeterministic() const { return false; }
 
 	virtual BaseTrackingVirtualizer* Clone() const;
+private:
+	// Runs the IMUSim script on the sampled trajectory, the only part that holds the GIL
+	bool Simulate(const std::vector<float>& timestamps, const std::vector<Vector3>& positions, const std::vector<Quaternion>& rotations,
+		std::vector<float>& sampleTimes, std::vector<AnimationCurve::VectorAnimationKey>& estimatedPositions, std::vector<AnimationCurve::QuaternionAnimationKey>& estimatedRotations) const;
+	// Converts the returned tuple of timestamps, rotations and positions, needs the GIL
+	static bool ReadResult(PyObject* pResult, std::vector<float>& sampleTimes, std::vector<AnimationCurve::VectorAnimationKey>& estimatedPositions, std::vector<AnimationCurve::QuaternionAnimationKey>& estimatedRotations);
 };
\ No newline at end of file
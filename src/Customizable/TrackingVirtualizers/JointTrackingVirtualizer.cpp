@@ -7,6 +7,14 @@ JointTrackingVirtualizer::JointTrackingVirtualizer() : BaseTrackingVirtualizer("
 	AddParameter(new Parameter("Joint", Enums::HumanJointType::Hips));
 }
 
+bool JointTrackingVirtualizer::DeclareJoints(std::set<std::string>& joints) const
+{
+	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters.at("Joint"))->GetValue();
+	if (selectedJoint != Enums::HumanJointType::All)
+		joints.insert(QVariant::fromValue(selectedJoint).toString().toStdString());
+	return true;
+}
+
 bool JointTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output)
 {
 	Enums::HumanJointType selectedJoint = dynamic_cast<Parameter<Enums::HumanJointType>*>(parameters["Joint"])->GetValue();
@@ -23,13 +31,17 @@ bool JointTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHandl
 	output.name = selectedJointString;
 	for (AnimationCurve::VectorAnimationKey key : jointCurve.positions)
 	{
+		if (trackerHandle.IsCanceled())
+			return false;
+		trackerHandle.ReportProgress(key.time / maxTime);
+
 		float normalizedTime = key.time / maxTime;
 
 		trackerHandle.SetNormalizedAnimationTime(normalizedTime);
-		Matrix matrix = model->GetJointMapping()[selectedJointString].globalTransform;
-		output.positions.push_back(AnimationCurve::VectorAnimationKey(key.time, matrix.translation()));
-		output.rotations.push_back(AnimationCurve::QuaternionAnimationKey(key.time, matrix.rotation()));
-		output.scalings.push_back(AnimationCurve::VectorAnimationKey(key.time, matrix.scale()));
+		const RigidTransform& pose = model->GetJointMapping()[selectedJointString].globalPose;
+		output.positions.push_back(AnimationCurve::VectorAnimationKey(key.time, pose.translation));
+		output.rotations.push_back(AnimationCurve::QuaternionAnimationKey(key.time, pose.rotation));
+		output.scalings.push_back(AnimationCurve::VectorAnimationKey(key.time, pose.scale));
 	}
 
 	return true;
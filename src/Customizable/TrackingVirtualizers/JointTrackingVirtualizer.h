@@ -13,6 +13,7 @@ public:
 	JointTrackingVirtualizer();
 
 	virtual bool CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output);
+	virtual bool DeclareJoints(std::set<std::string>& joints) const;
 
 	virtual BaseTrackingVirtualizer* Clone() const;
 };
\ No newline at end of file
@@ -1,11 +1,25 @@
-#include "NoiseTrackingVirtualizer.h"
 #define _USE_MATH_DEFINES
+#include "NoiseTrackingVirtualizer.h"
 #include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
 
 RegisterVirtualizer<NoiseTrackingVirtualizer> NoiseTrackingVirtualizer::Register;
 
-bool NoiseTrackingVirtualizer::randInitialized = false;
-int NoiseTrackingVirtualizer::randSeed = 0;
+namespace
+{
+	// Offsets of one sample, the recorded and the streamed virtualization draw them in the same order
+	void DrawOffsets(std::mt19937& random, std::uniform_int_distribution<int>& randomValue, float noiseStrength, Vector3& posOffset, Quaternion& quatOffset)
+	{
+		posOffset = Vector3(randomValue(random), randomValue(random), randomValue(random));
+		posOffset.normalize();
+		posOffset = posOffset * noiseStrength;
+		Vector3 rotOffset = Vector3(randomValue(random), randomValue(random), randomValue(random));
+		rotOffset = rotOffset * noiseStrength * M_PI;
+		quatOffset = Quaternion(rotOffset);
+	}
+}
 
 NoiseTrackingVirtualizer::NoiseTrackingVirtualizer() : BaseTrackingVirtualizer("NoiseTrackingVirtualizer")
 {
@@ -19,19 +33,23 @@ bool NoiseTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHandl
 	Parameter<float>* noiseStrength = dynamic_cast<Parameter<float>*>(parameters["NoiseStrength"]);
 	Parameter<int>* seed = dynamic_cast<Parameter<int>*>(parameters["RandomSeed"]);
 	Parameter<int>* sampleRate = dynamic_cast<Parameter<int>*>(parameters["SampleRate"]);
-	InitializeRand(seed->GetValue());
+
+	// Own generator per call, so equal seeds give equal noise on any thread. The slot keeps the trackers apart.
+	std::seed_seq seedSequence { (unsigned int)seed->GetValue(), (unsigned int)std::hash<std::string>()(trackerHandle.GetName()) };
+	std::mt19937 random(seedSequence);
+	std::uniform_int_distribution<int> randomValue(0, RAND_MAX);
 
 	float sampleCount = trackerHandle.GetAnimationLength() * sampleRate->GetValue();
 
 	for (int sample = 0; sample <= sampleCount; ++sample)
 	{
-		float random = std::rand();
-		Vector3 posOffset = Vector3(std::rand(), std::rand(), std::rand());
-		posOffset.normalize();
-		posOffset = posOffset * noiseStrength->GetValue();
-		Vector3 rotOffset = Vector3(std::rand(), std::rand(), std::rand());
-		rotOffset = rotOffset * noiseStrength->GetValue() * M_PI;
-		Quaternion quatOffset = Quaternion(rotOffset);
+		if (trackerHandle.IsCanceled())
+			return false;
+		trackerHandle.ReportProgress(sample / (sampleCount + 1));
+
+		Vector3 posOffset;
+		Quaternion quatOffset;
+		DrawOffsets(random, randomValue, noiseStrength->GetValue(), posOffset, quatOffset);
 
 		float timeNormalized = std::min(sample / sampleCount, 1.0f);
 		Matrix transform = trackerHandle.GetTransform(timeNormalized);
@@ -46,14 +64,55 @@ bool NoiseTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHandl
 	return true;
 }
 
-void NoiseTrackingVirtualizer::InitializeRand(int seed)
+bool NoiseTrackingVirtualizer::BeginStream(TrackerHandle& trackerHandle)
+{
+	Parameter<float>* noiseStrength = dynamic_cast<Parameter<float>*>(parameters["NoiseStrength"]);
+	Parameter<int>* seed = dynamic_cast<Parameter<int>*>(parameters["RandomSeed"]);
+	Parameter<int>* sampleRate = dynamic_cast<Parameter<int>*>(parameters["SampleRate"]);
+
+	stream.reset(new Stream());
+	stream->trackerHandle = &trackerHandle;
+	stream->sampleCount = trackerHandle.GetAnimationLength() * sampleRate->GetValue();
+	stream->noiseStrength = noiseStrength->GetValue();
+	std::seed_seq seedSequence { (unsigned int)seed->GetValue(), (unsigned int)std::hash<std::string>()(trackerHandle.GetName()) };
+	stream->random.seed(seedSequence);
+	stream->randomValue = std::uniform_int_distribution<int>(0, RAND_MAX);
+	return true;
+}
+
+bool NoiseTrackingVirtualizer::SampleFrame(float time, Vector3& position, Quaternion& rotation)
+{
+	if (!stream)
+		return false;
+
+	// The samples fall onto the times CreateOutputAnimation keys, between them the latest one is held
+	float duration = stream->trackerHandle->GetAnimationLength();
+	int sample = (int)std::floor(stream->sampleCount);
+	if (time < duration)
+		sample = std::min(sample, (int)std::floor(time / duration * stream->sampleCount + 1e-4f));
+
+	if (sample > stream->sample)
+	{
+		// Skipped samples draw their offsets too, so the stream gets the noise of the recorded curve
+		Vector3 posOffset;
+		Quaternion quatOffset;
+		for (; stream->sample < sample; ++stream->sample)
+			DrawOffsets(stream->random, stream->randomValue, stream->noiseStrength, posOffset, quatOffset);
+
+		float timeNormalized = stream->sampleCount > 0.0f ? std::min(sample / stream->sampleCount, 1.0f) : 0.0f;
+		Matrix transform = stream->trackerHandle->GetTransform(timeNormalized);
+		stream->position = transform.translation() + posOffset;
+		stream->rotation = transform.rotation() * quatOffset;
+	}
+
+	position = stream->position;
+	rotation = stream->rotation;
+	return true;
+}
+
+void NoiseTrackingVirtualizer::EndStream()
 {
-	if (randInitialized && seed == randSeed)
-		return;
-	
-	std::srand(seed);
-	randSeed = seed;
-	randInitialized = true;
+	stream.reset();
 }
 
 BaseTrackingVirtualizer* NoiseTrackingVirtualizer::Clone() const
@@ -1,6 +1,8 @@
 #pragma once
 #include "BaseTrackingVirtualizer.h"
 #include "../../Animation.h"
+#include <memory>
+#include <random>
 
 class NoiseTrackingVirtualizer : public BaseTrackingVirtualizer
 {
@@ -10,10 +12,28 @@ public:
 	NoiseTrackingVirtualizer();
 
 	virtual bool CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output);
-private:
-	static void InitializeRand(int seed);
-	static bool randInitialized;
-	static int randSeed;
+	// Only reads the tracker transforms
+	virtual bool DeclareJoints(std::set<std::string>& joints) const { return true; }
 
+	virtual bool SupportsStreaming() const { return true; }
+	virtual bool BeginStream(TrackerHandle& trackerHandle);
+	virtual bool SampleFrame(float time, Vector3& position, Quaternion& rotation);
+	virtual void EndStream();
+private:
 	virtual BaseTrackingVirtualizer* Clone() const;
+
+	// State of a streamed virtualization between BeginStream and EndStream
+	struct Stream
+	{
+		TrackerHandle* trackerHandle;
+		float sampleCount;
+		float noiseStrength;
+		std::mt19937 random;
+		std::uniform_int_distribution<int> randomValue;
+		// Index of the latest sample and its pose, -1 before the first one
+		int sample = -1;
+		Vector3 position;
+		Quaternion rotation;
+	};
+	std::unique_ptr<Stream> stream;
 };
@@ -1,4 +1,6 @@
 #include "PerfectTrackingVirtualizer.h"
+#include <algorithm>
+#include <cmath>
 
 RegisterVirtualizer<PerfectTrackingVirtualizer> PerfectTrackingVirtualizer::Register;
 
@@ -16,6 +18,10 @@ bool PerfectTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHan
 
 	for (size_t i = 0; i < frameCount + 1; i++)
 	{
+		if (trackerHandle.IsCanceled())
+			return false;
+		trackerHandle.ReportProgress(i / (frameCount + 1));
+
 		float time = i / frameCount;
 		time = std::fmin(time, 1.0f);
 
@@ -32,6 +38,44 @@ bool PerfectTrackingVirtualizer::CreateOutputAnimation(TrackerHandle& trackerHan
 	return true;
 }
 
+bool PerfectTrackingVirtualizer::BeginStream(TrackerHandle& trackerHandle)
+{
+	int samplerate = dynamic_cast<Parameter<int>*>(parameters["SampleRate"])->GetValue();
+	stream.reset(new Stream());
+	stream->trackerHandle = &trackerHandle;
+	stream->sampleCount = trackerHandle.GetAnimationLength() * samplerate;
+	return true;
+}
+
+bool PerfectTrackingVirtualizer::SampleFrame(float time, Vector3& position, Quaternion& rotation)
+{
+	if (!stream)
+		return false;
+
+	// The samples fall onto the times CreateOutputAnimation keys, between them the latest one is held. Its last key is at the end of the clip.
+	float duration = stream->trackerHandle->GetAnimationLength();
+	int sample = (int)std::ceil(stream->sampleCount);
+	if (time < duration)
+		sample = std::min(sample, (int)std::floor(time / duration * stream->sampleCount + 1e-4f));
+	if (sample != stream->sample)
+	{
+		float normalizedTime = stream->sampleCount > 0.0f ? std::fmin(sample / stream->sampleCount, 1.0f) : 0.0f;
+		Matrix transform = stream->trackerHandle->GetTransform(normalizedTime);
+		stream->position = transform.translation();
+		stream->rotation = transform.rotation();
+		stream->sample = sample;
+	}
+
+	position = stream->position;
+	rotation = stream->rotation;
+	return true;
+}
+
+void PerfectTrackingVirtualizer::EndStream()
+{
+	stream.reset();
+}
+
 BaseTrackingVirtualizer* PerfectTrackingVirtualizer::Clone() const
 {
 	return new PerfectTrackingVirtualizer();
@@ -4,6 +4,7 @@
 #include "../../Animation.h"
 #include <string>
 #include <vector>
+#include <memory>
 
 class PerfectTrackingVirtualizer : public BaseTrackingVirtualizer
 {
@@ -13,6 +14,25 @@ public:
 	PerfectTrackingVirtualizer();
 
 	virtual bool CreateOutputAnimation(TrackerHandle& trackerHandle, AnimationCurve& output);
+	// Only reads the tracker transforms
+	virtual bool DeclareJoints(std::set<std::string>& joints) const { return true; }
+
+	virtual bool SupportsStreaming() const { return true; }
+	virtual bool BeginStream(TrackerHandle& trackerHandle);
+	virtual bool SampleFrame(float time, Vector3& position, Quaternion& rotation);
+	virtual void EndStream();
 
 	virtual BaseTrackingVirtualizer* Clone() const;
+private:
+	// State of a streamed virtualization between BeginStream and EndStream
+	struct Stream
+	{
+		TrackerHandle* trackerHandle;
+		float sampleCount;
+		// Index of the latest sample and its pose, -1 before the first one
+		int sample = -1;
+		Vector3 position;
+		Quaternion rotation;
+	};
+	std::unique_ptr<Stream> stream;
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <vector>
 #include "Utils.h"
 #include "QDebug"
+#include <QCoreApplication>
 
 // Singleton
 class EventManager
@@ -23,7 +24,8 @@ public:
 			{
 				for each (std::function<void(T)> function in callback.second)
 				{
-					function(value);
+					if (function)
+						function(value);
 				}
 			}
 		}
@@ -34,10 +36,24 @@ public:
 		for each (std::pair<std::string, std::vector<std::function<void()>>> callback in voidEvents)
 			if (callback.first == eventName)
 				for each (std::function<void()> function in callback.second)
-					function();
+					if (function)
+						function();
 	}
 
-	void SubscribeToEvent(std::string eventName, std::function<void()> callback)
+	// Fires the event on the ui thread once it returns to its event loop, so worker threads can publish results
+	template <typename T>
+	void QueueEvent(std::string eventName, T value)
+	{
+		QMetaObject::invokeMethod(qApp, [this, eventName, value]() { FireEvent(eventName, value); }, Qt::QueuedConnection);
+	}
+
+	void QueueEvent(std::string eventName)
+	{
+		QMetaObject::invokeMethod(qApp, [this, eventName]() { FireEvent(eventName); }, Qt::QueuedConnection);
+	}
+
+	// Returns the slot of the callback, owners that die before the manager unsubscribe with it
+	size_t SubscribeToEvent(std::string eventName, std::function<void()> callback)
 	{
 		// Map already contains event name
 		if (Utils::Contains(voidEvents, eventName))
@@ -52,10 +68,17 @@ public:
 			newEventList->second.push_back(callback);
 			voidEvents.insert(*newEventList);
 		}
+		return voidEvents[eventName].size() - 1;
+	}
+
+	// Slots are only cleared, so the ones of the other subscribers stay valid
+	void UnsubscribeFromEvent(std::string eventName, size_t slot)
+	{
+		voidEvents[eventName][slot] = nullptr;
 	}
 
 	template <typename T>
-	void SubscribeToEvent(std::string eventName, std::function<void(T)> callback)
+	size_t SubscribeToEvent(std::string eventName, std::function<void(T)> callback)
 	{
 		std::map<std::string, std::vector<std::function<void(T)>>>* eventMap = get_listeners<T>();
 
@@ -72,6 +95,13 @@ public:
 			newEventList->second.push_back(callback);
 			eventMap->insert(*newEventList);
 		}
+		return (*eventMap)[eventName].size() - 1;
+	}
+
+	template <typename T>
+	void UnsubscribeFromEvent(std::string eventName, size_t slot)
+	{
+		(*get_listeners<T>())[eventName][slot] = nullptr;
 	}
 private:
 	EventManager();
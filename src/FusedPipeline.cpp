@@ -0,0 +1,137 @@
+#include "FusedPipeline.h"
+#include "StageCache.h"
+#include "JointDependencies.h"
+#include <QDebug>
+
+FusedPipeline::Worker FusedPipeline::CreateWorker(const std::string& modelfile)
+{
+	Worker worker;
+	worker.groundTruthModel = new SkinnedModel(modelfile.c_str(), false);
+	worker.solvedModel = new SkinnedModel(modelfile.c_str(), false);
+	worker.groundTruthAvatar = new Avatar(worker.groundTruthModel);
+	worker.solvedAvatar = new Avatar(worker.solvedModel);
+	worker.groundTruthAnimator = new Animator(*worker.groundTruthModel);
+	worker.solvedAnimator = new Animator(*worker.solvedModel);
+	return worker;
+}
+
+void FusedPipeline::DestroyWorker(Worker& worker)
+{
+	delete worker.groundTruthAnimator;
+	delete worker.solvedAnimator;
+	delete worker.groundTruthAvatar;
+	delete worker.solvedAvatar;
+	delete worker.groundTruthModel;
+	delete worker.solvedModel;
+	worker = Worker();
+}
+
+FusedPipeline::FusedPipeline(const Settings& settings, Worker& worker, RunJournal* journal, const std::string& settingsHash, CancellationToken& token)
+	:
+	settings(settings),
+	worker(worker),
+	journal(journal),
+	settingsHash(settingsHash),
+	token(token),
+	planner(settings.metrics),
+	metricQueue(settings.queueLength),
+	writeQueue(settings.queueLength)
+{
+	// The metric stage only poses the joints the metrics read
+	JointDependencies dependencies;
+	dependencies.AddMetrics(planner, worker.groundTruthAvatar);
+	worker.groundTruthAnimator->SetRequiredJoints(dependencies.GetJoints());
+	worker.solvedAnimator->SetRequiredJoints(dependencies.GetJoints());
+
+	// Every stage drains its queue in one long running job
+	metricPool = new ThreadPool(1);
+	metricPool->Enqueue([this](int) { RunMetricStage(); });
+	writerPool = new ThreadPool(1);
+	writerPool->Enqueue([this](int) { RunWriterStage(); });
+}
+
+FusedPipeline::~FusedPipeline()
+{
+	Finish();
+}
+
+std::shared_ptr<FusedPipeline::Clip> FusedPipeline::Submit(Animation* groundTruth, Animation* solved, const std::string& truthPath, const std::string& inputHash, const std::string& solvedPath, const std::string& cacheKey)
+{
+	std::shared_ptr<Clip> clip = std::make_shared<Clip>();
+	clip->truthPath = truthPath;
+	clip->solvedPath = solvedPath;
+	clip->name = groundTruth->name;
+
+	// Both stages share the solved clip, it is freed once the last of them is done with it
+	std::shared_ptr<Animation> solvedShared(solved);
+	if (!solvedPath.empty())
+		writeQueue.Push(WriteJob { truthPath, inputHash, solvedPath, cacheKey, solvedShared });
+
+	metricQueue.Push(MetricJob { clip, std::shared_ptr<Animation>(groundTruth), solvedShared });
+	return clip;
+}
+
+void FusedPipeline::Finish()
+{
+	if (finished)
+		return;
+	finished = true;
+
+	// Closed queues let the stages drain what is left and return
+	metricQueue.Close();
+	writeQueue.Close();
+	delete metricPool;
+	metricPool = nullptr;
+	delete writerPool;
+	writerPool = nullptr;
+
+	if (keptMemory > 0)
+		qDebug() << "Fused pipeline: Kept solved clips take" << keptCompressedMemory / 1024 << "kB instead of" << keptMemory / 1024 << "kB";
+}
+
+void FusedPipeline::RunMetricStage()
+{
+	MetricJob job;
+	while (metricQueue.Pop(job))
+	{
+		// Clips left over after an abort are dropped
+		if (!token.IsCanceled())
+		{
+			worker.groundTruthAnimator->SetAnimation(job.groundTruth.get());
+			worker.solvedAnimator->SetAnimation(job.solved.get());
+
+			planner.Evaluate(
+				*worker.groundTruthAnimator, *worker.groundTruthModel, worker.groundTruthAvatar,
+				*worker.solvedAnimator, *worker.solvedModel, worker.solvedAvatar,
+				settings.metricSampleRate, job.clip->timestamps, job.clip->metricResults);
+			job.clip->evaluated = true;
+
+			// Clips which are not written stay in memory for playback until the next run
+			if (job.clip->solvedPath.empty())
+			{
+				job.clip->solved.reset(CompressedAnimation::Compress(*job.solved));
+				keptMemory += CompressedAnimation::GetMemoryUsage(*job.solved);
+				keptCompressedMemory += job.clip->solved->GetMemoryUsage();
+			}
+
+			// The animations are owned by the job, not by the animators
+			worker.groundTruthAnimator->RemoveAnimation(false);
+			worker.solvedAnimator->RemoveAnimation(false);
+		}
+		job = MetricJob();
+	}
+}
+
+void FusedPipeline::RunWriterStage()
+{
+	WriteJob job;
+	while (writeQueue.Pop(job))
+	{
+		Animation::SaveToPath(settings.modelfile, *job.solved, job.solvedPath);
+		if (!job.cacheKey.empty())
+			StageCache::instance().StoreFile("solved", job.cacheKey, job.solvedPath);
+		if (journal)
+			journal->CompleteStage(job.truthPath, "solved", job.inputHash, settingsHash, QJsonObject { { "path", job.solvedPath.c_str() } });
+		job = WriteJob();
+	}
+}
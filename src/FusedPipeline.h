@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include "Animation.h"
+#include "Animator.h"
+#include "CompressedAnimation.h"
+#include "AvatarSystem/Avatar.h"
+#include "BoundedQueue.h"
+#include "CancellationToken.h"
+#include "RunJournal.h"
+#include "ThreadPool.h"
+#include "Customizable/ErrorMetrics/BaseErrorMetric.h"
+#include "Customizable/ErrorMetrics/MetricEvaluationPlanner.h"
+
+// Hands the solved clips of a generation run straight to the error metrics, instead of writing them to disk and
+// importing them again for the comparison. The metrics run on a thread of their own while the solver goes on
+// with the next clip. Writing the solved clips is optional and happens on another thread.
+// The queues between the stages bound how many clips are held in memory at once.
+class FusedPipeline
+{
+public:
+	// Skeletons of the metric stage, created on the ui thread since loading models needs the GL context
+	struct Worker
+	{
+		SkinnedModel* groundTruthModel = nullptr;
+		SkinnedModel* solvedModel = nullptr;
+		Avatar* groundTruthAvatar = nullptr;
+		Avatar* solvedAvatar = nullptr;
+		Animator* groundTruthAnimator = nullptr;
+		Animator* solvedAnimator = nullptr;
+	};
+
+	// A clip going through the stages, complete once Finish returned
+	struct Clip
+	{
+		std::string truthPath;
+		// Empty if the clip is not written
+		std::string solvedPath;
+		// Only kept for playback if the clip is not written, compressed since a batch holds all of them at once
+		std::shared_ptr<CompressedAnimation> solved;
+		bool evaluated = false;
+		std::string name;
+		std::vector<double> timestamps;
+		// Indexed like the metrics of the settings
+		std::vector<std::vector<float>> metricResults;
+	};
+
+	struct Settings
+	{
+		std::vector<BaseErrorMetric*> metrics;
+		int metricSampleRate = 0;
+		std::string modelfile;
+		// Clips waiting for a stage before the solver blocks
+		int queueLength = 2;
+	};
+
+	static Worker CreateWorker(const std::string& modelfile);
+	static void DestroyWorker(Worker& worker);
+
+	// The journal records the written clips, it may be null
+	FusedPipeline(const Settings& settings, Worker& worker, RunJournal* journal, const std::string& settingsHash, CancellationToken& token);
+	~FusedPipeline();
+
+	/// <summary>
+	/// Passes a solved clip on to the metric and writer stages. Blocks while the metric stage is a full queue behind.
+	/// </summary>
+	/// <param name="groundTruth">The pipeline takes ownership of both clips</param>
+	/// <param name="solvedPath">Where the solved clip gets written, empty keeps it in memory only</param>
+	/// <param name="cacheKey">Stage cache key of the solved clip, empty if it must not be cached</param>
+	/// <returns>The clip, its results are filled in by the time Finish returns</returns>
+	std::shared_ptr<Clip> Submit(Animation* groundTruth, Animation* solved, const std::string& truthPath, const std::string& inputHash, const std::string& solvedPath, const std::string& cacheKey);
+	// Waits until every submitted clip went through all stages
+	void Finish();
+private:
+	FusedPipeline(const FusedPipeline&);
+
+	struct MetricJob
+	{
+		std::shared_ptr<Clip> clip;
+		std::shared_ptr<Animation> groundTruth;
+		std::shared_ptr<Animation> solved;
+	};
+
+	struct WriteJob
+	{
+		std::string truthPath;
+		std::string inputHash;
+		std::string solvedPath;
+		std::string cacheKey;
+		std::shared_ptr<Animation> solved;
+	};
+
+	void RunMetricStage();
+	void RunWriterStage();
+
+	Settings settings;
+	Worker& worker;
+	RunJournal* journal;
+	std::string settingsHash;
+	CancellationToken& token;
+	MetricEvaluationPlanner planner;
+
+	BoundedQueue<MetricJob> metricQueue;
+	BoundedQueue<WriteJob> writeQueue;
+	// One thread per stage
+	ThreadPool* metricPool = nullptr;
+	ThreadPool* writerPool = nullptr;
+	bool finished = false;
+	// Memory of the clips kept for playback, as solved and as held, written by the metric stage
+	size_t keptMemory = 0;
+	size_t keptCompressedMemory = 0;
+};
@@ -0,0 +1,26 @@
+#include "JointDependencies.h"
+
+void JointDependencies::AddTracker(const Tracker* tracker, SkinnedModel& model)
+{
+	if (tracker && tracker->GetModel())
+		tracker->GetModel()->GetAttachedJointNames(model, joints);
+}
+
+void JointDependencies::AddVirtualizer(const BaseTrackingVirtualizer* virtualizer)
+{
+	if (!virtualizer->DeclareJoints(joints))
+		allJoints = true;
+}
+
+void JointDependencies::AddMetrics(const MetricEvaluationPlanner& planner, Avatar* avatar)
+{
+	if (!planner.GetRequiredJoints(avatar, joints))
+		allJoints = true;
+}
+
+std::set<std::string> JointDependencies::GetJoints() const
+{
+	if (allJoints)
+		return std::set<std::string>();
+	return joints;
+}
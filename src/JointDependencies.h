@@ -0,0 +1,29 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include "Tracker.h"
+#include "AvatarSystem/Avatar.h"
+#include "Customizable/TrackingVirtualizers/BaseTrackingVirtualizer.h"
+#include "Customizable/ErrorMetrics/MetricEvaluationPlanner.h"
+
+// Collects the joints a run reads from the animated skeleton: the joints under the attached trackers, the joints
+// virtualizers read directly and the joints the metrics declare. Animators restricted to them skip the rest of the
+// rig, like the face and finger joints. The kernels only read the tracker curves and the bind pose, so they add none.
+class JointDependencies
+{
+public:
+	JointDependencies() : allJoints(false) {}
+
+	// The model is the one the tracker is attached to, or another one of the same rig
+	void AddTracker(const Tracker* tracker, SkinnedModel& model);
+	void AddVirtualizer(const BaseTrackingVirtualizer* virtualizer);
+	void AddMetrics(const MetricEvaluationPlanner& planner, Avatar* avatar);
+
+	// Empty if every joint is needed, which is what Animator::SetRequiredJoints expects
+	std::set<std::string> GetJoints() const;
+	bool NeedsAllJoints() const { return allJoints; }
+private:
+	bool allJoints;
+	std::set<std::string> joints;
+};
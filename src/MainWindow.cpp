@@ -6,7 +6,16 @@
 #include "Customizable/InverseKinematicsKernels/BaseIKKernel.h"
 #include "Customizable/ErrorMetrics/BaseErrorMetric.h"
 #include "ResultsWindow.h"
+#include "PipelineOptions.h"
+#include "AnimationChunkReader.h"
+#include "RunJournal.h"
+#include "StageCache.h"
+#include "JointDependencies.h"
+#include <QJsonArray>
+#include "QJsonSerializer.h"
+#include <algorithm>
 #include <filesystem>
+#include <mutex>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 {
@@ -27,6 +36,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 	EventManager::instance().SubscribeToEvent("SetProgressSliderValue", floatCallback);
 	std::function<void(std::string)> stringCallback = std::function([this](std::string value) { return this->OnLoadCharacterButtonPressed(value); });
 	EventManager::instance().SubscribeToEvent("OnLoadCharacterButtonPressed", stringCallback);
+	std::function<void(GenerationProgress)> progressCallback = std::function([this](GenerationProgress value) { return this->OnGenerationProgress(value); });
+	EventManager::instance().SubscribeToEvent("OnGenerationProgress", progressCallback);
+	std::function<void(GenerationResult)> resultCallback = std::function([this](GenerationResult value) { return this->OnGenerationFinished(value); });
+	EventManager::instance().SubscribeToEvent("OnGenerationFinished", resultCallback);
+	std::function<void(ParameterSweep::Results)> sweepCallback = std::function([this](ParameterSweep::Results value) { return this->OnSweepFinished(value); });
+	EventManager::instance().SubscribeToEvent("OnSweepFinished", sweepCallback);
 
 	OpenGLWindow* openGLWindow = static_cast<OpenGLWindow*>(ui.openGLWindow);
 	setupScene = new SetupScene();
@@ -43,20 +58,41 @@ MainWindow::~MainWindow()
 	qDebug() << "DESTRUCTOR CALLED";
 }
 
-bool MainWindow::GenerateTrackingVirtualizerAnimations(Animator& animator, const Animation& groundTruthAnimation, std::map<std::string, AnimationCurve>& result)
+bool MainWindow::GenerateTrackingVirtualizerAnimations(Animator& animator, const Animation& groundTruthAnimation, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers, const std::vector<std::string>& cacheKeys, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd, std::map<std::string, AnimationCurve>& result, const std::vector<TrackerTrajectory*>& trajectories)
 {
 	// Create tracking virtualizer animations
-	for (TrackingVirtualizerListItem* widget : ui.trackerList->itemWidgets)
+	float stageLength = (stageEnd - stageStart) / std::max<size_t>(1, virtualizers.size());
+	for (size_t i = 0; i < virtualizers.size(); ++i)
 	{
+		const GenerationSettings::VirtualizerSlot& virtualizerSlot = virtualizers[i];
+		token.BeginStage(stagePrefix + "Virtualizing " + virtualizerSlot.slot, stageStart + i * stageLength, stageStart + (i + 1) * stageLength);
+
 		animator.GetModel()->SetDefaultPose();
-		BaseTrackingVirtualizer* virtualizerToUse = widget->GetVirtualizer();
+		BaseTrackingVirtualizer* virtualizerToUse = virtualizerSlot.virtualizer;
 
-		TrackerHandle trackerHandle = TrackerHandle(&animator, widget->tracker, widget->solveSlotComboBox->currentText().toStdString());
+		TrackerHandle trackerHandle = TrackerHandle(&animator, virtualizerSlot.tracker, virtualizerSlot.slot, &token, i < trajectories.size() ? trajectories[i] : nullptr);
 
-		std::string solveSlotName = widget->solveSlotComboBox->currentText().toStdString();
+		std::string solveSlotName = virtualizerSlot.slot;
 		qDebug() << "Solveslot name: " << solveSlotName.c_str();
+
+		// Reuse the curve of an earlier run with the same inputs
+		std::string cacheKey = i < cacheKeys.size() ? cacheKeys[i] : "";
 		AnimationCurve trackerAnimationCurve;
+		QByteArray cachedCurve;
+		if (!cacheKey.empty() && StageCache::instance().Load("virtualizer", cacheKey, cachedCurve) && StageCache::DeserializeCurve(cachedCurve, trackerAnimationCurve))
+		{
+			trackerAnimationCurve.name = solveSlotName;
+			result[solveSlotName] = trackerAnimationCurve;
+			continue;
+		}
+
 		bool success = virtualizerToUse->CreateOutputAnimation(trackerHandle, trackerAnimationCurve);
+		if (token.IsCanceled())
+			return false;
+
+		if (success && !cacheKey.empty())
+			StageCache::instance().Store("virtualizer", cacheKey, StageCache::SerializeCurve(trackerAnimationCurve));
+
 		if (success)
 		{
 			trackerAnimationCurve.name = solveSlotName;
@@ -102,115 +138,811 @@ void MainWindow::SkipIKSolver(const std::string& affix, std::string& modelfile,
 	SkinnedModel* model = animator->GetModel();
 	modelfile = model->getPath();
 
-	int counter = 0;
-	std::string dir = "";
+	if (animationPaths.empty())
+		return;
+
+	std::string dir = std::filesystem::path(animationPaths[0]).parent_path().string() + "/../animations_solved_" + affix + "/";
+	RunJournal journal(dir);
 	for (std::string path : animationPaths)
 	{
-		Animation* groundTruthAnimation = Animation::LoadFromPath(path);
-
-		if (counter == 0)
-			dir = groundTruthAnimation->path + "../animations_solved_" + affix + "/";
+		// Runs with a journal know which clips got solved and where they went
+		QJsonObject solvedStage;
+		if (journal.FindStage(path, "solved", RunJournal::HashFile(path), journal.GetSettingsHash(), solvedStage))
+		{
+			solvedAnimationPaths.push_back(solvedStage["path"].toString().toStdString());
+			truthAnimationPaths.push_back(path);
+			continue;
+		}
+		if (journal.Exists())
+			continue;
 
-		std::string solvedPath = dir + groundTruthAnimation->filename;
+		std::string solvedPath = dir + std::filesystem::path(path).filename().string();
 		solvedAnimationPaths.push_back(solvedPath);
 		truthAnimationPaths.push_back(path);
 	}
 }
 
-void MainWindow::GenerateAnimations(std::string& modelfile, std::vector<std::string>& solvedAnimationPaths, std::vector<std::string>& truthAnimationPaths)
+void MainWindow::GenerateAnimations(const GenerationSettings& settings, CancellationToken& token, GenerationResult& result)
 {
 	qDebug() << "Generate Animations";
-	std::vector<std::string> animationPaths = ui.animationList->GetSelectedAnimationPaths();
-	SetupScene* currentScene = dynamic_cast<SetupScene*>(ui.openGLWindow->GetCurrentScene());
-	if (!currentScene)
+	Animator* animator = settings.animator;
+	SkinnedModel* model = animator->GetModel();
+	result.modelfile = settings.modelfile;
+
+	BaseIKKernel* usedKernel = settings.kernel;
+	usedKernel->SetCancellationToken(&token);
+
+	std::map<std::string, TrackerConfidence> confidences;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		confidences[virtualizerSlot.slot] = virtualizerSlot.virtualizer->GetConfidence();
+	usedKernel->SetInputConfidences(confidences);
+
+	int numFiles = settings.animationPaths.size();
+	if (numFiles == 0)
 		return;
 
-	Animator* animator = currentScene->GetAnimator();
-	SkinnedModel* model = animator->GetModel();
-	modelfile = model->getPath();
-	std::map<std::string, Tracker*> trackers = currentScene->GetTrackers();
+	// The skeletons of the virtualizers only pose the joints under the trackers and the joints the virtualizers read
+	JointDependencies dependencies;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+	{
+		dependencies.AddTracker(virtualizerSlot.tracker, *model);
+		dependencies.AddVirtualizer(virtualizerSlot.virtualizer);
+	}
+	std::set<std::string> requiredJoints = dependencies.GetJoints();
+	animator->SetRequiredJoints(requiredJoints);
+	if (settings.chunkWorkers)
+	{
+		for (ChunkWorker& worker : *settings.chunkWorkers)
+			worker.animator->SetRequiredJoints(requiredJoints);
+	}
+
+	// Resume an interrupted run with the same settings, otherwise start a fresh one
+	std::string parentDir = std::filesystem::path(settings.animationPaths[0]).parent_path().string() + "/../";
+	std::string dir = RunJournal::FindUnfinishedRun(parentDir, "animations_solved_", settings.settingsHash);
+	if (dir.empty())
+	{
+		std::stringstream ss;
+		ss << time(nullptr);
+		dir = parentDir + "animations_solved_" + ss.str() + "/";
+		if (!std::filesystem::exists(dir))
+			std::filesystem::create_directory(dir);
+	}
+	else
+	{
+		qDebug() << "Resuming run in" << dir.c_str();
+	}
+
+	RunJournal journal(dir);
+	journal.Begin(settings.settingsHash);
 
-	int numFiles = animationPaths.size();
-	QProgressDialog progress("Starting comparision process..", "Abort", 0, numFiles, this);
-	progress.setWindowModality(Qt::WindowModal);
+	// Every stage output depends on the character
+	std::string modelHash = StageCache::instance().IsEnabled() ? RunJournal::HashFile(settings.modelfile) : "";
 
+	// Solved clips are evaluated in memory while the next one gets solved
+	FusedPipeline* fusedPipeline = nullptr;
+	if (settings.fusedWorker)
+	{
+		FusedPipeline::Settings fusedSettings;
+		fusedSettings.metrics = settings.metrics;
+		fusedSettings.metricSampleRate = settings.metricSampleRate;
+		fusedSettings.modelfile = settings.modelfile;
+		fusedSettings.queueLength = PipelineOptions::instance().pipelineQueueLength;
+		fusedPipeline = new FusedPipeline(fusedSettings, *settings.fusedWorker, &journal, settings.settingsHash, token);
+	}
 
-	BaseIKKernel* usedKernel = BaseIKKernel::registry()[ui.ikKernelComboBox->currentIndex()];
+	// Whole clips are virtualized and solved frame by frame if asked for and every stage can
+	bool solveStreamed = PipelineOptions::instance().streamedSolve && CanSolveStreamed(settings);
+	if (PipelineOptions::instance().streamedSolve && !solveStreamed)
+		qDebug() << "Solving whole clips at once, the kernel or a virtualizer can not stream";
 
 	int counter = 0;
-	std::string dir = "";
-	for (std::string path : animationPaths)
+	for (const std::string& path : settings.animationPaths)
 	{
-		// Load ground truth animation
-		Animation* groundTruthAnimation = Animation::LoadFromPath(path);
-		animator->SetAnimation(groundTruthAnimation);
+		if (token.IsCanceled())
+			break;
 
-		if (counter == 0)
+		// Clips solved by an earlier attempt of this run are kept, as long as the ground truth did not change
+		std::string inputHash = RunJournal::HashFile(path);
+		QJsonObject solvedStage;
+		if (journal.FindStage(path, "solved", inputHash, settings.settingsHash, solvedStage))
 		{
-			time_t seconds = time(nullptr);
-			std::stringstream ss;
-			ss << seconds;
-			std::string ts = ss.str();
+			std::string solvedPath = solvedStage["path"].toString().toStdString();
+			if (std::filesystem::exists(solvedPath))
+			{
+				result.solvedAnimationPaths.push_back(solvedPath);
+				result.truthAnimationPaths.push_back(path);
+				counter++;
+				continue;
+			}
+		}
+
+		// Every animation gets an equal share of the progress
+		float animationStart = counter / (float)numFiles;
+		float animationLength = 1.0f / numFiles;
+		auto progressAt = [&](float animationProgress) { return animationStart + animationProgress * animationLength; };
+
+		// Long captures get virtualized and solved in chunks
+		const PipelineOptions& options = PipelineOptions::instance();
+		std::unique_ptr<AnimationChunkReader> chunkReader;
+		if (options.streamingChunkLength > 0.0)
+		{
+			chunkReader.reset(new AnimationChunkReader(path));
+			const AnimationChunkReader& reader = *chunkReader;
+			if (reader.IsValid() && options.UseStreaming(reader.GetDuration()))
+			{
+				std::stringstream ss;
+				ss << "Animation " << counter + 1 << "/" << numFiles << ": " << reader.GetName() << " (streamed) - ";
+				std::string stagePrefix = ss.str();
+				counter++;
+
+				std::vector<Animation*> solvedSegments = SolveAnimationChunked(reader, settings, token, stagePrefix, progressAt(0.0f), progressAt(0.95f));
+				if (solvedSegments.empty())
+					continue;
+
+				token.BeginStage(stagePrefix + "Saving", progressAt(0.95f), progressAt(1.0f));
+				std::string solvedPath = dir + reader.GetFilename();
+				Animation::SaveToPath(settings.modelfile, std::vector<const Animation*>(solvedSegments.begin(), solvedSegments.end()), solvedPath);
+				for (Animation* segment : solvedSegments)
+					delete segment;
+				journal.CompleteStage(path, "solved", inputHash, settings.settingsHash, QJsonObject { { "path", solvedPath.c_str() } });
+
+				result.solvedAnimationPaths.push_back(solvedPath);
+				result.truthAnimationPaths.push_back(path);
+				continue;
+			}
+		}
 
-			dir = groundTruthAnimation->path + "../animations_solved_" + ts + "/";
-			if (!std::filesystem::exists(dir))
-				std::filesystem::create_directory(dir);
+		// A clip solved with the same inputs before is only copied from the cache
+		std::vector<std::string> virtualizerKeys;
+		std::string solvedKey = GetStageCacheKeys(settings, inputHash, modelHash, virtualizerKeys);
+		std::string solvedPath = dir + Utils::FilenameFromPath(path, true, "/\\");
+		if (!solvedKey.empty() && StageCache::instance().LoadFile("solved", solvedKey, solvedPath))
+		{
+			journal.CompleteStage(path, "solved", inputHash, settings.settingsHash, QJsonObject { { "path", solvedPath.c_str() } });
+			result.solvedAnimationPaths.push_back(solvedPath);
+			result.truthAnimationPaths.push_back(path);
+			counter++;
+			continue;
+		}
+
+		std::stringstream loadingStage;
+		loadingStage << "Animation " << counter + 1 << "/" << numFiles << ": Loading " << path;
+		token.BeginStage(loadingStage.str(), progressAt(0.0f), progressAt(0.05f));
+
+		// Load ground truth animation, a short capture is converted from the scene read for its duration
+		Animation* groundTruthAnimation = chunkReader && chunkReader->IsValid() ? chunkReader->ReadAll() : Animation::LoadFromPath(path);
+		chunkReader.reset();
+		if (!groundTruthAnimation)
+		{
+			counter++;
+			continue;
 		}
 
 		std::stringstream ss;
-		ss << "Animation " << counter << "/" << numFiles << ": " << groundTruthAnimation->name;
-		progress.setLabelText(ss.str().c_str());
-		progress.setValue(counter);
-		ss.clear();
+		ss << "Animation " << counter + 1 << "/" << numFiles << ": " << groundTruthAnimation->name << " - ";
+		std::string stagePrefix = ss.str();
 
 		counter++;
 
-		if (progress.wasCanceled())
-			break;
-
 		animator->SetAnimation(groundTruthAnimation);
 
-		qDebug() << "Generate Tracker Animations";
-		std::map<std::string, AnimationCurve> trackerCurves;
-		bool success = GenerateTrackingVirtualizerAnimations(*animator, *groundTruthAnimation, trackerCurves);
+		Animation* solvedAnimation = nullptr;
+		if (solveStreamed)
+		{
+			token.BeginStage(stagePrefix + "Solving streamed", progressAt(0.05f), progressAt(0.95f));
+			solvedAnimation = SolveAnimationStreamed(*animator, *groundTruthAnimation, settings, token);
+		}
+		else
+		{
+			qDebug() << "Generate Tracker Animations";
+			std::map<std::string, AnimationCurve> trackerCurves;
+			std::vector<TrackerTrajectory*> trajectories = SampleTrackerTrajectories(*animator, settings.virtualizers);
+			bool success = GenerateTrackingVirtualizerAnimations(*animator, *groundTruthAnimation, settings.virtualizers, virtualizerKeys, token, stagePrefix, progressAt(0.05f), progressAt(0.7f), trackerCurves, trajectories);
+			for (TrackerTrajectory* trajectory : trajectories)
+				delete trajectory;
+
+			if (!success)
+			{
+				animator->RemoveAnimation(true);
+				continue;
+			}
+
+			qDebug() << "Combine Tracker Animations";
+			Animation* trackerAnimation = CombineTrackerAnimations(*groundTruthAnimation, trackerCurves);
+			trackerCurves.clear();
+			qDebug() << "Solve Animation";
+
+			// Let the IK solver do its job
+			token.BeginStage(stagePrefix + "Solving", progressAt(0.7f), progressAt(0.95f));
+			animator->GetModel()->SetDefaultPose();
+			solvedAnimation = usedKernel->Solve(*groundTruthAnimation, settings.trackers, *model, *trackerAnimation);
+			delete trackerAnimation;
+		}
 
-		if (!success)
+		if (!solvedAnimation || token.IsCanceled())
 		{
 			animator->RemoveAnimation(true);
+			delete solvedAnimation;
 			continue;
 		}
 
-		qDebug() << "Combine Tracker Animations";
-		Animation* trackerAnimation = CombineTrackerAnimations(*groundTruthAnimation, trackerCurves);
-		trackerCurves.clear();
-		qDebug() << "Solve Animation";
-
-		// Let the IK solver do its job
-		animator->GetModel()->SetDefaultPose();
-		Animation* solvedAnimation = usedKernel->Solve(*groundTruthAnimation, trackers, *model, *trackerAnimation);
+		if (fusedPipeline)
+		{
+			// The pipeline owns both clips from here on and writes the solved one if asked to
+			animator->RemoveAnimation(false);
+			std::string fusedSolvedPath = PipelineOptions::instance().writeSolvedAnimations ? solvedPath : "";
+			result.fusedClips[path] = fusedPipeline->Submit(groundTruthAnimation, solvedAnimation, path, inputHash, fusedSolvedPath, solvedKey);
+			result.solvedAnimationPaths.push_back(fusedSolvedPath);
+			result.truthAnimationPaths.push_back(path);
+			continue;
+		}
 
-		std::string solvedPath = dir + groundTruthAnimation->filename;
-		Animation::SaveToPath(path, *solvedAnimation, solvedPath);
+		token.BeginStage(stagePrefix + "Saving", progressAt(0.95f), progressAt(1.0f));
+		Animation::SaveToPath(settings.modelfile, *solvedAnimation, solvedPath);
+		if (!solvedKey.empty())
+			StageCache::instance().StoreFile("solved", solvedKey, solvedPath);
 
 		// Delete ground truth and solved animation from memory
 		animator->RemoveAnimation(true); //handles gt destruction
 		delete solvedAnimation;
+		journal.CompleteStage(path, "solved", inputHash, settings.settingsHash, QJsonObject { { "path", solvedPath.c_str() } });
 
-		solvedAnimationPaths.push_back(solvedPath);
-		truthAnimationPaths.push_back(path);
+		result.solvedAnimationPaths.push_back(solvedPath);
+		result.truthAnimationPaths.push_back(path);
+	}
+
+	usedKernel->SetCancellationToken(nullptr);
+	animator->SetRequiredJoints(std::set<std::string>());
+
+	// Waits for the clips still in the metric and writer stages
+	delete fusedPipeline;
+	result.canceled = token.IsCanceled();
+
+	// Only an aborted run gets resumed
+	if (!result.canceled)
+		journal.Finish();
+}
+
+std::string MainWindow::GetStageCacheKeys(const GenerationSettings& settings, const std::string& animationHash, const std::string& modelHash, std::vector<std::string>& virtualizerKeys)
+{
+	virtualizerKeys.assign(settings.virtualizers.size(), "");
+	StageCache& cache = StageCache::instance();
+	if (!cache.IsEnabled())
+		return "";
+
+	QJsonObject clipInputs;
+	clipInputs.insert("animation", animationHash.c_str());
+	clipInputs.insert("model", modelHash.c_str());
+	clipInputs.insert("pipeline", PipelineOptions::instance().GetProcessingSettings());
+
+	// The solved clip depends on every tracker curve, so it is only cached if they all are
+	bool cacheSolved = settings.kernel->IsDeterministic();
+	QJsonArray virtualizerKeyArray;
+	for (size_t i = 0; i < settings.virtualizers.size(); ++i)
+	{
+		const GenerationSettings::VirtualizerSlot& virtualizerSlot = settings.virtualizers[i];
+		if (!virtualizerSlot.virtualizer->IsDeterministic())
+		{
+			cacheSolved = false;
+			continue;
+		}
+
+		QJsonObject inputs = clipInputs;
+		inputs.insert("tracker", virtualizerSlot.settings);
+		virtualizerKeys[i] = cache.GetKey("virtualizer", inputs);
+		virtualizerKeyArray.append(virtualizerKeys[i].c_str());
+	}
+
+	if (!cacheSolved)
+		return "";
+
+	QJsonObject inputs = clipInputs;
+	inputs.insert("virtualizers", virtualizerKeyArray);
+	inputs.insert("kernel", settings.kernelSettings);
+	return cache.GetKey("solved", inputs);
+}
+
+std::vector<Animation*> MainWindow::SolveAnimationChunked(const AnimationChunkReader& reader, const GenerationSettings& settings, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd)
+{
+	const PipelineOptions& options = PipelineOptions::instance();
+	double duration = reader.GetDuration();
+
+	std::vector<double> chunkStarts;
+	for (double chunkStart = 0.0; chunkStart < duration; chunkStart += options.streamingChunkLength)
+		chunkStarts.push_back(chunkStart);
+	int chunkCount = chunkStarts.size();
+	auto chunkEndAt = [&](int chunk) { return std::min(chunkStarts[chunk] + options.streamingChunkLength, duration); };
+	// Start early, so noise filters and the solver have settled once the chunk starts
+	auto chunkFromAt = [&](int chunk) { return std::max(0.0, chunkStarts[chunk] - options.streamingChunkOverlap); };
+
+	// Solved chunks in chunk local time, starting at their warm up
+	std::vector<Animation*> solvedChunks(chunkCount, nullptr);
+	if (settings.chunkWorkers && chunkCount > 1)
+	{
+		// The warm up makes the chunks independent of each other, so every worker solves its own
+		std::vector<ChunkWorker>& workers = *settings.chunkWorkers;
+		token.BeginStage(stagePrefix + "Solving " + std::to_string(chunkCount) + " chunks", stageStart, stageEnd);
+		std::mutex progressMutex;
+		int finishedChunks = 0;
+
+		ThreadPool pool(workers.size());
+		for (int chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			pool.Enqueue([&, chunk](int workerIndex)
+			{
+				ChunkWorker& worker = workers[workerIndex];
+				CancellationToken chunkToken(&token);
+				worker.kernel->SetCancellationToken(&chunkToken);
+				solvedChunks[chunk] = SolveChunk(reader, chunkFromAt(chunk), chunkEndAt(chunk), *worker.animator, worker.virtualizers, *worker.kernel, settings.trackers, chunkToken, stagePrefix, 0.0f, 1.0f);
+				worker.kernel->SetCancellationToken(nullptr);
+
+				std::lock_guard<std::mutex> lock(progressMutex);
+				token.ReportProgress(++finishedChunks / (float)chunkCount);
+			});
+		}
+		pool.Wait();
+	}
+	else
+	{
+		for (int chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			// The chunks share the progress range by their length
+			float chunkProgressStart = stageStart + (stageEnd - stageStart) * (float)(chunkStarts[chunk] / duration);
+			float chunkProgressEnd = stageStart + (stageEnd - stageStart) * (float)(chunkEndAt(chunk) / duration);
+			solvedChunks[chunk] = SolveChunk(reader, chunkFromAt(chunk), chunkEndAt(chunk), *settings.animator, settings.virtualizers, *settings.kernel, settings.trackers, token, stagePrefix, chunkProgressStart, chunkProgressEnd);
+			if (!solvedChunks[chunk])
+				break;
+		}
+	}
+
+	bool complete = !token.IsCanceled() && std::find(solvedChunks.begin(), solvedChunks.end(), nullptr) == solvedChunks.end();
+	std::vector<Animation*> solvedSegments;
+	for (int chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		Animation* solvedChunk = solvedChunks[chunk];
+		if (!complete)
+		{
+			delete solvedChunk;
+			continue;
+		}
+
+		// Keep the keys of the chunk itself in chunk local time, the warm up is dropped. The next chunk starts where this one ends.
+		double from = chunkFromAt(chunk);
+		double chunkLocalStart = chunkStarts[chunk] - from;
+		double chunkLocalEnd = chunkEndAt(chunk) - from;
+		bool lastChunk = chunk == chunkCount - 1;
+		auto inChunk = [&](float time) { return time >= chunkLocalStart && (lastChunk || time < chunkLocalEnd); };
+
+		Animation* segment = new Animation();
+		segment->name = reader.GetName();
+		segment->filename = reader.GetFilename();
+		segment->duration = chunkLocalEnd;
+		segment->timeOffset = from;
+		for (const auto& kv : solvedChunk->animNodeMapping)
+		{
+			const AnimationCurve& chunkCurve = kv.second;
+			AnimationCurve& curve = segment->animNodeMapping[kv.first];
+			curve.name = chunkCurve.name;
+
+			for (const AnimationCurve::VectorAnimationKey& key : chunkCurve.positions)
+				if (inChunk(key.time))
+					curve.positions.push_back(key);
+			for (const AnimationCurve::QuaternionAnimationKey& key : chunkCurve.rotations)
+				if (inChunk(key.time))
+					curve.rotations.push_back(key);
+			for (const AnimationCurve::VectorAnimationKey& key : chunkCurve.scalings)
+				if (inChunk(key.time))
+					curve.scalings.push_back(key);
+		}
+		solvedSegments.push_back(segment);
+
+		delete solvedChunk;
 	}
 
-	progress.setValue(numFiles);
+	return solvedSegments;
+}
+
+std::vector<TrackerTrajectory*> MainWindow::SampleTrackerTrajectories(Animator& animator, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers)
+{
+	// A grid every virtualizer samples on exactly, as long as it stays small
+	std::vector<int> rates;
+	std::vector<const Tracker*> slotTrackers;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : virtualizers)
+	{
+		rates.push_back(virtualizerSlot.virtualizer->GetInputSampleRate());
+		slotTrackers.push_back(virtualizerSlot.tracker);
+	}
+	int trajectoryRate = TrackerTrajectory::GetCommonSampleRate(rates, PipelineOptions::instance().maxResampleRate);
+	return TrackerTrajectory::SampleAll(animator, slotTrackers, trajectoryRate);
+}
+
+bool MainWindow::CanSolveStreamed(const GenerationSettings& settings)
+{
+	if (!settings.kernel->SupportsStreaming())
+		return false;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		if (!virtualizerSlot.virtualizer->SupportsStreaming())
+			return false;
+	return true;
+}
+
+Animation* MainWindow::SolveAnimationStreamed(Animator& animator, const Animation& groundTruthAnimation, const GenerationSettings& settings, CancellationToken& token)
+{
+	// The trackers are polled on the skeleton of the animator as the frames come, nothing is sampled ahead
+	animator.GetModel()->SetDefaultPose();
+	std::vector<TrackerHandle> handles;
+	handles.reserve(settings.virtualizers.size());
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		handles.push_back(TrackerHandle(&animator, virtualizerSlot.tracker, virtualizerSlot.slot, &token));
+
+	// The samples are ordered like the inputs of the kernel, inputs without a virtualizer stay invalid
+	std::vector<std::string> inputNames = settings.kernel->InputNames();
+	std::vector<int> inputVirtualizers(inputNames.size(), -1);
+	bool started = true;
+	for (size_t i = 0; i < settings.virtualizers.size(); ++i)
+	{
+		auto input = std::find(inputNames.begin(), inputNames.end(), settings.virtualizers[i].slot);
+		if (input != inputNames.end())
+			inputVirtualizers[input - inputNames.begin()] = i;
+		started = settings.virtualizers[i].virtualizer->BeginStream(handles[i]) && started;
+	}
+
+	Animation* solvedAnimation = nullptr;
+	if (started)
+	{
+		solvedAnimation = settings.kernel->SolveStreamed(groundTruthAnimation, settings.trackers, *animator.GetModel(), [&](float time, std::vector<TrackerSample>& samples)
+		{
+			for (size_t i = 0; i < samples.size(); ++i)
+			{
+				int virtualizer = inputVirtualizers[i];
+				if (virtualizer < 0)
+					continue;
+				if (!settings.virtualizers[virtualizer].virtualizer->SampleFrame(time, samples[i].position, samples[i].rotation))
+					return false;
+				samples[i].valid = true;
+			}
+			return true;
+		});
+	}
+	else
+		qDebug() << "A virtualizer could not start streaming" << groundTruthAnimation.name.c_str();
+
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		virtualizerSlot.virtualizer->EndStream();
+	return solvedAnimation;
+}
+
+Animation* MainWindow::SolveChunk(const AnimationChunkReader& reader, double from, double to, Animator& animator, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers, BaseIKKernel& kernel, const std::map<std::string, Tracker*>& trackers, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd)
+{
+	float solveStart = stageStart + (stageEnd - stageStart) * 0.7f;
+
+	Animation* groundTruthChunk = reader.ReadRange(from, to);
+	if (!groundTruthChunk)
+		return nullptr;
+	animator.SetAnimation(groundTruthChunk);
+
+	std::vector<TrackerTrajectory*> trajectories = SampleTrackerTrajectories(animator, virtualizers);
+	std::map<std::string, AnimationCurve> trackerCurves;
+	bool success = GenerateTrackingVirtualizerAnimations(animator, *groundTruthChunk, virtualizers, std::vector<std::string>(), token, stagePrefix, stageStart, solveStart, trackerCurves, trajectories);
+	for (TrackerTrajectory* trajectory : trajectories)
+		delete trajectory;
+	if (!success)
+	{
+		animator.RemoveAnimation(true);
+		return nullptr;
+	}
+
+	Animation* trackerAnimation = CombineTrackerAnimations(*groundTruthChunk, trackerCurves);
+	trackerCurves.clear();
+
+	token.BeginStage(stagePrefix + "Solving", solveStart, stageEnd);
+	animator.GetModel()->SetDefaultPose();
+	Animation* solvedChunk = kernel.Solve(*groundTruthChunk, trackers, *animator.GetModel(), *trackerAnimation);
+	delete trackerAnimation;
+	animator.RemoveAnimation(true); //handles chunk destruction
+
+	if (!solvedChunk || token.IsCanceled())
+	{
+		delete solvedChunk;
+		return nullptr;
+	}
+	return solvedChunk;
+}
+
+MainWindow::ChunkWorker MainWindow::CreateChunkWorker(const GenerationSettings& settings)
+{
+	ChunkWorker worker;
+	worker.model = new SkinnedModel(settings.modelfile.c_str(), false);
+	worker.animator = new Animator(*worker.model);
+
+	std::map<std::string, TrackerConfidence> confidences;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+	{
+		GenerationSettings::VirtualizerSlot clone = virtualizerSlot;
+		clone.virtualizer = virtualizerSlot.virtualizer->Clone();
+		ParameterSweep::CopyParameters(virtualizerSlot.virtualizer->GetParameters(), clone.virtualizer->GetParameters());
+		worker.virtualizers.push_back(clone);
+		confidences[clone.slot] = clone.virtualizer->GetConfidence();
+	}
+
+	worker.kernel = settings.kernel->Clone();
+	ParameterSweep::CopyParameters(settings.kernel->GetParameters(), worker.kernel->GetParameters());
+	worker.kernel->SetInputConfidences(confidences);
+
+	// The chunks already keep every thread busy, so the kernel solves its own segments in order
+	ParameterSweep::SetKernelThreads(worker.kernel->GetParameters(), 1);
+	return worker;
+}
+
+void MainWindow::DestroyChunkWorker(ChunkWorker& worker)
+{
+	for (GenerationSettings::VirtualizerSlot& virtualizerSlot : worker.virtualizers)
+		delete virtualizerSlot.virtualizer;
+	delete worker.kernel;
+	delete worker.animator;
+	delete worker.model;
+	worker = ChunkWorker();
+}
+
+void MainWindow::CollectGenerationSettings(SetupScene* scene, GenerationSettings& settings)
+{
+	settings = GenerationSettings();
+	settings.animationPaths = ui.animationList->GetSelectedAnimationPaths();
+	QJsonArray trackerSettings;
+	for (TrackingVirtualizerListItem* widget : ui.trackerList->itemWidgets)
+	{
+		// Placement, virtualizer and its parameters, the offsets follow from the placement on the character
+		QJsonObject slotSettings = widget->SaveSettings();
+		slotSettings.insert("offsetPosition", QJsonSerializer::Vector3ToJson(widget->tracker->GetOffsetPosition()));
+		slotSettings.insert("offsetRotation", QJsonSerializer::QuaterionToQJsonObject(widget->tracker->GetOffsetRotation()));
+		trackerSettings.append(slotSettings);
+
+		settings.virtualizers.push_back({ widget->GetVirtualizer(), widget->tracker, widget->solveSlotComboBox->currentText().toStdString(), slotSettings });
+	}
+	settings.trackers = scene->GetTrackers();
+	settings.kernel = BaseIKKernel::registry()[ui.ikKernelComboBox->currentIndex()];
+	settings.kernelSettings.insert("name", settings.kernel->GetName().c_str());
+	settings.kernelSettings.insert("settings", ui.ikKernelOptionsList->SaveSettings());
+	settings.kernelSettings.insert("trackers", trackerSettings);
+	settings.animator = scene->GetAnimator();
+	settings.modelfile = settings.animator->GetModel()->getPath();
+
+	// The clips can be converted to dense tracks if all stages sample them on a common grid
+	std::vector<int> downstreamRates;
+	for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		downstreamRates.push_back(virtualizerSlot.virtualizer->GetInputSampleRate());
+	downstreamRates.push_back(ui.errorMetricsSampleRateSpinBox->value());
+	PipelineOptions::instance().UpdateResampleRate(downstreamRates);
+
+	for (ErrorMetricListWidget* widget : static_cast<ErrorMetricList*>(ui.errorMetricsList)->itemWidgets)
+		settings.metrics.push_back(widget->errorMetric);
+	settings.metricSampleRate = ui.errorMetricsSampleRateSpinBox->value();
+
+	// Everything the solved clips depend on besides the ground truth itself, an interrupted run is only resumed if it matches
+	QJsonObject settingsJson;
+	settingsJson.insert("character", ui.characterList->SaveSelected());
+	settingsJson.insert("ikkernelname", settings.kernel->GetName().c_str());
+	settingsJson.insert("ikkernel", ui.ikKernelOptionsList->SaveSettings());
+	settingsJson.insert("trackerList", ui.trackerList->SaveTrackers());
+	settingsJson.insert("pipeline", PipelineOptions::instance().GetProcessingSettings());
+	settings.settingsHash = RunJournal::HashJson(settingsJson);
+}
+
+void MainWindow::BeginBackgroundJob(SetupScene* scene, const QString& label, ThreadPool::Job job)
+{
+	// Window modal keeps the settings fixed while the event loop keeps running
+	generationProgress = new QProgressDialog(label, "Abort", 0, 1000, this);
+	generationProgress->setWindowModality(Qt::WindowModal);
+	generationProgress->setAutoClose(false);
+	generationProgress->setAutoReset(false);
+	generationProgress->setMinimumDuration(0);
+	connect(generationProgress, &QProgressDialog::canceled, this, [this]()
+	{
+		generationToken->Cancel();
+		generationProgress->setLabelText("Aborting..");
+	});
+	generationProgress->show();
+
+	// The job reads the trackers placed on the scene character, they must not be edited until it is done
+	scene->SetRigLocked(true);
+
+	generationToken = new CancellationToken([](const std::string& stage, float progress)
+	{
+		EventManager::instance().QueueEvent("OnGenerationProgress", GenerationProgress { stage, progress });
+	});
+
+	generationPool = new ThreadPool(1);
+	generationPool->Enqueue(job);
+}
+
+void MainWindow::EndBackgroundJob()
+{
+	// The job already returned, this only joins the thread
+	delete generationPool;
+	generationPool = nullptr;
+	delete generationToken;
+	generationToken = nullptr;
+
+	generationProgress->close();
+	generationProgress->deleteLater();
+	generationProgress = nullptr;
+
+	ui.openGLWindow->makeCurrent();
+	DestroyJobSkeleton();
+	ui.openGLWindow->doneCurrent();
+
+	SetupScene* currentScene = dynamic_cast<SetupScene*>(ui.openGLWindow->GetCurrentScene());
+	if (currentScene)
+		currentScene->SetRigLocked(false);
+}
+
+void MainWindow::CreateJobSkeleton(const std::string& modelfile)
+{
+	jobModel = new SkinnedModel(modelfile.c_str(), false);
+	jobAnimator = new Animator(*jobModel);
+}
+
+void MainWindow::DestroyJobSkeleton()
+{
+	delete jobAnimator;
+	jobAnimator = nullptr;
+	delete jobModel;
+	jobModel = nullptr;
 }
 
 void MainWindow::OnCalculationButtonPressed()
 {
-	std::vector<std::string> animationPaths = ui.animationList->GetSelectedAnimationPaths();
-	std::vector<std::string> truthAnimationPaths;
-	std::vector<std::string> solvedAnimationPaths;
-	std::string characterModel;
+	// Only one generation job at a time
+	if (generationPool)
+		return;
+
+	SetupScene* currentScene = dynamic_cast<SetupScene*>(ui.openGLWindow->GetCurrentScene());
+	if (!currentScene)
+		return;
+
+	// Collect the settings here, the job must not read the widgets
+	CollectGenerationSettings(currentScene, generationSettings);
+
+	// The job poses a skeleton of its own, so the scene keeps playing and drawing its character
+	ui.openGLWindow->makeCurrent();
+	CreateJobSkeleton(generationSettings.modelfile);
+	ui.openGLWindow->doneCurrent();
+	generationSettings.animator = jobAnimator;
+
+	// The metric stage of the fused pipeline needs its own skeletons, models need the GL context
+	if (PipelineOptions::instance().fusedPipeline && !generationSettings.metrics.empty())
+	{
+		ui.openGLWindow->makeCurrent();
+		fusedWorker = FusedPipeline::CreateWorker(generationSettings.modelfile);
+		ui.openGLWindow->doneCurrent();
+		generationSettings.fusedWorker = &fusedWorker;
+	}
+
+	// Long captures get their chunks solved side by side, every chunk worker needs its own skeleton
+	int chunkThreads = PipelineOptions::instance().GetChunkThreadCount();
+	if (chunkThreads > 1)
+	{
+		ui.openGLWindow->makeCurrent();
+		for (int worker = 0; worker < chunkThreads; ++worker)
+			chunkWorkers.push_back(CreateChunkWorker(generationSettings));
+		ui.openGLWindow->doneCurrent();
+		generationSettings.chunkWorkers = &chunkWorkers;
+	}
+
+	BeginBackgroundJob(currentScene, "Starting comparision process..", [this](int worker)
+	{
+		GenerationResult result;
+		GenerateAnimations(generationSettings, *generationToken, result);
+		EventManager::instance().QueueEvent("OnGenerationFinished", result);
+	});
+}
+
+void MainWindow::OnRunSweepButtonPressed()
+{
+	if (generationPool)
+		return;
+
+	SetupScene* currentScene = dynamic_cast<SetupScene*>(ui.openGLWindow->GetCurrentScene());
+	if (!currentScene)
+		return;
+
+	QString fileName = QFileDialog::getOpenFileName(this, tr("Load Parameter Sweep"), "sweeps", tr("JSON files (*.json)"));
+	if (fileName.isEmpty())
+		return;
+
+	// The current layout is the base configuration the sweep varies
+	ParameterSweep* sweep = new ParameterSweep();
+	std::string error;
+	bool valid = sweep->LoadSettings(loadJson(fileName).object(), error);
+	if (valid)
+	{
+		CollectGenerationSettings(currentScene, generationSettings);
+
+		sweepSettings = ParameterSweep::RunSettings();
+		sweepSettings.animationPaths = generationSettings.animationPaths;
+		for (const GenerationSettings::VirtualizerSlot& virtualizerSlot : generationSettings.virtualizers)
+			sweepSettings.virtualizers.push_back({ virtualizerSlot.virtualizer, virtualizerSlot.tracker, virtualizerSlot.slot });
+		sweepSettings.trackers = generationSettings.trackers;
+		sweepSettings.kernel = generationSettings.kernel;
+		sweepSettings.animator = generationSettings.animator;
+		sweepSettings.metrics = generationSettings.metrics;
+		sweepSettings.metricSampleRate = generationSettings.metricSampleRate;
+
+		if (sweepSettings.animationPaths.empty() || sweepSettings.metrics.empty())
+		{
+			error = "A sweep needs selected animations and at least one error metric";
+			valid = false;
+		}
+		else
+			valid = sweep->Validate(sweepSettings, error);
+	}
+
+	if (!valid)
+	{
+		QMessageBox::warning(this, tr("Parameter Sweep"), error.c_str());
+		delete sweep;
+		return;
+	}
+	activeSweep = sweep;
+
+	std::stringstream ss;
+	ss << time(nullptr);
+	sweepSettings.outputDirectory = std::filesystem::path(sweepSettings.animationPaths[0]).parent_path().string() + "/../sweep_" + ss.str() + "/";
+
+	// Models need the GL context, so the workers are created here
+	ui.openGLWindow->makeCurrent();
+	CreateJobSkeleton(generationSettings.modelfile);
+	sweepSettings.animator = jobAnimator;
+	sweepSettings.avatar = new Avatar(jobModel);
+	for (int worker = 0; worker < ThreadPool::DefaultThreadCount(); ++worker)
+		sweepWorkers.push_back(ParameterSweep::CreateWorker(generationSettings.modelfile));
+	ui.openGLWindow->doneCurrent();
+
+	BeginBackgroundJob(currentScene, "Starting parameter sweep..", [this](int worker)
+	{
+		ParameterSweep::Results results;
+		activeSweep->Run(sweepSettings, sweepWorkers, *generationToken, results);
+		results.Save(sweepSettings.outputDirectory);
+		EventManager::instance().QueueEvent("OnSweepFinished", results);
+	});
+}
+
+void MainWindow::OnGenerationProgress(GenerationProgress progress)
+{
+	// Late events of a finished or aborted job
+	if (!generationProgress || generationToken->IsCanceled())
+		return;
+
+	generationProgress->setLabelText(progress.stage.c_str());
+	generationProgress->setValue((int)(progress.progress * generationProgress->maximum()));
+}
+
+void MainWindow::OnGenerationFinished(GenerationResult result)
+{
+	EndBackgroundJob();
+
+	if (generationSettings.fusedWorker)
+	{
+		ui.openGLWindow->makeCurrent();
+		FusedPipeline::DestroyWorker(fusedWorker);
+		ui.openGLWindow->doneCurrent();
+		generationSettings.fusedWorker = nullptr;
+	}
+
+	if (generationSettings.chunkWorkers)
+	{
+		ui.openGLWindow->makeCurrent();
+		for (ChunkWorker& worker : chunkWorkers)
+			DestroyChunkWorker(worker);
+		chunkWorkers.clear();
+		ui.openGLWindow->doneCurrent();
+		generationSettings.chunkWorkers = nullptr;
+	}
+
+	// Stay in the setup if the run was aborted before anything got solved
+	if (result.canceled && result.truthAnimationPaths.empty())
+		return;
 
-	GenerateAnimations(characterModel, solvedAnimationPaths, truthAnimationPaths);
 	//SkipIKSolver("dances_10", characterModel, solvedAnimationPaths, truthAnimationPaths);
 
 	ErrorMetricList* errorList = static_cast<ErrorMetricList*>(ui.errorMetricsList);
@@ -221,12 +953,33 @@ void MainWindow::OnCalculationButtonPressed()
 
 	int errorMetricsSampleRate = ui.errorMetricsSampleRateSpinBox->value();
 
-	ResultsWindow* rw = new ResultsWindow(nullptr, characterModel, selectedErrorMetrics, truthAnimationPaths, solvedAnimationPaths, errorMetricsSampleRate);
+	ResultsWindow* rw = new ResultsWindow(nullptr, result.modelfile, selectedErrorMetrics, result.truthAnimationPaths, result.solvedAnimationPaths, errorMetricsSampleRate, result.fusedClips);
 
 	rw->show();
 	this->close();
 }
 
+void MainWindow::OnSweepFinished(ParameterSweep::Results results)
+{
+	EndBackgroundJob();
+
+	ui.openGLWindow->makeCurrent();
+	for (ParameterSweep::Worker& worker : sweepWorkers)
+		ParameterSweep::DestroyWorker(worker);
+	sweepWorkers.clear();
+	delete sweepSettings.avatar;
+	sweepSettings.avatar = nullptr;
+	ui.openGLWindow->doneCurrent();
+
+	delete activeSweep;
+	activeSweep = nullptr;
+
+	std::stringstream ss;
+	ss << (results.canceled ? "Sweep aborted, the finished configurations" : "Sweep finished, the results of " + std::to_string(results.points.size()) + " configurations")
+		<< " were written to " << sweepSettings.outputDirectory;
+	QMessageBox::information(this, tr("Parameter Sweep"), ss.str().c_str());
+}
+
 void MainWindow::ValidateCalculationButton()
 {
 	bool isValid = true;
@@ -277,6 +1030,8 @@ void MainWindow::OnSaveLayoutButtonPressed()
 	json.insert("trackerList", ui.trackerList->SaveTrackers());
 	//Read ErrorMetrics
 	json.insert("metricList", ui.errorMetricsList->SaveSettings());
+	//Read pipeline options
+	json.insert("pipeline", PipelineOptions::instance().SaveSettings());
 
 	//Save
 	QString fileName = QFileDialog::getSaveFileName(this, tr("Save Layout"), "layouts", tr("JSON files (*.json)"));
@@ -303,6 +1058,8 @@ void MainWindow::OnLoadLayoutButtonPressed()
 	ui.trackerList->LoadTrackers(json["trackerList"].toObject(), *scene);
 	//Read ErrorMetrics
 	ui.errorMetricsList->LoadSettings(json["metricList"].toObject());
+	//Read pipeline options
+	PipelineOptions::instance().LoadSettings(json["pipeline"].toObject());
 	ui.openGLWindow->doneCurrent();
 }
 
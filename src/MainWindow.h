@@ -3,6 +3,13 @@
 #include <QtWidgets/QMainWindow>
 #include "ui_MainWindow.h"
 #include "SetupScene.h"
+#include "AnimationChunkReader.h"
+#include "Customizable/InverseKinematicsKernels/BaseIKKernel.h"
+#include "Customizable/TrackingVirtualizers/BaseTrackingVirtualizer.h"
+#include "CancellationToken.h"
+#include "ThreadPool.h"
+#include "ParameterSweep.h"
+#include "FusedPipeline.h"
 
 class MainWindow : public QMainWindow
 {
@@ -11,6 +18,63 @@ public:
 	MainWindow(QWidget *parent = Q_NULLPTR);
 	~MainWindow();
 	Ui::MainWindowClass GetUi() { return ui; }
+
+	struct ChunkWorker;
+
+	// Everything the generation job needs, collected from the widgets before it starts
+	struct GenerationSettings
+	{
+		struct VirtualizerSlot
+		{
+			BaseTrackingVirtualizer* virtualizer;
+			Tracker* tracker;
+			std::string slot;
+			// Placement and virtualizer parameters, keys the cached virtualizer output
+			QJsonObject settings;
+		};
+
+		std::vector<std::string> animationPaths;
+		std::vector<VirtualizerSlot> virtualizers;
+		std::map<std::string, Tracker*> trackers;
+		BaseIKKernel* kernel = nullptr;
+		// Kernel parameters and the tracker placements, keys the cached solved clips
+		QJsonObject kernelSettings;
+		Animator* animator = nullptr;
+		std::string modelfile;
+		// Hash of every setting the solved clips depend on
+		std::string settingsHash;
+		std::vector<BaseErrorMetric*> metrics;
+		int metricSampleRate = 0;
+		// Set if the solved clips go through the fused pipeline
+		FusedPipeline::Worker* fusedWorker = nullptr;
+		// Set if the chunks of long captures are solved side by side
+		std::vector<ChunkWorker>* chunkWorkers = nullptr;
+	};
+
+	// Skeleton and stage clones solving one chunk of a long capture, next to the other workers
+	struct ChunkWorker
+	{
+		SkinnedModel* model = nullptr;
+		Animator* animator = nullptr;
+		std::vector<GenerationSettings::VirtualizerSlot> virtualizers;
+		BaseIKKernel* kernel = nullptr;
+	};
+
+	struct GenerationProgress
+	{
+		std::string stage;
+		float progress = 0.0f;
+	};
+
+	struct GenerationResult
+	{
+		bool canceled = false;
+		std::string modelfile;
+		std::vector<std::string> solvedAnimationPaths;
+		std::vector<std::string> truthAnimationPaths;
+		// Clips the fused pipeline already evaluated, by ground truth path
+		std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips;
+	};
 protected:
 	//void closeEvent(QCloseEvent* event) override;
 
@@ -20,19 +84,68 @@ public slots:
 	void ValidateCalculationButton();
 	void OnSaveLayoutButtonPressed();
 	void OnLoadLayoutButtonPressed();
+	void OnRunSweepButtonPressed();
 
 	void ReloadUI();
 
 private:
 	SetupScene* setupScene;
 
+	// The generation job runs on its own thread, the ui only gets queued events from it
+	ThreadPool* generationPool = nullptr;
+	CancellationToken* generationToken = nullptr;
+	QProgressDialog* generationProgress = nullptr;
+	GenerationSettings generationSettings;
+	// A sweep runs as the generation job, its workers are created and destroyed on the ui thread
+	ParameterSweep* activeSweep = nullptr;
+	ParameterSweep::RunSettings sweepSettings;
+	std::vector<ParameterSweep::Worker> sweepWorkers;
+	FusedPipeline::Worker fusedWorker;
+	std::vector<ChunkWorker> chunkWorkers;
+	// Skeleton of the background job, the scene keeps animating and drawing its own character meanwhile
+	SkinnedModel* jobModel = nullptr;
+	Animator* jobAnimator = nullptr;
+
 	void OnLoadCharacterButtonPressed(std::string path);
 	void SetProgressSliderValue(float normalizedValue);
 	Ui::MainWindowClass ui;
 	void saveJson(QJsonDocument document, QString fileName);
 	QJsonDocument loadJson(QString fileName);
-	bool GenerateTrackingVirtualizerAnimations(Animator& animator, const Animation& groundTruthAnimation, std::map<std::string, AnimationCurve>& output);
+	// Each virtualizer gets an equal share of the progress range [stageStart, stageEnd]
+	// Curves with a cache key are taken from the stage cache if possible, pass no keys to skip the cache
+	// Trackers read their transforms from the trajectories if there are any, indexed like the virtualizers
+	bool GenerateTrackingVirtualizerAnimations(Animator& animator, const Animation& groundTruthAnimation, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers, const std::vector<std::string>& cacheKeys, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd, std::map<std::string, AnimationCurve>& output, const std::vector<TrackerTrajectory*>& trajectories = std::vector<TrackerTrajectory*>());
 	Animation* CombineTrackerAnimations(const Animation& groundTruthAnimation, const std::map<std::string, AnimationCurve>& trackerAnimations);
 	void SkipIKSolver(const std::string& affix, std::string& modelfile, std::vector<std::string>& solvedAnimationPaths, std::vector<std::string>& truthAnimationPaths);
-	void GenerateAnimations(std::string& model, std::vector<std::string>& solvedAnimationPaths, std::vector<std::string>& truthAnimationPaths);
+	// Runs on the generation thread, must not touch any widget
+	void GenerateAnimations(const GenerationSettings& settings, CancellationToken& token, GenerationResult& result);
+	// Stage cache keys of the virtualizer curves and the solved clip, empty for outputs that must not be cached
+	std::string GetStageCacheKeys(const GenerationSettings& settings, const std::string& animationHash, const std::string& modelHash, std::vector<std::string>& virtualizerKeys);
+	// Virtualizes and solves a long capture chunk by chunk, only the solved keys of every chunk itself are kept.
+	// With chunk workers the chunks are solved side by side. Returns the chunks in order as segments with their
+	// start as time offset, so the capture time stays in double precision until it is written. Empty if a chunk failed.
+	std::vector<Animation*> SolveAnimationChunked(const AnimationChunkReader& reader, const GenerationSettings& settings, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd);
+	// Virtualizes and solves the range [from, to] of a capture, the solved chunk starts at from.
+	// The trackers are attached to the scene character, their transforms are sampled from the skeleton of the animator first.
+	Animation* SolveChunk(const AnimationChunkReader& reader, double from, double to, Animator& animator, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers, BaseIKKernel& kernel, const std::map<std::string, Tracker*>& trackers, CancellationToken& token, const std::string& stagePrefix, float stageStart, float stageEnd);
+	// Whether the kernel and every virtualizer implement the streaming interface
+	static bool CanSolveStreamed(const GenerationSettings& settings);
+	// Virtualizes and solves the clip of the animator frame by frame like a live session, nullptr if it failed or got canceled
+	Animation* SolveAnimationStreamed(Animator& animator, const Animation& groundTruthAnimation, const GenerationSettings& settings, CancellationToken& token);
+	// Samples the transforms of the trackers off the skeleton of the animator, the trackers themselves stay on the scene character
+	std::vector<TrackerTrajectory*> SampleTrackerTrajectories(Animator& animator, const std::vector<GenerationSettings::VirtualizerSlot>& virtualizers);
+	// Loads the skeleton of the background job, needs the GL context
+	void CreateJobSkeleton(const std::string& modelfile);
+	void DestroyJobSkeleton();
+	// Loads a skeleton and clones the configured stages, needs the GL context
+	ChunkWorker CreateChunkWorker(const GenerationSettings& settings);
+	void DestroyChunkWorker(ChunkWorker& worker);
+	// Reads the widgets into the settings of a generation or sweep
+	void CollectGenerationSettings(SetupScene* scene, GenerationSettings& settings);
+	// Shows the progress dialog, locks the rig and runs the job on the generation thread
+	void BeginBackgroundJob(SetupScene* scene, const QString& label, ThreadPool::Job job);
+	void EndBackgroundJob();
+	void OnGenerationProgress(GenerationProgress progress);
+	void OnGenerationFinished(GenerationResult result);
+	void OnSweepFinished(ParameterSweep::Results results);
 };
\ No newline at end of file
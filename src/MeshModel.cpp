@@ -5,8 +5,29 @@
 #include <list>
 #include "AttachedModel.h"
 #include "Customizable/JointnameParser.h"
+#include "PipelineOptions.h"
+#include <QDebug>
+#include <cmath>
 #define FITSCALE 4.f
 
+namespace
+{
+	// Estimate of how far the vertex moves when skinned with the pruned weights instead of the original ones. Only the
+	// influencing bones are rotated, each about its own joint. Both sets sum up to one, so the difference is a blend of
+	// how far every bone alone would carry the vertex, which is at most twice its distance to the joint. This is no bound
+	// for real poses, the joints between the influencing bones that carry no weight move the bones apart as well.
+	float SkinDeviationEstimate(const VertexBuffer::JointWeights& original, const VertexBuffer::JointWeights& pruned, const Vector3& vertex, const std::vector<Vector3>& joints)
+	{
+		float estimate = 0.0f;
+		for (int i = 0; i < JOINTCOUNT; i++)
+		{
+			float change = std::abs(original.weights[i] - pruned.weights[i]);
+			estimate += change * 2.0f * (vertex - joints[original.ids[i]]).length();
+		}
+		return estimate;
+	}
+}
+
 MeshModel::MeshModel() : indices(NULL), vertices(NULL), pMeshes(NULL), MeshCount(0), pMaterials(NULL), MaterialCount(0), inverseMeshTransform(Matrix::identity)
 {
 }
@@ -237,6 +258,7 @@ void MeshModel::loadBones(const aiMesh* aiMesh, Mesh* pMesh, const int vertexID)
 			info.offset = convertAiMatrix4x4(bone->mOffsetMatrix);
 			//info.identityOffset = Matrix(info.offset).invert();
 			jointMapping[boneName] = info;
+			jointBindPositions.push_back(Matrix(info.offset).invert().translation());
 		}
 		else
 			info = jointMapping[boneName];
@@ -250,6 +272,20 @@ void MeshModel::loadBones(const aiMesh* aiMesh, Mesh* pMesh, const int vertexID)
 		}
 	}
 
+	// The pruned weights are compared slot by slot, both lists are sorted the same way. The joints are in the units of
+	// the file, so the vertex is taken from the file as well instead of the buffer, which FitSize scales.
+	int influences = PipelineOptions::instance().skinInfluences;
+	if (influences > 0)
+	{
+		VertexBuffer::JointWeights sorted = weights.Sorted();
+		weights = sorted.Pruned(influences);
+		if (aiMesh->HasPositions())
+		{
+			const aiVector3D& vertex = aiMesh->mVertices[vertexID];
+			skinDeviation = std::max(skinDeviation, SkinDeviationEstimate(sorted, weights, Vector3(vertex.x, vertex.y, vertex.z), jointBindPositions));
+		}
+	}
+
 	pMesh->VB.addJointWeights(weights);
 }
 
@@ -276,6 +312,8 @@ void MeshModel::loadMesh(const aiScene* pScene, const int meshID, const Vector3
 	Mesh& pMesh = this->pMeshes[meshID];
 
 	pMesh.VB.begin();
+	if (mMesh->HasBones())
+		pMesh.VB.packJoints(PipelineOptions::instance().skinInfluences);
 	for (unsigned int vertexID = 0; vertexID < mMesh->mNumVertices; ++vertexID)
 	{
 		pMesh.MaterialIdx = mMesh->mMaterialIndex;
@@ -320,6 +358,9 @@ void MeshModel::loadMeshes(const aiScene* pScene, bool FitSize)
 		loadMesh(pScene, meshID, scale);
 	}
 
+	if (!jointMapping.empty() && PipelineOptions::instance().skinInfluences > 0)
+		qDebug() << "Pruned skin weights to" << PipelineOptions::instance().skinInfluences << "influences, vertices deviate by about" << skinDeviation << "file units (estimate)";
+
 	if (FitSize) {
 		Vector3 min, max, vec;
 		std::vector<Vector3> vecs;
@@ -423,6 +464,7 @@ void MeshModel::copyNodesRecursive(const aiNode* paiNode, Node* pNode)
 {
 	pNode->Name = JointnameParser::ExtractJointName(paiNode->mName);
     pNode->Trans = convertAiMatrix4x4(paiNode->mTransformation);
+    pNode->Pose = RigidTransform::FromMatrix(pNode->Trans);
 	
 	if (jointMapping.find(pNode->Name) != jointMapping.end())
 		jointMapping[pNode->Name].node = pNode;
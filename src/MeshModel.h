@@ -12,6 +12,7 @@
 #include "aabb.h"
 #include "lineboxmodel.h"
 #include <string>
+#include "RigidTransform.h"
 
 class AttachedModel;
 
@@ -32,6 +33,8 @@ public:
     {
         Node() : Parent(NULL), Children(NULL), ChildCount(0), MeshCount(0), Meshes(NULL) {}
         Matrix Trans;
+        // Trans split into its parts once on load
+        RigidTransform Pose;
         Matrix GlobalTrans;
         int* Meshes;
         unsigned int MeshCount;
@@ -56,6 +59,9 @@ public:
         Matrix transform;
 		Matrix localTransform;
 		Matrix globalTransform;
+		// The same poses without the matrix math, written together with the matrices
+		RigidTransform localPose;
+		RigidTransform globalPose;
         const Node* node;
     };
 
@@ -75,10 +81,14 @@ public:
     const Node& GetRoot() const;
 	const Node* GetNode(std::string name, const Node* node = NULL) const;
 	const Mesh& GetMesh(int meshID) const;
+	unsigned int GetMeshCount() const { return MeshCount; }
 	std::string GetFilename() const { return Filename; }
 	Matrix GetInverseMeshTransform() const { return inverseMeshTransform; }
 	std::string GetFilepath() const { return Path; }
 	const JointInfo* GetJointInfo(std::string name) const;
+	// Estimate of how far pruning the skin weights on load moves a vertex in the units of the file, 0 if they were kept.
+	// It assumes rotations of the influencing bones alone, so it is no bound for real poses.
+	float GetSkinDeviation() const { return skinDeviation; }
 protected: // protected methods
 	void loadFaces(const aiMesh* mMesh, Mesh* pMesh);
 	void loadBones(const aiMesh* mMesh, Mesh* pMesh, const int vertexID);
@@ -112,5 +122,8 @@ protected: // protected member variables
 	std::string Filename; //stores filename
     Node RootNode;
     std::map<std::string, JointInfo> jointMapping;
+	// Mesh space position of every joint in the bind pose, indexed by joint id
+	std::vector<Vector3> jointBindPositions;
+	float skinDeviation = 0.0f;
 	Matrix inverseMeshTransform;
 };
\ No newline at end of file
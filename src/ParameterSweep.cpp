@@ -0,0 +1,862 @@
+#define _USE_MATH_DEFINES
+#include "ParameterSweep.h"
+#include "PipelineOptions.h"
+#include "ThreadPool.h"
+#include "JointDependencies.h"
+#include "QJsonSerializer.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <mutex>
+#include <cmath>
+#include <sstream>
+
+const char* ParameterSweep::KernelTarget = "kernel";
+const char* ParameterSweep::AllTrackersTarget = "trackers";
+
+namespace
+{
+	const char* DesignNames[] = { "grid", "random", "latinhypercube", "montecarlo" };
+
+	float MeanResult(const std::vector<float>& results)
+	{
+		float combined = 0.0f;
+		int resultCount = 0;
+		for (float result : results)
+		{
+			if (std::isnan(result))
+				continue;
+			combined += result;
+			resultCount++;
+		}
+		return resultCount > 0 ? combined / resultCount : NAN;
+	}
+
+	// Levels of a grid axis, the explicit values if there are any
+	std::vector<double> GetLevels(const ParameterSweep::Axis& axis)
+	{
+		if (!axis.values.empty())
+			return axis.values;
+
+		std::vector<double> levels;
+		int steps = std::max(1, axis.steps);
+		for (int step = 0; step < steps; ++step)
+			levels.push_back(steps == 1 ? axis.min : axis.min + (axis.max - axis.min) * step / (steps - 1));
+		return levels;
+	}
+
+	// Rational approximation of the standard normal quantile by Acklam, relative error below 1.2e-9
+	double NormalQuantile(double p)
+	{
+		const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+		const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+		const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+		const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00 };
+		const double tail = 0.02425;
+
+		if (p < tail || p > 1.0 - tail)
+		{
+			double q = std::sqrt(-2.0 * std::log(p < tail ? p : 1.0 - p));
+			double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+			return p < tail ? x : -x;
+		}
+
+		double q = p - 0.5;
+		double r = q * q;
+		return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+	}
+
+	// Exact for one and two degrees of freedom, Cornish-Fisher expansion above (Abramowitz and Stegun 26.7.5)
+	double StudentTQuantile(double p, int degreesOfFreedom)
+	{
+		if (degreesOfFreedom == 1)
+			return std::tan(M_PI * (p - 0.5));
+		if (degreesOfFreedom == 2)
+			return (2.0 * p - 1.0) / std::sqrt(2.0 * p * (1.0 - p));
+
+		double z = NormalQuantile(p);
+		double z2 = z * z;
+		double v = degreesOfFreedom;
+		double g1 = (z2 + 1.0) * z / 4.0;
+		double g2 = ((5.0 * z2 + 16.0) * z2 + 3.0) * z / 96.0;
+		double g3 = (((3.0 * z2 + 19.0) * z2 + 17.0) * z2 - 15.0) * z / 384.0;
+		double g4 = ((((79.0 * z2 + 776.0) * z2 + 1482.0) * z2 - 1920.0) * z2 - 945.0) * z / 92160.0;
+		return z + g1 / v + g2 / (v * v) + g3 / (v * v * v) + g4 / (v * v * v * v);
+	}
+
+	// Maps a uniform sample in [0, 1) onto the axis
+	double MapSample(const ParameterSweep::Axis& axis, double sample)
+	{
+		if (!axis.values.empty())
+			return axis.values[std::min((size_t)(sample * axis.values.size()), axis.values.size() - 1)];
+		return axis.min + (axis.max - axis.min) * sample;
+	}
+}
+
+ParameterSweep::ParameterSweep() :
+	design(Design::Grid),
+	sampleCount(10),
+	seed(0),
+	seedParameter("RandomSeed"),
+	confidence(0.95),
+	halfWidth(0.0),
+	relativeHalfWidth(0.0),
+	minSeeds(5),
+	maxSeeds(100)
+{
+}
+
+void ParameterSweep::Estimate::Add(double value)
+{
+	if (std::isnan(value))
+		return;
+
+	// Welford's update, stable for long runs
+	count++;
+	double delta = value - mean;
+	mean += delta / count;
+	m2 += delta * (value - mean);
+}
+
+double ParameterSweep::Estimate::GetHalfWidth(double confidence) const
+{
+	if (count < 2)
+		return NAN;
+	return StudentTQuantile(0.5 + confidence / 2.0, count - 1) * GetStandardDeviation() / std::sqrt((double)count);
+}
+
+bool ParameterSweep::LoadSettings(const QJsonObject& settings, std::string& error)
+{
+	QString designName = settings["design"].toString("grid").toLower();
+	if (designName == DesignNames[0])
+		design = Design::Grid;
+	else if (designName == DesignNames[1])
+		design = Design::Random;
+	else if (designName == DesignNames[2])
+		design = Design::LatinHypercube;
+	else if (designName == DesignNames[3])
+		design = Design::MonteCarlo;
+	else
+	{
+		error = "Unknown sweep design " + designName.toStdString();
+		return false;
+	}
+
+	sampleCount = settings["samples"].toInt(10);
+	seed = settings["seed"].toInt(0);
+	if (design != Design::Grid && sampleCount < 1)
+	{
+		error = "A sampled design needs at least one sample";
+		return false;
+	}
+
+	axes.clear();
+	if (design == Design::MonteCarlo)
+	{
+		seedParameter = settings["seedParameter"].toString("RandomSeed").toStdString();
+		confidence = settings["confidence"].toDouble(0.95);
+		halfWidth = settings["halfWidth"].toDouble(0.0);
+		relativeHalfWidth = settings["relativeHalfWidth"].toDouble(0.0);
+		minSeeds = std::max(2, settings["minSeeds"].toInt(5));
+		maxSeeds = settings["maxSeeds"].toInt(100);
+
+		if (confidence <= 0.0 || confidence >= 1.0)
+		{
+			error = "The confidence has to be in (0, 1)";
+			return false;
+		}
+		if (maxSeeds < minSeeds)
+		{
+			error = "maxSeeds must not be below minSeeds";
+			return false;
+		}
+
+		// The seed is the only axis, it is applied to every tracker having the parameter
+		Axis seedAxis;
+		seedAxis.target = AllTrackersTarget;
+		seedAxis.parameter = seedParameter;
+		axes.push_back(seedAxis);
+		return true;
+	}
+
+	for (const QJsonValue& axisValue : settings["axes"].toArray())
+	{
+		QJsonObject axisJson = axisValue.toObject();
+		Axis axis;
+		axis.target = axisJson["target"].toString().toStdString();
+		axis.parameter = axisJson["parameter"].toString().toStdString();
+		for (const QJsonValue& value : axisJson["values"].toArray())
+			axis.values.push_back(value.toDouble());
+		axis.min = axisJson["min"].toDouble(0.0);
+		axis.max = axisJson["max"].toDouble(axis.min);
+		axis.steps = axisJson["steps"].toInt(5);
+
+		if (axis.target.empty() || axis.parameter.empty())
+		{
+			error = "Every sweep axis needs a target and a parameter";
+			return false;
+		}
+		axes.push_back(axis);
+	}
+
+	if (axes.empty())
+	{
+		error = "The sweep has no axes";
+		return false;
+	}
+	return true;
+}
+
+QJsonObject ParameterSweep::SaveSettings() const
+{
+	if (design == Design::MonteCarlo)
+	{
+		QJsonObject settings;
+		settings.insert("design", DesignNames[(int)design]);
+		settings.insert("seed", (int)seed);
+		settings.insert("seedParameter", seedParameter.c_str());
+		settings.insert("confidence", confidence);
+		settings.insert("halfWidth", halfWidth);
+		settings.insert("relativeHalfWidth", relativeHalfWidth);
+		settings.insert("minSeeds", minSeeds);
+		settings.insert("maxSeeds", maxSeeds);
+		return settings;
+	}
+
+	QJsonArray axesJson;
+	for (const Axis& axis : axes)
+	{
+		QJsonObject axisJson;
+		axisJson.insert("target", axis.target.c_str());
+		axisJson.insert("parameter", axis.parameter.c_str());
+		if (!axis.values.empty())
+		{
+			QJsonArray values;
+			for (double value : axis.values)
+				values.append(value);
+			axisJson.insert("values", values);
+		}
+		else
+		{
+			axisJson.insert("min", axis.min);
+			axisJson.insert("max", axis.max);
+			axisJson.insert("steps", axis.steps);
+		}
+		axesJson.append(axisJson);
+	}
+
+	QJsonObject settings;
+	settings.insert("design", DesignNames[(int)design]);
+	settings.insert("samples", sampleCount);
+	settings.insert("seed", (int)seed);
+	settings.insert("axes", axesJson);
+	return settings;
+}
+
+bool ParameterSweep::Validate(const RunSettings& settings, std::string& error) const
+{
+	// Unseeded stochastic stages differ between repetitions even without a seed parameter
+	bool stochastic = !settings.kernel->IsDeterministic();
+	for (const RunSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+		stochastic = stochastic || !virtualizerSlot.virtualizer->IsDeterministic();
+
+	for (const Axis& axis : axes)
+	{
+		std::vector<const BaseParameter*> parameters;
+		if (axis.target == KernelTarget)
+		{
+			auto it = settings.kernel->GetParameters().find(axis.parameter);
+			if (it != settings.kernel->GetParameters().end())
+				parameters.push_back(it->second);
+		}
+		else
+		{
+			for (const RunSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+			{
+				if (!Targets(axis, virtualizerSlot.slot))
+					continue;
+
+				auto it = virtualizerSlot.virtualizer->GetParameters().find(axis.parameter);
+				if (it != virtualizerSlot.virtualizer->GetParameters().end())
+					parameters.push_back(it->second);
+			}
+		}
+
+		if (parameters.empty() && design == Design::MonteCarlo && stochastic)
+			continue;
+		if (parameters.empty())
+		{
+			error = "No " + axis.target + " has a parameter " + axis.parameter;
+			return false;
+		}
+		for (const BaseParameter* parameter : parameters)
+		{
+			if (!IsSweepable(parameter))
+			{
+				error = axis.GetName() + " is not numeric and can not be swept";
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+std::vector<std::vector<double>> ParameterSweep::GeneratePoints() const
+{
+	std::vector<std::vector<double>> points;
+	int axisCount = axes.size();
+
+	// The budget of consecutive seeds, a clip stops as soon as it converged
+	if (design == Design::MonteCarlo)
+	{
+		for (int p = 0; p < maxSeeds; ++p)
+			points.push_back(std::vector<double>(1, (double)seed + p));
+		return points;
+	}
+
+	if (design == Design::Grid)
+	{
+		std::vector<std::vector<double>> levels;
+		for (const Axis& axis : axes)
+			levels.push_back(GetLevels(axis));
+
+		// Counts through the levels like an odometer, the last axis turns fastest
+		std::vector<size_t> indices(axisCount, 0);
+		while (true)
+		{
+			std::vector<double> point;
+			for (int a = 0; a < axisCount; ++a)
+				point.push_back(levels[a][indices[a]]);
+			points.push_back(point);
+
+			int a = axisCount - 1;
+			for (; a >= 0; --a)
+			{
+				if (++indices[a] < levels[a].size())
+					break;
+				indices[a] = 0;
+			}
+			if (a < 0)
+				break;
+		}
+		return points;
+	}
+
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	points.assign(sampleCount, std::vector<double>(axisCount));
+
+	for (int a = 0; a < axisCount; ++a)
+	{
+		// Latin hypercubes put exactly one sample into every stratum of every axis
+		std::vector<int> strata(sampleCount);
+		std::iota(strata.begin(), strata.end(), 0);
+		if (design == Design::LatinHypercube)
+			std::shuffle(strata.begin(), strata.end(), random);
+
+		for (int p = 0; p < sampleCount; ++p)
+		{
+			double sample = uniform(random);
+			if (design == Design::LatinHypercube)
+				sample = (strata[p] + sample) / sampleCount;
+			points[p][a] = MapSample(axes[a], sample);
+		}
+	}
+	return points;
+}
+
+void ParameterSweep::Run(const RunSettings& settings, std::vector<Worker>& workers, CancellationToken& token, Results& results) const
+{
+	MetricEvaluationPlanner planner(settings.metrics);
+	std::vector<std::vector<double>> points = GeneratePoints();
+	int pointCount = points.size();
+	int clipCount = settings.animationPaths.size();
+	int metricCount = settings.metrics.size();
+
+	results.sweep = SaveSettings();
+	results.axisNames.clear();
+	for (const Axis& axis : axes)
+		results.axisNames.push_back(axis.GetName());
+	results.points = points;
+	results.metricNames = planner.GetMetricNames();
+	results.clipNames.clear();
+	for (const std::string& path : settings.animationPaths)
+		results.clipNames.push_back(std::filesystem::path(path).stem().string());
+	results.values.assign((size_t)pointCount * clipCount * metricCount, NAN);
+	if (design == Design::MonteCarlo)
+	{
+		results.confidence = confidence;
+		results.estimates.assign((size_t)clipCount * metricCount, Estimate());
+		results.seedsUsed.assign(clipCount, 0);
+		results.converged.assign(clipCount, false);
+	}
+
+	// Cloned here instead of per configuration, virtualizer constructors may touch shared state like the python environment
+	for (Worker& worker : workers)
+	{
+		for (const RunSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+			worker.virtualizers.push_back(virtualizerSlot.virtualizer->Clone());
+		worker.kernel = settings.kernel->Clone();
+		worker.kernelThreads = workers.size() > 1 ? 1 : 0;
+	}
+
+	// A grid every configuration samples on exactly, as long as it stays small
+	int trajectoryRate = TrackerTrajectory::GetCommonSampleRate(GetVirtualizerSampleRates(settings, points, workers[0].virtualizers), PipelineOptions::instance().maxResampleRate);
+	qDebug() << "Sweep:" << pointCount << "configurations," << clipCount << "clips, trajectory rate" << trajectoryRate;
+
+	Animator& animator = *settings.animator;
+	ThreadPool pool(workers.size());
+
+	// Every skeleton of the run only poses the joints under the trackers and the joints the virtualizers and metrics read
+	JointDependencies dependencies;
+	for (const RunSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+	{
+		dependencies.AddTracker(virtualizerSlot.tracker, *animator.GetModel());
+		dependencies.AddVirtualizer(virtualizerSlot.virtualizer);
+	}
+	dependencies.AddMetrics(planner, settings.avatar);
+	std::set<std::string> requiredJoints = dependencies.GetJoints();
+	animator.SetRequiredJoints(requiredJoints);
+	for (Worker& worker : workers)
+	{
+		worker.groundTruthAnimator->SetRequiredJoints(requiredJoints);
+		worker.solvedAnimator->SetRequiredJoints(requiredJoints);
+	}
+	std::mutex progressMutex;
+
+	for (int clip = 0; clip < clipCount && !token.IsCanceled(); ++clip)
+	{
+		const std::string& path = settings.animationPaths[clip];
+		std::stringstream ss;
+		ss << "Clip " << clip + 1 << "/" << clipCount << ": " << results.clipNames[clip] << " - ";
+		std::string stagePrefix = ss.str();
+
+		// Everything derived from the ground truth alone is sampled once for all configurations
+		token.BeginStage(stagePrefix + "Sampling ground truth", clip / (float)clipCount, (clip + 0.1f) / clipCount);
+		Animation* groundTruthAnimation = Animation::LoadFromPath(path);
+		if (!groundTruthAnimation)
+			continue;
+		animator.SetAnimation(groundTruthAnimation);
+
+		std::vector<const Tracker*> trackers;
+		for (const RunSettings::VirtualizerSlot& virtualizerSlot : settings.virtualizers)
+			trackers.push_back(virtualizerSlot.tracker);
+		std::vector<TrackerTrajectory*> trajectories = TrackerTrajectory::SampleAll(animator, trackers, trajectoryRate);
+
+		PoseFrames groundTruthFrames;
+		std::vector<double> sampleTimes;
+		planner.CaptureGroundTruth(animator, *animator.GetModel(), settings.avatar, settings.metricSampleRate, sampleTimes, groundTruthFrames);
+
+		// Virtualizers reading the skeleton directly get a copy of the clip on the worker skeleton
+		for (Worker& worker : workers)
+			worker.groundTruthAnimator->SetAnimation(new Animation(*groundTruthAnimation));
+
+		token.BeginStage(stagePrefix + (design == Design::MonteCarlo ? "Repeating seeds" : "Evaluating configurations"), (clip + 0.1f) / clipCount, (clip + 1.0f) / clipCount);
+		int finishedPoints = 0;
+		int issuedPoints = 0;
+		while (issuedPoints < pointCount && !token.IsCanceled())
+		{
+			// Monte Carlo runs issue one seed per worker and check the intervals in between. The batches
+			// are folded in seed order, so the stopping point does not depend on the thread timing.
+			int batchSize = design == Design::MonteCarlo ? (int)workers.size() : pointCount;
+			int batchEnd = std::min(issuedPoints + batchSize, pointCount);
+			for (int p = issuedPoints; p < batchEnd; ++p)
+			{
+				pool.Enqueue([&, p, clip](int workerIndex)
+				{
+					std::vector<float> means;
+					if (RunPoint(settings, points[p], workers[workerIndex], trajectories, planner, groundTruthFrames, sampleTimes, token, means))
+					{
+						for (int metric = 0; metric < metricCount; ++metric)
+							results.At(p, clip, metric) = means[metric];
+					}
+
+					std::lock_guard<std::mutex> lock(progressMutex);
+					token.ReportProgress(++finishedPoints / (float)pointCount);
+				});
+			}
+			pool.Wait();
+
+			if (design == Design::MonteCarlo && !token.IsCanceled())
+			{
+				std::vector<Estimate>::iterator clipEstimates = results.estimates.begin() + (size_t)clip * metricCount;
+				for (int p = issuedPoints; p < batchEnd; ++p)
+					for (int metric = 0; metric < metricCount; ++metric)
+						clipEstimates[metric].Add(results.At(p, clip, metric));
+				results.seedsUsed[clip] = batchEnd;
+				results.converged[clip] = HasConverged(std::vector<Estimate>(clipEstimates, clipEstimates + metricCount));
+				if (results.converged[clip])
+					break;
+			}
+			issuedPoints = batchEnd;
+		}
+
+		for (Worker& worker : workers)
+			worker.groundTruthAnimator->RemoveAnimation(true);
+		for (TrackerTrajectory* trajectory : trajectories)
+			delete trajectory;
+		animator.RemoveAnimation(true); //handles gt destruction
+	}
+	animator.SetRequiredJoints(std::set<std::string>());
+
+	for (Worker& worker : workers)
+	{
+		for (BaseTrackingVirtualizer* virtualizer : worker.virtualizers)
+			delete virtualizer;
+		worker.virtualizers.clear();
+		delete worker.kernel;
+		worker.kernel = nullptr;
+	}
+
+	results.canceled = token.IsCanceled();
+}
+
+bool ParameterSweep::RunPoint(
+	const RunSettings& settings, const std::vector<double>& point, Worker& worker,
+	const std::vector<TrackerTrajectory*>& trajectories, const MetricEvaluationPlanner& planner,
+	const PoseFrames& groundTruthFrames, const std::vector<double>& sampleTimes,
+	CancellationToken& token, std::vector<float>& means) const
+{
+	// The shared token only gets the progress per configuration
+	CancellationToken pointToken(&token);
+	if (pointToken.IsCanceled())
+		return false;
+
+	const Animation& groundTruthAnimation = *worker.groundTruthAnimator->GetAnimation();
+	Animation* trackerAnimation = new Animation();
+	trackerAnimation->name = groundTruthAnimation.name;
+	trackerAnimation->duration = groundTruthAnimation.duration;
+	trackerAnimation->ticksPerSecond = groundTruthAnimation.ticksPerSecond;
+
+	// Every configuration works on the clones of the worker, the base configuration stays untouched
+	std::map<std::string, TrackerConfidence> confidences;
+	for (size_t i = 0; i < settings.virtualizers.size(); ++i)
+	{
+		const RunSettings::VirtualizerSlot& virtualizerSlot = settings.virtualizers[i];
+		BaseTrackingVirtualizer* virtualizer = worker.virtualizers[i];
+		CopyParameters(virtualizerSlot.virtualizer->GetParameters(), virtualizer->GetParameters());
+		ApplyPoint(point, virtualizerSlot.slot, virtualizer->GetParameters());
+		confidences[virtualizerSlot.slot] = virtualizer->GetConfidence();
+
+		worker.groundTruthModel->SetDefaultPose();
+		TrackerHandle trackerHandle = TrackerHandle(worker.groundTruthAnimator, virtualizerSlot.tracker, virtualizerSlot.slot, &pointToken, trajectories[i]);
+		AnimationCurve trackerAnimationCurve;
+		bool success = virtualizer->CreateOutputAnimation(trackerHandle, trackerAnimationCurve);
+
+		if (!success || pointToken.IsCanceled())
+		{
+			delete trackerAnimation;
+			return false;
+		}
+
+		trackerAnimationCurve.name = virtualizerSlot.slot;
+		trackerAnimation->animNodeMapping[virtualizerSlot.slot] = trackerAnimationCurve;
+	}
+
+	BaseIKKernel* kernel = worker.kernel;
+	CopyParameters(settings.kernel->GetParameters(), kernel->GetParameters());
+	if (worker.kernelThreads > 0)
+		SetKernelThreads(kernel->GetParameters(), worker.kernelThreads);
+	ApplyPoint(point, KernelTarget, kernel->GetParameters());
+	kernel->SetCancellationToken(&pointToken);
+	kernel->SetInputConfidences(confidences);
+
+	worker.model->SetDefaultPose();
+	Animation* solvedAnimation = kernel->Solve(groundTruthAnimation, settings.trackers, *worker.model, *trackerAnimation);
+	kernel->SetCancellationToken(nullptr);
+	delete trackerAnimation;
+
+	if (!solvedAnimation || pointToken.IsCanceled())
+	{
+		delete solvedAnimation;
+		return false;
+	}
+
+	// Only the solved side gets sampled, the ground truth frames are shared. Per frame metrics pose the worker's own ground truth skeleton.
+	worker.solvedAnimator->SetAnimation(solvedAnimation);
+	std::vector<std::vector<float>> metricResults;
+	planner.EvaluateAgainst(
+		groundTruthFrames, *worker.groundTruthAnimator, *worker.groundTruthModel, worker.groundTruthAvatar,
+		*worker.solvedAnimator, *worker.model, worker.avatar,
+		sampleTimes, metricResults);
+	worker.solvedAnimator->RemoveAnimation(true); //handles solved destruction
+
+	means.clear();
+	for (const std::vector<float>& metricResult : metricResults)
+		means.push_back(MeanResult(metricResult));
+	return true;
+}
+
+std::vector<int> ParameterSweep::GetVirtualizerSampleRates(const RunSettings& settings, const std::vector<std::vector<double>>& points, const std::vector<BaseTrackingVirtualizer*>& clones) const
+{
+	std::vector<int> rates;
+	for (size_t i = 0; i < settings.virtualizers.size(); ++i)
+	{
+		const RunSettings::VirtualizerSlot& virtualizerSlot = settings.virtualizers[i];
+		rates.push_back(virtualizerSlot.virtualizer->GetInputSampleRate());
+
+		// Virtualizers know best which of their parameters is the rate
+		for (const std::vector<double>& point : points)
+		{
+			CopyParameters(virtualizerSlot.virtualizer->GetParameters(), clones[i]->GetParameters());
+			ApplyPoint(point, virtualizerSlot.slot, clones[i]->GetParameters());
+			rates.push_back(clones[i]->GetInputSampleRate());
+		}
+	}
+
+	std::sort(rates.begin(), rates.end());
+	rates.erase(std::unique(rates.begin(), rates.end()), rates.end());
+	return rates;
+}
+
+bool ParameterSweep::HasConverged(const std::vector<Estimate>& estimates) const
+{
+	for (const Estimate& estimate : estimates)
+	{
+		if (estimate.count < minSeeds)
+			return false;
+
+		double bound = std::max(halfWidth, relativeHalfWidth * std::abs(estimate.mean));
+		double estimateHalfWidth = estimate.GetHalfWidth(confidence);
+		if (std::isnan(estimateHalfWidth) || estimateHalfWidth > bound)
+			return false;
+	}
+	return true;
+}
+
+bool ParameterSweep::Targets(const Axis& axis, const std::string& target) const
+{
+	if (target == KernelTarget)
+		return axis.target == KernelTarget;
+	return axis.target == target || axis.target == AllTrackersTarget;
+}
+
+void ParameterSweep::ApplyPoint(const std::vector<double>& point, const std::string& target, const std::map<std::string, BaseParameter*>& parameters) const
+{
+	for (size_t a = 0; a < axes.size(); ++a)
+	{
+		if (!Targets(axes[a], target))
+			continue;
+
+		auto it = parameters.find(axes[a].parameter);
+		if (it != parameters.end())
+			SetParameterValue(it->second, point[a]);
+	}
+}
+
+bool ParameterSweep::IsSweepable(const BaseParameter* parameter)
+{
+	const std::type_info& paramType = parameter->GetType();
+	return paramType == typeid(bool) || paramType == typeid(int) || paramType == typeid(float) || paramType == typeid(double)
+		|| std::string(paramType.name()).find("enum ") != std::string::npos;
+}
+
+void ParameterSweep::SetParameterValue(BaseParameter* parameter, double value)
+{
+	const std::type_info& paramType = parameter->GetType();
+	if (paramType == typeid(bool))
+		dynamic_cast<Parameter<bool>*>(parameter)->SetValue(value != 0.0);
+	else if (paramType == typeid(int))
+		dynamic_cast<Parameter<int>*>(parameter)->SetValue((int)std::lround(value));
+	else if (paramType == typeid(float))
+		dynamic_cast<Parameter<float>*>(parameter)->SetValue((float)value);
+	else if (paramType == typeid(double))
+		dynamic_cast<Parameter<double>*>(parameter)->SetValue(value);
+	else if (std::string(paramType.name()).find("enum ") != std::string::npos)
+		static_cast<Parameter<int>*>(parameter)->SetValue((int)std::lround(value));
+}
+
+void ParameterSweep::CopyParameters(const std::map<std::string, BaseParameter*>& from, const std::map<std::string, BaseParameter*>& to)
+{
+	// Goes through the serializer, which knows every parameter type
+	for (const auto& kv : from)
+	{
+		auto it = to.find(kv.first);
+		if (it != to.end())
+			QJsonSerializer::JsonToParameter(it->second, QJsonSerializer::ParameterToJson(kv.second));
+	}
+}
+
+void ParameterSweep::SetKernelThreads(const std::map<std::string, BaseParameter*>& parameters, int threads)
+{
+	auto it = parameters.find("Threads");
+	if (it != parameters.end() && it->second->GetType() == typeid(int))
+		dynamic_cast<Parameter<int>*>(it->second)->SetValue(threads);
+}
+
+ParameterSweep::Worker ParameterSweep::CreateWorker(const std::string& modelfile)
+{
+	Worker worker;
+	worker.model = new SkinnedModel(modelfile.c_str(), false);
+	worker.avatar = new Avatar(worker.model);
+	worker.groundTruthModel = new SkinnedModel(modelfile.c_str(), false);
+	worker.groundTruthAvatar = new Avatar(worker.groundTruthModel);
+	worker.groundTruthAnimator = new Animator(*worker.groundTruthModel);
+	worker.solvedAnimator = new Animator(*worker.model);
+	return worker;
+}
+
+void ParameterSweep::DestroyWorker(Worker& worker)
+{
+	delete worker.groundTruthAnimator;
+	delete worker.solvedAnimator;
+	delete worker.avatar;
+	delete worker.model;
+	delete worker.groundTruthAvatar;
+	delete worker.groundTruthModel;
+	worker = Worker();
+}
+
+bool ParameterSweep::Results::Save(const std::string& directory) const
+{
+	if (!std::filesystem::exists(directory))
+		std::filesystem::create_directories(directory);
+
+	QJsonArray pointsJson;
+	for (size_t p = 0; p < points.size(); ++p)
+	{
+		QJsonObject parameters;
+		for (size_t a = 0; a < axisNames.size(); ++a)
+			parameters.insert(axisNames[a].c_str(), points[p][a]);
+
+		// NAN has no json representation, failed configurations are stored as null
+		QJsonArray clips;
+		for (size_t clip = 0; clip < clipNames.size(); ++clip)
+		{
+			QJsonArray metrics;
+			for (size_t metric = 0; metric < metricNames.size(); ++metric)
+			{
+				float value = values[(p * clipNames.size() + clip) * metricNames.size() + metric];
+				metrics.append(std::isnan(value) ? QJsonValue() : QJsonValue(value));
+			}
+			clips.append(metrics);
+		}
+
+		QJsonObject pointJson;
+		pointJson.insert("parameters", parameters);
+		pointJson.insert("values", clips);
+		pointsJson.append(pointJson);
+	}
+
+	QJsonArray clipsJson;
+	for (const std::string& clipName : clipNames)
+		clipsJson.append(clipName.c_str());
+	QJsonArray metricsJson;
+	for (const std::string& metricName : metricNames)
+		metricsJson.append(metricName.c_str());
+
+	QJsonObject json;
+	json.insert("sweep", sweep);
+	json.insert("canceled", canceled);
+	json.insert("clips", clipsJson);
+	json.insert("metrics", metricsJson);
+	json.insert("points", pointsJson);
+
+	if (!estimates.empty())
+	{
+		QJsonArray estimatesJson;
+		for (size_t clip = 0; clip < clipNames.size(); ++clip)
+		{
+			QJsonObject clipJson;
+			clipJson.insert("seeds", seedsUsed[clip]);
+			clipJson.insert("converged", (bool)converged[clip]);
+			QJsonArray metrics;
+			for (size_t metric = 0; metric < metricNames.size(); ++metric)
+			{
+				const Estimate& estimate = estimates[clip * metricNames.size() + metric];
+				double deviation = estimate.GetStandardDeviation();
+				double interval = estimate.GetHalfWidth(confidence);
+				QJsonObject metricJson;
+				metricJson.insert("count", estimate.count);
+				metricJson.insert("mean", estimate.count > 0 ? QJsonValue(estimate.mean) : QJsonValue());
+				metricJson.insert("standardDeviation", std::isnan(deviation) ? QJsonValue() : QJsonValue(deviation));
+				metricJson.insert("halfWidth", std::isnan(interval) ? QJsonValue() : QJsonValue(interval));
+				metrics.append(metricJson);
+			}
+			clipJson.insert("metrics", metrics);
+			estimatesJson.append(clipJson);
+		}
+		json.insert("confidence", confidence);
+		json.insert("estimates", estimatesJson);
+	}
+
+	std::string jsonPath = (std::filesystem::path(directory) / "results.json").string();
+	QFile jsonFile(jsonPath.c_str());
+	if (!jsonFile.open(QFile::WriteOnly))
+	{
+		qDebug() << "ParameterSweep: could not write" << jsonPath.c_str();
+		return false;
+	}
+	jsonFile.write(QJsonDocument(json).toJson());
+	jsonFile.close();
+
+	// Long format, one row per configuration and clip
+	std::string csvPath = (std::filesystem::path(directory) / "results.csv").string();
+	QFile csvFile(csvPath.c_str());
+	if (!csvFile.open(QFile::WriteOnly | QFile::Text))
+	{
+		qDebug() << "ParameterSweep: could not write" << csvPath.c_str();
+		return false;
+	}
+
+	QTextStream csv(&csvFile);
+	csv << "point";
+	for (const std::string& axisName : axisNames)
+		csv << ";" << axisName.c_str();
+	csv << ";clip";
+	for (const std::string& metricName : metricNames)
+		csv << ";" << metricName.c_str();
+	csv << "\n";
+
+	for (size_t p = 0; p < points.size(); ++p)
+	{
+		for (size_t clip = 0; clip < clipNames.size(); ++clip)
+		{
+			// Seeds past the stopping point of a clip never ran
+			if (!seedsUsed.empty() && (int)p >= seedsUsed[clip])
+				continue;
+
+			csv << p;
+			for (double value : points[p])
+				csv << ";" << value;
+			csv << ";" << clipNames[clip].c_str();
+			for (size_t metric = 0; metric < metricNames.size(); ++metric)
+				csv << ";" << values[(p * clipNames.size() + clip) * metricNames.size() + metric];
+			csv << "\n";
+		}
+	}
+	csvFile.close();
+
+	if (estimates.empty())
+		return true;
+
+	// One row per clip and metric with the confidence interval of the mean
+	std::string summaryPath = (std::filesystem::path(directory) / "summary.csv").string();
+	QFile summaryFile(summaryPath.c_str());
+	if (!summaryFile.open(QFile::WriteOnly | QFile::Text))
+	{
+		qDebug() << "ParameterSweep: could not write" << summaryPath.c_str();
+		return false;
+	}
+
+	QTextStream summary(&summaryFile);
+	summary << "clip;metric;seeds;mean;standardDeviation;halfWidth;confidence;converged\n";
+	for (size_t clip = 0; clip < clipNames.size(); ++clip)
+	{
+		for (size_t metric = 0; metric < metricNames.size(); ++metric)
+		{
+			const Estimate& estimate = estimates[clip * metricNames.size() + metric];
+			summary << clipNames[clip].c_str() << ";" << metricNames[metric].c_str() << ";" << estimate.count << ";"
+				<< estimate.mean << ";" << estimate.GetStandardDeviation() << ";" << estimate.GetHalfWidth(confidence) << ";"
+				<< confidence << ";" << (converged[clip] ? 1 : 0) << "\n";
+		}
+	}
+	return true;
+}
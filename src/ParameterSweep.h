@@ -0,0 +1,189 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <QJsonObject>
+#include "Animator.h"
+#include "AvatarSystem/Avatar.h"
+#include "Tracker.h"
+#include "TrackerTrajectory.h"
+#include "CancellationToken.h"
+#include "Customizable/TrackingVirtualizers/BaseTrackingVirtualizer.h"
+#include "Customizable/InverseKinematicsKernels/BaseIKKernel.h"
+#include "Customizable/ErrorMetrics/BaseErrorMetric.h"
+#include "Customizable/ErrorMetrics/MetricEvaluationPlanner.h"
+
+// Study over virtualizer and kernel parameters. The design gets expanded into configurations, which are
+// run in parallel against every clip. The ground truth tracker trajectories and metric frames of a clip
+// are sampled once and shared by all configurations.
+// The Monte Carlo design repeats the base configuration with consecutive seeds instead, until the
+// confidence interval of every metric mean is narrow enough or the seed budget of the clip is used up.
+class ParameterSweep
+{
+public:
+	enum class Design
+	{
+		Grid,
+		Random,
+		LatinHypercube,
+		MonteCarlo
+	};
+
+	// Axis targets besides the solve slot names
+	static const char* KernelTarget;
+	static const char* AllTrackersTarget;
+
+	struct Axis
+	{
+		// Solve slot of the varied virtualizer, KernelTarget or AllTrackersTarget
+		std::string target;
+		std::string parameter;
+		// Explicit levels. Without them a grid uses evenly spaced steps in [min, max], sampled designs draw from [min, max].
+		std::vector<double> values;
+		double min = 0.0;
+		double max = 0.0;
+		int steps = 5;
+
+		std::string GetName() const { return target + "." + parameter; }
+	};
+
+	// Running mean and variance of a metric over the seeds of a clip
+	struct Estimate
+	{
+		int count = 0;
+		double mean = 0.0;
+		// Sum of squared differences from the mean
+		double m2 = 0.0;
+
+		// NAN values of failed seeds are skipped
+		void Add(double value);
+		double GetStandardDeviation() const { return count > 1 ? std::sqrt(m2 / (count - 1)) : NAN; }
+		// Half width of the Student t confidence interval of the mean, NAN below two values
+		double GetHalfWidth(double confidence) const;
+	};
+
+	// Everything a run needs besides the design, collected on the ui thread
+	struct RunSettings
+	{
+		struct VirtualizerSlot
+		{
+			BaseTrackingVirtualizer* virtualizer;
+			Tracker* tracker;
+			std::string slot;
+		};
+
+		std::vector<std::string> animationPaths;
+		// The base configuration, every configuration works on clones of it
+		std::vector<VirtualizerSlot> virtualizers;
+		std::map<std::string, Tracker*> trackers;
+		BaseIKKernel* kernel = nullptr;
+		// Holds the ground truth, the tracker trajectories and metric frames get sampled with it
+		Animator* animator = nullptr;
+		Avatar* avatar = nullptr;
+		std::vector<BaseErrorMetric*> metrics;
+		int metricSampleRate = 30;
+		std::string outputDirectory;
+	};
+
+	// Skeleton of one parallel configuration, created on the ui thread since models need the GL context
+	struct Worker
+	{
+		SkinnedModel* model = nullptr;
+		Avatar* avatar = nullptr;
+		// Separate skeleton, so per frame metrics can see both poses at once
+		SkinnedModel* groundTruthModel = nullptr;
+		Avatar* groundTruthAvatar = nullptr;
+		Animator* groundTruthAnimator = nullptr;
+		Animator* solvedAnimator = nullptr;
+		// Clones of the base configuration, reset to it before every configuration
+		std::vector<BaseTrackingVirtualizer*> virtualizers;
+		BaseIKKernel* kernel = nullptr;
+		// Threads of every solve, 1 once the workers keep the cores busy, 0 leaves the configured value
+		int kernelThreads = 0;
+	};
+
+	// The results cube, the mean of every metric per configuration and clip
+	struct Results
+	{
+		bool canceled = false;
+		QJsonObject sweep;
+		std::vector<std::string> axisNames;
+		std::vector<std::vector<double>> points;
+		std::vector<std::string> clipNames;
+		std::vector<std::string> metricNames;
+		// values[(point * clipCount + clip) * metricCount + metric], NAN if the configuration failed on the clip
+		std::vector<float> values;
+		// Monte Carlo only, per clip and metric: estimates[clip * metricCount + metric]
+		std::vector<Estimate> estimates;
+		double confidence = 0.0;
+		std::vector<int> seedsUsed;
+		std::vector<bool> converged;
+
+		float& At(int point, int clip, int metric) { return values[(point * clipNames.size() + clip) * metricNames.size() + metric]; }
+		// Writes the cube as results.json and results.csv with one row per configuration and clip.
+		// Monte Carlo runs add summary.csv with the interval of every clip and metric.
+		bool Save(const std::string& directory) const;
+	};
+
+	ParameterSweep();
+
+	// { "design": "grid" | "random" | "latinhypercube", "samples": 20, "seed": 0,
+	//   "axes": [ { "target": "kernel", "parameter": "Iterations", "values": [ 5, 10 ] }, { "target": "trackers", "parameter": "NoiseStrength", "min": 0, "max": 0.1, "steps": 5 } ] }
+	// { "design": "montecarlo", "seed": 0, "seedParameter": "RandomSeed", "confidence": 0.95,
+	//   "halfWidth": 0.001, "relativeHalfWidth": 0.05, "minSeeds": 5, "maxSeeds": 100 }
+	bool LoadSettings(const QJsonObject& settings, std::string& error);
+	QJsonObject SaveSettings() const;
+	// Checks every axis against the base configuration
+	bool Validate(const RunSettings& settings, std::string& error) const;
+
+	// One value per axis for every configuration, grids vary the last axis fastest
+	std::vector<std::vector<double>> GeneratePoints() const;
+
+	// Runs on a job thread, the workers are used in parallel
+	void Run(const RunSettings& settings, std::vector<Worker>& workers, CancellationToken& token, Results& results) const;
+
+	static Worker CreateWorker(const std::string& modelfile);
+	static void DestroyWorker(Worker& worker);
+
+	// Sets the parameters both maps share to the values of the first, used to configure clones
+	static void CopyParameters(const std::map<std::string, BaseParameter*>& from, const std::map<std::string, BaseParameter*>& to);
+	// Sets the Threads parameter of kernels that solve segments in parallel, so clones running side by side do not oversubscribe
+	static void SetKernelThreads(const std::map<std::string, BaseParameter*>& parameters, int threads);
+private:
+	Design design;
+	// Configurations drawn by the random designs
+	int sampleCount;
+	unsigned int seed;
+	std::vector<Axis> axes;
+
+	// Monte Carlo stopping rule, a metric has converged once the half width is below the larger of both bounds
+	std::string seedParameter;
+	double confidence;
+	double halfWidth;
+	double relativeHalfWidth;
+	int minSeeds;
+	int maxSeeds;
+
+	// Numeric parameters only, strings and vectors have no order to sweep over
+	static bool IsSweepable(const BaseParameter* parameter);
+	static void SetParameterValue(BaseParameter* parameter, double value);
+
+	bool Targets(const Axis& axis, const std::string& target) const;
+	bool HasConverged(const std::vector<Estimate>& estimates) const;
+	void ApplyPoint(const std::vector<double>& point, const std::string& target, const std::map<std::string, BaseParameter*>& parameters) const;
+	// The rates the virtualizers of all configurations sample the ground truth with, the clones get the points applied
+	std::vector<int> GetVirtualizerSampleRates(const RunSettings& settings, const std::vector<std::vector<double>>& points, const std::vector<BaseTrackingVirtualizer*>& clones) const;
+
+	/// <summary>
+	/// Virtualizes, solves and evaluates one configuration on the clip held by the worker
+	/// </summary>
+	/// <param name="means">Receives the mean of every metric over the clip</param>
+	/// <returns>False if a stage failed or the run got canceled</returns>
+	bool RunPoint(
+		const RunSettings& settings, const std::vector<double>& point, Worker& worker,
+		const std::vector<TrackerTrajectory*>& trajectories, const MetricEvaluationPlanner& planner,
+		const PoseFrames& groundTruthFrames, const std::vector<double>& sampleTimes,
+		CancellationToken& token, std::vector<float>& means) const;
+};
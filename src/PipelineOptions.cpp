@@ -0,0 +1,97 @@
+#include "PipelineOptions.h"
+#include "ThreadPool.h"
+#include <numeric>
+#include <QDebug>
+
+PipelineOptions& PipelineOptions::instance()
+{
+	static PipelineOptions* instance = new PipelineOptions();
+	return *instance;
+}
+
+int PipelineOptions::UpdateResampleRate(const std::vector<int>& downstreamRates)
+{
+	activeResampleRate = 0;
+	if (!resampleOnLoad || downstreamRates.empty())
+		return activeResampleRate;
+
+	int commonRate = 1;
+	for (int rate : downstreamRates)
+	{
+		// A stage with an unknown rate could sample anywhere
+		if (rate <= 0)
+		{
+			qDebug() << "Keeping keyed animations, a stage has no fixed sample rate";
+			return activeResampleRate;
+		}
+		commonRate = std::lcm(commonRate, rate);
+	}
+
+	if (resampleRate > 0)
+	{
+		if (resampleRate % commonRate != 0)
+		{
+			qDebug() << "Keeping keyed animations, resample rate" << resampleRate << "is no multiple of" << commonRate;
+			return activeResampleRate;
+		}
+		activeResampleRate = resampleRate;
+	}
+	else if (commonRate <= maxResampleRate)
+		activeResampleRate = commonRate;
+	else
+		qDebug() << "Keeping keyed animations, common sample rate" << commonRate << "exceeds" << maxResampleRate;
+
+	return activeResampleRate;
+}
+
+int PipelineOptions::GetChunkThreadCount() const
+{
+	if (streamingChunkLength <= 0.0)
+		return 1;
+	return chunkThreads > 0 ? chunkThreads : ThreadPool::DefaultThreadCount();
+}
+
+QJsonObject PipelineOptions::SaveSettings() const
+{
+	QJsonObject settings;
+	settings.insert("resampleOnLoad", resampleOnLoad);
+	settings.insert("resampleRate", resampleRate);
+	settings.insert("maxResampleRate", maxResampleRate);
+	settings.insert("streamingChunkLength", streamingChunkLength);
+	settings.insert("streamingChunkOverlap", streamingChunkOverlap);
+	settings.insert("chunkThreads", chunkThreads);
+	settings.insert("cacheSizeLimit", cacheSizeLimit);
+	settings.insert("fusedPipeline", fusedPipeline);
+	settings.insert("writeSolvedAnimations", writeSolvedAnimations);
+	settings.insert("pipelineQueueLength", pipelineQueueLength);
+	settings.insert("streamedSolve", streamedSolve);
+	settings.insert("skinInfluences", skinInfluences);
+	return settings;
+}
+
+QJsonObject PipelineOptions::GetProcessingSettings() const
+{
+	QJsonObject settings;
+	settings.insert("activeResampleRate", activeResampleRate);
+	settings.insert("streamingChunkLength", streamingChunkLength);
+	settings.insert("streamingChunkOverlap", streamingChunkOverlap);
+	settings.insert("streamedSolve", streamedSolve);
+	settings.insert("skinInfluences", skinInfluences);
+	return settings;
+}
+
+void PipelineOptions::LoadSettings(const QJsonObject& settings)
+{
+	resampleOnLoad = settings["resampleOnLoad"].toBool(false);
+	resampleRate = settings["resampleRate"].toInt(0);
+	maxResampleRate = settings["maxResampleRate"].toInt(480);
+	streamingChunkLength = settings["streamingChunkLength"].toDouble(0.0);
+	streamingChunkOverlap = settings["streamingChunkOverlap"].toDouble(1.0);
+	chunkThreads = settings["chunkThreads"].toInt(0);
+	cacheSizeLimit = settings["cacheSizeLimit"].toInt(2048);
+	fusedPipeline = settings["fusedPipeline"].toBool(false);
+	writeSolvedAnimations = settings["writeSolvedAnimations"].toBool(true);
+	pipelineQueueLength = settings["pipelineQueueLength"].toInt(2);
+	streamedSolve = settings["streamedSolve"].toBool(false);
+	skinInfluences = settings["skinInfluences"].toInt(0);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <QJsonObject>
+
+// Singleton
+// Settings shared by all stages of the tracking pipeline, stored with the layout
+class PipelineOptions
+{
+public:
+	static PipelineOptions& instance();
+
+	// Convert clips to dense tracks on load if all downstream sample rates allow it
+	bool resampleOnLoad = false;
+	// Rate of the dense tracks, 0 derives it from the downstream sample rates
+	int resampleRate = 0;
+	// Upper bound for a derived rate, to keep the dense tracks small
+	int maxResampleRate = 480;
+
+	// Captures longer than this get processed in chunks of this length in seconds, 0 disables streaming
+	double streamingChunkLength = 0.0;
+	// Time in seconds every chunk starts early, so filters and derivatives are settled at the chunk start
+	double streamingChunkOverlap = 1.0;
+	// Chunks of a long capture processed side by side, 0 uses one thread per core, 1 processes them in order
+	int chunkThreads = 0;
+
+	// Size of the stage output cache in megabytes, 0 disables it
+	int cacheSizeLimit = 2048;
+
+	// Solved clips go from the solver straight to the error metrics in memory, without reimporting them
+	bool fusedPipeline = false;
+	// Also write the solved clips when fused, needed to compare them again later
+	bool writeSolvedAnimations = true;
+	// Clips a fused stage may fall behind before the solver waits for it
+	int pipelineQueueLength = 2;
+
+	// Clips get virtualized and solved frame by frame like a live session, if the kernel and all virtualizers can stream.
+	// Off by default, solving whole clips in parallel segments is faster and the held tracker samples change the solved clips.
+	bool streamedSolve = false;
+
+	// Skin weights kept per vertex when a model is loaded, the rest is pruned and the weights get packed
+	// into small integers for the shaders. 0 keeps all JOINTCOUNT as floats.
+	int skinInfluences = 0;
+
+	bool UseStreaming(double duration) const { return streamingChunkLength > 0.0 && duration > streamingChunkLength; }
+	// Threads working on the chunks of one capture, 1 if there are no chunks
+	int GetChunkThreadCount() const;
+
+	/// <summary>
+	/// Picks the dense rate for the next run. Every downstream rate has to divide it,
+	/// so all their sample times fall onto dense samples and no lookup is interpolated twice.
+	/// </summary>
+	/// <param name="downstreamRates">The rates every stage samples the loaded clips with, 0 marks an unknown rate</param>
+	/// <returns>The rate clips get resampled at on load, 0 if they stay keyed</returns>
+	int UpdateResampleRate(const std::vector<int>& downstreamRates);
+	int GetActiveResampleRate() const { return activeResampleRate; }
+
+	QJsonObject SaveSettings() const;
+	// Only the settings that change the outputs of the stages, used to key journals and caches
+	QJsonObject GetProcessingSettings() const;
+	void LoadSettings(const QJsonObject& settings);
+private:
+	PipelineOptions() {}
+	PipelineOptions(const PipelineOptions&);
+
+	int activeResampleRate = 0;
+};
@@ -13,7 +13,8 @@ ResultsWindow::ResultsWindow(
 	std::vector<BaseErrorMetric*> selectedErrorMetrics,
 	std::vector<std::string> groundTruthAnimationPaths, 
 	std::vector<std::string> solvedAnimations,
-	int errorMetricsSampleRate)
+	int errorMetricsSampleRate,
+	std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips)
 	:
 	QWidget(parent),
 	currentIndex(-1)
@@ -25,23 +26,76 @@ ResultsWindow::ResultsWindow(
 	connect(header, SIGNAL(sectionClicked(int)), this, SLOT(HeaderSelected(int)));
 
 	std::function<void(float)> floatFunction = std::function([this](float value) { return SetProgressSliderValue(value); });
-	EventManager::instance().SubscribeToEvent("SetProgressSliderValue", floatFunction);
-	std::function<void(ComparisonScene::ResultsMatrix)> matrixFunction = std::function([this](ComparisonScene::ResultsMatrix value) { return OnMatrixCalculated(value); });
-	EventManager::instance().SubscribeToEvent("OnMatrixCalculated", matrixFunction);
+	progressSubscription = EventManager::instance().SubscribeToEvent("SetProgressSliderValue", floatFunction);
+	std::function<void(ComparisonScene::ResultsMatrix)> matrixFunction = std::function([this](ComparisonScene::ResultsMatrix value) { return OnComparisonStarted(value); });
+	startedSubscription = EventManager::instance().SubscribeToEvent("OnComparisonStarted", matrixFunction);
+	std::function<void(ComparisonScene::ResultsRow)> rowFunction = std::function([this](ComparisonScene::ResultsRow value) { return OnComparisonRowCalculated(value); });
+	rowSubscription = EventManager::instance().SubscribeToEvent("OnComparisonRowCalculated", rowFunction);
+	matrixFunction = std::function([this](ComparisonScene::ResultsMatrix value) { return OnMatrixCalculated(value); });
+	matrixSubscription = EventManager::instance().SubscribeToEvent("OnMatrixCalculated", matrixFunction);
 
 	OpenGLWindow* openGLWindow = static_cast<OpenGLWindow*>(ui.openGLWindow);
-	comparisonScene = new ComparisonScene(modelfile,selectedErrorMetrics, groundTruthAnimationPaths ,solvedAnimations, errorMetricsSampleRate);
+	comparisonScene = new ComparisonScene(modelfile,selectedErrorMetrics, groundTruthAnimationPaths ,solvedAnimations, errorMetricsSampleRate, fusedClips);
 	openGLWindow->SetCurrentScene(comparisonScene);
 
 }
 
 ResultsWindow::~ResultsWindow() 
 {
+	// Queued comparison events can still arrive after the window is gone
+	EventManager::instance().UnsubscribeFromEvent<float>("SetProgressSliderValue", progressSubscription);
+	EventManager::instance().UnsubscribeFromEvent<ComparisonScene::ResultsMatrix>("OnComparisonStarted", startedSubscription);
+	EventManager::instance().UnsubscribeFromEvent<ComparisonScene::ResultsRow>("OnComparisonRowCalculated", rowSubscription);
+	EventManager::instance().UnsubscribeFromEvent<ComparisonScene::ResultsMatrix>("OnMatrixCalculated", matrixSubscription);
+}
+
+void ResultsWindow::OnComparisonStarted(ComparisonScene::ResultsMatrix emptyMatrix)
+{
+	QTableWidget* table = ui.resultsTable;
+	table->clearContents();
+	table->setRowCount(emptyMatrix.y);
+	table->setColumnCount(emptyMatrix.x);
+
+	for (int x = 0; x < emptyMatrix.x; x++)
+	{
+		std::string name = emptyMatrix.columnLabels[x];
+		QTableWidgetItem* item = new QTableWidgetItem(name.c_str());
+		table->setHorizontalHeaderItem(x, item);
+	}
+
+	// Rows stay empty until their animation is evaluated
+	for (int y = 0; y < emptyMatrix.y; y++)
+	{
+		std::string name = emptyMatrix.rowLabels[y];
+		QTableWidgetItem* item = new QTableWidgetItem(name.c_str());
+		table->setVerticalHeaderItem(y, item);
+	}
+}
+
+void ResultsWindow::OnComparisonRowCalculated(ComparisonScene::ResultsRow row)
+{
+	QTableWidget* table = ui.resultsTable;
+	if (row.row >= table->rowCount())
+		return;
+
+	table->setVerticalHeaderItem(row.row, new QTableWidgetItem(row.label.c_str()));
+
+	if (!row.loaded)
+	{
+		for (int x = 0; x < table->columnCount(); x++)
+			table->setItem(row.row, x, new QTableWidgetItem("failed"));
+		return;
+	}
+
+	for (int x = 0; x < row.values.size() && x < table->columnCount(); x++)
+		table->setItem(row.row, x, new QTableWidgetItem(QString::number(row.values[x])));
 }
 
 void ResultsWindow::OnMatrixCalculated(ComparisonScene::ResultsMatrix resultsMatrix)
 {
 	this->resultsMatrix = resultsMatrix;
+	// Rows of failed animations are dropped from the final matrix, so the previous row index is stale
+	currentIndex = -1;
 
 	QTableWidget* table = ui.resultsTable;
 	table->setRowCount(resultsMatrix.y);
@@ -79,7 +133,9 @@ void ResultsWindow::HeaderSelected(int row)
 	if (currentIndex == row)
 		return;
 
-	comparisonScene->LoadAnimations(row);
+	// Rows that are still being evaluated can not be played yet
+	if (!comparisonScene->LoadAnimations(row))
+		return;
 
 	currentIndex = row;
 }
@@ -91,7 +147,8 @@ void ResultsWindow::CellSelected(int row, int column)
 	if (currentIndex == row)
 		return;
 
-	comparisonScene->LoadAnimations(row);
+	if (!comparisonScene->LoadAnimations(row))
+		return;
 
 	currentIndex = row;
 }
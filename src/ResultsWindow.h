@@ -12,13 +12,20 @@ private:
 	ComparisonScene::ResultsMatrix resultsMatrix;
 	int currentIndex;
 	ComparisonScene* comparisonScene;
+	// Event manager slots of the callbacks, cleared again on destruction
+	size_t progressSubscription;
+	size_t startedSubscription;
+	size_t rowSubscription;
+	size_t matrixSubscription;
 
 	void SetProgressSliderValue(float normalizedValue);
 public:
-	ResultsWindow(QWidget* parent, std::string modelfile, std::vector<BaseErrorMetric*> selectedErrorMetrics, std::vector<std::string> groundTruthAnimationPaths, std::vector<std::string> solvedAnimationPaths, int errorMetricsSampleRate);
+	ResultsWindow(QWidget* parent, std::string modelfile, std::vector<BaseErrorMetric*> selectedErrorMetrics, std::vector<std::string> groundTruthAnimationPaths, std::vector<std::string> solvedAnimationPaths, int errorMetricsSampleRate, std::map<std::string, std::shared_ptr<FusedPipeline::Clip>> fusedClips = {});
 	~ResultsWindow();
 	Ui::ResultsWindow ui;
 
+	void OnComparisonStarted(ComparisonScene::ResultsMatrix emptyMatrix);
+	void OnComparisonRowCalculated(ComparisonScene::ResultsRow row);
 	void OnMatrixCalculated(ComparisonScene::ResultsMatrix resultsMatrix);
 public slots:
 	void CellSelected(int row, int column);
@@ -0,0 +1,55 @@
+#include "RigidTransform.h"
+
+const RigidTransform RigidTransform::identity = RigidTransform();
+
+RigidTransform RigidTransform::operator*(const RigidTransform& other) const
+{
+	RigidTransform result;
+	result.rotation = rotation * other.rotation;
+	result.translation = translation + rotation * Vector3(scale.x * other.translation.x, scale.y * other.translation.y, scale.z * other.translation.z);
+	result.scale = Vector3(scale.x * other.scale.x, scale.y * other.scale.y, scale.z * other.scale.z);
+	return result;
+}
+
+RigidTransform RigidTransform::Inverse() const
+{
+	// The rotations of the poses stay unit length, so the conjugate is the inverse
+	RigidTransform result;
+	result.rotation = rotation.conjugate();
+	result.scale = Vector3(1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z);
+	Vector3 rotated = result.rotation * translation;
+	result.translation = Vector3(-rotated.x * result.scale.x, -rotated.y * result.scale.y, -rotated.z * result.scale.z);
+	return result;
+}
+
+Vector3 RigidTransform::TransformPoint(const Vector3& point) const
+{
+	return translation + rotation * Vector3(scale.x * point.x, scale.y * point.y, scale.z * point.z);
+}
+
+Matrix RigidTransform::ToMatrix() const
+{
+	// translation * rotation * scale, the scale multiplies the axes of the rotation
+	Matrix matrix = rotation.toRotationMatrix();
+	matrix.m00 *= scale.x; matrix.m10 *= scale.x; matrix.m20 *= scale.x;
+	matrix.m01 *= scale.y; matrix.m11 *= scale.y; matrix.m21 *= scale.y;
+	matrix.m02 *= scale.z; matrix.m12 *= scale.z; matrix.m22 *= scale.z;
+	matrix.m03 = translation.x;
+	matrix.m13 = translation.y;
+	matrix.m23 = translation.z;
+	return matrix;
+}
+
+RigidTransform RigidTransform::FromMatrix(const Matrix& matrix)
+{
+	RigidTransform result;
+	result.translation = matrix.translation();
+	result.scale = matrix.scale();
+
+	Matrix axes = Matrix::identity;
+	axes.m00 = matrix.m00 / result.scale.x; axes.m10 = matrix.m10 / result.scale.x; axes.m20 = matrix.m20 / result.scale.x;
+	axes.m01 = matrix.m01 / result.scale.y; axes.m11 = matrix.m11 / result.scale.y; axes.m21 = matrix.m21 / result.scale.y;
+	axes.m02 = matrix.m02 / result.scale.z; axes.m12 = matrix.m12 / result.scale.z; axes.m22 = matrix.m22 / result.scale.z;
+	result.rotation = axes.rotation();
+	return result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "vector.h"
+#include "Quaternion.h"
+#include "Matrix.h"
+
+// Joint pose as rotation, translation and scale, applied as translation * rotation * scale like the animation curves.
+// Composition and inverse are closed form, so posing a skeleton needs no general 4x4 products, inverses or
+// matrix to quaternion conversions. The scale is kept per axis, composing is exact as long as the outer
+// transform is scaled uniformly, which holds for the joints of the supported rigs.
+struct RigidTransform
+{
+	Quaternion rotation;
+	Vector3 translation;
+	Vector3 scale;
+
+	// Spelled out instead of using the identity constants, which may not be initialized yet for static instances
+	RigidTransform() : rotation(0.0f, 0.0f, 0.0f, 1.0f), translation(0.0f, 0.0f, 0.0f), scale(1.0f, 1.0f, 1.0f) {}
+	RigidTransform(const Quaternion& rotation, const Vector3& translation, const Vector3& scale = Vector3::one) : rotation(rotation), translation(translation), scale(scale) {}
+
+	// The other transform is applied first, like with matrices
+	RigidTransform operator*(const RigidTransform& other) const;
+	RigidTransform Inverse() const;
+	Vector3 TransformPoint(const Vector3& point) const;
+
+	// Only needed where matrices are consumed, like the bone upload
+	Matrix ToMatrix() const;
+	// Splits a matrix without shear into its parts, the rotation is taken from the normalized axes
+	static RigidTransform FromMatrix(const Matrix& matrix);
+
+	static const RigidTransform identity;
+};
@@ -0,0 +1,174 @@
+#include "RunJournal.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <filesystem>
+
+const char* RunJournal::Filename = "journal.jsonl";
+
+RunJournal::RunJournal(const std::string& directory) : directory(directory), finished(false)
+{
+	QFile file(GetPath().c_str());
+	if (!file.open(QFile::ReadOnly))
+		return;
+
+	// One record per line, later records override earlier ones
+	while (!file.atEnd())
+	{
+		QByteArray line = file.readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+
+		// A crash while appending leaves a torn last line
+		QJsonParseError error;
+		QJsonDocument document = QJsonDocument::fromJson(line, &error);
+		if (error.error != QJsonParseError::NoError || !document.isObject())
+		{
+			qDebug() << "RunJournal: skipping unreadable record in" << GetPath().c_str();
+			continue;
+		}
+
+		QJsonObject record = document.object();
+		QString type = record["type"].toString();
+		if (type == "run")
+			settingsHash = record["settings"].toString().toStdString();
+		else if (type == "finished")
+			finished = true;
+		else if (type == "stage")
+			stages[std::make_pair(record["clip"].toString().toStdString(), record["stage"].toString().toStdString())] = record;
+	}
+}
+
+bool RunJournal::Exists() const
+{
+	return std::filesystem::exists(GetPath());
+}
+
+std::string RunJournal::GetSettingsHash() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return settingsHash;
+}
+
+bool RunJournal::IsFinished() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return finished;
+}
+
+void RunJournal::Begin(const std::string& settingsHash)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!this->settingsHash.empty())
+		return;
+
+	this->settingsHash = settingsHash;
+
+	QJsonObject record;
+	record.insert("type", "run");
+	record.insert("settings", settingsHash.c_str());
+	Append(record);
+}
+
+void RunJournal::Finish()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	finished = true;
+
+	QJsonObject record;
+	record.insert("type", "finished");
+	Append(record);
+}
+
+bool RunJournal::FindStage(const std::string& clip, const std::string& stage, const std::string& inputHash, const std::string& settingsHash, QJsonObject& output) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = stages.find(std::make_pair(clip, stage));
+	if (it == stages.end())
+		return false;
+
+	const QJsonObject& record = it->second;
+	if (record["input"].toString().toStdString() != inputHash || record["settings"].toString().toStdString() != settingsHash)
+		return false;
+
+	output = record["output"].toObject();
+	return true;
+}
+
+void RunJournal::CompleteStage(const std::string& clip, const std::string& stage, const std::string& inputHash, const std::string& settingsHash, const QJsonObject& output)
+{
+	QJsonObject record;
+	record.insert("type", "stage");
+	record.insert("clip", clip.c_str());
+	record.insert("stage", stage.c_str());
+	record.insert("input", inputHash.c_str());
+	record.insert("settings", settingsHash.c_str());
+	record.insert("output", output);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stages[std::make_pair(clip, stage)] = record;
+	Append(record);
+}
+
+void RunJournal::Append(const QJsonObject& record)
+{
+	if (!std::filesystem::exists(directory))
+		std::filesystem::create_directories(directory);
+
+	// Reopened per record, so everything written so far survives a crash
+	QFile file(GetPath().c_str());
+	if (!file.open(QFile::WriteOnly | QFile::Append))
+	{
+		qDebug() << "RunJournal: could not write to" << GetPath().c_str();
+		return;
+	}
+
+	file.write(QJsonDocument(record).toJson(QJsonDocument::Compact));
+	file.write("\n");
+}
+
+std::string RunJournal::GetPath() const
+{
+	return (std::filesystem::path(directory) / Filename).string();
+}
+
+std::string RunJournal::HashFile(const std::string& path)
+{
+	QFile file(path.c_str());
+	if (!file.open(QFile::ReadOnly))
+		return "";
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(&file);
+	return hash.result().toHex().toStdString();
+}
+
+std::string RunJournal::HashBytes(const QByteArray& bytes)
+{
+	return QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex().toStdString();
+}
+
+std::string RunJournal::HashJson(const QJsonObject& json)
+{
+	// Qt sorts the keys, so equal settings always serialize the same
+	return HashBytes(QJsonDocument(json).toJson(QJsonDocument::Compact));
+}
+
+std::string RunJournal::FindUnfinishedRun(const std::string& parentDirectory, const std::string& prefix, const std::string& settingsHash)
+{
+	if (!std::filesystem::exists(parentDirectory))
+		return "";
+
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(parentDirectory))
+	{
+		if (!entry.is_directory() || entry.path().filename().string().rfind(prefix, 0) != 0)
+			continue;
+
+		RunJournal journal(entry.path().string());
+		if (journal.Exists() && !journal.IsFinished() && journal.GetSettingsHash() == settingsHash)
+			return entry.path().string() + "/";
+	}
+
+	return "";
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <QJsonObject>
+
+// Append only record of the stages a batch run completed per clip, stored next to the run outputs.
+// An interrupted run with the same settings can skip every stage whose inputs did not change.
+// All methods are thread safe.
+class RunJournal
+{
+public:
+	static const char* Filename;
+
+	// Replays the journal in the directory if there is one, it gets created with the first record
+	RunJournal(const std::string& directory);
+
+	bool Exists() const;
+	const std::string& GetDirectory() const { return directory; }
+	std::string GetSettingsHash() const;
+	bool IsFinished() const;
+
+	// Marks the start of a run with the given settings, only written if the journal is new
+	void Begin(const std::string& settingsHash);
+	void Finish();
+
+	/// <summary>
+	/// Looks up a completed stage of a clip
+	/// </summary>
+	/// <param name="clip">Identifies the clip, usually the ground truth path</param>
+	/// <param name="stage">Name of the pipeline stage</param>
+	/// <param name="inputHash">Content hash of the stage inputs</param>
+	/// <param name="settingsHash">Hash of the settings the stage ran with</param>
+	/// <param name="output">The output description that was recorded with the stage</param>
+	/// <returns>True if the stage was completed with the same inputs and settings</returns>
+	bool FindStage(const std::string& clip, const std::string& stage, const std::string& inputHash, const std::string& settingsHash, QJsonObject& output) const;
+	void CompleteStage(const std::string& clip, const std::string& stage, const std::string& inputHash, const std::string& settingsHash, const QJsonObject& output);
+
+	// Hex encoded content hashes
+	static std::string HashFile(const std::string& path);
+	static std::string HashBytes(const QByteArray& bytes);
+	static std::string HashJson(const QJsonObject& json);
+
+	// The directory of an unfinished run with the given settings among the subdirectories starting with prefix, empty if there is none
+	static std::string FindUnfinishedRun(const std::string& parentDirectory, const std::string& prefix, const std::string& settingsHash);
+private:
+	RunJournal(const RunJournal&);
+
+	void Append(const QJsonObject& record);
+	std::string GetPath() const;
+
+	mutable std::mutex mutex;
+	std::string directory;
+	std::string settingsHash;
+	bool finished;
+	// Latest record per clip and stage
+	std::map<std::pair<std::string, std::string>, QJsonObject> stages;
+};
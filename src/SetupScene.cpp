@@ -58,7 +58,8 @@ SetupScene::SetupScene() :
 	arrowsMove(NULL),
 	ikSolver(NULL),
 	drawSkeleton(false),
-	drawTrackerOffset(false)
+	drawTrackerOffset(false),
+	rigLocked(false)
 {
 	std::function<void()> voidCallback = std::function([this]() { return this->OnStopButtonPressed(); });
 	EventManager::instance().SubscribeToEvent("OnStopButtonPressed", voidCallback);
@@ -540,8 +541,11 @@ void SetupScene::OnTPoseButtonPressed()
 
 void SetupScene::update(float dtime)
 {
-	handleInput();
-	updateSelection();
+	if (!rigLocked)
+	{
+		handleInput();
+		updateSelection();
+	}
 
 	Scene::update(dtime);
 
@@ -37,6 +37,10 @@ public:
 
 	void ReloadScene(std::string characterFile);
 	std::map<std::string, Tracker*> GetTrackers() const;
+
+	// While locked, a background job reads the trackers, so they can not be placed, moved or selected. The scene keeps animating and drawing.
+	void SetRigLocked(bool state) { rigLocked = state; }
+	bool IsRigLocked() const { return rigLocked; }
 protected:
 	virtual void ClearScene();
 private:
@@ -81,6 +85,7 @@ private:
 
 	bool drawSkeleton;
 	bool drawTrackerOffset;
+	bool rigLocked;
 
 	// DEBUG VARIABLES
 	Avatar* avatar;
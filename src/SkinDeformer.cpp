@@ -0,0 +1,266 @@
+#include "SkinDeformer.h"
+#include "RigidTransform.h"
+#include <QDebug>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// Vertices per job, large enough to outweigh the queueing
+	const size_t BlockSize = 4096;
+}
+
+SkinDeformer::SkinDeformer(const VertexBuffer& vertexBuffer) :
+	vertexCount(vertexBuffer.vertices().size()),
+	slotCount(1),
+	maxJoint(0)
+{
+	const std::vector<Vector3>& vertices = vertexBuffer.vertices();
+	bindPositions.reserve(vertexCount * 3);
+	for (const Vector3& vertex : vertices)
+	{
+		bindPositions.push_back(vertex.x);
+		bindPositions.push_back(vertex.y);
+		bindPositions.push_back(vertex.z);
+	}
+
+	const std::vector<Vector3>& normals = vertexBuffer.normals();
+	if (normals.size() == vertexCount)
+	{
+		bindNormals.reserve(vertexCount * 3);
+		for (const Vector3& normal : normals)
+		{
+			bindNormals.push_back(normal.x);
+			bindNormals.push_back(normal.y);
+			bindNormals.push_back(normal.z);
+		}
+	}
+
+	// Vertices without weights stay in the bind pose of bone 0 with weight 0, like in the shader
+	// The weights are sorted, the used slots come first
+	const std::vector<VertexBuffer::JointWeights>& jointWeights = vertexBuffer.jointWeights();
+	size_t weightedCount = std::min(vertexCount, jointWeights.size());
+	for (size_t vertex = 0; vertex < weightedCount; ++vertex)
+		for (int slot = slotCount; slot < JOINTCOUNT; ++slot)
+			if (jointWeights[vertex].weights[slot] != 0.0f)
+				slotCount = slot + 1;
+
+	joints.assign(vertexCount * slotCount, 0);
+	weights.assign(vertexCount * slotCount, 0.0f);
+	for (size_t vertex = 0; vertex < weightedCount; ++vertex)
+	{
+		for (int slot = 0; slot < slotCount; ++slot)
+		{
+			joints[vertex * slotCount + slot] = jointWeights[vertex].ids[slot];
+			weights[vertex * slotCount + slot] = jointWeights[vertex].weights[slot];
+			maxJoint = std::max(maxJoint, jointWeights[vertex].ids[slot]);
+		}
+	}
+}
+
+bool SkinDeformer::Skin(const SkinnedModel& model, Mode mode, std::vector<Vector3>& positions, std::vector<Vector3>* normals, ThreadPool* pool) const
+{
+	return Run(model, mode, nullptr, vertexCount, positions, normals, pool);
+}
+
+bool SkinDeformer::SkinSubset(const SkinnedModel& model, Mode mode, const std::vector<unsigned int>& vertices, std::vector<Vector3>& positions, std::vector<Vector3>* normals, ThreadPool* pool) const
+{
+	for (unsigned int vertex : vertices)
+	{
+		if (vertex >= vertexCount)
+		{
+			qDebug() << "SkinDeformer: Vertex" << vertex << "is out of range";
+			return false;
+		}
+	}
+	return Run(model, mode, vertices.data(), vertices.size(), positions, normals, pool);
+}
+
+std::vector<unsigned int> SkinDeformer::FindVerticesNear(const Vector3& point, float radius) const
+{
+	std::vector<unsigned int> vertices;
+	float radiusSquared = radius * radius;
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		float dx = bindPositions[vertex * 3] - point.x;
+		float dy = bindPositions[vertex * 3 + 1] - point.y;
+		float dz = bindPositions[vertex * 3 + 2] - point.z;
+		if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+			vertices.push_back((unsigned int)vertex);
+	}
+	return vertices;
+}
+
+bool SkinDeformer::Run(const SkinnedModel& model, Mode mode, const unsigned int* vertices, size_t count, std::vector<Vector3>& positions, std::vector<Vector3>* normals, ThreadPool* pool) const
+{
+	Palette palette;
+	if (!BuildPalette(model, mode, palette))
+		return false;
+
+	positions.resize(count);
+	if (normals)
+		normals->resize(bindNormals.empty() ? 0 : count);
+	Vector3* normalOutput = normals && !bindNormals.empty() ? normals->data() : nullptr;
+
+	if (!pool || count <= BlockSize)
+	{
+		SkinRange(palette, mode, vertices, 0, count, positions.data(), normalOutput);
+		return true;
+	}
+
+	// The blocks write disjoint parts of the outputs
+	for (size_t begin = 0; begin < count; begin += BlockSize)
+	{
+		size_t end = std::min(begin + BlockSize, count);
+		pool->Enqueue([this, &palette, mode, vertices, begin, end, &positions, normalOutput](int)
+		{
+			SkinRange(palette, mode, vertices, begin, end, positions.data() + begin, normalOutput ? normalOutput + begin : nullptr);
+		});
+	}
+	pool->Wait();
+	return true;
+}
+
+bool SkinDeformer::BuildPalette(const SkinnedModel& model, Mode mode, Palette& palette) const
+{
+	const int* boneCount = nullptr;
+	const Matrix* bones = model.getBones(boneCount);
+	if (vertexCount > 0 && maxJoint >= *boneCount)
+	{
+		qDebug() << "SkinDeformer: Mesh references bone" << maxJoint << "but the model has" << *boneCount;
+		return false;
+	}
+
+	if (mode == Mode::LinearBlend)
+	{
+		palette.matrices.resize((size_t)*boneCount * 12);
+		for (int bone = 0; bone < *boneCount; ++bone)
+		{
+			const Matrix& matrix = bones[bone];
+			float* row = &palette.matrices[bone * 12];
+			row[0] = matrix.m00; row[1] = matrix.m01; row[2] = matrix.m02; row[3] = matrix.m03;
+			row[4] = matrix.m10; row[5] = matrix.m11; row[6] = matrix.m12; row[7] = matrix.m13;
+			row[8] = matrix.m20; row[9] = matrix.m21; row[10] = matrix.m22; row[11] = matrix.m23;
+		}
+		return true;
+	}
+
+	// The scale is blended apart from the rigid part, dual quaternions can not hold it
+	palette.dualQuaternions.resize((size_t)*boneCount * 8);
+	palette.scales.resize((size_t)*boneCount * 3);
+	for (int bone = 0; bone < *boneCount; ++bone)
+	{
+		RigidTransform pose = RigidTransform::FromMatrix(bones[bone]);
+		Quaternion real = pose.rotation.normalized();
+		Quaternion dual = Quaternion(pose.translation.x, pose.translation.y, pose.translation.z, 0.0f) * real * 0.5f;
+
+		float* dualQuaternion = &palette.dualQuaternions[bone * 8];
+		dualQuaternion[0] = real.x; dualQuaternion[1] = real.y; dualQuaternion[2] = real.z; dualQuaternion[3] = real.w;
+		dualQuaternion[4] = dual.x; dualQuaternion[5] = dual.y; dualQuaternion[6] = dual.z; dualQuaternion[7] = dual.w;
+
+		float* scale = &palette.scales[bone * 3];
+		scale[0] = pose.scale.x; scale[1] = pose.scale.y; scale[2] = pose.scale.z;
+	}
+	return true;
+}
+
+void SkinDeformer::SkinRange(const Palette& palette, Mode mode, const unsigned int* vertices, size_t begin, size_t end, Vector3* positions, Vector3* normals) const
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		unsigned int vertex = vertices ? vertices[i] : (unsigned int)i;
+		Vector3* normal = normals ? &normals[i - begin] : nullptr;
+		if (mode == Mode::LinearBlend)
+			SkinLinearBlend(palette, vertex, positions[i - begin], normal);
+		else
+			SkinDualQuaternion(palette, vertex, positions[i - begin], normal);
+	}
+}
+
+void SkinDeformer::SkinLinearBlend(const Palette& palette, unsigned int vertex, Vector3& position, Vector3* normal) const
+{
+	// Empty slots add zeros instead of ending the loop early
+	const int* vertexJoints = &joints[vertex * slotCount];
+	const float* vertexWeights = &weights[vertex * slotCount];
+	float blended[12] = {};
+	for (int slot = 0; slot < slotCount; ++slot)
+	{
+		const float* bone = &palette.matrices[vertexJoints[slot] * 12];
+		float weight = vertexWeights[slot];
+		for (int k = 0; k < 12; ++k)
+			blended[k] += bone[k] * weight;
+	}
+
+	const float* p = &bindPositions[vertex * 3];
+	position.x = blended[0] * p[0] + blended[1] * p[1] + blended[2] * p[2] + blended[3];
+	position.y = blended[4] * p[0] + blended[5] * p[1] + blended[6] * p[2] + blended[7];
+	position.z = blended[8] * p[0] + blended[9] * p[1] + blended[10] * p[2] + blended[11];
+
+	if (!normal)
+		return;
+
+	// The shader transforms normals with the blended matrix as well
+	const float* n = &bindNormals[vertex * 3];
+	Vector3 skinned(
+		blended[0] * n[0] + blended[1] * n[1] + blended[2] * n[2],
+		blended[4] * n[0] + blended[5] * n[1] + blended[6] * n[2],
+		blended[8] * n[0] + blended[9] * n[1] + blended[10] * n[2]);
+	float length = skinned.length();
+	*normal = length > 0.0f ? skinned * (1.0f / length) : skinned;
+}
+
+void SkinDeformer::SkinDualQuaternion(const Palette& palette, unsigned int vertex, Vector3& position, Vector3* normal) const
+{
+	const int* vertexJoints = &joints[vertex * slotCount];
+	const float* vertexWeights = &weights[vertex * slotCount];
+
+	// Rotations on the other hemisphere than the first one are flipped, so the blend takes the short way
+	const float* pivot = &palette.dualQuaternions[vertexJoints[0] * 8];
+	float blended[8] = {};
+	float scale[3] = {};
+	for (int slot = 0; slot < slotCount; ++slot)
+	{
+		const float* dualQuaternion = &palette.dualQuaternions[vertexJoints[slot] * 8];
+		const float* boneScale = &palette.scales[vertexJoints[slot] * 3];
+		float weight = vertexWeights[slot];
+		float hemisphere = dualQuaternion[0] * pivot[0] + dualQuaternion[1] * pivot[1] + dualQuaternion[2] * pivot[2] + dualQuaternion[3] * pivot[3];
+		float signedWeight = hemisphere < 0.0f ? -weight : weight;
+		for (int k = 0; k < 8; ++k)
+			blended[k] += dualQuaternion[k] * signedWeight;
+		for (int k = 0; k < 3; ++k)
+			scale[k] += boneScale[k] * weight;
+	}
+
+	const float* p = &bindPositions[vertex * 3];
+	float length = std::sqrt(blended[0] * blended[0] + blended[1] * blended[1] + blended[2] * blended[2] + blended[3] * blended[3]);
+	if (length == 0.0f)
+	{
+		// No weights at all, the linear blend would collapse the vertex to the origin the same way
+		position = Vector3::zero;
+		if (normal)
+			*normal = Vector3::zero;
+		return;
+	}
+	for (int k = 0; k < 8; ++k)
+		blended[k] /= length;
+
+	Vector3 realVector(blended[0], blended[1], blended[2]);
+	float realScalar = blended[3];
+	Vector3 dualVector(blended[4], blended[5], blended[6]);
+	float dualScalar = blended[7];
+
+	// Rotates the scaled point with the real part, the translation is 2 * dual * conjugate(real)
+	Vector3 scaled(p[0] * scale[0], p[1] * scale[1], p[2] * scale[2]);
+	Vector3 rotated = scaled + realVector.cross(realVector.cross(scaled) + scaled * realScalar) * 2.0f;
+	Vector3 translation = (dualVector * realScalar - realVector * dualScalar + realVector.cross(dualVector)) * 2.0f;
+	position = rotated + translation;
+
+	if (!normal)
+		return;
+
+	const float* n = &bindNormals[vertex * 3];
+	Vector3 bindNormal(n[0], n[1], n[2]);
+	Vector3 skinned = bindNormal + realVector.cross(realVector.cross(bindNormal) + bindNormal * realScalar) * 2.0f;
+	float normalLength = skinned.length();
+	*normal = normalLength > 0.0f ? skinned * (1.0f / normalLength) : skinned;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include "VertexBuffer.h"
+#include "SkinnedModel.h"
+#include "ThreadPool.h"
+
+// CPU counterpart of the skinning in vsphongskinned.glsl, for features which need the deformed surface like
+// skinned picking, soft tissue markers or per vertex error maps. The weights of a mesh are compiled into flat
+// tables with as many slots per vertex as its most influenced vertex needs, so every vertex runs the same
+// branchless loop over plain floats. Meshes with pruned weights get shorter loops that way.
+// Besides the linear blend of the shader, dual quaternion blending keeps the volume around twisting joints.
+class SkinDeformer
+{
+public:
+	enum class Mode
+	{
+		LinearBlend,
+		DualQuaternion
+	};
+
+	// Copies the bind pose and the weights of the mesh, the vertex buffer is not needed afterwards
+	SkinDeformer(const VertexBuffer& vertexBuffer);
+
+	size_t GetVertexCount() const { return vertexCount; }
+
+	/// <summary>
+	/// Skins every vertex with the current bones of the model. The results are in model space like the bones,
+	/// the global transform of the model is not applied.
+	/// </summary>
+	/// <param name="normals">Receives the skinned normals if not null and the mesh has normals</param>
+	/// <param name="pool">Skins blocks of vertices in parallel if set, it must not run other jobs meanwhile</param>
+	/// <returns>False if the mesh references bones the model does not have</returns>
+	bool Skin(const SkinnedModel& model, Mode mode, std::vector<Vector3>& positions, std::vector<Vector3>* normals = nullptr, ThreadPool* pool = nullptr) const;
+
+	/// <summary>
+	/// Same as Skin for the listed vertices only, the results follow the order of the list
+	/// </summary>
+	bool SkinSubset(const SkinnedModel& model, Mode mode, const std::vector<unsigned int>& vertices, std::vector<Vector3>& positions, std::vector<Vector3>* normals = nullptr, ThreadPool* pool = nullptr) const;
+
+	// The vertices within the radius around a point in the bind pose, like the surface under a tracker
+	std::vector<unsigned int> FindVerticesNear(const Vector3& point, float radius) const;
+private:
+	// The current bones in the layout the kernels read
+	struct Palette
+	{
+		// Upper 3x4 of every bone matrix, row by row
+		std::vector<float> matrices;
+		// Real part then dual part per bone, both as x, y, z, w
+		std::vector<float> dualQuaternions;
+		std::vector<float> scales;
+	};
+
+	bool BuildPalette(const SkinnedModel& model, Mode mode, Palette& palette) const;
+	// Skins the vertices [begin, end) of the list, or of the mesh if the list is null, into the outputs starting at 0
+	void SkinRange(const Palette& palette, Mode mode, const unsigned int* vertices, size_t begin, size_t end, Vector3* positions, Vector3* normals) const;
+	void SkinLinearBlend(const Palette& palette, unsigned int vertex, Vector3& position, Vector3* normal) const;
+	void SkinDualQuaternion(const Palette& palette, unsigned int vertex, Vector3& position, Vector3* normal) const;
+	bool Run(const SkinnedModel& model, Mode mode, const unsigned int* vertices, size_t count, std::vector<Vector3>& positions, std::vector<Vector3>* normals, ThreadPool* pool) const;
+
+	size_t vertexCount;
+	// Three floats per vertex, the normals are empty if the mesh has none
+	std::vector<float> bindPositions;
+	std::vector<float> bindNormals;
+	// slotCount slots per vertex
+	int slotCount;
+	std::vector<int> joints;
+	std::vector<float> weights;
+	int maxJoint;
+};
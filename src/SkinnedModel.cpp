@@ -145,55 +145,61 @@ std::vector<Transform*> SkinnedModel::ConvertRepresentationToTransforms()
 
 void SkinnedModel::SetIdentityPose()
 {
-	SetIdentityPose(&RootNode, Matrix::identity);
+	SetIdentityPose(&RootNode, RigidTransform::identity, RigidTransform::FromMatrix(getGlobalTransform()));
 	UpdateBoneAnimation();
 }
 
-void SkinnedModel::SetIdentityPose(const MeshModel::Node* node, const Matrix& localToMeshTransform)
+void SkinnedModel::SetIdentityPose(const MeshModel::Node* node, const RigidTransform& localToMeshPose, const RigidTransform& modelPose)
 {
-	std::string nodeName = node->Name;
-	Matrix meshTransform = localToMeshTransform * node->Trans;
+	const std::string& nodeName = node->Name;
+	RigidTransform meshPose = localToMeshPose * node->Pose;
 
 	auto& jointMapping = GetJointMapping();
-	if (jointMapping.find(nodeName) != jointMapping.end())
+	auto joint = jointMapping.find(nodeName);
+	if (joint != jointMapping.end())
 	{
-		SkinnedModel::JointInfo& info = jointMapping.at(nodeName);
+		SkinnedModel::JointInfo& info = joint->second;
 
-		//override meshtransform for identity matrix insertion
-		meshTransform = RootNode.Trans * Matrix(info.offset).invert();
+		//override meshtransform for identity matrix insertion, the offsets are rigid so their inverse is closed form
+		meshPose = RootNode.Pose * RigidTransform::FromMatrix(info.offset).Inverse();
 
 		info.transform = Matrix::identity;
-		info.localTransform = Matrix(localToMeshTransform).invert() * meshTransform;
-		info.globalTransform = getGlobalTransform() * meshTransform;
+		info.localPose = localToMeshPose.Inverse() * meshPose;
+		info.globalPose = modelPose * meshPose;
+		info.localTransform = info.localPose.ToMatrix();
+		info.globalTransform = info.globalPose.ToMatrix();
 	}
 
 	for (int i = 0; i < node->ChildCount; i++)
-		SetIdentityPose(&node->Children[i], meshTransform);
+		SetIdentityPose(&node->Children[i], meshPose, modelPose);
 }
 
 void SkinnedModel::SetDefaultPose()
 {
-	SetDefaultPose(&RootNode, Matrix::identity);
+	SetDefaultPose(&RootNode, RigidTransform::identity, RigidTransform::FromMatrix(getGlobalTransform()));
 	UpdateBoneAnimation();
 }
 
-void SkinnedModel::SetDefaultPose(const MeshModel::Node* node, const Matrix& localToMeshTransform)
+void SkinnedModel::SetDefaultPose(const MeshModel::Node* node, const RigidTransform& localToMeshPose, const RigidTransform& modelPose)
 {
-	std::string nodeName = node->Name;
-	Matrix meshTransform = localToMeshTransform * node->Trans;
+	const std::string& nodeName = node->Name;
+	RigidTransform meshPose = localToMeshPose * node->Pose;
 
 	auto& jointMapping = GetJointMapping();
-	if (jointMapping.find(nodeName) != jointMapping.end())
+	auto joint = jointMapping.find(nodeName);
+	if (joint != jointMapping.end())
 	{
-		SkinnedModel::JointInfo& info = jointMapping.at(nodeName);
+		SkinnedModel::JointInfo& info = joint->second;
 
-		info.transform = inverseMeshTransform * meshTransform * info.offset;
+		info.transform = inverseMeshTransform * meshPose.ToMatrix() * info.offset;
+		info.localPose = node->Pose;
+		info.globalPose = modelPose * meshPose;
 		info.localTransform = node->Trans;
-		info.globalTransform = getGlobalTransform() * meshTransform;
+		info.globalTransform = info.globalPose.ToMatrix();
 	}
 
 	for (int i = 0; i < node->ChildCount; i++)
-		SetDefaultPose(&node->Children[i], meshTransform);
+		SetDefaultPose(&node->Children[i], meshPose, modelPose);
 }
 
 void SkinnedModel::draw(const BaseCamera& Cam)
@@ -24,8 +24,8 @@ public:
 	std::vector<Transform*> ConvertRepresentationToTransforms();
 	void SetDefaultPose();
 	void SetIdentityPose();
-	void SetIdentityPose(const MeshModel::Node* node, const Matrix& localToMeshTransform);
-	void SetDefaultPose(const MeshModel::Node* node, const Matrix& parentTransform);
+	void SetIdentityPose(const MeshModel::Node* node, const RigidTransform& localToMeshPose, const RigidTransform& modelPose);
+	void SetDefaultPose(const MeshModel::Node* node, const RigidTransform& localToMeshPose, const RigidTransform& modelPose);
 
 	void UpdateTransformsFromJointMapping(const std::vector<Transform*>& transforms);
 	void UpdateJointMappingFromTransforms(const std::vector<Transform*>& transforms);
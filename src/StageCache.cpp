@@ -0,0 +1,217 @@
+#include "StageCache.h"
+#include "PipelineOptions.h"
+#include "RunJournal.h"
+#include <QFile>
+#include <QDebug>
+#include <filesystem>
+#include <algorithm>
+
+const int StageCache::CodeVersion = 4;
+
+namespace
+{
+	// The cached data never leaves this machine, so the keys are stored as they are in memory
+	template <typename T>
+	void AppendArray(QByteArray& data, const std::vector<T>& values)
+	{
+		uint32_t count = (uint32_t)values.size();
+		data.append((const char*)&count, sizeof(count));
+		data.append((const char*)values.data(), (int)(values.size() * sizeof(T)));
+	}
+
+	template <typename T>
+	bool ReadArray(const QByteArray& data, int& offset, std::vector<T>& values)
+	{
+		uint32_t count;
+		if (offset + (int)sizeof(count) > data.size())
+			return false;
+		memcpy(&count, data.constData() + offset, sizeof(count));
+		offset += sizeof(count);
+
+		if (offset + (long long)count * sizeof(T) > data.size())
+			return false;
+		values.resize(count);
+		memcpy(values.data(), data.constData() + offset, count * sizeof(T));
+		offset += count * sizeof(T);
+		return true;
+	}
+}
+
+StageCache::StageCache() : scanned(false), totalSize(0)
+{
+	directory = (std::filesystem::current_path() / "cache").string();
+}
+
+StageCache& StageCache::instance()
+{
+	static StageCache* instance = new StageCache();
+	return *instance;
+}
+
+bool StageCache::IsEnabled() const
+{
+	return PipelineOptions::instance().cacheSizeLimit > 0;
+}
+
+std::string StageCache::GetKey(const std::string& stage, const QJsonObject& inputs) const
+{
+	QJsonObject key = inputs;
+	key.insert("stage", stage.c_str());
+	key.insert("codeVersion", CodeVersion);
+	return RunJournal::HashJson(key);
+}
+
+bool StageCache::Load(const std::string& stage, const std::string& key, QByteArray& data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::string path = GetEntryPath(stage, key);
+
+	QFile file(path.c_str());
+	if (!file.open(QFile::ReadOnly))
+		return false;
+	data = file.readAll();
+	file.close();
+
+	// The write time doubles as the last access for the eviction
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return true;
+}
+
+void StageCache::Store(const std::string& stage, const std::string& key, const QByteArray& data)
+{
+	unsigned long long sizeLimit = (unsigned long long)PipelineOptions::instance().cacheSizeLimit * 1024 * 1024;
+	if (sizeLimit == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	ScanEntries();
+
+	std::string path = GetEntryPath(stage, key);
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+	std::error_code error;
+	unsigned long long previousSize = std::filesystem::exists(path) ? std::filesystem::file_size(path, error) : 0;
+
+	// Written aside and renamed, so a crash never leaves a torn entry
+	std::string temporaryPath = path + ".tmp";
+	QFile file(temporaryPath.c_str());
+	if (!file.open(QFile::WriteOnly) || file.write(data) != data.size())
+	{
+		qDebug() << "StageCache: could not write" << temporaryPath.c_str();
+		return;
+	}
+	file.close();
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+		return;
+
+	totalSize += data.size() - previousSize;
+	if (totalSize > sizeLimit)
+		Evict(sizeLimit);
+}
+
+bool StageCache::LoadFile(const std::string& stage, const std::string& key, const std::string& targetPath)
+{
+	QByteArray data;
+	if (!Load(stage, key, data))
+		return false;
+
+	QFile file(targetPath.c_str());
+	if (!file.open(QFile::WriteOnly))
+		return false;
+	return file.write(data) == data.size();
+}
+
+void StageCache::StoreFile(const std::string& stage, const std::string& key, const std::string& sourcePath)
+{
+	QFile file(sourcePath.c_str());
+	if (!file.open(QFile::ReadOnly))
+		return;
+	Store(stage, key, file.readAll());
+}
+
+std::string StageCache::GetEntryPath(const std::string& stage, const std::string& key) const
+{
+	return (std::filesystem::path(directory) / stage / key).string();
+}
+
+void StageCache::ScanEntries()
+{
+	if (scanned)
+		return;
+	scanned = true;
+
+	totalSize = 0;
+	if (!std::filesystem::exists(directory))
+		return;
+
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory))
+		if (entry.is_regular_file())
+			totalSize += entry.file_size();
+}
+
+void StageCache::Evict(unsigned long long sizeLimit)
+{
+	struct Entry
+	{
+		std::filesystem::file_time_type lastAccess;
+		unsigned long long size;
+		std::filesystem::path path;
+	};
+
+	std::vector<Entry> entries;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory))
+		if (entry.is_regular_file())
+			entries.push_back({ entry.last_write_time(), entry.file_size(), entry.path() });
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastAccess < b.lastAccess; });
+
+	// Evict below the limit, so not every store has to scan the directory again
+	unsigned long long targetSize = sizeLimit / 10 * 9;
+	for (const Entry& entry : entries)
+	{
+		if (totalSize <= targetSize)
+			break;
+
+		std::error_code error;
+		if (std::filesystem::remove(entry.path, error))
+			totalSize -= std::min(totalSize, entry.size);
+	}
+}
+
+QByteArray StageCache::SerializeCurve(const AnimationCurve& curve)
+{
+	QByteArray data;
+	AppendArray(data, curve.positions);
+	AppendArray(data, curve.rotations);
+	AppendArray(data, curve.scalings);
+	return data;
+}
+
+bool StageCache::DeserializeCurve(const QByteArray& data, AnimationCurve& curve)
+{
+	int offset = 0;
+	return ReadArray(data, offset, curve.positions)
+		&& ReadArray(data, offset, curve.rotations)
+		&& ReadArray(data, offset, curve.scalings);
+}
+
+QByteArray StageCache::SerializeSeries(const std::string& name, const std::vector<double>& timestamps, const std::vector<float>& series)
+{
+	QByteArray data;
+	AppendArray(data, std::vector<char>(name.begin(), name.end()));
+	AppendArray(data, timestamps);
+	AppendArray(data, series);
+	return data;
+}
+
+bool StageCache::DeserializeSeries(const QByteArray& data, std::string& name, std::vector<double>& timestamps, std::vector<float>& series)
+{
+	int offset = 0;
+	std::vector<char> nameData;
+	if (!ReadArray(data, offset, nameData) || !ReadArray(data, offset, timestamps) || !ReadArray(data, offset, series))
+		return false;
+	name.assign(nameData.begin(), nameData.end());
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <QByteArray>
+#include <QJsonObject>
+#include "AnimationCurve.h"
+
+// Singleton
+// Content addressed store for the outputs of pipeline stages. Entries are keyed by a hash of everything
+// the output depends on, so a re-run only recomputes stages whose inputs changed.
+// The size is bounded by PipelineOptions::cacheSizeLimit, least recently used entries get evicted first.
+// All methods are thread safe.
+class StageCache
+{
+public:
+	// Bump whenever a stage produces different output for the same inputs, so older entries stop matching
+	static const int CodeVersion;
+
+	static StageCache& instance();
+
+	bool IsEnabled() const;
+
+	// Hash of the stage inputs and the code version
+	std::string GetKey(const std::string& stage, const QJsonObject& inputs) const;
+
+	bool Load(const std::string& stage, const std::string& key, QByteArray& data);
+	void Store(const std::string& stage, const std::string& key, const QByteArray& data);
+	// Copies a cached file output to the target path
+	bool LoadFile(const std::string& stage, const std::string& key, const std::string& targetPath);
+	void StoreFile(const std::string& stage, const std::string& key, const std::string& sourcePath);
+
+	static QByteArray SerializeCurve(const AnimationCurve& curve);
+	static bool DeserializeCurve(const QByteArray& data, AnimationCurve& curve);
+	// A per frame metric series together with the name of the animation and its sample times
+	static QByteArray SerializeSeries(const std::string& name, const std::vector<double>& timestamps, const std::vector<float>& series);
+	static bool DeserializeSeries(const QByteArray& data, std::string& name, std::vector<double>& timestamps, std::vector<float>& series);
+private:
+	StageCache();
+	StageCache(const StageCache&);
+
+	std::string GetEntryPath(const std::string& stage, const std::string& key) const;
+	// Both expect the mutex to be held
+	void ScanEntries();
+	void Evict(unsigned long long sizeLimit);
+
+	std::mutex mutex;
+	std::string directory;
+	bool scanned;
+	unsigned long long totalSize;
+};
@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include <QDebug>
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) : activeJobs(0), stopping(false)
+{
+	if (threadCount <= 0)
+		threadCount = DefaultThreadCount();
+
+	threads.reserve(threadCount);
+	for (int worker = 0; worker < threadCount; ++worker)
+		threads.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+int ThreadPool::DefaultThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::Enqueue(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobsFinished.wait(lock, [this]() { return jobs.empty() && activeJobs == 0; });
+}
+
+bool ThreadPool::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.empty() && activeJobs == 0;
+}
+
+void ThreadPool::WorkerLoop(int worker)
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			// Only stop once everything queued has been processed
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			activeJobs++;
+		}
+
+		try
+		{
+			job(worker);
+		}
+		catch (const std::exception& e)
+		{
+			qDebug() << "Exception in worker" << worker << ":" << e.what();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeJobs--;
+		}
+		jobsFinished.notify_all();
+	}
+}
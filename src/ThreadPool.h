@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed size pool of worker threads processing a shared job queue
+class ThreadPool
+{
+public:
+	// The job receives the index of the executing worker, so callers can keep per worker state
+	typedef std::function<void(int worker)> Job;
+
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="threadCount">The amount of workers, 0 uses one per hardware thread</param>
+	ThreadPool(int threadCount = 0);
+	// Finishes all queued jobs before joining the workers
+	~ThreadPool();
+
+	int GetThreadCount() const { return threads.size(); }
+
+	void Enqueue(Job job);
+	// Blocks until the queue is empty and no job is running anymore
+	void Wait();
+	bool IsIdle();
+
+	// One per hardware thread, at least one
+	static int DefaultThreadCount();
+private:
+	ThreadPool(const ThreadPool&);
+
+	void WorkerLoop(int worker);
+
+	std::vector<std::thread> threads;
+	std::deque<Job> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsFinished;
+	int activeJobs;
+	bool stopping;
+};
@@ -2,6 +2,13 @@
 #include "AttachedModel.h"
 #include "Parameter.h"
 
+// How far a solver should trust the poses of a tracker, as weights in [0, 1]
+struct TrackerConfidence
+{
+	float position = 1.0f;
+	float orientation = 1.0f;
+};
+
 class Tracker
 {
 public:
@@ -0,0 +1,157 @@
+#include "TrackerTrajectory.h"
+#include "AttachmentBatch.h"
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Grid times posed before the attachment batch evaluates them together
+	const int RecordBlockFrames = 64;
+}
+
+TrackerTrajectory::TrackerTrajectory(Animator& animator, const Tracker& tracker, int sampleRate) :
+	TrackerTrajectory(animator.GetAnimationLength(), sampleRate)
+{
+	Record(animator, { &tracker }, { this });
+}
+
+TrackerTrajectory::TrackerTrajectory(float duration, int sampleRate) :
+	sampleRate(std::max(1, sampleRate)),
+	duration(duration)
+{
+}
+
+std::vector<TrackerTrajectory*> TrackerTrajectory::SampleAll(Animator& animator, const std::vector<const Tracker*>& trackers, int sampleRate)
+{
+	std::vector<TrackerTrajectory*> trajectories;
+	for (size_t i = 0; i < trackers.size(); ++i)
+		trajectories.push_back(new TrackerTrajectory(animator.GetAnimationLength(), sampleRate));
+	Record(animator, trackers, trajectories);
+	return trajectories;
+}
+
+void TrackerTrajectory::Record(Animator& animator, const std::vector<const Tracker*>& trackers, const std::vector<TrackerTrajectory*>& trajectories)
+{
+	if (trajectories.empty())
+		return;
+
+	// All trajectories share the grid, the last sample lands on the end of the animation, like the last virtualizer sample
+	float duration = trajectories[0]->duration;
+	int sampleRate = trajectories[0]->sampleRate;
+	int sampleCount = (int)std::ceil(duration * sampleRate) + 1;
+	for (TrackerTrajectory* trajectory : trajectories)
+	{
+		trajectory->positions.reserve(sampleCount);
+		trajectory->rotations.reserve(sampleCount);
+		trajectory->scalings.reserve(sampleCount);
+	}
+
+	std::vector<const AttachedModel*> models;
+	for (const Tracker* tracker : trackers)
+		models.push_back(tracker->GetModel());
+	AttachmentBatch batch(models, animator.GetModel());
+
+	// The grid is posed in blocks, the batch then runs every tracker through the whole block. Without
+	// bones of the posed model to copy, the trackers read their live bones and every frame is its own block.
+	int boneCount = batch.GetPosedBoneCount();
+	int blockLength = boneCount > 0 ? RecordBlockFrames : 1;
+	std::vector<Matrix> poses((size_t)blockLength * boneCount);
+	std::vector<Matrix> transforms;
+	for (int blockStart = 0; blockStart < sampleCount; blockStart += blockLength)
+	{
+		int blockFrames = std::min(blockLength, sampleCount - blockStart);
+		for (int frame = 0; frame < blockFrames; ++frame)
+		{
+			int sample = blockStart + frame;
+			float normalizedTime = duration > 0.0f ? std::min(sample / (duration * sampleRate), 1.0f) : 0.0f;
+			animator.SetNormalizedAnimationTime(normalizedTime);
+
+			const int* posedBoneCount = nullptr;
+			const Matrix* bones = animator.GetModel()->getBones(posedBoneCount);
+			if (boneCount > 0)
+				std::copy(bones, bones + boneCount, poses.begin() + (size_t)frame * boneCount);
+		}
+
+		batch.EvaluateFrames(poses, blockFrames, transforms);
+		for (int frame = 0; frame < blockFrames; ++frame)
+		{
+			for (size_t i = 0; i < trajectories.size(); ++i)
+			{
+				const Matrix& transform = transforms[frame * batch.GetSize() + i];
+				trajectories[i]->positions.push_back(transform.translation());
+				trajectories[i]->rotations.push_back(transform.rotation());
+				trajectories[i]->scalings.push_back(transform.scale());
+			}
+		}
+	}
+}
+
+void TrackerTrajectory::Locate(float normalizedTime, int& sample, float& weight) const
+{
+	float position = std::clamp(normalizedTime, 0.0f, 1.0f) * duration * sampleRate;
+	int last = (int)positions.size() - 1;
+
+	// Queries on the grid must not pick up float noise from the neighbour
+	float rounded = std::round(position);
+	if (std::abs(position - rounded) < 1e-3f)
+		position = rounded;
+
+	sample = std::min((int)position, last);
+	weight = 0.0f;
+	if (sample < last)
+	{
+		// The last sample sits on the end of the animation, which need not be on the grid
+		float span = sample + 1 == last ? duration * sampleRate - sample : 1.0f;
+		weight = span > 0.0f ? std::min((position - sample) / span, 1.0f) : 0.0f;
+	}
+}
+
+Vector3 TrackerTrajectory::GetPosition(float normalizedTime) const
+{
+	int sample;
+	float weight;
+	Locate(normalizedTime, sample, weight);
+	if (weight == 0.0f)
+		return positions[sample];
+	return Vector3::Lerp(positions[sample], positions[sample + 1], weight);
+}
+
+Quaternion TrackerTrajectory::GetRotation(float normalizedTime) const
+{
+	int sample;
+	float weight;
+	Locate(normalizedTime, sample, weight);
+	if (weight == 0.0f)
+		return rotations[sample];
+	return Quaternion::Slerp(rotations[sample], rotations[sample + 1], weight);
+}
+
+Matrix TrackerTrajectory::GetTransform(float normalizedTime) const
+{
+	int sample;
+	float weight;
+	Locate(normalizedTime, sample, weight);
+
+	Vector3 scaling = weight == 0.0f ? scalings[sample] : Vector3::Lerp(scalings[sample], scalings[sample + 1], weight);
+	Matrix scalingMatrix = Matrix().scale(scaling);
+	Matrix rotationMatrix = GetRotation(normalizedTime).toRotationMatrix();
+	Matrix translationMatrix = Matrix().translation(GetPosition(normalizedTime));
+	return translationMatrix * rotationMatrix * scalingMatrix;
+}
+
+int TrackerTrajectory::GetCommonSampleRate(const std::vector<int>& rates, int maxRate)
+{
+	int commonRate = 1;
+	int largestRate = 1;
+	for (int rate : rates)
+	{
+		// Stages without a fixed rate read interpolated transforms anyway
+		if (rate <= 0)
+			continue;
+		commonRate = std::lcm(commonRate, rate);
+		largestRate = std::max(largestRate, rate);
+	}
+
+	return commonRate <= maxRate ? commonRate : std::max(largestRate, maxRate);
+}
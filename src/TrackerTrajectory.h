@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "Animator.h"
+#include "Tracker.h"
+
+// Global transforms of a tracker sampled once on a fixed grid. Several virtualizer configurations
+// can read the ground truth from it concurrently, without posing the skeleton again.
+class TrackerTrajectory
+{
+public:
+	/// <summary>
+	/// Poses the animator at every grid time and records the tracker transform
+	/// </summary>
+	/// <param name="animator">Holds the ground truth animation. Its model is the one sampled, the tracker may be attached to another model of the same rig.</param>
+	/// <param name="sampleRate">Grid rate, queries at multiples of a rate dividing it are exact</param>
+	TrackerTrajectory(Animator& animator, const Tracker& tracker, int sampleRate);
+
+	// Same for several trackers on the same animator, every grid time is posed once for all of them
+	static std::vector<TrackerTrajectory*> SampleAll(Animator& animator, const std::vector<const Tracker*>& trackers, int sampleRate);
+
+	// Times are normalized like the TrackerHandle ones, in between grid times the transform gets interpolated
+	Vector3 GetPosition(float normalizedTime) const;
+	Quaternion GetRotation(float normalizedTime) const;
+	Matrix GetTransform(float normalizedTime) const;
+
+	int GetSampleRate() const { return sampleRate; }
+
+	// Least common multiple of the known rates, so all of them hit grid times. Falls back to the largest rate above maxRate.
+	static int GetCommonSampleRate(const std::vector<int>& rates, int maxRate);
+private:
+	TrackerTrajectory(float duration, int sampleRate);
+	static void Record(Animator& animator, const std::vector<const Tracker*>& trackers, const std::vector<TrackerTrajectory*>& trajectories);
+
+	// Sample before the time and the interpolation weight towards the next one
+	void Locate(float normalizedTime, int& sample, float& weight) const;
+
+	int sampleRate;
+	float duration;
+	std::vector<Vector3> positions;
+	std::vector<Quaternion> rotations;
+	std::vector<Vector3> scalings;
+};
@@ -1,10 +1,11 @@
 
 #include "VertexBuffer.h"
 #include <assert.h>
+#include <cmath>
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
-VertexBuffer::VertexBuffer() : ActiveAttributes(0), WithinBeginBlock(false), VAO(0), VBO(0), VertexCount(0), BuffersInitialized(false)
+VertexBuffer::VertexBuffer() : ActiveAttributes(0), WithinBeginBlock(false), VAO(0), VBO(0), VertexCount(0), BuffersInitialized(false), PackedInfluences(0)
 {
     
 }
@@ -37,6 +38,7 @@ void VertexBuffer::begin()
     Texcoord2.clear();
     Texcoord3.clear();
 	Weights.clear();
+	PackedInfluences = 0;
     WithinBeginBlock = true;
 }
 
@@ -94,6 +96,44 @@ void VertexBuffer::addJointWeights(const JointWeights& weights)
 	Weights.push_back(weights.Sorted());
 }
 
+void VertexBuffer::packJoints(int influences)
+{
+	if (!WithinBeginBlock) { std::cout << "call packJoints only between begin and end method!\n"; return; }
+	PackedInfluences = std::max(0, std::min(influences, JOINTCOUNT));
+}
+
+VertexBuffer::JointWeights VertexBuffer::JointWeights::Pruned(int influences) const
+{
+	JointWeights pruned;
+	influences = std::max(1, std::min(influences, JOINTCOUNT));
+
+	float total = 0.0f;
+	for (int i = 0; i < influences; i++)
+		total += weights[i];
+	if (total <= 0.0f)
+		return pruned;
+
+	// The largest weight takes up the rounding error, so the steps still sum up to one
+	int steps[JOINTCOUNT] = {};
+	int totalSteps = 0;
+	for (int i = 0; i < influences; i++)
+	{
+		steps[i] = (int)std::lround(weights[i] / total * JOINTWEIGHTSTEPS);
+		totalSteps += steps[i];
+	}
+	steps[0] += JOINTWEIGHTSTEPS - totalSteps;
+
+	for (int i = 0; i < influences; i++)
+	{
+		// Influences rounded away end the list like any other empty slot
+		if (steps[i] <= 0)
+			break;
+		pruned.ids[i] = ids[i];
+		pruned.weights[i] = (float)steps[i] / JOINTWEIGHTSTEPS;
+	}
+	return pruned;
+}
+
 void VertexBuffer::addVertex( float x, float y, float z)
 {
     addVertex( Vector3(x,y,z) );
@@ -161,6 +201,19 @@ void VertexBuffer::end()
 		((ActiveAttributes & TEXCOORD2) ? 3 * sizeof(float) : 0) +
 		((ActiveAttributes & TEXCOORD3) ? 3 * sizeof(float) : 0) +
 		((ActiveAttributes & JOINTS) ? JOINTCOUNT * (sizeof(float) + sizeof(float)) : 0);*/
+	// Packed joints hold their ids in bytes, or in shorts for larger rigs, and the weights as unorm16
+	int jointVectors = (JOINTCOUNT + JOINTSIZE - 1) / JOINTSIZE;
+	int packedVectors = (PackedInfluences + JOINTSIZE - 1) / JOINTSIZE;
+	GLuint idSize = sizeof(GLubyte);
+	if (PackedInfluences > 0)
+		for (const JointWeights& weights : Weights)
+			for (int j = 0; j < JOINTCOUNT; j++)
+				if (weights.ids[j] > 255)
+					idSize = sizeof(GLushort);
+	GLuint JointElementSize = PackedInfluences > 0 ?
+		packedVectors * JOINTSIZE * (idSize + sizeof(GLushort)) :
+		JOINTCOUNT * (sizeof(float) + sizeof(float));
+
 	GLuint ElementSize = 4 * sizeof(float) +
 		4 * sizeof(float) +
 		((ActiveAttributes & COLOR) ? 4 * sizeof(float) : 0) +
@@ -168,7 +221,7 @@ void VertexBuffer::end()
 		3 * sizeof(float) +
 		3 * sizeof(float) +
 		3 * sizeof(float) +
-		((ActiveAttributes & JOINTS) ? JOINTCOUNT * (sizeof(float) + sizeof(float)) : 0);
+		((ActiveAttributes & JOINTS) ? JointElementSize : 0);
 	GLuint BufferSize = (GLuint)Vertices.size() * ElementSize;
 
 	char* ByteBuf = new char[BufferSize];
@@ -259,7 +312,25 @@ void VertexBuffer::end()
 			*(++Buffer) = 0.0f;
 		}
 
-		if (ActiveAttributes & JOINTS)
+		if ((ActiveAttributes & JOINTS) && PackedInfluences > 0)
+		{
+			GLubyte* Packed = (GLubyte*)(Buffer + 1);
+			for (int j = 0; j < packedVectors * JOINTSIZE; j++)
+			{
+				if (idSize == sizeof(GLubyte))
+					*Packed = (GLubyte)Weights[i].ids[j];
+				else
+					*(GLushort*)Packed = (GLushort)Weights[i].ids[j];
+				Packed += idSize;
+			}
+			for (int j = 0; j < packedVectors * JOINTSIZE; j++)
+			{
+				*(GLushort*)Packed = (GLushort)std::lround(Weights[i].weights[j] * JOINTWEIGHTSTEPS);
+				Packed += sizeof(GLushort);
+			}
+			Buffer = (float*)Packed - 1;
+		}
+		else if (ActiveAttributes & JOINTS)
 		{
 			for (int j = 0; j < JOINTCOUNT; j++)
 				*(++Buffer) = (float)Weights[i].ids[j];
@@ -312,9 +383,29 @@ void VertexBuffer::end()
 	glVertexAttribPointer(Index++, 3, GL_FLOAT, GL_FALSE, ElementSize, BUFFER_OFFSET(Offset));
 	Offset += 3 * sizeof(float);
 
-	if (ActiveAttributes & JOINTS)
+	if ((ActiveAttributes & JOINTS) && PackedInfluences > 0)
+	{
+		// The shaders expect the weights at fixed locations behind all id vectors. The vectors left out stay
+		// disabled, their weights read as zero and end the loop over the influences.
+		GLuint WeightIndex = Index + jointVectors;
+		for (int i = 0; i < packedVectors; i++)
+		{
+			glEnableVertexAttribArray(Index + i);
+			glVertexAttribPointer(Index + i, JOINTSIZE, idSize == sizeof(GLubyte) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT, GL_FALSE, ElementSize, BUFFER_OFFSET(Offset));
+			Offset += JOINTSIZE * idSize;
+		}
+
+		for (int i = 0; i < packedVectors; i++)
+		{
+			glEnableVertexAttribArray(WeightIndex + i);
+			glVertexAttribPointer(WeightIndex + i, JOINTSIZE, GL_UNSIGNED_SHORT, GL_TRUE, ElementSize, BUFFER_OFFSET(Offset));
+			Offset += JOINTSIZE * sizeof(GLushort);
+		}
+		Index += 2 * jointVectors;
+	}
+	else if (ActiveAttributes & JOINTS)
 	{
-		int vectorCount = (JOINTCOUNT + JOINTSIZE - 1) / JOINTSIZE;
+		int vectorCount = jointVectors;
 		for(int i = 0; i < vectorCount; i++)
 		{
 			int vectorSize = std::min(JOINTCOUNT - JOINTSIZE * i, JOINTSIZE);
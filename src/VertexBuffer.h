@@ -3,6 +3,7 @@
 #define VertexBuffer_hpp
 #define JOINTCOUNT 8
 #define JOINTSIZE 4
+#define JOINTWEIGHTSTEPS 65535
 
 #include <iostream>
 #include <vector>
@@ -87,6 +88,10 @@ public:
 
 			return sorted;
 		}
+
+		// The strongest influences of sorted weights scaled to sum up to one again. The weights are rounded to the
+		// unorm16 steps of a packed buffer, so the weights kept on the cpu match the ones the shaders read.
+		JointWeights Pruned(int influences) const;
 	};
     
     VertexBuffer();
@@ -103,6 +108,9 @@ public:
     void addVertex( float x, float y, float z);
     void addVertex( const Vector3& v);
 	void addJointWeights( const JointWeights& jointWeights);
+	// Uploads the joints of the next end() as small integer ids and unorm16 weights for that many influences,
+	// instead of floats for all JOINTCOUNT. 0 keeps the float layout. The weights have to be pruned already.
+	void packJoints(int influences);
     void end();
     
     void activate();
@@ -111,7 +119,7 @@ public:
     unsigned int vertexCount() const { return VertexCount; }
     
     const std::vector<Vector3>& vertices() const { return Vertices; }
-    const std::vector<Vector3>& normals() const { return Vertices; }
+    const std::vector<Vector3>& normals() const { return Normals; }
     const std::vector<Color>& colors() const { return Colors; }
     const std::vector<Vector3>& texcoord0() const { return Texcoord0; }
     const std::vector<Vector3>& texcoord1() const { return Texcoord1; }
@@ -145,6 +153,7 @@ private:
     GLuint VAO;
     bool BuffersInitialized;
     unsigned int VertexCount;
+	int PackedInfluences;
     
     
 };
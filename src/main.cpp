@@ -1,8 +1,20 @@
 #include "MainWindow.h"
+#include "Customizable/InverseKinematicsKernels/FabrikIKKernel.h"
 #include <QtWidgets/QApplication>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+	// Throughput of the FABRIK kernel on one core, without opening the window
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--benchmark-ik") == 0)
+		{
+			qDebug() << "FabrikIKKernel:" << FabrikIKKernel::Benchmark(100000) << "full body solves per second on one thread";
+			return 0;
+		}
+	}
+
 	QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 	QApplication a(argc, argv);
 	MainWindow w;